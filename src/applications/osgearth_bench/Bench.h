@@ -0,0 +1,65 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef OSGEARTH_BENCH_H
+#define OSGEARTH_BENCH_H 1
+
+#include <osg/ArgumentParser>
+#include <osg/Timer>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace Bench
+{
+    //! Wall-clock stopwatch in milliseconds.
+    struct Stopwatch
+    {
+        osg::Timer_t _start;
+        Stopwatch() : _start(osg::Timer::instance()->tick()) { }
+        void reset() { _start = osg::Timer::instance()->tick(); }
+        double elapsedMS() const { return osg::Timer::instance()->delta_m(_start, osg::Timer::instance()->tick()); }
+    };
+
+    //! Prints one aligned result row.
+    inline void report(const std::string& name, double msPerIter, const std::string& extra = std::string())
+    {
+        std::cout
+            << "  " << std::left << std::setw(40) << name
+            << std::right << std::setw(10) << std::fixed << std::setprecision(3) << msPerIter << " ms"
+            << "  " << extra
+            << std::endl;
+    }
+
+    // Benchmark suites. Each returns a process exit code.
+#ifdef OSGEARTH_BENCH_HAVE_BCN
+    int texcomp(osg::ArgumentParser& args);
+#endif
+    int imageutils(osg::ArgumentParser& args);
+    int reproject(osg::ArgumentParser& args);
+    int paging(osg::ArgumentParser& args);
+    int script(osg::ArgumentParser& args);
+    int geojson(osg::ArgumentParser& args);
+    int tessellate(osg::ArgumentParser& args);
+    int featureimage(osg::ArgumentParser& args);
+}
+
+#endif // OSGEARTH_BENCH_H
@@ -0,0 +1,271 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Bench.h"
+
+#include <osgEarth/CoverageRasterizer>
+#include <osgEarth/FeatureImageLayer>
+#include <osgEarth/GeoJSON>
+#include <osgEarth/Map>
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/StyleSheet>
+#include <osgDB/FileUtils>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    double jitter(double amount)
+    {
+        return amount * ((double)::rand() / (double)RAND_MAX - 0.5);
+    }
+
+    // Writes parcel-like polygons and road-like polylines covering the
+    // given extent to a GeoJSON file.
+    bool makeFeatures(const std::string& file, const GeoExtent& extent, unsigned numParcels, unsigned numRoads)
+    {
+        std::ofstream out(file.c_str());
+        if (!out.is_open())
+            return false;
+
+        const SpatialReference* srs = extent.getSRS();
+        GeoJSONWriter writer(out);
+        writer.beginFeatureCollection();
+
+        for (unsigned i = 0; i < numParcels; ++i)
+        {
+            osg::Vec3d c(
+                extent.xMin() + extent.width() * (double)::rand() / (double)RAND_MAX,
+                extent.yMin() + extent.height() * (double)::rand() / (double)RAND_MAX,
+                0.0);
+
+            unsigned numVerts = 4u + (i % 9u);
+            double radius = 0.0005 * (1.0 + jitter(0.5));
+            osg::ref_ptr<Polygon> poly = new Polygon();
+            for (unsigned v = 0; v < numVerts; ++v)
+            {
+                double a = 2.0 * osg::PI * (double)v / (double)numVerts;
+                double r = radius * (1.0 + jitter(0.3));
+                poly->push_back(c + osg::Vec3d(r * cos(a), r * sin(a), 0.0));
+            }
+
+            osg::ref_ptr<Feature> feature = new Feature(poly.get(), srs);
+            writer.write(feature.get());
+        }
+
+        for (unsigned i = 0; i < numRoads; ++i)
+        {
+            osg::Vec3d p(
+                extent.xMin() + extent.width() * (double)::rand() / (double)RAND_MAX,
+                extent.yMin() + extent.height() * (double)::rand() / (double)RAND_MAX,
+                0.0);
+
+            double heading = 2.0 * osg::PI * (double)::rand() / (double)RAND_MAX;
+            osg::ref_ptr<LineString> line = new LineString();
+            for (unsigned v = 0; v < 64u; ++v)
+            {
+                line->push_back(p);
+                heading += jitter(0.6);
+                p += osg::Vec3d(0.002 * cos(heading), 0.002 * sin(heading), 0.0);
+            }
+
+            osg::ref_ptr<Feature> feature = new Feature(line.get(), srs);
+            writer.write(feature.get());
+        }
+
+        writer.endFeatureCollection();
+        return out.good();
+    }
+
+    // Renders every tile once, spread over the given number of threads.
+    double renderTiles(FeatureImageLayer* layer, const std::vector<TileKey>& keys, unsigned numThreads, unsigned& numImages)
+    {
+        std::atomic<unsigned> next(0u), images(0u);
+
+        Bench::Stopwatch timer;
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < numThreads; ++t)
+        {
+            threads.push_back(std::thread([&]()
+            {
+                for (unsigned k = next++; k < keys.size(); k = next++)
+                {
+                    GeoImage image = layer->createImage(keys[k], 0L);
+                    if (image.valid())
+                        ++images;
+                }
+            }));
+        }
+
+        for (unsigned t = 0; t < threads.size(); ++t)
+            threads[t].join();
+
+        numImages = images;
+        return timer.elapsedMS();
+    }
+
+    void run(FeatureImageLayer* layer, const std::vector<TileKey>& keys, unsigned numThreads, int iterations)
+    {
+        double ms = 0.0;
+        unsigned numImages = 0u;
+        for (int i = 0; i < iterations; ++i)
+            ms += renderTiles(layer, keys, numThreads, numImages);
+
+        double perIter = ms / (double)iterations;
+        std::ostringstream name, extra;
+        name << "FeatureImageLayer" << (layer->getAccumulateCoverage() ? " (accumulated)" : "") << ", "
+             << numThreads << (numThreads == 1u ? " tile thread, " : " tile threads, ")
+             << layer->getRenderThreads() << (layer->getRenderThreads() == 1u ? " render thread" : " render threads");
+        extra << (1000.0 * (double)keys.size() / perIter) << " tiles/s, " << numImages << " images";
+        Bench::report(name.str(), perIter, extra.str());
+    }
+
+    // Blends one full tile of coverage, so the SIMD span blender can be
+    // compared across builds in isolation from the feature pipeline.
+    void runBlend(unsigned size, int iterations)
+    {
+        std::vector<unsigned char> pixels(size * size * 4u, 0u), covers(size);
+        for (unsigned i = 0; i < size; ++i)
+            covers[i] = (unsigned char)(i * 255u / size);
+
+        const unsigned char abgr[4] = { 200, 40, 120, 220 };
+        const int reps = 50 * iterations;
+
+        Bench::Stopwatch timer;
+        for (int r = 0; r < reps; ++r)
+            for (unsigned row = 0; row < size; ++row)
+                CoverageRasterizer::blendSpan(&pixels[row * size * 4u], &covers[0], size, abgr);
+        double ms = timer.elapsedMS() / (double)reps;
+
+        std::ostringstream extra;
+        extra << size << "x" << size << " pixels, checksum " << (unsigned)pixels[(size * size * 4u) / 2u];
+        Bench::report("CoverageRasterizer::blendSpan", ms, extra.str());
+    }
+}
+
+int
+Bench::featureimage(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --file <path>    ; feature layer to render (default: synthetic parcels and roads)"
+            << "\n  --level <n>      ; LOD of the tiles to render (default 12)"
+            << "\n  --threads <n>    ; threads for the parallel runs (default: all cores)"
+            << "\n  --iterations <n> ; runs of each test (default 3)"
+            << std::endl;
+        return 0;
+    }
+
+    std::string file;
+    unsigned level = 12u;
+    unsigned numThreads = std::thread::hardware_concurrency();
+    int iterations = 3;
+    args.read("--file", file);
+    args.read("--level", level);
+    args.read("--threads", numThreads);
+    args.read("--iterations", iterations);
+    iterations = osg::maximum(iterations, 1);
+    numThreads = osg::maximum(numThreads, 1u);
+
+    osg::ref_ptr<const Profile> profile = Profile::create("global-geodetic");
+
+    std::string tempFile;
+    if (file.empty())
+    {
+        ::srand(1);
+        GeoExtent extent(profile->getSRS(), 0.0, 0.0, 0.5, 0.5);
+        tempFile = osgDB::concatPaths(osgDB::getCurrentWorkingDirectory(), "osgearth_bench_featureimage.geojson");
+        if (!makeFeatures(tempFile, extent, 20000u, 500u))
+        {
+            std::cout << "  Cannot write \"" << tempFile << "\"" << std::endl;
+            return -1;
+        }
+        file = tempFile;
+    }
+
+    osg::ref_ptr<OGRFeatureSource> features = new OGRFeatureSource();
+    features->setURL(file);
+    features->setCachePolicy(CachePolicy::NO_CACHE);
+
+    Style style;
+    style.getOrCreate<PolygonSymbol>()->fill()->color() = Color(Color::Yellow, 0.6f);
+    style.getOrCreate<LineSymbol>()->stroke()->color() = Color::White;
+    style.getOrCreate<LineSymbol>()->stroke()->width() = 4.0f;
+    StyleSheet* sheet = new StyleSheet();
+    sheet->addStyle(style);
+
+    osg::ref_ptr<FeatureImageLayer> layer = new FeatureImageLayer();
+    layer->setFeatureSource(features.get());
+    layer->setStyleSheet(sheet);
+    layer->setCachePolicy(CachePolicy::NO_CACHE);
+    layer->setRenderThreads(1u);
+
+    osg::ref_ptr<Map> map = new Map();
+    map->addLayer(layer.get());
+
+    int result = 0;
+    if (layer->getStatus().isError() || !features->getFeatureProfile())
+    {
+        std::cout << "  Cannot open \"" << file << "\": " << layer->getStatus().message() << std::endl;
+        result = -1;
+    }
+    else
+    {
+        std::vector<TileKey> keys;
+        profile->getIntersectingTiles(features->getFeatureProfile()->getExtent(), level, keys);
+
+        std::cout << "  " << file << ": " << keys.size() << " tiles at LOD " << level << std::endl;
+
+        runBlend(256u, iterations);
+
+        // the GEOS-buffer renderer, then the coverage-accumulating one:
+        for (int accumulate = 0; accumulate < 2; ++accumulate)
+        {
+            layer->setAccumulateCoverage(accumulate == 1);
+            run(layer.get(), keys, 1u, iterations);
+            if (numThreads > 1u)
+            {
+                // tiles in parallel, then the features of each tile in parallel:
+                run(layer.get(), keys, numThreads, iterations);
+                layer->setRenderThreads(numThreads);
+                run(layer.get(), keys, 1u, iterations);
+                layer->setRenderThreads(1u);
+            }
+        }
+    }
+
+    map->removeLayer(layer.get());
+
+    if (!tempFile.empty())
+        ::remove(tempFile.c_str());
+
+    return result;
+}
@@ -0,0 +1,234 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Bench.h"
+
+#include <osgEarth/Feature>
+#include <osgEarth/GeoJSON>
+#include <osgEarth/Geometry>
+#include <osgEarth/JsonUtils>
+#include <osgEarth/OgrUtils>
+#include <osgEarth/StringUtils>
+#include <osg/Math>
+#include <cmath>
+#include <sstream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    FeatureList makeFeatures(unsigned count, unsigned numVerts)
+    {
+        FeatureList features;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Polygon* poly = new Polygon();
+            double step = 2.0 * osg::PI / (double)numVerts;
+            for (unsigned v = 0; v < numVerts; ++v)
+                poly->push_back(osg::Vec3d(
+                    0.001 * cos(v*step) + 0.01 * (double)(i % 1000),
+                    0.001 * sin(v*step) + 0.01 * (double)(i / 1000),
+                    0.0));
+
+            Feature* feature = new Feature(poly, 0L, Style(), (FeatureID)i);
+            feature->set("name", Stringify() << "building_" << i);
+            feature->set("height", 10.0 + (double)(i % 40));
+            feature->set("floors", (long long)(i % 12));
+            feature->set("residential", (i % 3) == 0);
+            features.push_back(feature);
+        }
+        return features;
+    }
+
+    // The previous writer: export the geometry through OGR, parse it back
+    // into a jsoncpp document, add the properties and print the document.
+    std::string oldFeatureToGeoJSON(const Feature* feature)
+    {
+        std::string geometry;
+        OGRGeometryH g = OgrUtils::createOgrGeometry(feature->getGeometry());
+        if (g)
+        {
+            char* buf = OGR_G_ExportToJson(g);
+            if (buf)
+            {
+                geometry = buf;
+                OGRFree(buf);
+            }
+            OGR_G_DestroyGeometry(g);
+        }
+
+        Json::Value root(Json::objectValue);
+        root["type"] = "Feature";
+        root["id"] = (double)feature->getFID();
+
+        Json::Reader reader;
+        Json::Value geometryValue(Json::objectValue);
+        if (reader.parse(geometry, geometryValue))
+            root["geometry"] = geometryValue;
+
+        Json::Value props(Json::objectValue);
+        const AttributeTable& attrs = feature->getAttrs();
+        for (AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+        {
+            if (!a->second.second.set)
+                props[a->first] = Json::nullValue;
+            else if (a->second.first == ATTRTYPE_INT)
+                props[a->first] = (double)a->second.getInt();
+            else if (a->second.first == ATTRTYPE_DOUBLE)
+                props[a->first] = a->second.getDouble();
+            else if (a->second.first == ATTRTYPE_BOOL)
+                props[a->first] = a->second.getBool();
+            else
+                props[a->first] = a->second.getString();
+        }
+        root["properties"] = props;
+        return Json::FastWriter().write(root);
+    }
+
+    std::string oldWrite(const FeatureList& features)
+    {
+        std::stringstream buf;
+        buf << "{\"type\": \"FeatureCollection\", \"features\": [";
+        for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+        {
+            if (i != features.begin())
+                buf << ",";
+            buf << oldFeatureToGeoJSON(i->get());
+        }
+        buf << "]}";
+        return buf.str();
+    }
+
+    // The previous reader: open the text with the OGR GeoJSON driver and
+    // convert each OGR feature.
+    bool oldRead(const std::string& json, FeatureList& output)
+    {
+        OGRSFDriverH driver = OGRGetDriverByName("GeoJSON");
+        OGRDataSourceH ds = driver ? OGROpen(json.c_str(), FALSE, &driver) : 0L;
+        if (!ds)
+            return false;
+
+        OGRLayerH layer = OGR_DS_GetLayer(ds, 0);
+        if (layer)
+        {
+            OGR_L_ResetReading(layer);
+            OGRFeatureH handle;
+            while ((handle = OGR_L_GetNextFeature(layer)) != NULL)
+            {
+                output.push_back(OgrUtils::createFeature(handle, (const SpatialReference*)0L, true));
+                OGR_F_Destroy(handle);
+            }
+        }
+        OGR_DS_Destroy(ds);
+        return true;
+    }
+
+    void reportThroughput(const char* name, double ms, int iterations, size_t bytes, unsigned count)
+    {
+        double perIter = ms / (double)iterations;
+        std::ostringstream extra;
+        extra << (0.001 * (double)bytes / perIter) << " MB/s, "
+            << (1000.0 * (double)count / perIter) << " features/s";
+        Bench::report(name, perIter, extra.str());
+    }
+}
+
+int
+Bench::geojson(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --features <n>   ; polygons per collection (default 20000)"
+            << "\n  --verts <n>      ; vertices per polygon (default 32)"
+            << "\n  --iterations <n> ; runs of each test (default 5)"
+            << std::endl;
+        return 0;
+    }
+
+    int numFeatures = 20000;
+    int numVerts = 32;
+    int iterations = 5;
+    args.read("--features", numFeatures);
+    args.read("--verts", numVerts);
+    args.read("--iterations", iterations);
+    numFeatures = osg::maximum(numFeatures, 1);
+    numVerts = osg::maximum(numVerts, 3);
+    iterations = osg::maximum(iterations, 1);
+
+    OGRRegisterAll();
+
+    FeatureList features = makeFeatures(numFeatures, numVerts);
+
+    std::cout << "  " << numFeatures << " polygons with " << numVerts
+        << " vertices and 4 attributes each" << std::endl;
+
+    std::string oldJSON, newJSON;
+    {
+        Bench::Stopwatch timer;
+        for (int i = 0; i < iterations; ++i)
+            oldJSON = oldWrite(features);
+        reportThroughput("write, OGR + jsoncpp", timer.elapsedMS(), iterations, oldJSON.size(), numFeatures);
+    }
+    {
+        Bench::Stopwatch timer;
+        for (int i = 0; i < iterations; ++i)
+            newJSON = GeoJSONWriter::toGeoJSON(features);
+        reportThroughput("write, GeoJSONWriter", timer.elapsedMS(), iterations, newJSON.size(), numFeatures);
+    }
+
+    unsigned oldCount = 0u, newCount = 0u;
+    {
+        Bench::Stopwatch timer;
+        for (int i = 0; i < iterations; ++i)
+        {
+            FeatureList output;
+            if (!oldRead(newJSON, output))
+            {
+                std::cout << "  OGR failed to read the collection" << std::endl;
+                return -1;
+            }
+            oldCount = output.size();
+        }
+        reportThroughput("read, OGR GeoJSON driver", timer.elapsedMS(), iterations, newJSON.size(), numFeatures);
+    }
+    {
+        GeoJSONReader reader;
+        Bench::Stopwatch timer;
+        for (int i = 0; i < iterations; ++i)
+        {
+            FeatureList output;
+            if (!reader.read(newJSON, output))
+            {
+                std::cout << "  GeoJSONReader failed: " << reader.getError() << std::endl;
+                return -1;
+            }
+            newCount = output.size();
+        }
+        reportThroughput("read, GeoJSONReader", timer.elapsedMS(), iterations, newJSON.size(), numFeatures);
+    }
+
+    if (oldCount != newCount)
+        std::cout << "  WARNING: feature counts differ (" << oldCount << " vs. " << newCount << ")" << std::endl;
+
+    return 0;
+}
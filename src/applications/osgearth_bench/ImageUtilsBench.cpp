@@ -0,0 +1,252 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Bench.h"
+
+#include <osg/Image>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Random>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    struct Format
+    {
+        const char* name;
+        GLenum pixelFormat;
+        GLenum dataType;
+    };
+
+    osg::Image* makeTile(int size, const Format& format, unsigned seed)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, format.pixelFormat, format.dataType);
+        Random prng(seed);
+        unsigned char* data = image->data();
+        if (format.dataType == GL_FLOAT)
+        {
+            for (unsigned i = 0; i < image->getTotalSizeInBytes() / sizeof(float); ++i)
+                ((float*)data)[i] = (float)(prng.next() * 4000.0);
+        }
+        else
+        {
+            for (unsigned i = 0; i < image->getTotalSizeInBytes(); ++i)
+                data[i] = (unsigned char)prng.next(256);
+        }
+        return image;
+    }
+
+    // Largest per-byte difference between two images' data, or -1 if the
+    // images are not comparable.
+    int maxDiff(const osg::Image* a, const osg::Image* b)
+    {
+        if (!a || !b || a->getTotalSizeInBytes() != b->getTotalSizeInBytes())
+            return -1;
+        int result = 0;
+        for (unsigned i = 0; i < a->getTotalSizeInBytes(); ++i)
+            result = osg::maximum(result, abs((int)a->data()[i] - (int)b->data()[i]));
+        return result;
+    }
+
+    //! One ImageUtils operation; run() returns the image to compare (or null).
+    struct Op
+    {
+        virtual ~Op() { }
+        virtual const char* name() const = 0;
+        virtual osg::Image* run(const osg::Image* input) = 0;
+    };
+
+    struct ResizeUp : public Op {
+        const char* name() const { return "resize 2x"; }
+        osg::Image* run(const osg::Image* input) {
+            osg::ref_ptr<osg::Image> out;
+            ImageUtils::resizeImage(input, input->s()*2, input->t()*2, out);
+            return out.release();
+        }
+    };
+
+    struct ResizeDown : public Op {
+        const char* name() const { return "resize 0.5x nearest"; }
+        osg::Image* run(const osg::Image* input) {
+            osg::ref_ptr<osg::Image> out;
+            ImageUtils::resizeImage(input, input->s()/2, input->t()/2, out, 0, false);
+            return out.release();
+        }
+    };
+
+    struct Mix : public Op {
+        osg::ref_ptr<osg::Image> _src;
+        const char* name() const { return "mix"; }
+        osg::Image* run(const osg::Image* input) {
+            osg::Image* out = ImageUtils::cloneImage(input);
+            ImageUtils::mix(out, _src.get(), 0.5f);
+            return out;
+        }
+    };
+
+    struct ConvertRGBA8 : public Op {
+        const char* name() const { return "convert to RGBA8"; }
+        osg::Image* run(const osg::Image* input) {
+            return ImageUtils::convert(input, GL_RGBA, GL_UNSIGNED_BYTE);
+        }
+    };
+
+    struct SingleColor : public Op {
+        const char* name() const { return "isSingleColorImage"; }
+        osg::Image* run(const osg::Image* input) {
+            // worst case: every pixel has to be visited.
+            osg::ref_ptr<osg::Image> solid = ImageUtils::cloneImage(input);
+            ::memset(solid->data(), 0x40, solid->getTotalSizeInBytes());
+            ImageUtils::isSingleColorImage(solid.get());
+            return 0L;
+        }
+    };
+
+    struct IsEmpty : public Op {
+        osg::ref_ptr<osg::Image> _empty;
+        const char* name() const { return "isEmptyImage"; }
+        osg::Image* run(const osg::Image*) {
+            ImageUtils::isEmptyImage(_empty.get());
+            return 0L;
+        }
+    };
+
+    struct Feather : public Op {
+        const char* name() const { return "featherAlphaRegions"; }
+        osg::Image* run(const osg::Image* input) {
+            osg::Image* out = ImageUtils::cloneImage(input);
+            ImageUtils::featherAlphaRegions(out, 0.5f);
+            return out;
+        }
+    };
+
+    struct Bicubic : public Op {
+        const char* name() const { return "bicubicUpsample"; }
+        osg::Image* run(const osg::Image* input) {
+            osg::Image* out = ImageUtils::cloneImage(input);
+            ImageUtils::bicubicUpsample(input, out, 0, 4);
+            return out;
+        }
+    };
+
+    struct MipmapBlend : public Op {
+        const char* name() const { return "createMipmapBlendedImage"; }
+        osg::Image* run(const osg::Image* input) {
+            return ImageUtils::createMipmapBlendedImage(input, input);
+        }
+    };
+
+    double timeOp(Op& op, const osg::Image* input, int iterations, osg::ref_ptr<osg::Image>& result)
+    {
+        Bench::Stopwatch timer;
+        for (int i = 0; i < iterations; ++i)
+            result = op.run(input);
+        return timer.elapsedMS() / (double)iterations;
+    }
+}
+
+int
+Bench::imageutils(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --size <n>       ; tile size (default 256)"
+            << "\n  --iterations <n> ; repetitions per case (default 20)"
+            << std::endl;
+        return 0;
+    }
+
+    int size = 256;
+    int iterations = 20;
+    args.read("--size", size);
+    args.read("--iterations", iterations);
+
+    std::cout << "  " << size << "x" << size << ", " << iterations << " iterations;"
+        << " generic PixelReader/PixelWriter path vs. pixel kernels" << std::endl;
+
+    const Format formats[] = {
+        { "RGBA8", GL_RGBA, GL_UNSIGNED_BYTE },
+        { "RGB8",  GL_RGB,  GL_UNSIGNED_BYTE },
+        { "R32F",  GL_RED,  GL_FLOAT },
+        { "RG16",  GL_RG,   GL_UNSIGNED_SHORT }
+    };
+
+    Format rgba8 = formats[0];
+
+    ResizeUp resizeUp;
+    ResizeDown resizeDown;
+    Mix mix;
+    mix._src = makeTile(size, rgba8, 7u);
+    ConvertRGBA8 convert;
+    SingleColor singleColor;
+    IsEmpty isEmpty;
+    isEmpty._empty = ImageUtils::createEmptyImage(size, size);
+    Feather feather;
+    Bicubic bicubic;
+    MipmapBlend mipmapBlend;
+
+    Op* allFormats[] = { &resizeUp, &resizeDown, &mix, &convert, &singleColor, &bicubic };
+    Op* rgbaOnly[] = { &isEmpty, &feather, &mipmapBlend };
+
+    bool oldValue = ImageUtils::getPixelKernelsEnabled();
+
+    for (unsigned f = 0; f < sizeof(formats)/sizeof(formats[0]); ++f)
+    {
+        osg::ref_ptr<osg::Image> input = makeTile(size, formats[f], 1u + f);
+
+        std::vector<Op*> ops(allFormats, allFormats + sizeof(allFormats)/sizeof(allFormats[0]));
+        if (f == 0)
+            ops.insert(ops.end(), rgbaOnly, rgbaOnly + sizeof(rgbaOnly)/sizeof(rgbaOnly[0]));
+
+        for (unsigned i = 0; i < ops.size(); ++i)
+        {
+            osg::ref_ptr<osg::Image> generic, fast;
+
+            ImageUtils::setPixelKernelsEnabled(false);
+            double genericMS = timeOp(*ops[i], input.get(), iterations, generic);
+
+            ImageUtils::setPixelKernelsEnabled(true);
+            double fastMS = timeOp(*ops[i], input.get(), iterations, fast);
+
+            std::ostringstream name;
+            name << formats[f].name << " " << ops[i]->name();
+
+            std::ostringstream extra;
+            extra << "generic " << std::setprecision(3) << genericMS << " ms, "
+                << std::setprecision(1) << (fastMS > 0.0 ? genericMS/fastMS : 0.0) << "x";
+            if (generic.valid())
+                extra << ", max diff " << maxDiff(generic.get(), fast.get());
+
+            Bench::report(name.str(), fastMS, extra.str());
+        }
+    }
+
+    ImageUtils::setPixelKernelsEnabled(oldValue);
+
+    return 0;
+}
@@ -0,0 +1,420 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Terrain paging simulator. Drives the terrain engine's update and cull
+ * traversals along a scripted camera path with osgUtil::SceneView, which
+ * needs no graphics context, so tile selection, loading and unloading run
+ * exactly as they would in a viewer -- minus the drawing. The GL object
+ * compilers in the scene stand in for the draw: each frame they work
+ * through their queues under their usual budget, without a GL state.
+ */
+#include "Bench.h"
+
+#include <osgEarth/MapNode>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/TerrainEngineNode>
+#include <osgEarth/GLObjectCompiler>
+#include <osgEarth/NodeUtils>
+#include <osgEarth/StringUtils>
+#include <osgUtil/SceneView>
+#include <osgDB/DatabasePager>
+#include <osgDB/ReadFile>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    /**
+     * Solid-color imagery generated on the fly, with an optional
+     * per-tile delay to mimic a remote source.
+     */
+    class SyntheticImageLayer : public ImageLayer
+    {
+    public:
+        META_Layer(osgEarth, SyntheticImageLayer, Options, ImageLayer, synthetic_image);
+
+        unsigned _latencyMS;
+
+        virtual void init()
+        {
+            ImageLayer::init();
+            _latencyMS = 0u;
+            layerHints().cachePolicy() = CachePolicy::NO_CACHE;
+            if (getName().empty())
+                setName("Synthetic");
+        }
+
+        virtual Status openImplementation()
+        {
+            Status parent = ImageLayer::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setProfile(Profile::create("global-geodetic"));
+            return Status::NoError;
+        }
+
+        virtual GeoImage createImageImplementation(const TileKey& key, ProgressCallback* progress) const
+        {
+            // sleep in small slices so cancelation is noticed promptly.
+            for (unsigned t = 0; t < _latencyMS; t += 5u)
+            {
+                if (progress && progress->isCanceled())
+                    return GeoImage::INVALID;
+                OpenThreads::Thread::microSleep(5000);
+            }
+
+            static const unsigned char colors[4][3] = {
+                { 255, 64, 64 }, { 64, 255, 64 }, { 64, 64, 255 }, { 255, 255, 64 } };
+            const unsigned char* c = colors[key.getLOD() % 4];
+
+            osg::Image* image = new osg::Image();
+            image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            unsigned char* p = image->data();
+            for (unsigned i = 0; i < 256u * 256u; ++i, p += 4)
+            {
+                p[0] = c[0]; p[1] = c[1]; p[2] = c[2]; p[3] = 255;
+            }
+
+            return GeoImage(image, key.getExtent());
+        }
+
+    protected:
+        virtual ~SyntheticImageLayer() { }
+    };
+
+    //! Camera keyframe (time in seconds; degrees; meters)
+    struct Keyframe
+    {
+        double time, lon, lat, range, heading, pitch;
+    };
+
+    bool builtInPath(const std::string& name, std::vector<Keyframe>& path)
+    {
+        if (name == "zoom")
+        {
+            // straight down from orbit to street level
+            Keyframe k0 = { 0.0,  -77.03, 38.89, 2.0e7,  0.0, -90.0 };
+            Keyframe k1 = { 20.0, -77.03, 38.89, 2000.0, 0.0, -90.0 };
+            path.push_back(k0); path.push_back(k1);
+        }
+        else if (name == "pan")
+        {
+            // low oblique flight across ten degrees of longitude
+            Keyframe k0 = { 0.0,  -82.0, 40.0, 20000.0, 90.0, -45.0 };
+            Keyframe k1 = { 30.0, -72.0, 40.0, 20000.0, 90.0, -45.0 };
+            path.push_back(k0); path.push_back(k1);
+        }
+        else if (name == "orbit")
+        {
+            // full turn around a point
+            Keyframe k0 = { 0.0,  -77.03, 38.89, 5000.0, 0.0,   -30.0 };
+            Keyframe k1 = { 30.0, -77.03, 38.89, 5000.0, 360.0, -30.0 };
+            path.push_back(k0); path.push_back(k1);
+        }
+        return !path.empty();
+    }
+
+    // One keyframe per line: time lon lat range heading pitch ('#' starts a comment)
+    bool readPath(const std::string& filename, std::vector<Keyframe>& path)
+    {
+        std::ifstream in(filename.c_str());
+        std::string line;
+        while (std::getline(in, line))
+        {
+            line = trim(line);
+            if (line.empty() || line[0] == '#')
+                continue;
+
+            std::istringstream buf(line);
+            Keyframe k;
+            if (buf >> k.time >> k.lon >> k.lat >> k.range >> k.heading >> k.pitch)
+                path.push_back(k);
+        }
+        return !path.empty();
+    }
+
+    Keyframe interpolate(const std::vector<Keyframe>& path, double t)
+    {
+        if (t <= path.front().time)
+            return path.front();
+        if (t >= path.back().time)
+            return path.back();
+
+        unsigned i = 1;
+        while (path[i].time < t)
+            ++i;
+
+        const Keyframe& a = path[i-1];
+        const Keyframe& b = path[i];
+        double u = (t - a.time) / (b.time - a.time);
+
+        Keyframe k;
+        k.time = t;
+        k.lon = a.lon + (b.lon - a.lon)*u;
+        k.lat = a.lat + (b.lat - a.lat)*u;
+        k.heading = a.heading + (b.heading - a.heading)*u;
+        k.pitch = a.pitch + (b.pitch - a.pitch)*u;
+        // range changes geometrically, like a manipulator zoom:
+        k.range = a.range * pow(b.range / a.range, u);
+        return k;
+    }
+
+    // View matrix looking at a point on the ellipsoid from the given
+    // heading, pitch and range (same conventions as a Viewpoint).
+    osg::Matrixd computeViewMatrix(const SpatialReference* srs, const Keyframe& k, osg::Vec3d& out_eye)
+    {
+        GeoPoint focus(srs->getGeographicSRS(), k.lon, k.lat, 0.0, ALTMODE_ABSOLUTE);
+        osg::Matrixd local2world;
+        focus.transform(srs).createLocalToWorld(local2world);
+
+        double h = osg::DegreesToRadians(k.heading);
+        double p = osg::DegreesToRadians(osg::clampBetween(k.pitch, -90.0, -1.0));
+
+        // look vector and up vector in the local ENU frame:
+        osg::Vec3d look(sin(h)*cos(p), cos(h)*cos(p), sin(p));
+        osg::Vec3d up = (look ^ osg::Vec3d(0,0,1)) ^ look;
+        if (up.length2() < 1e-12)
+            up.set(sin(h), cos(h), 0.0);
+        up.normalize();
+
+        osg::Vec3d center = osg::Vec3d(0,0,0) * local2world;
+        out_eye = (-look * k.range) * local2world;
+        osg::Vec3d upWorld = osg::Matrixd::transform3x3(up, local2world);
+
+        return osg::Matrixd::lookAt(out_eye, center, upWorld);
+    }
+}
+
+int
+Bench::paging(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --earth <file>      ; earth file to load (default: synthetic imagery)"
+            << "\n  --latency <ms>      ; per-tile delay of the synthetic layer (default 0)"
+            << "\n  --path <name|file>  ; zoom, pan, orbit, or a keyframe file (default zoom)"
+            << "\n                        file lines: time lon lat range heading pitch"
+            << "\n  --loader <type>     ; native or pager (default: terrain options)"
+            << "\n  --compile-budget <ms> ; per-frame GL compile budget (default: terrain options)"
+            << "\n  --fps <n>           ; simulated frame rate (default 60)"
+            << "\n  --size <w> <h>      ; viewport size in pixels (default 1920 1080)"
+            << "\n  --settle <s>        ; max seconds to wait for loading after the path ends (default 30)"
+            << "\n  --csv <file>        ; write per-frame counters to a CSV file"
+            << std::endl;
+        return 0;
+    }
+
+    std::string earthFile, pathName = "zoom", loaderType, csvFile;
+    unsigned latency = 0u;
+    double fps = 60.0, settle = 30.0;
+    float compileBudget = -1.0f;
+    int width = 1920, height = 1080;
+    args.read("--earth", earthFile);
+    args.read("--latency", latency);
+    args.read("--path", pathName);
+    args.read("--loader", loaderType);
+    args.read("--compile-budget", compileBudget);
+    args.read("--fps", fps);
+    args.read("--size", width, height);
+    args.read("--settle", settle);
+    args.read("--csv", csvFile);
+
+    std::vector<Keyframe> path;
+    if (!builtInPath(pathName, path) && !readPath(pathName, path))
+    {
+        std::cout << "  Unknown path \"" << pathName << "\"" << std::endl;
+        return -1;
+    }
+
+    osg::ref_ptr<MapNode> mapNode;
+    osg::ref_ptr<osg::Node> loaded;
+    if (!earthFile.empty())
+    {
+        loaded = osgDB::readRefNodeFile(earthFile);
+        mapNode = MapNode::get(loaded.get());
+        if (!mapNode.valid())
+        {
+            std::cout << "  No map node in \"" << earthFile << "\"" << std::endl;
+            return -1;
+        }
+    }
+    else
+    {
+        Map* map = new Map();
+        SyntheticImageLayer* layer = new SyntheticImageLayer();
+        layer->_latencyMS = latency;
+        map->addLayer(layer);
+        mapNode = new MapNode(map);
+    }
+
+    // must happen before the first traversal opens the map node:
+    if (loaderType == "native")
+        mapNode->getTerrainOptions().setNativeLoader(true);
+    else if (loaderType == "pager")
+        mapNode->getTerrainOptions().setNativeLoader(false);
+
+    if (compileBudget >= 0.0f)
+        mapNode->getTerrainOptions().setCompileBudget(compileBudget);
+
+    // GL object compilers in the scene; found once the map node has opened
+    std::vector<GLObjectCompiler*> compilers;
+    bool foundCompilers = false;
+    unsigned compiledItems = 0u;
+
+    osg::ref_ptr<osg::FrameStamp> frameStamp = new osg::FrameStamp();
+
+    osg::ref_ptr<osgUtil::SceneView> sceneView = new osgUtil::SceneView();
+    sceneView->setDefaults(osgUtil::SceneView::NO_SCENEVIEW_LIGHT);
+    sceneView->setSceneData(loaded.valid() ? loaded.get() : mapNode.get());
+    sceneView->setFrameStamp(frameStamp.get());
+    sceneView->setViewport(0, 0, width, height);
+    sceneView->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+
+    // The pager loader needs a database pager attached to the cull visitor.
+    osg::ref_ptr<osgDB::DatabasePager> pager = osgDB::DatabasePager::create();
+    sceneView->getCullVisitor()->setDatabaseRequestHandler(pager.get());
+    sceneView->getUpdateVisitor()->setDatabaseRequestHandler(pager.get());
+
+    std::ofstream csv;
+    if (!csvFile.empty())
+    {
+        csv.open(csvFile.c_str());
+        csv << "frame,time_s,moving,requested,loaded,canceled,expired,expired_unused,resident,pending\n";
+    }
+
+    const SpatialReference* srs = mapNode->getMapSRS();
+    const double frameTime = 1.0 / osg::maximum(fps, 1.0);
+    const double pathEnd = path.back().time;
+    const double quietTime = 0.5; // seconds without paging activity that count as "done"
+
+    TerrainEngineNode::PagingStats stats, last;
+    unsigned peakResident = 0u, peakPending = 0u;
+    double lastActivity = 0.0;
+    double totalFrameMS = 0.0;
+    unsigned frame = 0u;
+    bool settled = false;
+
+    Stopwatch clock;
+
+    for (double t = 0.0; ; t += frameTime)
+    {
+        bool moving = t <= pathEnd;
+        if (!moving && (t - pathEnd > settle || t - lastActivity > quietTime))
+        {
+            settled = (t - lastActivity > quietTime);
+            break;
+        }
+
+        ++frame;
+        frameStamp->setFrameNumber(frame);
+        frameStamp->setReferenceTime(t);
+        frameStamp->setSimulationTime(t);
+
+        Keyframe k = interpolate(path, t);
+        osg::Vec3d eye;
+        sceneView->setViewMatrix(computeViewMatrix(srs, k, eye));
+
+        double nearPlane = osg::maximum(1.0, k.range * 0.001);
+        sceneView->setProjectionMatrixAsPerspective(30.0, (double)width / (double)height, nearPlane, k.range + 2.0e7);
+
+        Stopwatch frameClock;
+
+        pager->signalBeginFrame(frameStamp.get());
+        sceneView->update();
+        pager->updateSceneGraph(*frameStamp.get());
+        sceneView->cull();
+        pager->signalEndFrame();
+
+        totalFrameMS += frameClock.elapsedMS();
+
+        // Nothing draws here, so run the compilers the draw would have run.
+        // Without a GL state their items only advance the queues, so this
+        // measures how the budget paces merging, not GL compile cost.
+        if (!foundCompilers && mapNode->getTerrainEngine())
+        {
+            FindNodesVisitor<GLObjectCompiler> finder;
+            sceneView->getSceneData()->accept(finder);
+            compilers = finder._results;
+            foundCompilers = true;
+        }
+        for (unsigned i = 0; i < compilers.size(); ++i)
+            compiledItems += compilers[i]->compile(0L, compilers[i]->getFrameBudget());
+
+        if (mapNode->getTerrainEngine())
+            stats = mapNode->getTerrainEngine()->getPagingStats();
+
+        if (stats._pending > 0 || stats._requested != last._requested || stats._loaded != last._loaded || moving)
+            lastActivity = t;
+
+        peakResident = osg::maximum(peakResident, stats._resident);
+        peakPending = osg::maximum(peakPending, stats._pending);
+        last = stats;
+
+        if (csv.is_open())
+        {
+            csv << frame << "," << t << "," << (moving ? 1 : 0) << ","
+                << stats._requested << "," << stats._loaded << "," << stats._canceled << ","
+                << stats._expired << "," << stats._expiredUnused << ","
+                << stats._resident << "," << stats._pending << "\n";
+        }
+
+        // run in real time so the background loader keeps pace as it would in a viewer.
+        double ahead = (t + frameTime) - clock.elapsedMS()*0.001;
+        if (ahead > 0.0)
+            OpenThreads::Thread::microSleep((unsigned)(ahead * 1.0e6));
+    }
+
+    unsigned wasted = last._canceled + last._expiredUnused;
+
+    std::cout << "  path \"" << pathName << "\" (" << pathEnd << " s), " << frame << " frames" << std::endl;
+    Bench::report("update+cull per frame", totalFrameMS / (double)osg::maximum(frame, 1u));
+    if (settled)
+        Bench::report("time to full resolution", osg::maximum(lastActivity - pathEnd, 0.0) * 1000.0);
+    else
+        std::cout << "  time to full resolution: did not settle within " << settle << " s" << std::endl;
+
+    std::cout
+        << "  requested " << last._requested
+        << ", loaded " << last._loaded
+        << ", wasted " << wasted << " (" << last._canceled << " canceled, " << last._expiredUnused << " evicted unused)"
+        << "\n  resident " << last._resident << " (peak " << peakResident << ")"
+        << ", peak pending " << peakPending
+        << ", expired " << last._expired
+        << "\n  GL compile items " << compiledItems
+        << " (budget " << mapNode->getTerrainOptions().getCompileBudget() << " ms)"
+        << std::endl;
+
+    if (last._requested > 0u && last._loaded == 0u)
+    {
+        std::cout << "  No tile data was merged" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Bench.h"
+
+#include <osgEarth/GeoData>
+#include <osgEarth/ImageWarp>
+#include <osgEarth/Profile>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/TileKey>
+#include <sstream>
+
+using namespace osgEarth;
+
+namespace
+{
+    osg::Image* makeSource(int size)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        for (int t = 0; t < size; ++t)
+        {
+            for (int s = 0; s < size; ++s)
+            {
+                unsigned char* p = image->data(s, t);
+                p[0] = (unsigned char)s; p[1] = (unsigned char)t; p[2] = (unsigned char)(s^t); p[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    struct Config
+    {
+        const char* name;
+        double maxError;
+        unsigned cachedGrids;
+        unsigned threads;
+    };
+}
+
+int
+Bench::reproject(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --size <n>       ; output tile size (default 256)"
+            << "\n  --tiles <n>      ; tiles per run (default 64)"
+            << "\n  --passes <n>     ; repeat the same tiles this many times (default 2)"
+            << std::endl;
+        return 0;
+    }
+
+    int size = 256;
+    int numTiles = 64;
+    int passes = 2;
+    args.read("--size", size);
+    args.read("--tiles", numTiles);
+    args.read("--passes", passes);
+
+    // UTM zone 33N imagery warped onto level-9 geodetic tiles:
+    osg::ref_ptr<const SpatialReference> utm = SpatialReference::create("epsg:32633");
+    osg::ref_ptr<const Profile> geodetic = Profile::create("global-geodetic");
+    if (!utm.valid() || !geodetic.valid())
+    {
+        std::cout << "Failed to create SRS" << std::endl;
+        return -1;
+    }
+
+    TileKey origin = geodetic->createTileKey(15.0, 45.0, 9u);
+
+    std::vector<GeoImage> sources;
+    std::vector<GeoExtent> targets;
+    osg::ref_ptr<osg::Image> sourceImage = makeSource(size * 2);
+    for (int i = 0; i < numTiles; ++i)
+    {
+        TileKey key(9u, origin.getTileX() + (i % 8), origin.getTileY() + (i / 8), geodetic.get());
+        GeoExtent utmExtent = key.getExtent().transform(utm.get());
+        sources.push_back(GeoImage(sourceImage.get(), utmExtent));
+        targets.push_back(key.getExtent());
+    }
+
+    std::cout << "  " << numTiles << " tiles of " << size << "x" << size << ", UTM 33N -> geodetic, "
+        << passes << " passes" << std::endl;
+
+    const Config configs[] = {
+        { "exact, 1 thread",             0.0,   0u,   1u },
+        { "grid, 1 thread, no cache",    0.125, 0u,   1u },
+        { "grid, 1 thread, cached",      0.125, 128u, 1u },
+        { "grid, all threads, cached",   0.125, 128u, 0u }
+    };
+
+    for (unsigned c = 0; c < sizeof(configs)/sizeof(configs[0]); ++c)
+    {
+        const Config& config = configs[c];
+        ImageWarp::setMaxError(config.maxError);
+        ImageWarp::setMaxCachedGrids(config.cachedGrids);
+        ImageWarp::setNumThreads(config.threads);
+        ImageWarp::clearCache();
+
+        Bench::Stopwatch timer;
+        for (int pass = 0; pass < passes; ++pass)
+            for (unsigned i = 0; i < sources.size(); ++i)
+                sources[i].reproject(geodetic->getSRS(), &targets[i], size, size, true);
+
+        double ms = timer.elapsedMS() / (double)(passes * sources.size());
+
+        std::ostringstream extra;
+        extra << ImageWarp::getNumThreads() << " threads, cache hits "
+            << ImageWarp::getCacheHits() << "/" << ImageWarp::getCacheQueries();
+        Bench::report(config.name, ms, extra.str());
+    }
+
+    ImageWarp::setMaxError(0.125);
+    ImageWarp::setMaxCachedGrids(128u);
+    ImageWarp::setNumThreads(0u);
+
+    return 0;
+}
@@ -0,0 +1,160 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Bench.h"
+
+#include <osgEarth/Feature>
+#include <osgEarth/Geometry>
+#include <osgEarth/ScriptEngine>
+#include <osgEarth/StringUtils>
+#include <osg/Math>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+using namespace osgEarth;
+
+namespace
+{
+    const char* s_readScript =
+        "feature.properties.height * 2.0 + feature.properties.name.length";
+
+    const char* s_writeScript =
+        "feature.properties.score = feature.properties.height * 2.0;"
+        "feature.geometry.coordinates[0][0][2] = feature.properties.score;"
+        "feature.save();"
+        "feature.properties.score";
+
+    std::vector<osg::ref_ptr<Feature> > makeFeatures(unsigned count)
+    {
+        std::vector<osg::ref_ptr<Feature> > features;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Polygon* poly = new Polygon();
+            for (unsigned v = 0; v < 6; ++v)
+                poly->push_back(osg::Vec3d(cos(v*1.047) + (double)i, sin(v*1.047), 0.0));
+
+            Feature* feature = new Feature(poly, 0L, Style(), (FeatureID)i);
+            feature->set("name", Stringify() << "building_" << i);
+            feature->set("height", 10.0 + (double)(i % 40));
+            feature->set("floors", (int)(i % 12));
+            feature->set("residential", (i % 3) == 0);
+            for (unsigned a = 0; a < 6; ++a)
+                feature->set(Stringify() << "attr" << a, (double)(i * a));
+            features.push_back(feature);
+        }
+        return features;
+    }
+
+    // Evaluates the script once per feature through the engine, which
+    // compiles it on first use. Returns the sum of the results, or a
+    // negative time on a script error.
+    double run(ScriptEngine* engine, const std::vector<osg::ref_ptr<Feature> >& features, int numEvals, const char* script, double& checksum)
+    {
+        const std::string code(script);
+        const int numDistinct = (int)features.size();
+
+        Bench::Stopwatch timer;
+        for (int i = 0; i < numEvals; ++i)
+        {
+            ScriptResult result = engine->run(code, features[i % numDistinct].get(), 0L);
+            if (!result.success())
+            {
+                std::cout << "  script failed: " << result.message() << std::endl;
+                return -1.0;
+            }
+            checksum += result.asDouble(0.0);
+        }
+        return timer.elapsedMS();
+    }
+}
+
+int
+Bench::script(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --features <n>   ; feature evaluations per run (default 1000000)"
+            << "\n  --distinct <n>   ; distinct features cycled through (default 1000)"
+            << std::endl;
+        return 0;
+    }
+
+    int numEvals = 1000000;
+    int numDistinct = 1000;
+    args.read("--features", numEvals);
+    args.read("--distinct", numDistinct);
+    numDistinct = osg::clampBetween(numDistinct, 1, numEvals);
+
+    std::vector<osg::ref_ptr<Feature> > features = makeFeatures(numDistinct);
+
+    std::cout << "  " << numEvals << " feature evaluations over " << numDistinct
+        << " polygons with 10 attributes each" << std::endl;
+
+    // The plugin is loaded as a module, so go through the factory.
+    // The "geojson" profile copies each feature in and out through GeoJSON,
+    // the way features were bound before the native binding.
+    Script empty("", "javascript");
+    osg::ref_ptr<ScriptEngine> geojson = ScriptEngineFactory::createWithProfile(empty, "geojson");
+    osg::ref_ptr<ScriptEngine> native = ScriptEngineFactory::create("javascript");
+    if (!geojson.valid() || !native.valid())
+    {
+        std::cout << "  Cannot load the javascript script engine" << std::endl;
+        return -1;
+    }
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const bool save = (pass == 1);
+        const char* script = save ? s_writeScript : s_readScript;
+        double checksum[2] = { 0.0, 0.0 };
+
+        {
+            double ms = run(geojson.get(), features, numEvals, script, checksum[0]);
+            if (ms < 0.0)
+                return -1;
+
+            std::ostringstream extra;
+            extra << (1000.0 * (double)numEvals / ms) << " features/s";
+            Bench::report(save ? "geojson round trip, read+write" : "geojson round trip, read", ms, extra.str());
+        }
+
+        // the write pass changed the features; start the native one fresh.
+        if (save)
+            features = makeFeatures(numDistinct);
+
+        {
+            double ms = run(native.get(), features, numEvals, script, checksum[1]);
+            if (ms < 0.0)
+                return -1;
+
+            std::ostringstream extra;
+            extra << (1000.0 * (double)numEvals / ms) << " features/s";
+            Bench::report(save ? "native binding, read+write" : "native binding, read", ms, extra.str());
+        }
+
+        if (checksum[0] != checksum[1])
+            std::cout << "  WARNING: results differ (" << checksum[0] << " vs. " << checksum[1] << ")" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,261 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Bench.h"
+
+#include <osgEarth/Geometry>
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/Tessellator>
+#include <osg/Geometry>
+#include <osgUtil/Tessellator>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // A polygon as the filters hand it to a tessellator: the outer ring
+    // (CCW) followed by its holes (CW), localized around the origin.
+    typedef std::vector<std::vector<osg::Vec3> > Rings;
+    typedef std::vector<Rings> Polygons;
+
+    void addRing(const Geometry* ring, const osg::Vec3d& center, Geometry::Orientation orientation, Rings& out)
+    {
+        std::vector<osg::Vec3> points;
+        points.reserve(ring->size());
+        for (Geometry::const_iterator p = ring->begin(); p != ring->end(); ++p)
+            points.push_back(osg::Vec3(p->x() - center.x(), p->y() - center.y(), 0.0f));
+
+        if (ring->getOrientation() != orientation)
+            std::reverse(points.begin(), points.end());
+
+        out.push_back(points);
+    }
+
+    bool loadPolygons(const std::string& file, Polygons& out)
+    {
+        osg::ref_ptr<OGRFeatureSource> fs = new OGRFeatureSource();
+        fs->setURL(file);
+        if (fs->open().isError())
+            return false;
+
+        osg::ref_ptr<FeatureCursor> cursor = fs->createFeatureCursor(Query(), 0L);
+        while (cursor.valid() && cursor->hasMore())
+        {
+            Feature* feature = cursor->nextFeature();
+            if (!feature || !feature->getGeometry())
+                continue;
+
+            ConstGeometryIterator parts(feature->getGeometry(), false);
+            while (parts.hasMore())
+            {
+                const Polygon* poly = dynamic_cast<const Polygon*>(parts.next());
+                if (!poly || !poly->isValid())
+                    continue;
+
+                osg::Vec3d center = poly->getBounds().center();
+                Rings rings;
+                addRing(poly, center, Geometry::ORIENTATION_CCW, rings);
+                for (RingCollection::const_iterator h = poly->getHoles().begin(); h != poly->getHoles().end(); ++h)
+                    if (h->get()->isValid())
+                        addRing(h->get(), center, Geometry::ORIENTATION_CW, rings);
+                out.push_back(rings);
+            }
+        }
+        return !out.empty();
+    }
+
+    double jitter(double amount)
+    {
+        return amount * ((double)::rand() / (double)RAND_MAX - 0.5);
+    }
+
+    std::vector<osg::Vec3> makeRing(double radius, unsigned numVerts, double roughness, bool ccw, const osg::Vec3& center)
+    {
+        std::vector<osg::Vec3> ring;
+        for (unsigned i = 0; i < numVerts; ++i)
+        {
+            double a = (ccw ? 2.0 : -2.0) * osg::PI * (double)i / (double)numVerts;
+            double r = radius * (1.0 + jitter(roughness));
+            ring.push_back(center + osg::Vec3(r * cos(a), r * sin(a), 0.0));
+        }
+        return ring;
+    }
+
+    // Small parcel-like polygons.
+    void makeParcels(unsigned count, Polygons& out)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Rings rings;
+            rings.push_back(makeRing(20.0, 4u + (i % 9u), 0.3, true, osg::Vec3()));
+            out.push_back(rings);
+        }
+    }
+
+    // Large landuse-like polygons with many holes.
+    void makeLanduse(unsigned count, unsigned numVerts, unsigned numHoles, Polygons& out)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Rings rings;
+            rings.push_back(makeRing(1000.0, numVerts, 0.05, true, osg::Vec3()));
+            for (unsigned h = 0; h < numHoles; ++h)
+            {
+                double a = 2.0 * osg::PI * (double)h / (double)numHoles;
+                double d = 200.0 + 500.0 * (double)(h % 3) / 2.0;
+                rings.push_back(makeRing(20.0, 24u, 0.2, false, osg::Vec3(d * cos(a), d * sin(a), 0.0)));
+            }
+            out.push_back(rings);
+        }
+    }
+
+    void makeGeometries(const Polygons& polygons, std::vector<osg::ref_ptr<osg::Geometry> >& out)
+    {
+        out.clear();
+        out.reserve(polygons.size());
+        for (Polygons::const_iterator p = polygons.begin(); p != polygons.end(); ++p)
+        {
+            osg::Geometry* geom = new osg::Geometry();
+            osg::Vec3Array* verts = new osg::Vec3Array();
+            geom->setVertexArray(verts);
+            for (Rings::const_iterator r = p->begin(); r != p->end(); ++r)
+            {
+                geom->addPrimitiveSet(new osg::DrawArrays(GL_LINE_LOOP, verts->size(), r->size()));
+                verts->insert(verts->end(), r->begin(), r->end());
+            }
+            out.push_back(geom);
+        }
+    }
+
+    enum Method { METHOD_GLU, METHOD_EARCUT };
+
+    void run(const char* name, Method method, const Polygons& polygons, int iterations)
+    {
+        std::vector<osg::ref_ptr<osg::Geometry> > geoms;
+        double ms = 0.0;
+        unsigned failures = 0u, triangles = 0u;
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            makeGeometries(polygons, geoms);
+            failures = 0u;
+
+            Bench::Stopwatch timer;
+            for (unsigned g = 0; g < geoms.size(); ++g)
+            {
+                osg::Geometry& geom = *geoms[g].get();
+                if (method == METHOD_GLU)
+                {
+                    osgUtil::Tessellator tess;
+                    tess.setTessellationType(osgUtil::Tessellator::TESS_TYPE_GEOMETRY);
+                    tess.setWindingType(osgUtil::Tessellator::TESS_WINDING_ODD);
+                    tess.retessellatePolygons(geom);
+                }
+                else
+                {
+                    Tessellator tess;
+                    if (!tess.tessellateGeometry(geom))
+                        ++failures;
+                }
+            }
+            ms += timer.elapsedMS();
+        }
+
+        triangles = 0u;
+        for (unsigned g = 0; g < geoms.size(); ++g)
+            for (unsigned p = 0; p < geoms[g]->getNumPrimitiveSets(); ++p)
+                if (geoms[g]->getPrimitiveSet(p)->getMode() != GL_LINE_LOOP)
+                    triangles += geoms[g]->getPrimitiveSet(p)->getNumPrimitives();
+
+        double perIter = ms / (double)iterations;
+        std::ostringstream extra;
+        extra << (1000.0 * (double)polygons.size() / perIter) << " polygons/s, " << triangles << " triangles";
+        if (failures > 0u)
+            extra << ", " << failures << " failed";
+        Bench::report(name, perIter, extra.str());
+    }
+
+    void runAll(const std::string& title, const Polygons& polygons, int iterations)
+    {
+        unsigned numVerts = 0u, numHoles = 0u;
+        for (Polygons::const_iterator p = polygons.begin(); p != polygons.end(); ++p)
+        {
+            numHoles += p->size() - 1u;
+            for (Rings::const_iterator r = p->begin(); r != p->end(); ++r)
+                numVerts += r->size();
+        }
+
+        std::cout << "  " << title << ": " << polygons.size() << " polygons, "
+            << numVerts << " vertices, " << numHoles << " holes" << std::endl;
+
+        run("osgUtil::Tessellator (GLU)", METHOD_GLU, polygons, iterations);
+        run("Tessellator::tessellateGeometry (earcut)", METHOD_EARCUT, polygons, iterations);
+    }
+}
+
+int
+Bench::tessellate(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --file <path>    ; polygon layer to tessellate, e.g. parcels or landuse"
+            << "\n                     (default: synthetic parcels and landuse)"
+            << "\n  --iterations <n> ; runs of each test (default 3)"
+            << std::endl;
+        return 0;
+    }
+
+    std::string file;
+    int iterations = 3;
+    args.read("--file", file);
+    args.read("--iterations", iterations);
+    iterations = osg::maximum(iterations, 1);
+
+    if (!file.empty())
+    {
+        Polygons polygons;
+        if (!loadPolygons(file, polygons))
+        {
+            std::cout << "  No polygons in \"" << file << "\"" << std::endl;
+            return -1;
+        }
+        runAll(file, polygons, iterations);
+    }
+    else
+    {
+        ::srand(1);
+
+        Polygons parcels;
+        makeParcels(20000u, parcels);
+        runAll("parcels", parcels, iterations);
+
+        Polygons landuse;
+        makeLanduse(20u, 4000u, 60u, landuse);
+        runAll("landuse", landuse, iterations);
+    }
+
+    return 0;
+}
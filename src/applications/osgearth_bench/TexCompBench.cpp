@@ -0,0 +1,212 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include "Bench.h"
+#include "BCnEncoder.h"
+
+#include <osg/Image>
+#include <osg/Texture>
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Random>
+#include <sstream>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Imagery-like test tile: smooth low-frequency color with pixel noise.
+    osg::Image* makeTile(int size, GLenum pixelFormat)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, pixelFormat, GL_UNSIGNED_BYTE);
+        int comps = osg::Image::computeNumComponents(pixelFormat);
+        Random prng(size);
+        for (int t = 0; t < size; ++t)
+        {
+            for (int s = 0; s < size; ++s)
+            {
+                unsigned char* p = image->data(s, t);
+                double n = prng.next() * 24.0;
+                double v[4] = {
+                    128.0 + 100.0 * sin(s * 0.02) * cos(t * 0.03) + n,
+                    90.0 + 60.0 * sin((s + t) * 0.01) + n,
+                    60.0 + 40.0 * cos(t * 0.05) + n * 0.5,
+                    200.0 + 55.0 * sin(s * 0.07) };
+                for (int c = 0; c < comps; ++c)
+                    p[c] = (unsigned char)osg::clampBetween(v[c], 0.0, 255.0);
+            }
+        }
+        return image;
+    }
+
+    // RMS error over the first "channels" channels of level 0.
+    double rmse(const osg::Image* reference, const osg::Image* compressed, BCn::Format format, int channels)
+    {
+        osg::ref_ptr<osg::Image> ref = ImageUtils::convertToRGBA8(reference);
+        int w = ref->s(), h = ref->t();
+        std::vector<unsigned char> decoded((size_t)w * h * 4);
+        BCn::decodeImage(compressed->data(), w, h, &decoded[0], format);
+
+        double sum = 0.0;
+        const unsigned char* a = ref->data();
+        for (int i = 0; i < w * h; ++i)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                double d = (double)a[i * 4 + c] - (double)decoded[i * 4 + c];
+                sum += d * d;
+            }
+        }
+        return sqrt(sum / ((double)w * h * channels));
+    }
+
+    struct Case
+    {
+        const char* name;
+        osg::Texture::InternalFormatMode mode;
+        BCn::Format format;
+        GLenum pixelFormat;
+        int channels;
+    };
+
+    void runCase(
+        const std::string& processorName,
+        osgDB::ImageProcessor* processor,
+        osgDB::ImageProcessor::CompressionQuality quality,
+        const char* qualityName,
+        const Case& c,
+        const osg::Image* source,
+        bool mipmaps,
+        int iterations)
+    {
+        double totalMS = 0.0;
+        osg::ref_ptr<osg::Image> result;
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            result = new osg::Image(*source, osg::CopyOp::DEEP_COPY_ALL);
+            Bench::Stopwatch timer;
+            processor->compress(*result, c.mode, mipmaps, false, osgDB::ImageProcessor::USE_CPU, quality);
+            totalMS += timer.elapsedMS();
+        }
+
+        std::ostringstream name;
+        name << processorName << " " << c.name << " " << qualityName << (mipmaps ? " +mips" : "");
+
+        if (!ImageUtils::isCompressed(result.get()))
+        {
+            Bench::report(name.str(), 0.0, "(unsupported)");
+            return;
+        }
+
+        double ms = totalMS / (double)iterations;
+        double mpix = ((double)source->s() * source->t()) / (ms * 1000.0);
+
+        std::ostringstream extra;
+        extra << std::setprecision(1) << mpix << " MPix/s, rmse "
+            << std::setprecision(3) << rmse(source, result.get(), c.format, c.channels);
+        Bench::report(name.str(), ms, extra.str());
+    }
+}
+
+int
+Bench::texcomp(osg::ArgumentParser& args)
+{
+    if (args.read("--help"))
+    {
+        std::cout
+            << "  --image <file>   ; use this image instead of a synthetic tile"
+            << "\n  --size <n>       ; synthetic tile size (default 256)"
+            << "\n  --iterations <n> ; repetitions per case (default 50)"
+            << "\n  --mipmaps        ; also build the mipmap chain (bcn only)"
+            << std::endl;
+        return 0;
+    }
+
+    int size = 256;
+    int iterations = 50;
+    std::string imageFile;
+    args.read("--size", size);
+    args.read("--iterations", iterations);
+    args.read("--image", imageFile);
+    bool mipmaps = args.read("--mipmaps");
+
+    osg::ref_ptr<osg::Image> rgb, rgba, rg;
+    if (!imageFile.empty())
+    {
+        osg::ref_ptr<osg::Image> file = osgDB::readRefImageFile(imageFile);
+        if (!file.valid())
+        {
+            std::cout << "Failed to read " << imageFile << std::endl;
+            return -1;
+        }
+        rgba = ImageUtils::convertToRGBA8(file.get());
+        rgb = rg = rgba;
+    }
+    else
+    {
+        rgb = makeTile(size, GL_RGB);
+        rgba = makeTile(size, GL_RGBA);
+        rg = makeTile(size, GL_RG);
+    }
+
+    std::cout << "  " << rgba->s() << "x" << rgba->t() << ", " << iterations << " iterations"
+        << (BCn::hasSIMD() ? ", SSE2" : ", scalar") << std::endl;
+
+    const Case cases[] = {
+        { "BC1", osg::Texture::USE_S3TC_DXT1_COMPRESSION, BCn::FORMAT_BC1, GL_RGB,  3 },
+        { "BC3", osg::Texture::USE_S3TC_DXT5_COMPRESSION, BCn::FORMAT_BC3, GL_RGBA, 4 },
+        { "BC4", osg::Texture::USE_RGTC1_COMPRESSION,     BCn::FORMAT_BC4, GL_RG,   1 },
+        { "BC5", osg::Texture::USE_RGTC2_COMPRESSION,     BCn::FORMAT_BC5, GL_RG,   2 }
+    };
+
+    osgDB::ImageProcessor* fastdxt = osgDB::Registry::instance()->getImageProcessorForExtension("fastdxt");
+    osgDB::ImageProcessor* bcn = osgDB::Registry::instance()->getImageProcessorForExtension("bcn");
+
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+        const Case& c = cases[i];
+        const osg::Image* source =
+            c.pixelFormat == GL_RGB ? rgb.get() :
+            c.pixelFormat == GL_RGBA ? rgba.get() :
+            rg.get();
+
+        // fastdxt only implements DXT1/DXT5 and has no quality settings.
+        if (fastdxt && c.format <= BCn::FORMAT_BC3)
+            runCase("fastdxt", fastdxt, osgDB::ImageProcessor::FASTEST, "", c, source, false, iterations);
+
+        if (bcn)
+        {
+            runCase("bcn", bcn, osgDB::ImageProcessor::FASTEST, "fast", c, source, mipmaps, iterations);
+            runCase("bcn", bcn, osgDB::ImageProcessor::NORMAL, "normal", c, source, mipmaps, iterations);
+            runCase("bcn", bcn, osgDB::ImageProcessor::HIGHEST, "high", c, source, mipmaps, iterations);
+        }
+    }
+
+    if (!fastdxt) std::cout << "  (fastdxt plugin not found)" << std::endl;
+    if (!bcn) std::cout << "  (bcn plugin not found)" << std::endl;
+
+    return 0;
+}
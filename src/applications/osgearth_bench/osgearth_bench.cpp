@@ -0,0 +1,95 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Headless CPU micro-benchmarks for osgEarth subsystems.
+ * None of the suites require a graphics context.
+ */
+#include <osgEarth/Registry>
+#include <osgEarth/Notify>
+#include "Bench.h"
+
+using namespace osgEarth;
+
+struct Suite
+{
+    const char* name;
+    const char* description;
+    int (*run)(osg::ArgumentParser&);
+};
+
+static Suite s_suites[] = {
+#ifdef OSGEARTH_BENCH_HAVE_BCN
+    { "texcomp",    "CPU texture compression (fastdxt vs. bcn)", Bench::texcomp },
+#endif
+    { "imageutils", "ImageUtils pixel operations (generic vs. pixel kernels)", Bench::imageutils },
+    { "reproject",  "GeoImage reprojection (exact vs. cached, threaded warp grids)", Bench::reproject },
+    { "paging",     "Terrain tile paging along a scripted camera path", Bench::paging },
+    { "script",     "Duktape feature scripting (GeoJSON round trip vs. native binding)", Bench::script },
+    { "geojson",    "GeoJSON read/write throughput (OGR + jsoncpp vs. GeoJSONReader/Writer)", Bench::geojson },
+    { "tessellate", "Polygon triangulation (GLU vs. earcut)", Bench::tessellate },
+    { "featureimage", "FeatureImageLayer tile rasterization (1 thread vs. all threads)", Bench::featureimage }
+};
+
+static const unsigned s_numSuites = sizeof(s_suites) / sizeof(s_suites[0]);
+
+int
+usage(const char* name)
+{
+    std::cout
+        << "Headless osgEarth benchmarks."
+        << "\nUsage:"
+        << "\n" << name << " <suite> [suite options]"
+        << "\n\nSuites:"
+        << std::endl;
+
+    for (unsigned i = 0; i < s_numSuites; ++i)
+        std::cout << "  " << std::left << std::setw(14) << s_suites[i].name << s_suites[i].description << std::endl;
+
+    return -1;
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+
+    if (argc < 2 || arguments.read("--help") || arguments.read("-h"))
+        return usage(argv[0]);
+
+    std::string suite = argv[1];
+    arguments.remove(1);
+
+    osgEarth::initialize();
+
+    for (unsigned i = 0; i < s_numSuites; ++i)
+    {
+        if (suite == s_suites[i].name)
+        {
+            std::cout << "[" << suite << "]" << std::endl;
+            return s_suites[i].run(arguments);
+        }
+    }
+
+    std::cout << "Unknown suite \"" << suite << "\"" << std::endl;
+    return usage(argv[0]);
+}
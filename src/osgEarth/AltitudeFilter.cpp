@@ -18,7 +18,9 @@
  */
 #include <osgEarth/AltitudeFilter>
 #include <osgEarth/ElevationQuery>
+#include <osgEarth/ElevationPool>
 #include <osgEarth/GeoData>
+#include <osgEarth/Map>
 #include <osgEarth/Metrics>
 
 #define LC "[AltitudeFilter] "
@@ -148,6 +150,83 @@ AltitudeFilter::pushAndDontClamp( FeatureList& features, FilterContext& cx )
     }
 }
 
+namespace
+{
+    // Per-feature values gathered before the batched elevation query.
+    struct ClampRecord
+    {
+        Feature* feature;
+        double   scaleZ;
+        double   offsetZ;
+        unsigned first;   // index of the feature's first sample in the batch
+    };
+
+    bool hasTerrainPatches(const Map* map)
+    {
+        LayerVector layers;
+        map->getLayers(layers);
+        for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+        {
+            if (i->get()->options().terrainPatch() == true)
+                return true;
+        }
+        return false;
+    }
+
+    // Samples the terrain under every point in one pass. Misses come back
+    // as zero, the same as a per-point ElevationQuery.
+    void sampleTerrain(
+        const Map* map,
+        const SpatialReference* pointSRS,
+        const std::vector<osg::Vec3d>& points,
+        double resolution,
+        std::vector<float>& out_elevations)
+    {
+        out_elevations.assign(points.size(), NO_DATA_VALUE);
+        if (points.empty())
+            return;
+
+        // Terrain patches require intersection tests, which only the
+        // ElevationQuery knows how to do.
+        if (hasTerrainPatches(map) == false)
+        {
+            const SpatialReference* poolSRS = map->getProfile()->getSRS();
+
+            std::vector<osg::Vec3d> mapPoints(points);
+            for (auto& p : mapPoints)
+                p.z() = 0.0;
+
+            if (pointSRS->isHorizEquivalentTo(poolSRS) || pointSRS->transform(mapPoints, poolSRS))
+            {
+                ElevationPool::WorkingSet workingSet;
+
+                int count = map->getElevationPool()->sampleMapCoords(
+                    mapPoints,
+                    Distance(resolution, map->getSRS()->getUnits()),
+                    &workingSet);
+
+                if (count >= 0)
+                {
+                    for (unsigned i = 0; i < mapPoints.size(); ++i)
+                        out_elevations[i] = mapPoints[i].z() == NO_DATA_VALUE ? 0.0f : mapPoints[i].z();
+                    return;
+                }
+            }
+        }
+
+        ElevationQuery eq(map);
+        out_elevations.clear();
+        eq.getElevations(points, pointSRS, out_elevations, resolution);
+
+        // a map without elevation layers reports NO_DATA_VALUE
+        for (auto& e : out_elevations)
+        {
+            if (e == NO_DATA_VALUE)
+                e = 0.0f;
+        }
+    }
+}
+
 void
 AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
 {
@@ -164,9 +243,6 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     const SpatialReference* mapSRS = map->getSRS();
     osg::ref_ptr<const SpatialReference> featureSRS = cx.profile()->getSRS();
 
-    // establish an elevation query interface based on the features' SRS.
-    ElevationQuery eq(map.get());
-
     NumericExpression scaleExpr;
     if ( _altitude->verticalScale().isSet() )
         scaleExpr = *_altitude->verticalScale();
@@ -188,6 +264,19 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     bool vertEquiv =
         featureSRS->isVertEquivalentTo( mapSRS );
 
+    // for converting Z values (which end up in the map's vertical datum)
+    // back into the feature's SRS.
+    osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
+        SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
+
+    // First pass: evaluate the per-feature expressions and gather every
+    // sample point (each vertex, or each feature's centroid) into one
+    // contiguous buffer so the terrain is sampled in a single batch.
+    std::vector<ClampRecord> records;
+    records.reserve(features.size());
+
+    std::vector<osg::Vec3d> samples;
+
     for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
     {
         Feature* feature = i->get();
@@ -201,36 +290,60 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
         if (feature->getGeometry() == 0L)
             continue;
 
-        double maxTerrainZ  = -DBL_MAX;
-        double minTerrainZ  =  DBL_MAX;
-        double minHAT       =  DBL_MAX;
-        double maxHAT       = -DBL_MAX;
+        ClampRecord record;
+        record.feature = feature;
+        record.first = samples.size();
 
-        double scaleZ = 1.0;
+        record.scaleZ = 1.0;
         if ( _altitude.valid() && _altitude->verticalScale().isSet() )
-            scaleZ = feature->eval( scaleExpr, &cx );
+            record.scaleZ = feature->eval( scaleExpr, &cx );
 
-        double offsetZ = 0.0;
+        record.offsetZ = 0.0;
         if ( _altitude.valid() && _altitude->verticalOffset().isSet() )
-            offsetZ = feature->eval( offsetExpr, &cx );
-
-        osgEarth::Bounds bounds = feature->getGeometry()->getBounds();
-        const osg::Vec2d& center = bounds.center2d();
-        GeoPoint centroid(featureSRS.get(), center.x(), center.y());
-        double   centroidElevation = 0.0;
+            record.offsetZ = feature->eval( offsetExpr, &cx );
 
-        // If we aren't doing per vertex clamping go ahead and get the centroid.
-        // We do this now instead of within the geometry iterator to ensure that multipolygons
-        // are clamped to the whole multipolygon and not per polygon.
-        if (!perVertex)
+        if (perVertex)
         {
-            centroidElevation = eq.getElevation( centroid, _maxRes );
-            // Check for NO_DATA_VALUE and use zero instead.
-            if (centroidElevation == NO_DATA_VALUE)
+            GeometryIterator gi( feature->getGeometry() );
+            while( gi.hasMore() )
             {
-                centroidElevation = 0.0;
+                Geometry* geom = gi.next();
+                samples.insert(samples.end(), geom->begin(), geom->end());
             }
         }
+        else
+        {
+            // Use the centroid of the whole feature so that multipolygons
+            // are clamped as a unit and not per polygon.
+            osg::Vec2d center = feature->getGeometry()->getBounds().center2d();
+            samples.push_back(osg::Vec3d(center.x(), center.y(), 0.0));
+        }
+
+        records.push_back(record);
+    }
+
+    // Sample the terrain under all the points at once.
+    std::vector<float> elevations;
+    sampleTerrain(map.get(), featureSRS.get(), samples, _maxRes, elevations);
+
+    // Second pass: apply the elevations.
+    for( std::vector<ClampRecord>::const_iterator r = records.begin(); r != records.end(); ++r )
+    {
+        Feature* feature = r->feature;
+        const double scaleZ  = r->scaleZ;
+        const double offsetZ = r->offsetZ;
+        unsigned k = r->first;
+
+        double maxTerrainZ  = -DBL_MAX;
+        double minTerrainZ  =  DBL_MAX;
+        double minHAT       =  DBL_MAX;
+        double maxHAT       = -DBL_MAX;
+
+        double centroidElevation = 0.0;
+        if (!perVertex)
+        {
+            centroidElevation = elevations[k];
+        }
         
         GeometryIterator gi( feature->getGeometry() );
         while( gi.hasMore() )
@@ -245,41 +358,33 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             {
                 if ( perVertex )
                 {
-                    std::vector<float> elevations;
-
-                    if ( eq.getElevations( geom->asVector(), featureSRS.get(), elevations, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i, ++k )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
+                        osg::Vec3d& p = (*geom)[i];
+
+                        p.z() *= scaleZ;
+                        p.z() += offsetZ;
+
+                        double z = p.z();
+
+                        if ( !vertEquiv )
                         {
-                            osg::Vec3d& p = (*geom)[i];
-
-                            if (elevations[i] != NO_DATA_VALUE)
-                            {
-                                p.z() *= scaleZ;
-                                p.z() += offsetZ;
-
-                                double z = p.z();
-
-                                if ( !vertEquiv )
-                                {
-                                    osg::Vec3d tempgeo;
-                                    if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
-                                        z = tempgeo.z();
-                                }
-
-                                double hat = z - elevations[i];
-
-                                if ( hat > maxHAT )
-                                    maxHAT = hat;
-                                if ( hat < minHAT )
-                                    minHAT = hat;
-
-                                if ( elevations[i] > maxTerrainZ )
-                                    maxTerrainZ = elevations[i];
-                                if ( elevations[i] < minTerrainZ )
-                                    minTerrainZ = elevations[i];
-                            }
+                            osg::Vec3d tempgeo;
+                            if ( !featureSRS->transform(p, mapSRS->getGeographicSRS(), tempgeo) )
+                                z = tempgeo.z();
                         }
+
+                        double hat = z - elevations[k];
+
+                        if ( hat > maxHAT )
+                            maxHAT = hat;
+                        if ( hat < minHAT )
+                            minHAT = hat;
+
+                        if ( elevations[k] > maxTerrainZ )
+                            maxTerrainZ = elevations[k];
+                        if ( elevations[k] < minTerrainZ )
+                            minTerrainZ = elevations[k];
                     }
                 }
                 else // per centroid
@@ -317,46 +422,34 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             // and record HATs along the way.
             else if ( _altitude->clamping() == AltitudeSymbol::CLAMP_RELATIVE_TO_TERRAIN )
             {
-                osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
-                    SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
-
                 if ( perVertex )
                 {
-                    std::vector<float> elevations;
-                    elevations.reserve( geom->size() );
-                    
-                    if ( eq.getElevations( geom->asVector(), featureSRS.get(), elevations, _maxRes ) )
+                    for( unsigned i=0; i<geom->size(); ++i, ++k )
                     {
-                        for( unsigned i=0; i<geom->size(); ++i )
+                        osg::Vec3d& p = (*geom)[i];
+
+                        p.z() *= scaleZ;
+                        p.z() += offsetZ;
+
+                        double hat = p.z();
+                        p.z() = elevations[k] + p.z();
+
+                        // if necessary, convert the Z value (which is now in the map's SRS) back to
+                        // the feature's SRS.
+                        if ( !vertEquiv )
                         {
-                            osg::Vec3d& p = (*geom)[i];
-
-                            if (elevations[i] != NO_DATA_VALUE)
-                            {
-                                p.z() *= scaleZ;
-                                p.z() += offsetZ;
-
-                                double hat = p.z();
-                                p.z() = elevations[i] + p.z();
-
-                                // if necessary, convert the Z value (which is now in the map's SRS) back to
-                                // the feature's SRS.
-                                if ( !vertEquiv )
-                                {
-                                    featureSRSwithMapVertDatum->transform(p, featureSRS.get(), p);
-                                }
-
-                                if ( hat > maxHAT )
-                                    maxHAT = hat;
-                                if ( hat < minHAT )
-                                    minHAT = hat;
-
-                                if ( elevations[i] > maxTerrainZ )
-                                    maxTerrainZ = elevations[i];
-                                if ( elevations[i] < minTerrainZ )
-                                    minTerrainZ = elevations[i];
-                            }
+                            featureSRSwithMapVertDatum->transform(p, featureSRS.get(), p);
                         }
+
+                        if ( hat > maxHAT )
+                            maxHAT = hat;
+                        if ( hat < minHAT )
+                            minHAT = hat;
+
+                        if ( elevations[k] > maxTerrainZ )
+                            maxTerrainZ = elevations[k];
+                        if ( elevations[k] < minTerrainZ )
+                            minTerrainZ = elevations[k];
                     }
                 }
                 else // per-centroid
@@ -393,39 +486,24 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             // Clamp - replace the geometry's Z with the terrain height.
             else // CLAMP_TO_TERRAIN
             {
-                if ( perVertex )
+                for( unsigned i=0; i<geom->size(); ++i )
                 {
-                    eq.getElevations( geom->asVector(), featureSRS.get(), true, _maxRes );
-                    
-                    // if necessary, transform the Z values (which are now in the map SRS) back
-                    // into the feature's SRS.
-                    if ( !vertEquiv )
-                    {
-                        osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum =
-                            SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString());
+                    osg::Vec3d& p = (*geom)[i];
 
-                        osg::Vec3d tempgeo;
-                        for( unsigned i=0; i<geom->size(); ++i )
-                        {
-                            osg::Vec3d& p = (*geom)[i];
-                            featureSRSwithMapVertDatum->transform(p, featureSRS.get(), p);
-                        }
+                    if ( perVertex )
+                    {
+                        p.z() = elevations[k++];
                     }
-                }
-                else // per-centroid
-                {
-                    osg::ref_ptr<const SpatialReference> featureSRSWithMapVertDatum;
-                    if ( !vertEquiv )
-                        featureSRSWithMapVertDatum = SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString());
-
-                    for( unsigned i=0; i<geom->size(); ++i )
+                    else
                     {
-                        osg::Vec3d& p = (*geom)[i];
                         p.z() = centroidElevation;
-                        if ( !vertEquiv )
-                        {
-                            featureSRSWithMapVertDatum->transform(p, featureSRS.get(), p);
-                        }
+                    }
+
+                    // if necessary, transform the Z values (which are now in the map SRS) back
+                    // into the feature's SRS.
+                    if ( !vertEquiv )
+                    {
+                        featureSRSwithMapVertDatum->transform(p, featureSRS.get(), p);
                     }
                 }
             }
@@ -454,5 +532,5 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     }
 
     double t = OE_GET_TIMER(pushAndClamp);
-    OE_DEBUG << LC << "pushAndClamp: tpp = " << (t / (double)total)*1000000.0 << " us\n";
+    OE_DEBUG << LC << "pushAndClamp: " << samples.size() << " samples, tpp = " << (t / (double)total)*1000000.0 << " us\n";
 }
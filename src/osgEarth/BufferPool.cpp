@@ -0,0 +1,188 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/BufferPool>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[BufferPool] "
+
+namespace
+{
+    // index of the highest set bit
+    unsigned log2floor(size_t value)
+    {
+        unsigned e = 0u;
+        while (value >>= 1)
+            ++e;
+        return e;
+    }
+}
+
+//........................................................................
+
+BufferPoolBase::Stats&
+BufferPoolBase::Stats::operator += (const Stats& rhs)
+{
+    _hits += rhs._hits;
+    _misses += rhs._misses;
+    _recycled += rhs._recycled;
+    _discarded += rhs._discarded;
+    _pooledBuffers += rhs._pooledBuffers;
+    _pooledBytes += rhs._pooledBytes;
+    return *this;
+}
+
+// Class (e*4 + sub) holds buffers of (4+sub) << (e-2) bytes: four classes
+// per power of two. Only used for sizes >= MIN_BYTES, so e >= 2.
+
+unsigned
+BufferPoolBase::ceilClass(size_t bytes)
+{
+    unsigned e = log2floor(bytes);
+    size_t step = (size_t)1u << (e - 2u);
+    size_t q = (bytes + step - 1u) / step; // 4..8
+    if (q == 8u)
+        return (e + 1u) * 4u;
+    return e * 4u + (unsigned)(q - 4u);
+}
+
+unsigned
+BufferPoolBase::floorClass(size_t bytes)
+{
+    unsigned e = log2floor(bytes);
+    size_t q = bytes >> (e - 2u); // 4..7
+    return e * 4u + (unsigned)(q - 4u);
+}
+
+size_t
+BufferPoolBase::classBytes(unsigned sizeClass)
+{
+    unsigned e = sizeClass / 4u;
+    unsigned sub = sizeClass % 4u;
+    return (size_t)(4u + sub) << (e - 2u);
+}
+
+//........................................................................
+
+// The pools are deliberately never destroyed: tile data can outlive
+// static destruction and still needs somewhere to return its buffers.
+
+VectorPool<unsigned char>&
+BufferPools::bytes()
+{
+    static VectorPool<unsigned char>* s_pool = new VectorPool<unsigned char>();
+    return *s_pool;
+}
+
+VectorPool<float>&
+BufferPools::floats()
+{
+    static VectorPool<float>* s_pool = new VectorPool<float>();
+    return *s_pool;
+}
+
+VectorPool<osg::Vec3f>&
+BufferPools::vec3fs()
+{
+    static VectorPool<osg::Vec3f>* s_pool = new VectorPool<osg::Vec3f>();
+    return *s_pool;
+}
+
+BufferPoolBase::Stats
+BufferPools::getStats()
+{
+    BufferPoolBase::Stats stats;
+    stats += bytes().getStats();
+    stats += floats().getStats();
+    stats += vec3fs().getStats();
+    return stats;
+}
+
+void
+BufferPools::trim(size_t maxBytes)
+{
+    bytes().trim(maxBytes);
+    floats().trim(maxBytes);
+    vec3fs().trim(maxBytes);
+}
+
+//........................................................................
+
+void
+PooledImage::allocateImage(int s, int t, int r, GLenum pixelFormat, GLenum type, int packing)
+{
+    unsigned size = osg::Image::computeImageSizeInBytes(s, t, r, pixelFormat, type, packing);
+
+    std::vector<unsigned char> buffer;
+    BufferPools::bytes().acquire(buffer, size);
+    buffer.resize(size);
+
+    // Like osg::Image::allocateImage, a fresh image takes the pixel format
+    // as its internal format.
+    GLint internalFormat = _internalTextureFormat ? _internalTextureFormat : (GLint)pixelFormat;
+
+    // NO_DELETE: the buffer belongs to this object, not to osg::Image.
+    setImage(s, t, r, internalFormat, pixelFormat, type, &buffer[0], NO_DELETE, packing);
+
+    // hand back the buffer from any previous allocation
+    if (_buffer.capacity() > 0)
+        BufferPools::bytes().recycle(_buffer);
+
+    _buffer.swap(buffer);
+}
+
+PooledImage::~PooledImage()
+{
+    if (_buffer.capacity() > 0)
+        BufferPools::bytes().recycle(_buffer);
+}
+
+//........................................................................
+
+void
+PooledHeightField::allocate(unsigned numColumns, unsigned numRows)
+{
+    osg::FloatArray* heights = getFloatArray();
+
+    if (heights && heights->referenceCount() == 1 &&
+        (numColumns != getNumColumns() || numRows != getNumRows()))
+    {
+        std::vector<float> previous;
+        previous.swap(heights->asVector());
+
+        BufferPools::floats().acquire(heights->asVector(), numColumns*numRows);
+
+        if (previous.capacity() > 0)
+            BufferPools::floats().recycle(previous);
+
+        // reset the dimensions so the base class resizes into the new storage
+        _columns = 0;
+        _rows = 0;
+    }
+
+    osg::HeightField::allocate(numColumns, numRows);
+}
+
+PooledHeightField::~PooledHeightField()
+{
+    osg::FloatArray* heights = getFloatArray();
+    if (heights && heights->referenceCount() == 1)
+        BufferPools::floats().recycle(heights->asVector());
+}
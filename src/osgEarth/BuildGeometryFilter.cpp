@@ -1069,6 +1069,10 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
     osg::ref_ptr<osg::Vec3Array> allPoints = new osg::Vec3Array();
     transformAndLocalize( ring->asVector(), featureSRS, allPoints.get(), outputSRS, world2local, makeECEF );
 
+    // The osgEarth tessellator (earcut) bridges holes itself, so they stay
+    // rings of their own; the OSG tessellator gets them bridged here.
+    std::vector<osg::ref_ptr<osg::Vec3Array> > holeRings;
+
     Polygon* poly = dynamic_cast<Polygon*>(ring);
     if ( poly )
     {
@@ -1085,6 +1089,12 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
                 osg::ref_ptr<osg::Vec3Array> holePoints = new osg::Vec3Array();
                 transformAndLocalize( hole->asVector(), featureSRS, holePoints.get(), outputSRS, world2local, makeECEF );
 
+                if ( _useOSGTessellator != true )
+                {
+                    holeRings.push_back( holePoints.get() );
+                    continue;
+                }
+
                 // find the point with the highest x value
                 unsigned int hCursor = 0;
                 for (unsigned int i=1; i < holePoints->size(); i++)
@@ -1219,6 +1229,14 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
         //v->reserve(v->size() + allPoints->size());
         std::copy(allPoints->begin(), allPoints->end(), std::back_inserter(*v));
     }
+
+    // the holes follow the outer ring:
+    for( unsigned i = 0; i < holeRings.size(); ++i )
+    {
+        osg::Vec3Array* v = static_cast<osg::Vec3Array*>(osgGeom->getVertexArray());
+        osgGeom->addPrimitiveSet( new osg::DrawArrays( mode, v->size(), holeRings[i]->size() ) );
+        v->insert( v->end(), holeRings[i]->begin(), holeRings[i]->end() );
+    }
 }
 
 
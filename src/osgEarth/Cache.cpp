@@ -231,3 +231,15 @@ CacheDriver::~CacheDriver()
 }
 
 //------------------------------------------------------------------------
+
+CacheMetrics::CacheMetrics(const std::string& driverName)
+{
+    MetricsRegistry* registry = MetricsRegistry::instance();
+    MetricsRegistry::Labels labels;
+    labels.push_back(std::make_pair("driver", driverName));
+
+    _hits = registry->counter("osgearth_cache_hits_total", "Cache reads that found data", labels);
+    _misses = registry->counter("osgearth_cache_misses_total", "Cache reads that found no data", labels);
+    _writes = registry->counter("osgearth_cache_writes_total", "Cache writes", labels);
+    _readTime = registry->histogram("osgearth_cache_read_seconds", "Time spent reading from the cache", labels);
+}
@@ -0,0 +1,663 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/CompiledExpression>
+#include <osgEarth/FilterContext>
+#include <osgEarth/FeatureSource>
+#include <osgEarth/ScriptEngine>
+#include <osgEarth/Session>
+#include <osgEarth/StringUtils>
+#include <osg/Math>
+#include <algorithm>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[CompiledExpression] "
+
+namespace
+{
+    // Scratch space for one evaluation lives on the stack up to this size.
+    const unsigned MAX_INLINE = 32u;
+
+    // Engine that evaluates variables that are not attributes
+    ScriptEngine* scriptEngineOf(const FilterContext* context)
+    {
+        return context && context->getSession() ?
+            context->getSession()->getScriptEngine() :
+            0L;
+    }
+
+    // Whether the schema lists an attribute (names ignore case)
+    bool inSchema(const std::string& name, const FeatureSchema& schema)
+    {
+        CIStringComp less;
+        for (FeatureSchema::const_iterator i = schema.begin(); i != schema.end(); ++i)
+        {
+            if (!less(name, i->first) && !less(i->first, name))
+                return true;
+        }
+        return false;
+    }
+
+    // The part of a schema that a compiled expression depends on: which
+    // of the expression's variables the schema lists.
+    template<typename VARIABLES>
+    std::string schemaSignature(const VARIABLES& vars, const FeatureSchema& schema)
+    {
+        std::string signature;
+        signature.reserve(vars.size());
+        for (typename VARIABLES::const_iterator v = vars.begin(); v != vars.end(); ++v)
+            signature.push_back(inSchema(v->first, schema) ? '1' : '0');
+        return signature;
+    }
+}
+
+//........................................................................
+
+unsigned
+ExpressionSlots::add(const std::string& name, const FeatureSchema& schema)
+{
+    for (unsigned i = 0; i < _slots.size(); ++i)
+    {
+        if (_slots[i].name == name)
+            return i;
+    }
+
+    // Keep the name as written; attribute lookups ignore case but
+    // scripts do not.
+    Slot slot;
+    slot.name = name;
+    slot.source = inSchema(name, schema) ? SOURCE_ATTRIBUTE : SOURCE_ANY;
+
+    _slots.push_back(slot);
+    return _slots.size() - 1;
+}
+
+//........................................................................
+
+CompiledNumericExpression::CompiledNumericExpression(const NumericExpression& expr,
+                                                     const FeatureSchema& schema) :
+    _src(expr.expr()),
+    _maxDepth(1u)
+{
+    // An expression without variables is a literal; use its own value
+    // since the source text may be rounded.
+    if (expr.variables().empty())
+    {
+        Instruction i;
+        i.op = PUSH_CONSTANT;
+        i.value = expr.eval();
+        i.slot = 0u;
+        _code.push_back(i);
+        return;
+    }
+
+    // which RPN atoms are variables:
+    std::map<unsigned, std::string> varAt;
+    for (NumericExpression::Variables::const_iterator v = expr._vars.begin(); v != expr._vars.end(); ++v)
+        varAt[v->second] = v->first;
+
+    unsigned depth = 0u;
+
+    for (unsigned a = 0; a < expr._rpn.size(); ++a)
+    {
+        const NumericExpression::Atom& atom = expr._rpn[a];
+        Instruction i;
+        i.value = 0.0;
+        i.slot = 0u;
+
+        switch (atom.first)
+        {
+        case NumericExpression::OPERAND:
+            i.op = PUSH_CONSTANT;
+            i.value = atom.second;
+            break;
+        case NumericExpression::VARIABLE:
+            i.op = PUSH_SLOT;
+            i.slot = _slots.add(varAt[a], schema);
+            break;
+        case NumericExpression::ADD:  i.op = ADD;  break;
+        case NumericExpression::SUB:  i.op = SUB;  break;
+        case NumericExpression::MULT: i.op = MULT; break;
+        case NumericExpression::DIV:  i.op = DIV;  break;
+        case NumericExpression::MOD:  i.op = MOD;  break;
+        case NumericExpression::MIN:  i.op = MIN;  break;
+        case NumericExpression::MAX:  i.op = MAX;  break;
+        default:
+            continue; // parens and commas never reach the RPN
+        }
+
+        if (i.op == PUSH_CONSTANT || i.op == PUSH_SLOT)
+        {
+            _code.push_back(i);
+            _maxDepth = osg::maximum(_maxDepth, ++depth);
+        }
+
+        // The interpreter skips operators that lack two operands;
+        // the stack depth is static, so drop them here instead.
+        else if (depth >= 2u)
+        {
+            --depth;
+
+            unsigned n = _code.size();
+            if (_code[n-1].op == PUSH_CONSTANT && _code[n-2].op == PUSH_CONSTANT)
+            {
+                // fold constant subexpressions:
+                _code[n-2].value = apply(i.op, _code[n-2].value, _code[n-1].value);
+                _code.pop_back();
+            }
+            else
+            {
+                _code.push_back(i);
+            }
+        }
+    }
+}
+
+double
+CompiledNumericExpression::apply(OpCode op, double lhs, double rhs)
+{
+    switch (op)
+    {
+    case ADD:  return lhs + rhs;
+    case SUB:  return lhs - rhs;
+    case MULT: return lhs * rhs;
+    case DIV:  return lhs / rhs;
+    case MOD:  return fmod(lhs, rhs);
+    case MIN:  return osg::minimum(lhs, rhs);
+    case MAX:  return osg::maximum(lhs, rhs);
+    default:   return rhs;
+    }
+}
+
+bool
+CompiledNumericExpression::fetch(const Feature* feature,
+                                 const FilterContext* context,
+                                 double* values) const
+{
+    ScriptEngine* engine = 0L;
+    bool needEngine = true;
+    bool scripted = false;
+
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        const ExpressionSlots::Slot& slot = _slots[s];
+        double val = 0.0;
+
+        AttributeTable::const_iterator a;
+        if (feature && (a = feature->getAttrs().find(slot.name)) != feature->getAttrs().end())
+        {
+            val = a->second.getDouble(0.0);
+        }
+        else if (slot.source == ExpressionSlots::SOURCE_ANY)
+        {
+            if (needEngine)
+            {
+                engine = scriptEngineOf(context);
+                needEngine = false;
+            }
+
+            if (engine)
+            {
+                ScriptResult result = engine->run(slot.name, feature, context);
+                if (result.success())
+                    val = result.asDouble();
+                else {
+                    OE_WARN << LC << "Feature Script error on '" << _src << "': " << result.message() << std::endl;
+                }
+                scripted = true;
+            }
+        }
+
+        values[s] = val;
+    }
+
+    return scripted;
+}
+
+double
+CompiledNumericExpression::run(const double* values, double* stack) const
+{
+    unsigned top = 0u;
+
+    for (unsigned i = 0; i < _code.size(); ++i)
+    {
+        const Instruction& in = _code[i];
+        switch (in.op)
+        {
+        case PUSH_CONSTANT:
+            stack[top++] = in.value;
+            break;
+        case PUSH_SLOT:
+            stack[top++] = values[in.slot];
+            break;
+        default:
+            --top;
+            stack[top-1] = apply(in.op, stack[top-1], stack[top]);
+        }
+    }
+
+    double result = top > 0u ? stack[top-1] : 0.0;
+    return osg::isNaN(result) ? 0.0 : result;
+}
+
+double
+CompiledNumericExpression::eval(const Feature* feature,
+                                const FilterContext* context,
+                                bool* out_scripted) const
+{
+    bool scripted;
+
+    if (_slots.size() <= MAX_INLINE && _maxDepth <= MAX_INLINE)
+    {
+        double values[MAX_INLINE];
+        double stack[MAX_INLINE];
+        scripted = fetch(feature, context, values);
+        if (out_scripted)
+            *out_scripted = scripted;
+        return run(values, stack);
+    }
+    else
+    {
+        std::vector<double> scratch(_slots.size() + _maxDepth);
+        scripted = fetch(feature, context, &scratch[0]);
+        if (out_scripted)
+            *out_scripted = scripted;
+        return run(&scratch[0], &scratch[_slots.size()]);
+    }
+}
+
+void
+CompiledNumericExpression::eval(const FeatureList& features,
+                                const FilterContext* context,
+                                std::vector<double>& output) const
+{
+    output.resize(features.size());
+
+    std::vector<double> scratch(_slots.size() + _maxDepth);
+    double* values = &scratch[0];
+    double* stack = &scratch[_slots.size()];
+
+    unsigned k = 0;
+    for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++k)
+    {
+        fetch(f->get(), context, values);
+        output[k] = run(values, stack);
+    }
+}
+
+//........................................................................
+
+CompiledStringExpression::CompiledStringExpression(const StringExpression& expr,
+                                                   const FeatureSchema& schema) :
+    _src(expr.expr()),
+    _literalLength(0u)
+{
+    if (expr.variables().empty())
+    {
+        Segment seg;
+        seg.isSlot = false;
+        seg.literal = expr.eval();
+        seg.slot = 0u;
+        _segments.push_back(seg);
+        _literalLength = seg.literal.length();
+        return;
+    }
+
+    std::map<unsigned, std::string> varAt;
+    for (StringExpression::Variables::const_iterator v = expr._vars.begin(); v != expr._vars.end(); ++v)
+        varAt[v->second] = v->first;
+
+    for (unsigned a = 0; a < expr._infix.size(); ++a)
+    {
+        const StringExpression::Atom& atom = expr._infix[a];
+
+        if (atom.first == StringExpression::VARIABLE)
+        {
+            Segment seg;
+            seg.isSlot = true;
+            seg.slot = _slots.add(varAt[a], schema);
+            _segments.push_back(seg);
+        }
+        else if (!_segments.empty() && !_segments.back().isSlot)
+        {
+            // merge adjacent literals:
+            _segments.back().literal += atom.second;
+            _literalLength += atom.second.length();
+        }
+        else
+        {
+            Segment seg;
+            seg.isSlot = false;
+            seg.literal = atom.second;
+            seg.slot = 0u;
+            _segments.push_back(seg);
+            _literalLength += atom.second.length();
+        }
+    }
+}
+
+std::string
+CompiledStringExpression::eval(const Feature* feature,
+                               const FilterContext* context,
+                               bool* out_scripted) const
+{
+    if (out_scripted)
+        *out_scripted = false;
+
+    if (_slots.size() == 0u)
+    {
+        return _segments.empty() ? std::string() : _segments.front().literal;
+    }
+
+    std::vector<std::string> values(_slots.size());
+    size_t length = _literalLength;
+    ScriptEngine* engine = 0L;
+    bool needEngine = true;
+
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        const ExpressionSlots::Slot& slot = _slots[s];
+
+        AttributeTable::const_iterator a;
+        if (feature && (a = feature->getAttrs().find(slot.name)) != feature->getAttrs().end())
+        {
+            values[s] = a->second.getString();
+        }
+        else if (slot.source == ExpressionSlots::SOURCE_ANY)
+        {
+            if (needEngine)
+            {
+                engine = scriptEngineOf(context);
+                needEngine = false;
+            }
+
+            if (engine)
+            {
+                ScriptResult result = engine->run(slot.name, feature, context);
+                if (result.success())
+                    values[s] = result.asString();
+                else
+                {
+                    // Couldn't execute it as code, just take it as a string literal.
+                    values[s] = slot.name;
+                    OE_DEBUG << LC << "Feature Script error on '" << _src << "': " << result.message() << std::endl;
+                }
+                if (out_scripted)
+                    *out_scripted = true;
+            }
+        }
+
+        length += values[s].length();
+    }
+
+    std::string output;
+    output.reserve(length);
+    for (std::vector<Segment>::const_iterator seg = _segments.begin(); seg != _segments.end(); ++seg)
+    {
+        output += seg->isSlot ? values[seg->slot] : seg->literal;
+    }
+    return output;
+}
+
+void
+CompiledStringExpression::eval(const FeatureList& features,
+                               const FilterContext* context,
+                               std::vector<std::string>& output) const
+{
+    output.resize(features.size());
+
+    unsigned k = 0;
+    for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++k)
+    {
+        output[k] = eval(f->get(), context);
+    }
+}
+
+//........................................................................
+
+ExpressionCache::ExpressionCache()
+{
+    //nop
+}
+
+const FeatureSchema&
+ExpressionCache::schemaOf(const FilterContext* context)
+{
+    static FeatureSchema s_empty;
+
+    if (context && context->getSession() && context->getSession()->getFeatureSource())
+        return context->getSession()->getFeatureSource()->getSchema();
+    else
+        return s_empty;
+}
+
+CompiledNumericExpression*
+ExpressionCache::compile(const NumericExpression& expr, const FeatureSchema& schema)
+{
+    ProgramKey key(expr.expr(), schemaSignature(expr.variables(), schema));
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    osg::ref_ptr<CompiledNumericExpression>& program = _numericPrograms[key];
+    if (!program.valid())
+        program = new CompiledNumericExpression(expr, schema);
+    return program.get();
+}
+
+CompiledStringExpression*
+ExpressionCache::compile(const StringExpression& expr, const FeatureSchema& schema)
+{
+    ProgramKey key(expr.expr(), schemaSignature(expr.variables(), schema));
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    osg::ref_ptr<CompiledStringExpression>& program = _stringPrograms[key];
+    if (!program.valid())
+        program = new CompiledStringExpression(expr, schema);
+    return program.get();
+}
+
+template<typename T, typename PROGRAM>
+T
+ExpressionCache::evalCached(const PROGRAM* program,
+                            std::map<ResultKey, Result<T> >& results,
+                            const Feature* feature,
+                            const FilterContext* context)
+{
+    if (feature == 0L)
+        return program->eval(feature, context);
+
+    ResultKey key(feature, program);
+    unsigned revision = feature->getAttrsRevision();
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        typename std::map<ResultKey, Result<T> >::const_iterator i = results.find(key);
+        if (i != results.end() && i->second.revision == revision)
+            return i->second.value;
+    }
+
+    // A script may give a different answer next time, so only
+    // attribute-derived results are kept.
+    bool scripted = false;
+    T value = program->eval(feature, context, &scripted);
+    if (!scripted)
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        Result<T>& result = results[key];
+        result.feature = feature;
+        result.revision = revision;
+        result.value = value;
+    }
+    return value;
+}
+
+template<typename T, typename PROGRAM>
+void
+ExpressionCache::evalCached(const PROGRAM* program,
+                            std::map<ResultKey, Result<T> >& results,
+                            const FeatureList& features,
+                            const FilterContext* context,
+                            std::vector<T>& output)
+{
+    output.resize(features.size());
+
+    // collect the features without a current cached result:
+    std::vector<const Feature*> misses;
+    std::vector<unsigned> missIndex;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        unsigned k = 0;
+        for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++k)
+        {
+            const Feature* feature = f->get();
+            if (feature)
+            {
+                typename std::map<ResultKey, Result<T> >::const_iterator i = results.find(ResultKey(feature, program));
+                if (i != results.end() && i->second.revision == feature->getAttrsRevision())
+                {
+                    output[k] = i->second.value;
+                    continue;
+                }
+            }
+            misses.push_back(feature);
+            missIndex.push_back(k);
+        }
+    }
+
+    if (misses.empty())
+        return;
+
+    std::vector<unsigned> revisions(misses.size(), 0u);
+    std::vector<bool> keep(misses.size(), false);
+    for (unsigned m = 0; m < misses.size(); ++m)
+    {
+        bool scripted = false;
+        if (misses[m])
+            revisions[m] = misses[m]->getAttrsRevision();
+        output[missIndex[m]] = program->eval(misses[m], context, &scripted);
+        keep[m] = misses[m] && !scripted;
+    }
+
+    Threading::ScopedMutexLock lock(_mutex);
+    for (unsigned m = 0; m < misses.size(); ++m)
+    {
+        if (keep[m])
+        {
+            Result<T>& result = results[ResultKey(misses[m], program)];
+            result.feature = misses[m];
+            result.revision = revisions[m];
+            result.value = output[missIndex[m]];
+        }
+    }
+}
+
+double
+ExpressionCache::eval(const NumericExpression& expr,
+                      const Feature* feature,
+                      const FilterContext* context)
+{
+    // Literals don't depend on the feature; also, two literals can share
+    // the same (rounded) source text.
+    if (expr.variables().empty())
+        return expr.eval();
+
+    return evalCached(compile(expr, schemaOf(context)), _numericResults, feature, context);
+}
+
+std::string
+ExpressionCache::eval(const StringExpression& expr,
+                      const Feature* feature,
+                      const FilterContext* context)
+{
+    if (expr.variables().empty())
+        return expr.eval();
+
+    return evalCached(compile(expr, schemaOf(context)), _stringResults, feature, context);
+}
+
+void
+ExpressionCache::eval(const NumericExpression& expr,
+                      const FeatureList& features,
+                      const FilterContext* context,
+                      std::vector<double>& output)
+{
+    if (expr.variables().empty())
+    {
+        output.assign(features.size(), expr.eval());
+        return;
+    }
+
+    evalCached(compile(expr, schemaOf(context)), _numericResults, features, context, output);
+}
+
+void
+ExpressionCache::eval(const StringExpression& expr,
+                      const FeatureList& features,
+                      const FilterContext* context,
+                      std::vector<std::string>& output)
+{
+    if (expr.variables().empty())
+    {
+        output.assign(features.size(), expr.eval());
+        return;
+    }
+
+    evalCached(compile(expr, schemaOf(context)), _stringResults, features, context, output);
+}
+
+void
+ExpressionCache::invalidate(const Feature* feature)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    // results are ordered by feature first, so each feature's are contiguous:
+    ResultKey first(feature, 0L);
+
+    std::map<ResultKey, Result<double> >::iterator n = _numericResults.lower_bound(first);
+    while (n != _numericResults.end() && n->first.first == feature)
+        _numericResults.erase(n++);
+
+    std::map<ResultKey, Result<std::string> >::iterator s = _stringResults.lower_bound(first);
+    while (s != _stringResults.end() && s->first.first == feature)
+        _stringResults.erase(s++);
+}
+
+void
+ExpressionCache::clear()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _numericResults.clear();
+    _stringResults.clear();
+}
+
+unsigned
+ExpressionCache::getNumResults() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _numericResults.size() + _stringResults.size();
+}
+
+unsigned
+ExpressionCache::getNumPrograms() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _numericPrograms.size() + _stringPrograms.size();
+}
@@ -0,0 +1,434 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/CoverageRasterizer>
+#include <osgEarth/AGG.h>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COVERAGE_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Adds covers into an 8-bit mask, saturating at full coverage.
+    struct span_cover8
+    {
+        static void render(unsigned char* ptr,
+                           int x,
+                           unsigned count,
+                           const unsigned char* covers,
+                           const unsigned char&)
+        {
+            unsigned char* p = ptr + x;
+            do
+            {
+                unsigned v = (unsigned)*p + (unsigned)*covers++;
+                *p++ = v > 255u ? 255u : (unsigned char)v;
+            }
+            while(--count);
+        }
+
+        static void hline(unsigned char* ptr,
+                          int x,
+                          unsigned count,
+                          const unsigned char& c)
+        {
+            ::memset(ptr + x, c, count);
+        }
+
+        static unsigned char get(unsigned char* ptr, int x)
+        {
+            return ptr[x];
+        }
+    };
+}
+
+struct CoverageRasterizer::Impl
+{
+    unsigned width, height;
+    std::vector<unsigned char> mask;
+    agg::rendering_buffer rbuf;
+    agg::rasterizer ras;
+    unsigned char gamma[256];
+    double xmin, ymin, xf, yf;
+
+    // inclusive pixel bounds of the accumulated coverage
+    int dirtyXMin, dirtyYMin, dirtyXMax, dirtyYMax;
+
+    // scratch space
+    std::vector<osg::Vec2d> points;
+    std::vector<osg::Vec2d> circle;
+    std::vector<unsigned char> covers;
+
+    Impl(unsigned w, unsigned h) :
+        width(w), height(h),
+        mask(w * h, 0u),
+        rbuf(mask.empty() ? 0L : &mask[0], w, h, w),
+        xmin(0.0), ymin(0.0), xf(1.0), yf(1.0)
+    {
+        // Rasterize linear coverage; gamma applies once the
+        // coverage of all the geometries has been summed.
+        unsigned char identity[256];
+        for (unsigned i = 0; i < 256u; ++i)
+        {
+            identity[i] = (unsigned char)i;
+            gamma[i] = (unsigned char)i;
+        }
+        ras.gamma(identity);
+
+        resetDirty();
+    }
+
+    void resetDirty()
+    {
+        dirtyXMin = dirtyYMin = INT_MAX;
+        dirtyXMax = dirtyYMax = INT_MIN;
+    }
+
+    bool empty() const
+    {
+        return dirtyXMin > dirtyXMax;
+    }
+
+    // Transforms a geometry part into pixels, dropping repeated points.
+    void toPixels(const Geometry* part, std::vector<osg::Vec2d>& out) const
+    {
+        out.clear();
+        out.reserve(part->size());
+        for (Geometry::const_iterator p = part->begin(); p != part->end(); ++p)
+        {
+            osg::Vec2d px(xf * (p->x() - xmin), yf * (p->y() - ymin));
+            if (out.empty() || px != out.back())
+                out.push_back(px);
+        }
+    }
+
+    void quad(const osg::Vec2d& a, const osg::Vec2d& b, const osg::Vec2d& c, const osg::Vec2d& d)
+    {
+        ras.move_to_d(a.x(), a.y());
+        ras.line_to_d(b.x(), b.y());
+        ras.line_to_d(c.x(), c.y());
+        ras.line_to_d(d.x(), d.y());
+    }
+
+    void disc(const osg::Vec2d& center)
+    {
+        ras.move_to_d(center.x() + circle[0].x(), center.y() + circle[0].y());
+        for (unsigned i = 1; i < circle.size(); ++i)
+            ras.line_to_d(center.x() + circle[i].x(), center.y() + circle[i].y());
+    }
+
+    // Sweeps the current outline into the mask.
+    void render(agg::filling_rule_e rule)
+    {
+        ras.filling_rule(rule);
+
+        agg::renderer<span_cover8, unsigned char> ren(rbuf);
+        ras.render(ren, (unsigned char)0u);
+
+        // grow the dirty bounds by the part of the outline inside the mask.
+        int x0 = osg::maximum(ras.min_x(), 0);
+        int y0 = osg::maximum(ras.min_y(), 0);
+        int x1 = osg::minimum(ras.max_x(), (int)width - 1);
+        int y1 = osg::minimum(ras.max_y(), (int)height - 1);
+        if (x0 <= x1 && y0 <= y1)
+        {
+            dirtyXMin = osg::minimum(dirtyXMin, x0);
+            dirtyYMin = osg::minimum(dirtyYMin, y0);
+            dirtyXMax = osg::maximum(dirtyXMax, x1);
+            dirtyYMax = osg::maximum(dirtyYMax, y1);
+        }
+
+        ras.reset();
+    }
+
+    void clear()
+    {
+        if (!empty())
+        {
+            unsigned count = dirtyXMax - dirtyXMin + 1;
+            for (int y = dirtyYMin; y <= dirtyYMax; ++y)
+                ::memset(&mask[y * width + dirtyXMin], 0, count);
+        }
+        resetDirty();
+    }
+};
+
+CoverageRasterizer::CoverageRasterizer(unsigned width, unsigned height) :
+_impl(new Impl(width, height))
+{
+    //nop
+}
+
+CoverageRasterizer::~CoverageRasterizer()
+{
+    delete _impl;
+}
+
+void
+CoverageRasterizer::setGamma(double value)
+{
+    for (unsigned i = 0; i < 256u; ++i)
+        _impl->gamma[i] = (unsigned char)(pow(double(i) / 255.0, value) * 255.0);
+}
+
+void
+CoverageRasterizer::setFrame(double xmin, double ymin, double xf, double yf)
+{
+    _impl->xmin = xmin;
+    _impl->ymin = ymin;
+    _impl->xf = xf;
+    _impl->yf = yf;
+}
+
+bool
+CoverageRasterizer::empty() const
+{
+    return _impl->empty();
+}
+
+void
+CoverageRasterizer::addPolygon(const Geometry* geometry)
+{
+    if (!geometry)
+        return;
+
+    ConstGeometryIterator gi(geometry);
+    while (gi.hasMore())
+    {
+        _impl->toPixels(gi.next(), _impl->points);
+        const std::vector<osg::Vec2d>& points = _impl->points;
+        if (points.size() < 3)
+            continue;
+
+        _impl->ras.move_to_d(points[0].x(), points[0].y());
+        for (unsigned i = 1; i < points.size(); ++i)
+            _impl->ras.line_to_d(points[i].x(), points[i].y());
+    }
+
+    _impl->render(agg::fill_even_odd);
+}
+
+void
+CoverageRasterizer::addLine(const Geometry* geometry, double width, Stroke::LineCapStyle cap)
+{
+    if (!geometry || !(width > 0.0))
+        return;
+
+    const double hw = 0.5 * width;
+
+    // Every piece of the stroke (segment quads, joins and caps) winds CCW,
+    // so the non-zero rule fills their union exactly once.
+    std::vector<osg::Vec2d>& circle = _impl->circle;
+    unsigned numCircleSegs = (unsigned)osg::clampBetween(hw * 4.0, 8.0, 64.0);
+    circle.resize(numCircleSegs);
+    for (unsigned i = 0; i < numCircleSegs; ++i)
+    {
+        double a = 2.0 * osg::PI * (double)i / (double)numCircleSegs;
+        circle[i].set(hw * cos(a), hw * sin(a));
+    }
+
+    std::vector<osg::Vec2d>& pts = _impl->points;
+
+    ConstGeometryIterator gi(geometry);
+    while (gi.hasMore())
+    {
+        const Geometry* part = gi.next();
+        _impl->toPixels(part, pts);
+        if (pts.empty())
+            continue;
+
+        bool closed = dynamic_cast<const Ring*>(part) != 0L;
+        if (closed && pts.size() > 1 && pts.front() == pts.back())
+            pts.pop_back();
+        if (pts.size() < 3)
+            closed = false;
+
+        unsigned n = pts.size();
+
+        if (n == 1)
+        {
+            // a degenerate line is only visible through its caps.
+            if (cap == Stroke::LINECAP_ROUND)
+            {
+                _impl->disc(pts[0]);
+            }
+            else if (cap == Stroke::LINECAP_SQUARE)
+            {
+                osg::Vec2d dx(hw, 0.0), dy(0.0, hw);
+                _impl->quad(pts[0] - dx - dy, pts[0] + dx - dy, pts[0] + dx + dy, pts[0] - dx + dy);
+            }
+            continue;
+        }
+
+        unsigned numEdges = closed ? n : n - 1;
+        for (unsigned e = 0; e < numEdges; ++e)
+        {
+            osg::Vec2d a = pts[e];
+            osg::Vec2d b = pts[(e + 1) % n];
+            osg::Vec2d dir = b - a;
+            dir.normalize();
+            osg::Vec2d side(-dir.y() * hw, dir.x() * hw);
+
+            if (!closed && cap == Stroke::LINECAP_SQUARE)
+            {
+                if (e == 0)
+                    a -= dir * hw;
+                if (e == numEdges - 1)
+                    b += dir * hw;
+            }
+
+            _impl->quad(a - side, b - side, b + side, a + side);
+        }
+
+        // Round joins. Skip the ones where the line barely turns, since the
+        // gap between the segment quads would not cover any pixel.
+        unsigned firstJoin = closed ? 0u : 1u;
+        unsigned lastJoin = closed ? n : n - 1;
+        for (unsigned v = firstJoin; v < lastJoin; ++v)
+        {
+            osg::Vec2d d0 = pts[v] - pts[(v + n - 1) % n];
+            osg::Vec2d d1 = pts[(v + 1) % n] - pts[v];
+            d0.normalize();
+            d1.normalize();
+            double cross = d0.x() * d1.y() - d0.y() * d1.x();
+            if (d0 * d1 > 0.0 && fabs(cross) * hw < 0.05)
+                continue;
+
+            _impl->disc(pts[v]);
+        }
+
+        if (!closed && cap == Stroke::LINECAP_ROUND)
+        {
+            _impl->disc(pts.front());
+            _impl->disc(pts.back());
+        }
+    }
+
+    _impl->render(agg::fill_non_zero);
+}
+
+void
+CoverageRasterizer::blend(unsigned char* pixels, unsigned rowBytes, const unsigned char abgr[4])
+{
+    if (_impl->empty())
+        return;
+
+    unsigned count = _impl->dirtyXMax - _impl->dirtyXMin + 1;
+    std::vector<unsigned char>& covers = _impl->covers;
+    covers.resize(count);
+
+    for (int y = _impl->dirtyYMin; y <= _impl->dirtyYMax; ++y)
+    {
+        const unsigned char* coverage = &_impl->mask[y * _impl->width + _impl->dirtyXMin];
+        for (unsigned i = 0; i < count; ++i)
+            covers[i] = _impl->gamma[coverage[i]];
+
+        blendSpan(pixels + y * rowBytes + (_impl->dirtyXMin << 2), &covers[0], count, abgr);
+    }
+
+    _impl->clear();
+}
+
+void
+CoverageRasterizer::fill(float* pixels, unsigned rowFloats, float value)
+{
+    if (_impl->empty())
+        return;
+
+    for (int y = _impl->dirtyYMin; y <= _impl->dirtyYMax; ++y)
+    {
+        const unsigned char* coverage = &_impl->mask[y * _impl->width];
+        float* row = pixels + y * rowFloats;
+        for (int x = _impl->dirtyXMin; x <= _impl->dirtyXMax; ++x)
+        {
+            if (coverage[x] > 127)
+                row[x] = value;
+        }
+    }
+
+    _impl->clear();
+}
+
+void
+CoverageRasterizer::blendSpan(unsigned char* pixels,
+                              const unsigned char* covers,
+                              unsigned count,
+                              const unsigned char abgr[4])
+{
+    // The blend weight is the coverage times the color's alpha, which the
+    // ABGR byte order stores first.
+    const int ca = abgr[0];
+    unsigned char* p = pixels;
+    unsigned i = 0;
+
+#ifdef COVERAGE_USE_SSE2
+    // Four pixels at a time, one pixel per float vector. Every intermediate
+    // is an integer below 2^24, so the float math is exact and matches the
+    // scalar fixed-point result bit for bit.
+    const __m128 color = _mm_set_ps(abgr[3], abgr[2], abgr[1], abgr[0]);
+    const __m128 one = _mm_set1_ps(65536.0f);
+    const __m128 scale = _mm_set1_ps(1.0f / 65536.0f);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 4u <= count; i += 4u, p += 16)
+    {
+        const unsigned char* c = covers + i;
+        if ((c[0] | c[1] | c[2] | c[3]) == 0)
+            continue;
+
+        __m128i px = _mm_loadu_si128((const __m128i*)p);
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+
+        __m128 f[4];
+        f[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+        f[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+        f[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+        f[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+
+        __m128i r[4];
+        for (unsigned k = 0; k < 4u; ++k)
+        {
+            __m128 alpha = _mm_set1_ps((float)(c[k] * ca));
+            __m128 v = _mm_add_ps(_mm_mul_ps(f[k], one), _mm_mul_ps(_mm_sub_ps(color, f[k]), alpha));
+            r[k] = _mm_cvttps_epi32(_mm_mul_ps(v, scale));
+        }
+
+        __m128i out = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3]));
+        _mm_storeu_si128((__m128i*)p, out);
+    }
+#endif
+
+    for (; i < count; ++i, p += 4)
+    {
+        int alpha = covers[i] * ca;
+        if (alpha == 0)
+            continue;
+
+        for (unsigned k = 0; k < 4u; ++k)
+            p[k] = (unsigned char)((((abgr[k] - p[k]) * alpha) + (p[k] << 16)) >> 16);
+    }
+}
@@ -20,6 +20,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Map>
 #include <osgEarth/Metrics>
+#include <osgEarth/BufferPool>
 
 using namespace osgEarth;
 
@@ -81,7 +82,7 @@ ElevationTexture::ElevationTexture(const TileKey& key, const GeoHeightField& in_
 
         osg::Vec4 value;
 
-        osg::Image* heights = new osg::Image();
+        PooledImage* heights = new PooledImage();
         heights->allocateImage(_heightField->getNumColumns(), _heightField->getNumRows(), 1, GL_RED, GL_FLOAT);
         heights->setInternalTextureFormat(GL_R32F);
 
@@ -157,7 +158,7 @@ NormalMapGenerator::createNormalMap(
 
     ElevationPool::WorkingSet* workingSet = static_cast<ElevationPool::WorkingSet*>(ws);
 
-    osg::Image* image = new osg::Image();
+    PooledImage* image = new PooledImage();
     image->allocateImage(
         ELEVATION_TILE_SIZE, ELEVATION_TILE_SIZE, 1,
         GL_RG, GL_UNSIGNED_BYTE);
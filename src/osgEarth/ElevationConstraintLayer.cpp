@@ -117,6 +117,13 @@ ElevationConstraintLayer::addedToMap(const Map* map)
     }
 }
 
+void
+ElevationConstraintLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    ImageLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+}
+
 void
 ElevationConstraintLayer::removedFromMap(const Map* map)
 {
@@ -22,6 +22,7 @@
 #include <osgEarth/MemCache>
 #include <osgEarth/Metrics>
 #include <osgEarth/NetworkMonitor>
+#include <osgEarth/MetricsRegistry>
 #include <cinttypes>
 
 using namespace osgEarth;
@@ -63,6 +64,36 @@ ElevationLayer::Options::fromConfig( const Config& conf )
 
 namespace
 {
+    using namespace osgEarth::Util;
+
+    void countCacheHit(const std::string& layerName, const char* cache)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("layer", layerName));
+        labels.push_back(std::make_pair("cache", std::string(cache)));
+        MetricsRegistry::instance()->counter(
+            "osgearth_layer_cache_hits_total",
+            "Layer tiles served from a cache", labels)->add();
+    }
+
+    void countCacheMiss(const std::string& layerName)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("layer", layerName));
+        MetricsRegistry::instance()->counter(
+            "osgearth_layer_cache_misses_total",
+            "Layer tiles not found in any cache", labels)->add();
+    }
+
+    MetricsRegistry::Histogram* fetchTime(const std::string& layerName)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("layer", layerName));
+        return MetricsRegistry::instance()->histogram(
+            "osgearth_layer_fetch_seconds",
+            "Time spent fetching and decoding a tile from the layer source", labels);
+    }
+
     // perform very basic sanity-check validation on a heightfield.
     bool validateHeightField(osg::HeightField* hf)
     {
@@ -404,6 +435,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
                 key.getExtent());
 
             fromMemCache = true;
+            countCacheHit(getName(), "memory");
         }
     }
 
@@ -439,6 +471,7 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
                     {
                         hf = cachedHF;
                         fromCache = true;
+                        countCacheHit(getName(), "bin");
                     }
                 }
             }
@@ -459,8 +492,11 @@ ElevationLayer::createHeightFieldInKeyProfile(const TileKey& key, ProgressCallba
                 return GeoHeightField::INVALID;
             }
 
+            countCacheMiss(getName());
+
             if (key.getProfile()->isHorizEquivalentTo(getProfile()))
             {
+                MetricsRegistry::ScopedTimer timer(fetchTime(getName()));
                 result = createHeightFieldImplementation(key, progress);
             }
             else
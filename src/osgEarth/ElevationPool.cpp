@@ -23,6 +23,7 @@
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/Registry>
 #include <osgEarth/Containers>
+#include <osgEarth/MetricsRegistry>
 
 #include <thread>
 #include <chrono>
@@ -31,6 +32,20 @@ using namespace osgEarth;
 
 #define LC "[ElevationPool] "
 
+namespace
+{
+    using namespace osgEarth::Util;
+
+    MetricsRegistry::Counter* poolHits(const char* tier)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("tier", std::string(tier)));
+        return MetricsRegistry::instance()->counter(
+            "osgearth_elevation_pool_hits_total",
+            "Elevation rasters found in an existing cache tier", labels);
+    }
+}
+
 void
 ElevationPool::MapCallbackAdapter::onMapModelChanged(const MapModelChange& c)
 {
@@ -270,6 +285,18 @@ ElevationPool::getOrCreateRaster(
 
     findExistingRaster(key, ws, result, &fromWS, &fromL2, &fromLUT);
 
+    static MetricsRegistry::Counter* s_wsHits = poolHits("local");
+    static MetricsRegistry::Counter* s_L2Hits = poolHits("L2");
+    static MetricsRegistry::Counter* s_LUTHits = poolHits("global");
+    static MetricsRegistry::Counter* s_misses = MetricsRegistry::instance()->counter(
+        "osgearth_elevation_pool_misses_total",
+        "Elevation rasters that had to be built from the elevation layers");
+
+    if (fromWS) s_wsHits->add();
+    else if (fromL2) s_L2Hits->add();
+    else if (fromLUT) s_LUTHits->add();
+    else s_misses->add();
+
     if (!result.valid())
     {
         // need to build NEW data for this key
@@ -447,6 +474,11 @@ ElevationPool::sampleMapCoords(
     const Units& units = map->getSRS()->getUnits();
     Distance pointRes(0.0, units);
 
+    unsigned maxLOD = INT_MAX; // best available until a point sets a resolution
+
+    // extent of the current tile; empty until the first point
+    double kxmin = 1.0, kxmax = 0.0, kymin = 1.0, kymax = 0.0;
+
     for(auto& p : points)
     {
         {
@@ -458,15 +490,27 @@ ElevationPool::sampleMapCoords(
 
                 double resolutionInMapUnits = pointRes.asDistance(units, p.y());
 
-                unsigned maxLOD = profile->getLevelOfDetailForHorizResolution(
+                maxLOD = profile->getLevelOfDetailForHorizResolution(
                     resolutionInMapUnits,
                     ELEVATION_TILE_SIZE);
 
-                lod = osg::minimum( getLOD(p.x(), p.y()), maxLOD );
+                lastRes = p.w();
 
-                profile->getNumTiles(lod, tw, th);
+                // force a new LOD lookup:
+                kxmin = 1.0, kxmax = 0.0;
+            }
 
-                lastRes = p.w();
+            // The best available LOD can vary across the points (e.g. a
+            // high-res inset), so look it up again whenever a point leaves
+            // the previous tile.
+            bool newTile = p.x() < kxmin || p.x() > kxmax || p.y() < kymin || p.y() > kymax;
+            if (newTile)
+            {
+                lod = osg::minimum( getLOD(p.x(), p.y()), maxLOD );
+                if (lod != lod_prev)
+                {
+                    profile->getNumTiles(lod, tw, th);
+                }
             }
 
             rx = (p.x()-pxmin)/pw, ry = (p.y()-pymin)/ph;
@@ -479,6 +523,13 @@ ElevationPool::sampleMapCoords(
                 lod_prev = lod;
                 tx_prev = tx;
                 ty_prev = ty;
+                newTile = true;
+            }
+
+            if (newTile)
+            {
+                kxmin = pxmin + pw*(double)tx/(double)tw, kxmax = pxmin + pw*(double)(tx+1)/(double)tw;
+                kymax = pymin + ph - ph*(double)ty/(double)th, kymin = pymin + ph - ph*(double)(ty+1)/(double)th;
             }
         }
         
@@ -589,15 +640,27 @@ ElevationPool::sampleMapCoords(
         resolutionInMapUnits,
         ELEVATION_TILE_SIZE);
 
-    lod = osg::minimum( getLOD(points[0].x(), points[0].y()), maxLOD );
-
-    profile->getNumTiles(lod, tw, th);
+    // extent of the current tile; empty until the first point
+    double kxmin = 1.0, kxmax = 0.0, kymin = 1.0, kymax = 0.0;
 
     for(auto& p : points)
     {
         {
             //OE_PROFILING_ZONE_NAMED("createTileKey");
 
+            // The best available LOD can vary across a large batch of points
+            // (e.g. a high-res inset), but looking it up is an index search,
+            // so only do it when a point leaves the previous tile.
+            bool newTile = p.x() < kxmin || p.x() > kxmax || p.y() < kymin || p.y() > kymax;
+            if (newTile)
+            {
+                lod = osg::minimum( getLOD(p.x(), p.y()), maxLOD );
+                if (lod != lod_prev)
+                {
+                    profile->getNumTiles(lod, tw, th);
+                }
+            }
+
             rx = (p.x()-pxmin)/pw, ry = (p.y()-pymin)/ph;
             tx = osg::clampBelow((unsigned)(rx * (double)tw), tw-1u ); // TODO: wrap around for geo
             ty = osg::clampBelow((unsigned)((1.0-ry) * (double)th), th-1u );
@@ -608,6 +671,13 @@ ElevationPool::sampleMapCoords(
                 lod_prev = lod;
                 tx_prev = tx;
                 ty_prev = ty;
+                newTile = true;
+            }
+
+            if (newTile)
+            {
+                kxmin = pxmin + pw*(double)tx/(double)tw, kxmax = pxmin + pw*(double)(tx+1)/(double)tw;
+                kymax = pymin + ph - ph*(double)ty/(double)th, kymin = pymin + ph - ph*(double)(ty+1)/(double)th;
             }
         }
 
@@ -464,6 +464,7 @@ MapNodeHelper::parse(MapNode*             mapNode,
     bool useLogDepth2  = args.read("--logdepth2");
     bool useLogDepth   = !args.read("--nologdepth") && !useLogDepth2; //args.read("--logdepth");
     bool kmlUI         = args.read("--kmlui");
+    bool kmlStream     = args.read("--kmlstream");
 
     std::string kmlFile;
     args.read( "--kml", kmlFile );
@@ -513,6 +514,7 @@ MapNodeHelper::parse(MapNode*             mapNode,
     {
         KML::KMLOptions kml_options;
         kml_options.declutter() = true;
+        kml_options.progressive() = kmlStream;
 
         // set up a default icon for point placemarks:
         IconSymbol* defaultIcon = new IconSymbol();
@@ -767,6 +769,7 @@ MapNodeHelper::usage() const
         << "  --sky                         : add a sky model\n"
         << "  --kml <file.kml>              : load a KML or KMZ file\n"
         << "  --kmlui                       : display a UI for toggling nodes loaded with --kml\n"
+        << "  --kmlstream                   : stream the --kml file in the background\n"
         << "  --coords                      : display map coords under mouse\n"
         << "  --ortho                       : use an orthographic camera\n"
         << "  --logdepth                    : activates the logarithmic depth buffer\n"
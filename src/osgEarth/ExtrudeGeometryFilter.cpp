@@ -1018,6 +1018,27 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
         if (input->getGeometry() == 0L)
             continue;
 
+        // calculate the extrusion height, once for all the parts:
+        float height;
+
+        if ( _heightCallback.valid() )
+        {
+            height = _heightCallback->operator()(input, context);
+        }
+        else if ( _heightExpr.isSet() )
+        {
+            height = context.expressionCache()->eval( _heightExpr.get(), input, &context );
+        }
+        else
+        {
+            height = *_extrusionSymbol->height();
+        }
+
+        // Set up for feature naming and feature indexing:
+        std::string name;
+        if ( !_featureNameExpr.empty() )
+            name = context.expressionCache()->eval( _featureNameExpr, input, &context );
+
         // iterator over the parts.
         GeometryIterator iter( input->getGeometry(), false );
         while( iter.hasMore() )
@@ -1047,22 +1068,6 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                 baselines->setUseVertexBufferObjects(true);
             }
 
-            // calculate the extrusion height:
-            float height;
-
-            if ( _heightCallback.valid() )
-            {
-                height = _heightCallback->operator()(input, context);
-            }
-            else if ( _heightExpr.isSet() )
-            {
-                height = input->eval( _heightExpr.mutable_value(), &context );
-            }
-            else
-            {
-                height = *_extrusionSymbol->height();
-            }
-
             osg::ref_ptr<osg::StateSet> wallStateSet;
             osg::ref_ptr<osg::StateSet> roofStateSet;
 
@@ -1179,11 +1184,6 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                 tess.retessellatePolygons( *(baselines.get()) );
             }
 
-            // Set up for feature naming and feature indexing:
-            std::string name;
-            if ( !_featureNameExpr.empty() )
-                name = input->eval( _featureNameExpr, &context );
-
             FeatureIndexBuilder* index = context.featureIndex();
 
             if ( walls.valid() && walls->getVertexArray() && walls->getVertexArray()->getNumElements() > 0 )
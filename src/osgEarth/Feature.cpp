@@ -17,12 +17,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/Feature>
+#include <osgEarth/CompiledExpression>
 #include <osgEarth/FilterContext>
 #include <osgEarth/GeometryUtils>
 #include <osgEarth/ScriptEngine>
 
 #include <osgEarth/StringUtils>
-#include <osgEarth/JsonUtils>
+#include <osgEarth/GeoJSON>
 #include <algorithm>
 
 using namespace osgEarth;
@@ -174,14 +175,16 @@ const std::vector<double>& AttributeValue::getDoubleArrayValue() const
 
 Feature::Feature() :
     _fid(0LL),
-    _srs(NULL)
+    _srs(NULL),
+    _attrsRevision(0u)
 {
     //nop
 }
 
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
-_srs( 0L )
+_srs( 0L ),
+_attrsRevision( 0u )
 {
     //NOP
 }
@@ -189,7 +192,8 @@ _srs( 0L )
 Feature::Feature( Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid ) :
 _geom ( geom ),
 _srs  ( srs ),
-_fid  ( fid )
+_fid  ( fid ),
+_attrsRevision( 0u )
 {
     if ( !style.empty() )
         _style = style;
@@ -202,7 +206,8 @@ _fid      ( rhs._fid ),
 _attrs    ( rhs._attrs ),
 _style    ( rhs._style ),
 _geoInterp( rhs._geoInterp ),
-_srs      ( rhs._srs.get() )
+_srs      ( rhs._srs.get() ),
+_attrsRevision( 0u )
 {
     if ( rhs._geom.valid() )
         _geom = rhs._geom->clone();
@@ -262,6 +267,7 @@ Feature::dirty()
 void
 Feature::set( const std::string& name, const std::string& value )
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_STRING;
     a.second.stringValue = value;
@@ -271,6 +277,7 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_DOUBLE;
     a.second.doubleValue = value;
@@ -280,6 +287,7 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, long long value )
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
@@ -289,6 +297,7 @@ Feature::set( const std::string& name, long long value )
 void
 Feature::set(const std::string& name, int value)
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
@@ -298,12 +307,14 @@ Feature::set(const std::string& name, int value)
 void
 Feature::set( const std::string& name, const AttributeValue& value)
 {
+    ++_attrsRevision;
     _attrs[ name ] = value;
 }
 
 void
 Feature::set( const std::string& name, bool value )
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_BOOL;
     a.second.boolValue = value;
@@ -313,6 +324,7 @@ Feature::set( const std::string& name, bool value )
 void
 Feature::set( const std::string& name, const std::vector<double>& value )
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_DOUBLEARRAY;
     a.second.doubleArrayValue = value;
@@ -322,6 +334,7 @@ Feature::set( const std::string& name, const std::vector<double>& value )
 void
 Feature::setSwap( const std::string& name, std::vector<double>& value )
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_DOUBLEARRAY;
     a.second.doubleArrayValue.swap(value);
@@ -331,6 +344,7 @@ Feature::setSwap( const std::string& name, std::vector<double>& value )
 void
 Feature::setNull( const std::string& name)
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.second.set = false;
 }
@@ -338,6 +352,7 @@ Feature::setNull( const std::string& name)
 void
 Feature::setNull( const std::string& name, AttributeType type)
 {
+    ++_attrsRevision;
     AttributeValue& a = _attrs[name];
     a.first = type;
     a.second.set = false;
@@ -397,6 +412,12 @@ Feature::isSet( const std::string& name) const
 double
 Feature::eval( NumericExpression& expr, FilterContext const* context ) const
 {
+    // the context's cache compiles the expression once and remembers results
+    if (context && context->expressionCache())
+    {
+        return context->expressionCache()->eval(expr, this, context);
+    }
+
     const NumericExpression::Variables& vars = expr.variables();
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
@@ -466,6 +487,13 @@ Feature::eval(NumericExpression& expr, Session* session) const
 const std::string&
 Feature::eval( StringExpression& expr, FilterContext const* context ) const
 {
+    if (context && context->expressionCache())
+    {
+        expr._value = context->expressionCache()->eval(expr, this, context);
+        expr._dirty = false;
+        return expr._value;
+    }
+
     const StringExpression::Variables& vars = expr.variables();
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
@@ -641,99 +669,12 @@ Feature::calculateExtent() const
 std::string
 Feature::getGeoJSON() const
 {
-    std::string geometry = GeometryUtils::geometryToGeoJSON( getGeometry() );
-
-    Json::Value root(Json::objectValue);
-    root["type"] = "Feature";
-    root["id"] = (double)getFID(); //TODO:  Update JSON to use unsigned longs
-
-    Json::Reader reader;
-    Json::Value geometryValue( Json::objectValue );
-    if ( reader.parse( geometry, geometryValue ) )
-    {
-        root["geometry"] = geometryValue;
-    }
-
-    //Write out all the properties
-    Json::Value props(Json::objectValue);
-    if (getAttrs().size() > 0)
-    {
-
-        for (AttributeTable::const_iterator itr = getAttrs().begin(); itr != getAttrs().end(); ++itr)
-        {
-            if (itr->second.first == ATTRTYPE_INT)
-            {
-                if (itr->second.second.set)
-                {
-                    props[itr->first] = (double)itr->second.getInt();
-                }
-                else
-                {
-                    props[itr->first] = Json::nullValue;
-                }
-            }
-            else if (itr->second.first == ATTRTYPE_DOUBLE)
-            {
-                if (itr->second.second.set)
-                {
-                    props[itr->first] = itr->second.getDouble();
-                }
-                else
-                {
-                    props[itr->first] = Json::nullValue;
-                }
-            }
-            else if (itr->second.first == ATTRTYPE_BOOL)
-            {
-                if (itr->second.second.set)
-                {
-                    props[itr->first] = itr->second.getBool();
-                }
-                else
-                {
-                    props[itr->first] = Json::nullValue;
-                }
-            }
-            else
-            {
-                if (itr->second.second.set)
-                {
-                    props[itr->first] = itr->second.getString();
-                }
-                else
-                {
-                    props[itr->first] = Json::nullValue;
-                }
-            }
-        }
-    }
-
-    root["properties"] = props;
-    return Json::FastWriter().write( root );
+    return GeoJSONWriter::toGeoJSON(this);
 }
 
 std::string Feature::featuresToGeoJSON( const FeatureList& features)
 {
-    std::stringstream buf;
-
-    buf << "{\"type\": \"FeatureCollection\", \"features\": [";
-
-    FeatureList::const_iterator last = features.end();
-    last--;
-
-    for (FeatureList::const_iterator i = features.begin(); i != features.end(); i++)
-    {
-        buf << i->get()->getGeoJSON();
-        if (i != last)
-        {
-            buf << ",";
-        }
-    }
-
-    buf << "]}";
-
-    return buf.str();
-
+    return GeoJSONWriter::toGeoJSON(features);
 }
 
 void Feature::transform( const SpatialReference* srs )
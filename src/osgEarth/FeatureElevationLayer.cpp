@@ -130,6 +130,13 @@ FeatureElevationLayer::addedToMap(const Map* map)
     options().featureSource().addedToMap(map);
 }
 
+void
+FeatureElevationLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    ElevationLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+}
+
 void
 FeatureElevationLayer::removedFromMap(const Map* map)
 {
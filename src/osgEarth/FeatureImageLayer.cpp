@@ -20,13 +20,16 @@
 #include <osgEarth/Session>
 #include <osgEarth/FeatureCursor>
 #include <osgEarth/TransformFilter>
-#include <osgEarth/BufferFilter>
 #include <osgEarth/ResampleFilter>
+#include <osgEarth/BufferFilter>
 #include <osgEarth/AGG.h>
+#include <osgEarth/CoverageRasterizer>
 #include <osgEarth/StyleSheet>
 #include <osgEarth/Registry>
 #include <osgEarth/Progress>
 #include <osgEarth/LandCover>
+#include <osgEarth/ThreadingUtils>
+#include <cstring>
 
 using namespace osgEarth;
 
@@ -151,6 +154,232 @@ namespace osgEarth { namespace FeatureImageLayerImpl
         ras.reset();
     }
 
+    // Accumulates runs of consecutively rendered features that share a
+    // color, and blends each run into the image in one pass.
+    struct ColorRuns
+    {
+        ColorRuns(CoverageRasterizer& ras, osg::Image* image) :
+            _ras(ras), _image(image)
+        {
+            ::memset(_abgr, 0, 4);
+        }
+
+        void setColor(const osg::Vec4& color)
+        {
+            unsigned char abgr[4];
+            abgr[0] = (unsigned char)(127.0f+(color.a()*255.0f)/2.0f); // scale alpha up
+            abgr[1] = (unsigned char)(color.b()*255.0f);
+            abgr[2] = (unsigned char)(color.g()*255.0f);
+            abgr[3] = (unsigned char)(color.r()*255.0f);
+
+            if (::memcmp(abgr, _abgr, 4) != 0)
+            {
+                flush();
+                ::memcpy(_abgr, abgr, 4);
+            }
+        }
+
+        void flush()
+        {
+            _ras.blend(_image->data(), _image->s() * 4, _abgr);
+        }
+
+        CoverageRasterizer& _ras;
+        osg::Image* _image;
+        unsigned char _abgr[4];
+    };
+
+    // Returns the part of a geometry to rasterize: the geometry itself if it
+    // lies within the crop bounds, a cropped copy if it straddles them, or
+    // NULL if it falls outside. Only straddling geometry pays for a crop.
+    const Geometry* clip(const Geometry* geometry, const Bounds& cropBounds, const Polygon* cropPoly, osg::ref_ptr<Geometry>& cropped)
+    {
+        Bounds b = geometry->getBounds();
+        if (!b.isValid())
+            return 0L;
+
+        if (b.xMin() > cropBounds.xMax() || b.xMax() < cropBounds.xMin() ||
+            b.yMin() > cropBounds.yMax() || b.yMax() < cropBounds.yMin())
+        {
+            return 0L;
+        }
+
+        if (b.xMin() >= cropBounds.xMin() && b.xMax() <= cropBounds.xMax() &&
+            b.yMin() >= cropBounds.yMin() && b.yMax() <= cropBounds.yMax())
+        {
+            return geometry;
+        }
+
+        return geometry->crop(cropPoly, cropped) ? cropped.get() : 0L;
+    }
+
+    // Fewest features worth handing to another thread for buffering or clipping
+    const unsigned MIN_FEATURES_PER_PART = 16u;
+
+    unsigned resolveNumThreads(unsigned numThreads)
+    {
+        return numThreads > 0u ? numThreads : (unsigned)osg::maximum(OpenThreads::GetNumberOfProcessors(), 1);
+    }
+
+    // Buffers lines into polygons, in contiguous parts on the shared fork-join
+    // pool. The parts go back in order, so the result matches a serial buffer.
+    void bufferLines(FeatureList& lines, const BufferFilter& buffer, FilterContext& context, unsigned numThreads)
+    {
+        unsigned numLines = lines.size();
+        unsigned numParts = numThreads > 1u && BufferFilter::isSupported() ?
+            Threading::ForkJoin::getNumParts(numLines, numThreads, MIN_FEATURES_PER_PART) : 0u;
+
+        if (numParts < 2u)
+        {
+            BufferFilter(buffer).push(lines, context);
+            return;
+        }
+
+        std::vector<FeatureList> parts(numParts);
+        FeatureList::iterator first = lines.begin();
+        for (unsigned p = 0; p < numParts; ++p)
+        {
+            unsigned count = (numLines * (p + 1u)) / numParts - (numLines * p) / numParts;
+            FeatureList::iterator last = first;
+            std::advance(last, count);
+            parts[p].splice(parts[p].end(), lines, first, last);
+            first = last;
+        }
+
+        osg::ref_ptr<Threading::ForkJoin> job = new Threading::ForkJoin();
+        for (unsigned p = 0; p < numParts; ++p)
+        {
+            job->add([&, p]()
+            {
+                BufferFilter localBuffer(buffer);
+                FilterContext localCX(context);
+                localBuffer.push(parts[p], localCX);
+            });
+        }
+        job->run(numThreads);
+
+        for (unsigned p = 0; p < numParts; ++p)
+            lines.splice(lines.end(), parts[p]);
+    }
+
+    // Clips the geometry of each feature (see clip), in parallel parts.
+    // out[i] holds the part of feature i to rasterize, or NULL.
+    void clipFeatures(const FeatureList& features, const Bounds& cropBounds, const Polygon* cropPoly,
+                      std::vector<osg::ref_ptr<const Geometry> >& out, unsigned numThreads)
+    {
+        std::vector<const Geometry*> geometries;
+        geometries.reserve(features.size());
+        for (FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+            geometries.push_back(i->get()->getGeometry());
+
+        unsigned numGeometries = geometries.size();
+        out.assign(numGeometries, 0L);
+
+        auto clipRange = [&](unsigned begin, unsigned end)
+        {
+            for (unsigned i = begin; i < end; ++i)
+            {
+                osg::ref_ptr<Geometry> cropped;
+                if (geometries[i])
+                    out[i] = clip(geometries[i], cropBounds, cropPoly, cropped);
+            }
+        };
+
+        unsigned numParts = numThreads > 1u ?
+            Threading::ForkJoin::getNumParts(numGeometries, numThreads, MIN_FEATURES_PER_PART) : 0u;
+
+        if (numParts < 2u)
+        {
+            clipRange(0u, numGeometries);
+            return;
+        }
+
+        osg::ref_ptr<Threading::ForkJoin> job = new Threading::ForkJoin();
+        for (unsigned p = 0; p < numParts; ++p)
+        {
+            unsigned begin = (numGeometries * p) / numParts;
+            unsigned end = (numGeometries * (p + 1u)) / numParts;
+            job->add([&clipRange, begin, end]() { clipRange(begin, end); });
+        }
+        job->run(numThreads);
+    }
+
+    // Per-tile data shared by every style and feature rendered into one tile:
+    // the crop region in the map SRS, and the tile and crop region in the
+    // feature SRS, so features can be rejected before they are binned,
+    // buffered, transformed or cropped.
+    struct TileFilter : public osg::Referenced
+    {
+        TileFilter(const GeoExtent& imageExtent, const SpatialReference* featureSRS)
+        {
+            // construct an extent for cropping the geometry to our tile.
+            // extend just outside the actual extents so we don't get edge artifacts:
+            GeoExtent cropExtent = GeoExtent(imageExtent);
+            cropExtent.scale(1.1, 1.1);
+            double cropXMin, cropYMin, cropXMax, cropYMax;
+            cropExtent.getBounds(cropXMin, cropYMin, cropXMax, cropYMax);
+
+            // GEOS crop won't abide by weird extents, so if we're in geographic space
+            // we must clamp the scaled extent back to a legal range.
+            if (cropExtent.crossesAntimeridian())
+            {
+                osg::Vec3d centroid = imageExtent.getCentroid();
+                if (centroid.x() < 0.0) // tile is east of antimeridian
+                {
+                    cropXMin = -180.0;
+                    cropXMax = cropExtent.east();
+                }
+                else
+                {
+                    cropXMin = cropExtent.west();
+                    cropXMax = 180.0;
+                }
+            }
+
+            cropBounds.set(cropXMin, cropYMin, cropXMax, cropYMax);
+
+            cropPoly = new Polygon(4);
+            cropPoly->push_back(osg::Vec3d(cropXMin, cropYMin, 0));
+            cropPoly->push_back(osg::Vec3d(cropXMax, cropYMin, 0));
+            cropPoly->push_back(osg::Vec3d(cropXMax, cropYMax, 0));
+            cropPoly->push_back(osg::Vec3d(cropXMin, cropYMax, 0));
+
+            if (featureSRS)
+            {
+                featureExtent = imageExtent.transform(featureSRS);
+
+                // leave featureBounds invalid (accepting everything) when the
+                // crop region has no simple bounding box in the feature SRS.
+                GeoExtent featureCropExtent = GeoExtent(imageExtent.getSRS(), cropBounds).transform(featureSRS);
+                if (featureCropExtent.isValid() && !featureCropExtent.crossesAntimeridian())
+                {
+                    featureBounds = featureCropExtent.bounds();
+                }
+            }
+        }
+
+        //! Whether a geometry in the feature SRS, grown by pad feature units,
+        //! can touch the crop region
+        bool accepts(const Geometry* geometry, double pad) const
+        {
+            if (!featureBounds.isValid())
+                return true;
+
+            Bounds b = geometry->getBounds();
+            if (!b.isValid())
+                return false;
+
+            return
+                b.xMin() - pad <= featureBounds.xMax() && b.xMax() + pad >= featureBounds.xMin() &&
+                b.yMin() - pad <= featureBounds.yMax() && b.yMax() + pad >= featureBounds.yMin();
+        }
+
+        Bounds cropBounds;
+        osg::ref_ptr<Polygon> cropPoly;
+        GeoExtent featureExtent;
+        Bounds featureBounds;
+    };
+
     FeatureCursor* createCursor(FeatureSource* fs, FeatureFilterChain* chain, FilterContext& cx, const Query& query, ProgressCallback* progress)
     {
         FeatureCursor* cursor = fs->createFeatureCursor(query, progress);
@@ -171,6 +400,8 @@ FeatureImageLayer::Options::getConfig() const
     featureSource().set(conf, "features");
     styleSheet().set(conf, "styles");
     conf.set("gamma", gamma());
+    conf.set("accumulate_coverage", accumulateCoverage());
+    conf.set("render_threads", renderThreads());
 
     if (filters().empty() == false)
     {
@@ -187,10 +418,14 @@ void
 FeatureImageLayer::Options::fromConfig(const Config& conf)
 {
     gamma().init(1.3);
+    accumulateCoverage().init(false);
+    renderThreads().init(0u);
 
     featureSource().get(conf, "features");
     styleSheet().get(conf, "styles");
     conf.get("gamma", gamma());
+    conf.get("accumulate_coverage", accumulateCoverage());
+    conf.get("render_threads", renderThreads());
 
     const Config& filtersConf = conf.child("filters");
     for(ConfigSet::const_iterator i = filtersConf.children().begin(); i != filtersConf.children().end(); ++i)
@@ -249,6 +484,14 @@ FeatureImageLayer::addedToMap(const Map* map)
     }
 }
 
+void
+FeatureImageLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    ImageLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+    options().styleSheet().getLayerName(names);
+}
+
 void
 FeatureImageLayer::removedFromMap(const Map* map)
 {
@@ -295,6 +538,30 @@ FeatureImageLayer::setStyleSheet(StyleSheet* value)
     }
 }
 
+void
+FeatureImageLayer::setAccumulateCoverage(bool value)
+{
+    options().accumulateCoverage() = value;
+}
+
+bool
+FeatureImageLayer::getAccumulateCoverage() const
+{
+    return options().accumulateCoverage().get();
+}
+
+void
+FeatureImageLayer::setRenderThreads(unsigned value)
+{
+    options().renderThreads() = value;
+}
+
+unsigned
+FeatureImageLayer::getRenderThreads() const
+{
+    return options().renderThreads().get();
+}
+
 void
 FeatureImageLayer::updateSession()
 {
@@ -434,10 +701,20 @@ FeatureImageLayer::postProcess(osg::Image* image) const
     return true;
 }
 
+osg::Referenced*
+FeatureImageLayer::createBuildData(Session*          session,
+                                   const GeoExtent&  imageExtent,
+                                   const osg::Image* image) const
+{
+    const FeatureProfile* featureProfile = session->getFeatureSource()->getFeatureProfile();
+    return new TileFilter(imageExtent, featureProfile ? featureProfile->getSRS() : 0L);
+}
+
 bool
 FeatureImageLayer::renderFeaturesForStyle(Session*           session,
                                           const Style&       style,
                                           const FeatureList& features,
+                                          osg::Referenced*   buildData,
                                           const GeoExtent&   imageExtent,
                                           osg::Image*        image) const
 {
@@ -447,17 +724,94 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
     FilterContext context(session);
     context.setProfile(getFeatureSource()->getFeatureProfile());
 
+    const SpatialReference* featureSRS = context.profile()->getSRS();
+
+    // the tile filter is normally built once per tile by createBuildData:
+    osg::ref_ptr<TileFilter> tile = dynamic_cast<TileFilter*>(buildData);
+    if (!tile.valid())
+        tile = new TileFilter(imageExtent, featureSRS);
+
+    const bool accumulate = options().accumulateCoverage() == true;
+    const unsigned numThreads = resolveNumThreads(options().renderThreads().get());
+
     const LineSymbol*    masterLine = style.getSymbol<LineSymbol>();
     const PolygonSymbol* masterPoly = style.getSymbol<PolygonSymbol>();
     const CoverageSymbol* masterCov = style.getSymbol<CoverageSymbol>();
 
-    // sort into bins, making a copy for lines that require buffering.
+    // We are measuring the line width in the features native extent, so we need
+    // to use the transformed extent to get the proper "resolution" for the image
+    const GeoExtent& transformedExtent = tile->featureExtent;
+
+    double trans_xf = (double)image->s() / transformedExtent.width();
+    double trans_yf = (double)image->t() / transformedExtent.height();
+
+    // resolution of the image (pixel extents):
+    double xres = 1.0 / trans_xf;
+    double yres = 1.0 / trans_yf;
+
+    double lineWidth = 1.0;
+    Stroke::LineCapStyle lineCap = Stroke::LINECAP_SQUARE;
+    if (masterLine)
+    {
+        lineCap = masterLine->stroke()->lineCap().value();
+
+        if (masterLine->stroke()->width().isSet())
+        {
+            lineWidth = masterLine->stroke()->width().value();
+
+            double pixelWidth = transformedExtent.width() / (double)image->s();
+
+            // if the width units are specified, process them:
+            if (masterLine->stroke()->widthUnits().isSet() &&
+                masterLine->stroke()->widthUnits().get() != Units::PIXELS)
+            {
+                const Units& featureUnits = featureSRS->getUnits();
+                const Units& strokeUnits = masterLine->stroke()->widthUnits().value();
+
+                // if the units are different than those of the feature data, we need to
+                // do a units conversion.
+                if (featureUnits != strokeUnits)
+                {
+                    if (Units::canConvert(strokeUnits, featureUnits))
+                    {
+                        // linear to linear, no problem
+                        lineWidth = strokeUnits.convertTo(featureUnits, lineWidth);
+                    }
+                    else if (strokeUnits.isLinear() && featureUnits.isAngular())
+                    {
+                        // linear to angular? approximate degrees per meter at the
+                        // latitude of the tile's centroid.
+                        double lineWidthM = masterLine->stroke()->widthUnits()->convertTo(Units::METERS, lineWidth);
+                        double mPerDegAtEquatorInv = 360.0 / (featureSRS->getEllipsoid()->getRadiusEquator() * 2.0 * osg::PI);
+                        double lon, lat;
+                        imageExtent.getCentroid(lon, lat);
+                        lineWidth = lineWidthM * mPerDegAtEquatorInv * cos(osg::DegreesToRadians(lat));
+                    }
+                }
+
+                // enfore a minimum width of one pixel.
+                float minPixels = masterLine->stroke()->minPixels().getOrUse(1.0f);
+                lineWidth = osg::clampAbove(lineWidth, pixelWidth*minPixels);
+            }
+
+            else // pixels
+            {
+                lineWidth *= pixelWidth;
+            }
+        }
+    }
+
+    // a stroke reaches half its width, plus an anti-aliased pixel, past its line:
+    double pad = 0.5*lineWidth + osg::maximum(xres, yres);
+
+    // sort into bins, making a copy for lines that require buffering, and
+    // skipping features that cannot reach the tile.
     FeatureList polygons;
     FeatureList lines;
 
     for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f)
     {
-        if (f->get()->getGeometry())
+        if (f->get()->getGeometry() && tile->accepts(f->get()->getGeometry(), pad))
         {
             bool hasPoly = false;
             bool hasLine = false;
@@ -498,6 +852,9 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
         }
     }
 
+    if (polygons.empty() && lines.empty())
+        return true;
+
     // initialize:
     RenderFrame frame;
     frame.xmin = imageExtent.xMin();
@@ -507,18 +864,6 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
 
     if (lines.size() > 0)
     {
-        // We are buffering in the features native extent, so we need to use the
-        // transformed extent to get the proper "resolution" for the image
-        const SpatialReference* featureSRS = context.profile()->getSRS();
-        GeoExtent transformedExtent = imageExtent.transform(featureSRS);
-
-        double trans_xf = (double)image->s() / transformedExtent.width();
-        double trans_yf = (double)image->t() / transformedExtent.height();
-
-        // resolution of the image (pixel extents):
-        double xres = 1.0 / trans_xf;
-        double yres = 1.0 / trans_yf;
-
         // downsample the line data so that it is no higher resolution than to image to which
         // we intend to rasterize it. If you don't do this, you run the risk of the buffer
         // operation taking forever on very high-res input data.
@@ -529,62 +874,14 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
             context = resample.push(lines, context);
         }
 
-        // now run the buffer operation on all lines:
-        BufferFilter buffer;
-        double lineWidth = 1.0;
-        if (masterLine)
+        // unless they are stroked in pixel space, run the buffer operation on all lines:
+        if (!accumulate)
         {
-            buffer.capStyle() = masterLine->stroke()->lineCap().value();
-
-            if (masterLine->stroke()->width().isSet())
-            {
-                lineWidth = masterLine->stroke()->width().value();
-
-                GeoExtent imageExtentInFeatureSRS = imageExtent.transform(featureSRS);
-                double pixelWidth = imageExtentInFeatureSRS.width() / (double)image->s();
-
-                // if the width units are specified, process them:
-                if (masterLine->stroke()->widthUnits().isSet() &&
-                    masterLine->stroke()->widthUnits().get() != Units::PIXELS)
-                {
-                    const Units& featureUnits = featureSRS->getUnits();
-                    const Units& strokeUnits = masterLine->stroke()->widthUnits().value();
-
-                    // if the units are different than those of the feature data, we need to
-                    // do a units conversion.
-                    if (featureUnits != strokeUnits)
-                    {
-                        if (Units::canConvert(strokeUnits, featureUnits))
-                        {
-                            // linear to linear, no problem
-                            lineWidth = strokeUnits.convertTo(featureUnits, lineWidth);
-                        }
-                        else if (strokeUnits.isLinear() && featureUnits.isAngular())
-                        {
-                            // linear to angular? approximate degrees per meter at the
-                            // latitude of the tile's centroid.
-                            double lineWidthM = masterLine->stroke()->widthUnits()->convertTo(Units::METERS, lineWidth);
-                            double mPerDegAtEquatorInv = 360.0 / (featureSRS->getEllipsoid()->getRadiusEquator() * 2.0 * osg::PI);
-                            double lon, lat;
-                            imageExtent.getCentroid(lon, lat);
-                            lineWidth = lineWidthM * mPerDegAtEquatorInv * cos(osg::DegreesToRadians(lat));
-                        }
-                    }
-
-                    // enfore a minimum width of one pixel.
-                    float minPixels = masterLine->stroke()->minPixels().getOrUse(1.0f);
-                    lineWidth = osg::clampAbove(lineWidth, pixelWidth*minPixels);
-                }
-
-                else // pixels
-                {
-                    lineWidth *= pixelWidth;
-                }
-            }
+            BufferFilter buffer;
+            buffer.capStyle() = lineCap;
+            buffer.distance() = lineWidth * 0.5;   // since the distance is for one side
+            bufferLines(lines, buffer, context, numThreads);
         }
-
-        buffer.distance() = lineWidth * 0.5;   // since the distance is for one side
-        buffer.push(lines, context);
     }
 
     // Transform the features into the map's SRS:
@@ -593,6 +890,37 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
     FilterContext polysContext = xform.push(polygons, context);
     FilterContext linesContext = xform.push(lines, context);
 
+    // Lines stroked after cropping need a crop region that reaches half a
+    // stroke past the tile, or wide strokes would stop short of the edge:
+    double lineWidthPixels = lineWidth * trans_xf;
+    Bounds lineCropBounds(tile->cropBounds);
+    osg::ref_ptr<Polygon> lineCropPoly = tile->cropPoly.get();
+    if (accumulate && lines.size() > 0)
+    {
+        double padX = (0.5*lineWidthPixels + 1.0) / frame.xf;
+        double padY = (0.5*lineWidthPixels + 1.0) / frame.yf;
+        lineCropBounds.expandBy(imageExtent.xMin() - padX, imageExtent.yMin() - padY);
+        lineCropBounds.expandBy(imageExtent.xMax() + padX, imageExtent.yMax() + padY);
+
+        if (imageExtent.getSRS()->isGeographic())
+        {
+            lineCropBounds.xMin() = osg::maximum(lineCropBounds.xMin(), -180.0);
+            lineCropBounds.xMax() = osg::minimum(lineCropBounds.xMax(), 180.0);
+        }
+
+        lineCropPoly = new Polygon(4);
+        lineCropPoly->push_back(osg::Vec3d(lineCropBounds.xMin(), lineCropBounds.yMin(), 0));
+        lineCropPoly->push_back(osg::Vec3d(lineCropBounds.xMax(), lineCropBounds.yMin(), 0));
+        lineCropPoly->push_back(osg::Vec3d(lineCropBounds.xMax(), lineCropBounds.yMax(), 0));
+        lineCropPoly->push_back(osg::Vec3d(lineCropBounds.xMin(), lineCropBounds.yMax(), 0));
+    }
+
+    // crop everything to the tile up front, in parallel; rasterizing below
+    // stays serial and in order, so the image does not depend on threading.
+    std::vector<osg::ref_ptr<const Geometry> > polygonParts, lineParts;
+    clipFeatures(polygons, tile->cropBounds, tile->cropPoly.get(), polygonParts, numThreads);
+    clipFeatures(lines, lineCropBounds, lineCropPoly.get(), lineParts, numThreads);
+
     // set up the AGG renderer:
     agg::rendering_buffer rbuf(image->data(), image->s(), image->t(), image->s() * 4);
 
@@ -607,36 +935,18 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
 
     ras.filling_rule(agg::fill_even_odd);
 
-    // construct an extent for cropping the geometry to our tile.
-    // extend just outside the actual extents so we don't get edge artifacts:
-    GeoExtent cropExtent = GeoExtent(imageExtent);
-    cropExtent.scale(1.1, 1.1);
-    double cropXMin, cropYMin, cropXMax, cropYMax;
-    cropExtent.getBounds(cropXMin, cropYMin, cropXMax, cropYMax);
-
-    // GEOS crop won't abide by weird extents, so if we're in geographic space
-    // we must clamp the scaled extent back to a legal range.
-    if (cropExtent.crossesAntimeridian())
+    // or, accumulate the coverage of each run of same-colored features,
+    // and blend it into the image once per run.
+    CoverageRasterizer* coverage = 0L;
+    ColorRuns* runs = 0L;
+    if (accumulate)
     {
-        osg::Vec3d centroid = imageExtent.getCentroid();
-        if (centroid.x() < 0.0) // tile is east of antimeridian
-        {
-            cropXMin = -180.0;
-            cropXMax = cropExtent.east();
-        }
-        else
-        {
-            cropXMin = cropExtent.west();
-            cropXMax = 180.0;
-        }
+        coverage = new CoverageRasterizer(image->s(), image->t());
+        coverage->setFrame(frame.xmin, frame.ymin, frame.xf, frame.yf);
+        coverage->setGamma(options().coverage() == true ? 1.0 : options().gamma().get());
+        runs = new ColorRuns(*coverage, image);
     }
 
-    osg::ref_ptr<Polygon> cropPoly = new Polygon(4);
-    cropPoly->push_back(osg::Vec3d(cropXMin, cropYMin, 0));
-    cropPoly->push_back(osg::Vec3d(cropXMax, cropYMin, 0));
-    cropPoly->push_back(osg::Vec3d(cropXMax, cropYMax, 0));
-    cropPoly->push_back(osg::Vec3d(cropXMin, cropYMax, 0));
-
     // If there's a coverage symbol, make a copy of the expressions so we can evaluate them
     optional<NumericExpression> covValue;
     const CoverageSymbol* covsym = style.get<CoverageSymbol>();
@@ -644,13 +954,12 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
         covValue = covsym->valueExpression().get();
 
     // render the polygons
-    for (FeatureList::iterator i = polygons.begin(); i != polygons.end(); i++)
+    unsigned index = 0u;
+    for (FeatureList::iterator i = polygons.begin(); i != polygons.end(); ++i, ++index)
     {
         Feature*  feature = i->get();
-        Geometry* geometry = feature->getGeometry();
-
-        osg::ref_ptr<Geometry> croppedGeometry;
-        if (geometry->crop(cropPoly.get(), croppedGeometry))
+        const Geometry* geometry = polygonParts[index].get();
+        if (geometry)
         {
             const PolygonSymbol* poly =
                 feature->style().isSet() && feature->style()->has<PolygonSymbol>() ? feature->style()->get<PolygonSymbol>() :
@@ -659,25 +968,39 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
             if (options().coverage() == true && covValue.isSet())
             {
                 float value = (float)feature->eval(covValue.mutable_value(), &context);
-                rasterizeCoverage(croppedGeometry.get(), value, frame, ras, rbuf);
+                if (accumulate)
+                {
+                    coverage->addPolygon(geometry);
+                    coverage->fill((float*)image->data(), image->s(), value);
+                }
+                else
+                {
+                    rasterizeCoverage(geometry, value, frame, ras, rbuf);
+                }
             }
             else
             {
                 Color color = poly ? poly->fill()->color() : Color::White;
-                rasterize(croppedGeometry.get(), color, frame, ras, rbuf);
+                if (accumulate)
+                {
+                    runs->setColor(color);
+                    coverage->addPolygon(geometry);
+                }
+                else
+                {
+                    rasterize(geometry, color, frame, ras, rbuf);
+                }
             }
-
         }
     }
 
     // render the lines
-    for (FeatureList::iterator i = lines.begin(); i != lines.end(); i++)
+    index = 0u;
+    for (FeatureList::iterator i = lines.begin(); i != lines.end(); ++i, ++index)
     {
         Feature*  feature = i->get();
-        Geometry* geometry = feature->getGeometry();
-
-        osg::ref_ptr<Geometry> croppedGeometry;
-        if (geometry->crop(cropPoly.get(), croppedGeometry))
+        const Geometry* geometry = lineParts[index].get();
+        if (geometry)
         {
             const LineSymbol* line =
                 feature->style().isSet() && feature->style()->has<LineSymbol>() ? feature->style()->get<LineSymbol>() :
@@ -686,16 +1009,39 @@ FeatureImageLayer::renderFeaturesForStyle(Session*           session,
             if (options().coverage() == true && covValue.isSet())
             {
                 float value = (float)feature->eval(covValue.mutable_value(), &context);
-                rasterizeCoverage(croppedGeometry.get(), value, frame, ras, rbuf);
+                if (accumulate)
+                {
+                    coverage->addLine(geometry, lineWidthPixels, lineCap);
+                    coverage->fill((float*)image->data(), image->s(), value);
+                }
+                else
+                {
+                    rasterizeCoverage(geometry, value, frame, ras, rbuf);
+                }
             }
             else
             {
                 osg::Vec4f color = line ? static_cast<osg::Vec4>(line->stroke()->color()) : osg::Vec4(1, 1, 1, 1);
-                rasterize(croppedGeometry.get(), color, frame, ras, rbuf);
+                if (accumulate)
+                {
+                    runs->setColor(color);
+                    coverage->addLine(geometry, lineWidthPixels, lineCap);
+                }
+                else
+                {
+                    rasterize(geometry, color, frame, ras, rbuf);
+                }
             }
         }
     }
 
+    if (accumulate)
+    {
+        runs->flush();
+        delete runs;
+        delete coverage;
+    }
+
     return true;
 }
 
@@ -715,6 +1061,9 @@ FeatureImageRenderer::render(const TileKey& key,
     if (!features)
         return false;
 
+    // build the per-tile data once, for every style and feature below:
+    osg::ref_ptr<osg::Referenced> buildData = createBuildData(session, key.getExtent(), target);
+
     // figure out if and how to style the geometry.
     if (features->hasEmbeddedStyles() )
     {
@@ -733,6 +1082,7 @@ FeatureImageRenderer::render(const TileKey& key,
                     session,
                     *feature->style(),
                     list,
+                    buildData.get(),
                     key.getExtent(),
                     target );
             }
@@ -799,6 +1149,7 @@ FeatureImageRenderer::render(const TileKey& key,
                                         session,
                                         combinedStyle,
                                         list,
+                                        buildData.get(),
                                         key.getExtent(),
                                         target);
                                 }
@@ -811,19 +1162,19 @@ FeatureImageRenderer::render(const TileKey& key,
                     const Style* style = styles->getStyle( sel.getSelectedStyleName() );
                     Query query = sel.query().get();
                     query.tileKey() = key;
-                    queryAndRenderFeaturesForStyle(session, *style, query, key.getExtent(), target, progress);
+                    queryAndRenderFeaturesForStyle(session, *style, query, buildData.get(), key.getExtent(), target, progress);
                 }
             }
         }
         else
         {
             const Style* style = styles->getDefaultStyle();
-            queryAndRenderFeaturesForStyle(session, *style, defaultQuery, key.getExtent(), target, progress);
+            queryAndRenderFeaturesForStyle(session, *style, defaultQuery, buildData.get(), key.getExtent(), target, progress);
         }
     }
     else
     {
-        queryAndRenderFeaturesForStyle(session, Style(), defaultQuery, key.getExtent(), target, progress);
+        queryAndRenderFeaturesForStyle(session, Style(), defaultQuery, buildData.get(), key.getExtent(), target, progress);
     }
 
     return true;
@@ -834,6 +1185,7 @@ bool
 FeatureImageRenderer::queryAndRenderFeaturesForStyle(Session*          session,
                                                      const Style&      style,
                                                      const Query&      query,
+                                                     osg::Referenced*  buildData,
                                                      const GeoExtent&  imageExtent,
                                                      osg::Image*       out_image,
                                                      ProgressCallback* progress) const
@@ -848,7 +1200,7 @@ FeatureImageRenderer::queryAndRenderFeaturesForStyle(Session*          session,
     if (!features.empty())
     {
         // Render them.
-        return renderFeaturesForStyle(session, style, features, imageExtent, out_image );
+        return renderFeaturesForStyle(session, style, features, buildData, imageExtent, out_image );
     }
     return false;
 }
@@ -119,6 +119,13 @@ FeatureMaskLayer::addedToMap(const Map* map)
     create();
 }
 
+void
+FeatureMaskLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    MaskLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+}
+
 void
 FeatureMaskLayer::removedFromMap(const Map* map)
 {
@@ -254,6 +254,14 @@ FeatureModelLayer::addedToMap(const Map* map)
     }
 }
 
+void
+FeatureModelLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    VisibleLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+    options().styleSheet().getLayerName(names);
+}
+
 void
 FeatureModelLayer::removedFromMap(const Map* map)
 {
@@ -56,6 +56,8 @@ _options           ( options ),
 _needsRebuild      ( true ),
 _styleSheet        ( styleSheet ),
 _clampDirty        (false),
+_incrementalClamping(::getenv("OSGEARTH_INCREMENTAL_CLAMPING") != 0L),
+_clampUpdateCount  ( 0u ),
 _index             ( 0 )
 {
     _features.push_back( feature );
@@ -78,6 +80,8 @@ _options        ( options ),
 _needsRebuild   ( true ),
 _styleSheet     ( styleSheet ),
 _clampDirty     ( false ),
+_incrementalClamping(::getenv("OSGEARTH_INCREMENTAL_CLAMPING") != 0L),
+_clampUpdateCount( 0u ),
 _index          ( 0 )
 {
     _features.insert( _features.end(), features.begin(), features.end() );
@@ -304,12 +308,34 @@ void FeatureNode::dirty()
     build();
 }
 
+void
+FeatureNode::setIncrementalClamping(bool value)
+{
+    if (_incrementalClamping != value)
+    {
+        _incrementalClamping = value;
+        build();
+    }
+}
+
 // This will be called by AnnotationNode when a new terrain tile comes in.
 void
 FeatureNode::onTileUpdate(const TileKey&          key,
                          osg::Node*              graph,
                          TerrainCallbackContext& context)
 {
+    if (_incrementalClamping && !_clamperData.empty())
+    {
+        // mark just the vertices under the new tile; update() does the rest.
+        GeometryClamper clamper(_clamperData);
+        if (setupClamper(clamper, context.getTerrain()) && clamper.dirty(key) > 0u && !_clampDirty)
+        {
+            _clampDirty = true;
+            ADJUST_UPDATE_TRAV_COUNT(this, +1);
+        }
+        return;
+    }
+
     if (!_clampDirty)
     {
         bool needsClamp;
@@ -336,23 +362,42 @@ FeatureNode::onTileUpdate(const TileKey&          key,
     }
 }
 
+bool
+FeatureNode::setupClamper(GeometryClamper& clamper, const Terrain* terrain)
+{
+    if (!terrain)
+        return false;
+
+    const AltitudeSymbol* alt = getStyle().get<AltitudeSymbol>();
+    if (alt && alt->technique() != alt->TECHNIQUE_SCENE)
+        return false;
+
+    bool relative = alt && alt->clamping() == alt->CLAMP_RELATIVE_TO_TERRAIN && alt->technique() == alt->TECHNIQUE_SCENE;
+    float offset = alt ? alt->verticalOffset()->eval() : 0.0f;
+
+    clamper.setTerrainSRS( terrain->getSRS() );
+    clamper.setUseVertexZ( relative );
+    clamper.setOffset( offset );
+
+    if (_incrementalClamping && getMapNode())
+    {
+        clamper.setMap( getMapNode()->getMap() );
+        clamper.setWorkingSet( &_clamperWorkingSet );
+    }
+
+    return true;
+}
+
 void
 FeatureNode::clamp(osg::Node* graph, const Terrain* terrain)
 {
     if ( terrain && graph )
     {
-        const AltitudeSymbol* alt = getStyle().get<AltitudeSymbol>();
-        if (alt && alt->technique() != alt->TECHNIQUE_SCENE)
+        GeometryClamper clamper(_clamperData);
+        if (!setupClamper(clamper, terrain))
             return;
 
-        bool relative = alt && alt->clamping() == alt->CLAMP_RELATIVE_TO_TERRAIN && alt->technique() == alt->TECHNIQUE_SCENE;
-        float offset = alt ? alt->verticalOffset()->eval() : 0.0f;
-
-        GeometryClamper clamper(_clamperData);
         clamper.setTerrainPatch( graph );
-        clamper.setTerrainSRS( terrain->getSRS() );
-        clamper.setUseVertexZ( relative );
-        clamper.setOffset( offset );
 
         this->accept( clamper );
     }
@@ -366,11 +411,28 @@ FeatureNode::traverse(osg::NodeVisitor& nv)
         if (getMapNode())
         {
             osg::ref_ptr<Terrain> terrain = getMapNode()->getTerrain();
-            if (terrain.valid())
-                clamp(terrain->getGraph(), terrain.get());
 
-            ADJUST_UPDATE_TRAV_COUNT(this, -1);
-            _clampDirty = false;
+            if (_incrementalClamping && !_clamperData.empty())
+            {
+                // re-clamp marked vertices within the frame budget
+                GeometryClamper clamper(_clamperData);
+                // without a frame stamp, count update traversals instead so
+                // that each one gets a fresh share of the budget.
+                unsigned frame = nv.getFrameStamp() ? nv.getFrameStamp()->getFrameNumber() : _clampUpdateCount++;
+                if (!setupClamper(clamper, terrain.get()) || clamper.update(frame))
+                {
+                    ADJUST_UPDATE_TRAV_COUNT(this, -1);
+                    _clampDirty = false;
+                }
+            }
+            else
+            {
+                if (terrain.valid())
+                    clamp(terrain->getGraph(), terrain.get());
+
+                ADJUST_UPDATE_TRAV_COUNT(this, -1);
+                _clampDirty = false;
+            }
         }
     }
     AnnotationNode::traverse(nv);
@@ -386,6 +448,8 @@ FeatureNode::FeatureNode(const Config&         conf,
                          const osgDB::Options* readOptions ) :
 AnnotationNode(conf, readOptions),
 _clampDirty(false),
+_incrementalClamping(::getenv("OSGEARTH_INCREMENTAL_CLAMPING") != 0L),
+_clampUpdateCount(0u),
 _index(0)
 {
     osg::ref_ptr<Geometry> geom;
@@ -27,6 +27,7 @@ FilterContext::FilterContext() :
 _session(0L),
 _profile(0L),
 _isGeocentric(false),
+_expressionCache(new ExpressionCache()),
 _index(0L),
 _shaderPolicy(osgEarth::SHADERPOLICY_GENERATE)
 {
@@ -41,6 +42,7 @@ _session     ( session ),
 _profile     ( profile ),
 _extent      ( workingExtent, workingExtent ),
 _isGeocentric( false ),
+_expressionCache( new ExpressionCache() ),
 _index       ( index ),
 _shaderPolicy( osgEarth::SHADERPOLICY_GENERATE )
 {
@@ -87,6 +89,7 @@ _extent               ( rhs._extent ),
 _referenceFrame       ( rhs._referenceFrame ),
 _inverseReferenceFrame( rhs._inverseReferenceFrame ),
 _resourceCache        ( rhs._resourceCache.get() ),
+_expressionCache      ( rhs._expressionCache.get() ),
 _index                ( rhs._index ),
 _shaderPolicy         ( rhs._shaderPolicy ),
 _history              ( rhs._history ),
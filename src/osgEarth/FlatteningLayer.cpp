@@ -803,6 +803,13 @@ FlatteningLayer::addedToMap(const Map* map)
     }
 }
 
+void
+FlatteningLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    ElevationLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+}
+
 void
 FlatteningLayer::removedFromMap(const Map* map)
 {
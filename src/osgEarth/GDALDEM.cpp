@@ -110,6 +110,13 @@ GDALDEMLayer::addedToMap(const Map* map)
     setDataExtents(layer->getDataExtents());
 }
 
+void
+GDALDEMLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    ImageLayer::getLayerReferences(names);
+    options().elevationLayer().getLayerName(names);
+}
+
 void
 GDALDEMLayer::removedFromMap(const Map* map)
 {
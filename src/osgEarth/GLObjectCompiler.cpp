@@ -0,0 +1,293 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/GLObjectCompiler>
+#include <osgEarth/Metrics>
+#include <osgEarth/StringUtils>
+#include <osg/NodeVisitor>
+#include <osg/Texture>
+#include <osg/Timer>
+#include <algorithm>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[GLObjectCompiler] "
+
+namespace
+{
+    struct AttributeItem : public GLObjectCompiler::Item
+    {
+        AttributeItem(osg::StateAttribute* attribute) : _attribute(attribute) { }
+
+        void compile(osg::State* state)
+        {
+            if (state)
+                _attribute->compileGLObjects(*state);
+        }
+
+        osg::ref_ptr<osg::StateAttribute> _attribute;
+    };
+
+    struct DrawableItem : public GLObjectCompiler::Item
+    {
+        DrawableItem(osg::Drawable* drawable) : _drawable(drawable) { }
+
+        void compile(osg::State* state)
+        {
+            if (state)
+            {
+                osg::RenderInfo ri(state, 0L);
+                _drawable->compileGLObjects(ri);
+            }
+        }
+
+        osg::ref_ptr<osg::Drawable> _drawable;
+    };
+
+    // Collects the compilable objects in a subgraph into a job.
+    struct CollectObjects : public osg::NodeVisitor
+    {
+        CollectObjects(GLObjectCompiler::Job& job) :
+            osg::NodeVisitor(TRAVERSE_ALL_CHILDREN),
+            _job(job) { }
+
+        void apply(osg::Node& node)
+        {
+            if (node.getStateSet())
+                _job.add(node.getStateSet());
+            traverse(node);
+        }
+
+        void apply(osg::Drawable& drawable)
+        {
+            if (drawable.getStateSet())
+                _job.add(drawable.getStateSet());
+            _job.add(&drawable);
+        }
+
+        GLObjectCompiler::Job& _job;
+    };
+
+    struct SortByPriority
+    {
+        bool operator()(const osg::ref_ptr<GLObjectCompiler::Job>& lhs,
+                        const osg::ref_ptr<GLObjectCompiler::Job>& rhs) const
+        {
+            return lhs->getPriority() > rhs->getPriority();
+        }
+    };
+}
+
+//........................................................................
+
+GLObjectCompiler::Job::Job(float priority) :
+    _next(0u),
+    _priority(priority)
+{
+    //nop
+}
+
+bool
+GLObjectCompiler::Job::wait(const Threading::Cancelable* cancelable, unsigned timeout_ms) const
+{
+    // wake up now and then to check for cancelation
+    for (unsigned t = 0u; t < timeout_ms; t += 10u)
+    {
+        if (_complete.wait(10u))
+            return true;
+        if (cancelable && cancelable->isCanceled())
+            break;
+    }
+    return isComplete();
+}
+
+void
+GLObjectCompiler::Job::add(Item* item)
+{
+    if (item)
+        _items.push_back(item);
+}
+
+void
+GLObjectCompiler::Job::add(osg::StateAttribute* attribute)
+{
+    if (attribute)
+        _items.push_back(new AttributeItem(attribute));
+}
+
+void
+GLObjectCompiler::Job::add(osg::Drawable* drawable)
+{
+    if (drawable)
+        _items.push_back(new DrawableItem(drawable));
+}
+
+void
+GLObjectCompiler::Job::add(osg::StateSet* stateSet)
+{
+    if (!stateSet)
+        return;
+
+    const osg::StateSet::AttributeList& attrs = stateSet->getAttributeList();
+    for (osg::StateSet::AttributeList::const_iterator i = attrs.begin(); i != attrs.end(); ++i)
+    {
+        if (i->first.first == osg::StateAttribute::PROGRAM)
+            add(i->second.first.get());
+    }
+
+    const osg::StateSet::TextureAttributeList& texAttrs = stateSet->getTextureAttributeList();
+    for (unsigned unit = 0; unit < texAttrs.size(); ++unit)
+    {
+        for (osg::StateSet::AttributeList::const_iterator i = texAttrs[unit].begin(); i != texAttrs[unit].end(); ++i)
+        {
+            if (i->second.first->asTexture())
+                add(i->second.first.get());
+        }
+    }
+}
+
+void
+GLObjectCompiler::Job::add(osg::Node* node)
+{
+    if (node)
+    {
+        CollectObjects visitor(*this);
+        node->accept(visitor);
+    }
+}
+
+//........................................................................
+
+GLObjectCompiler::GLObjectCompiler() :
+    _budget_ms(2.0),
+    _drawing(false)
+{
+    // ensure this node always gets traversed:
+    this->setCullingActive(false);
+
+    // ensure the draw runs synchronously:
+    this->setDataVariance(DYNAMIC);
+
+    // force the draw to run every frame:
+    this->setUseDisplayList(false);
+}
+
+void
+GLObjectCompiler::submit(Job* job)
+{
+    if (!job)
+        return;
+
+    if (job->getNumPending() == 0u)
+    {
+        job->_complete.set();
+        return;
+    }
+
+    Threading::ScopedMutexLock lock(_mutex);
+    _jobs.push_back(job);
+}
+
+unsigned
+GLObjectCompiler::getNumPendingJobs() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _jobs.size();
+}
+
+unsigned
+GLObjectCompiler::compile(osg::State* state, double budget_ms)
+{
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        if (_jobs.empty())
+            return 0u;
+
+        // Discard jobs whose owners have gone away; nobody is waiting on them.
+        unsigned kept = 0;
+        for (unsigned i = 0; i < _jobs.size(); ++i)
+        {
+            if (_jobs[i]->referenceCount() > 1)
+            {
+                if (kept != i)
+                    _jobs[kept] = _jobs[i];
+                ++kept;
+            }
+        }
+        _jobs.resize(kept);
+
+        std::stable_sort(_jobs.begin(), _jobs.end(), SortByPriority());
+    }
+
+    OE_PROFILING_ZONE;
+
+    const double start = now_ms();
+    unsigned count = 0u;
+
+    while (true)
+    {
+        osg::ref_ptr<Job> job;
+        osg::ref_ptr<Item> item;
+        bool lastItem = false;
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+
+            if (_jobs.empty())
+                break;
+
+            job = _jobs.front();
+            item = job->_items[job->_next++];
+            lastItem = (job->_next == job->_items.size());
+            if (lastItem)
+                _jobs.erase(_jobs.begin());
+        }
+
+        item->compile(state);
+        ++count;
+
+        if (lastItem)
+        {
+            // release the objects; the owner holds them from here on.
+            job->_items.clear();
+            job->_next = 0u;
+            job->_complete.set();
+        }
+
+        if (budget_ms > 0.0 && now_ms() - start >= budget_ms)
+            break;
+    }
+
+    OE_PROFILING_ZONE_TEXT(Stringify() << "Compiled " << count);
+    return count;
+}
+
+void
+GLObjectCompiler::drawImplementation(osg::RenderInfo& ri) const
+{
+    GLObjectCompiler* self = const_cast<GLObjectCompiler*>(this);
+    self->_drawing = true;
+    self->compile(ri.getState(), _budget_ms);
+}
+
+double
+GLObjectCompiler::now_ms() const
+{
+    return osg::Timer::instance()->time_m();
+}
@@ -0,0 +1,1034 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/GeoJSON>
+#include <osgEarth/StringUtils>
+#include <rapidjson/reader.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/error/en.h>
+#include <osg/Math>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[GeoJSON] "
+
+namespace
+{
+    // One open GeoJSON object. Whether it is a FeatureCollection, a
+    // Feature or a geometry is only known once the object closes, since
+    // "type" may come after the other members.
+    struct Object
+    {
+        enum Role
+        {
+            ROLE_ROOT,          // top-level object
+            ROLE_FEATURE,       // element of a "features" array
+            ROLE_GEOMETRY,      // "geometry" member of a Feature
+            ROLE_COMPONENT      // element of a "geometries" array
+        };
+
+        Role role;
+        std::string type;
+
+        // "coordinates", flattened: all positions, then the end (as a
+        // point index) of each position list, then the end (as a line
+        // index) of each list of position lists.
+        std::vector<osg::Vec3d> points;
+        std::vector<unsigned> lineEnds;
+        std::vector<unsigned> polygonEnds;
+
+        GeometryCollection components;      // "geometries"
+        osg::ref_ptr<Geometry> geometry;    // "geometry"
+        osg::ref_ptr<Feature> feature;      // created on "id" or "properties"
+        bool hasId;
+        FeatureID id;
+
+        void reset(Role value)
+        {
+            role = value;
+            type.clear();
+            points.clear();
+            lineEnds.clear();
+            polygonEnds.clear();
+            components.clear();
+            geometry = 0L;
+            feature = 0L;
+            hasId = false;
+            id = 0LL;
+        }
+    };
+
+    // Appends points [begin, end) to a geometry, dropping consecutive
+    // duplicates the way OgrUtils::populate does.
+    void populate(const std::vector<osg::Vec3d>& points, unsigned begin, unsigned end, Geometry* target)
+    {
+        target->reserve(target->size() + (end - begin));
+        for (unsigned i = begin; i < end; ++i)
+        {
+            if (target->empty() || points[i] != target->back())
+                target->push_back(points[i]);
+        }
+    }
+
+    class FeatureReader : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, FeatureReader>
+    {
+    public:
+        FeatureReader(const SpatialReference* srs, bool rewindPolygons, FeatureList& output) :
+            _srs(srs),
+            _rewindPolygons(rewindPolygons),
+            _output(output),
+            _numObjects(0u),
+            _member(MEMBER_OTHER),
+            _skipDepth(0u),
+            _rawDepth(0u),
+            _rawWriter(_rawBuffer),
+            _featureIndex(0LL)
+        {
+            //nop
+        }
+
+        template<typename STREAM>
+        bool parse(STREAM& stream, std::string& error)
+        {
+            rapidjson::Reader reader;
+            rapidjson::ParseResult ok = reader.Parse<rapidjson::kParseFullPrecisionFlag>(stream, *this);
+            if (!ok)
+            {
+                error = Stringify()
+                    << rapidjson::GetParseError_En(ok.Code())
+                    << " (at offset " << ok.Offset() << ")";
+                return false;
+            }
+            return true;
+        }
+
+        bool Null()
+        {
+            if (_skipDepth > 0u) return true;
+            if (_rawDepth > 0u) return _rawWriter.Null();
+
+            if (top() == FRAME_PROPERTIES)
+                current().feature->setNull(_property, ATTRTYPE_STRING);
+            return true;
+        }
+
+        bool Bool(bool value)
+        {
+            if (_skipDepth > 0u) return true;
+            if (_rawDepth > 0u) return _rawWriter.Bool(value);
+
+            if (top() == FRAME_PROPERTIES)
+                current().feature->set(_property, value);
+            return true;
+        }
+
+        bool Int(int value) { return Int64(value); }
+        bool Uint(unsigned value) { return Int64(value); }
+
+        bool Int64(int64_t value)
+        {
+            if (_skipDepth > 0u) return true;
+            if (_rawDepth > 0u) return _rawWriter.Int64(value);
+
+            switch (top())
+            {
+            case FRAME_COORDINATES:
+                return number((double)value);
+            case FRAME_PROPERTIES:
+                current().feature->set(_property, (long long)value);
+                return true;
+            case FRAME_OBJECT:
+                if (_member == MEMBER_ID)
+                    setId((FeatureID)value);
+                return true;
+            default:
+                return true;
+            }
+        }
+
+        bool Uint64(uint64_t value)
+        {
+            if (value <= (uint64_t)std::numeric_limits<int64_t>::max())
+                return Int64((int64_t)value);
+            return Double((double)value);
+        }
+
+        bool Double(double value)
+        {
+            if (_skipDepth > 0u) return true;
+            if (_rawDepth > 0u) return _rawWriter.Double(value);
+
+            switch (top())
+            {
+            case FRAME_COORDINATES:
+                return number(value);
+            case FRAME_PROPERTIES:
+                current().feature->set(_property, value);
+                return true;
+            case FRAME_OBJECT:
+                if (_member == MEMBER_ID && value == floor(value))
+                    setId((FeatureID)value);
+                return true;
+            default:
+                return true;
+            }
+        }
+
+        bool String(const char* str, rapidjson::SizeType length, bool)
+        {
+            if (_skipDepth > 0u) return true;
+            if (_rawDepth > 0u) return _rawWriter.String(str, length);
+
+            if (top() == FRAME_PROPERTIES)
+            {
+                current().feature->set(_property, std::string(str, length));
+            }
+            else if (top() == FRAME_OBJECT)
+            {
+                if (_member == MEMBER_TYPE)
+                {
+                    current().type.assign(str, length);
+                }
+                else if (_member == MEMBER_ID)
+                {
+                    // Like OGR, a string id is an attribute, not the FID.
+                    getFeature().set("id", std::string(str, length));
+                }
+            }
+            return true;
+        }
+
+        bool Key(const char* str, rapidjson::SizeType length, bool)
+        {
+            if (_skipDepth > 0u) return true;
+            if (_rawDepth > 0u) return _rawWriter.Key(str, length);
+
+            if (top() == FRAME_PROPERTIES)
+            {
+                _property = toLower(std::string(str, length));
+            }
+            else if (top() == FRAME_OBJECT)
+            {
+                std::string key(str, length);
+                _member =
+                    key == "type"        ? MEMBER_TYPE :
+                    key == "coordinates" ? MEMBER_COORDINATES :
+                    key == "geometries"  ? MEMBER_GEOMETRIES :
+                    key == "geometry"    ? MEMBER_GEOMETRY :
+                    key == "properties"  ? MEMBER_PROPERTIES :
+                    key == "features"    ? MEMBER_FEATURES :
+                    key == "id"          ? MEMBER_ID :
+                    MEMBER_OTHER;
+            }
+            return true;
+        }
+
+        bool StartObject()
+        {
+            if (_skipDepth > 0u) { ++_skipDepth; return true; }
+            if (_rawDepth > 0u) { ++_rawDepth; return _rawWriter.StartObject(); }
+
+            if (_frames.empty())
+            {
+                pushObject(Object::ROLE_ROOT);
+                return true;
+            }
+
+            switch (top())
+            {
+            case FRAME_OBJECT:
+                if (_member == MEMBER_GEOMETRY)
+                {
+                    pushObject(Object::ROLE_GEOMETRY);
+                }
+                else if (_member == MEMBER_PROPERTIES)
+                {
+                    getFeature();
+                    _frames.push_back(FRAME_PROPERTIES);
+                }
+                else
+                {
+                    _skipDepth = 1u;
+                }
+                return true;
+
+            case FRAME_FEATURES:
+                pushObject(Object::ROLE_FEATURE);
+                return true;
+
+            case FRAME_GEOMETRIES:
+                pushObject(Object::ROLE_COMPONENT);
+                return true;
+
+            case FRAME_PROPERTIES:
+                startRaw();
+                return _rawWriter.StartObject();
+
+            default:
+                _skipDepth = 1u;
+                return true;
+            }
+        }
+
+        bool EndObject(rapidjson::SizeType)
+        {
+            if (_skipDepth > 0u) { --_skipDepth; return true; }
+            if (_rawDepth > 0u) return endRaw(_rawWriter.EndObject());
+
+            if (top() == FRAME_PROPERTIES)
+            {
+                _frames.pop_back();
+                _member = MEMBER_OTHER;
+                return true;
+            }
+
+            _frames.pop_back();
+            Object& obj = current();
+            --_numObjects;
+            _member = MEMBER_OTHER;
+
+            switch (obj.role)
+            {
+            case Object::ROLE_ROOT:
+            case Object::ROLE_FEATURE:
+                if (obj.type == "Feature")
+                {
+                    emit(obj, obj.geometry.release());
+                }
+                else if (obj.type != "FeatureCollection")
+                {
+                    // a bare geometry becomes a feature of its own
+                    Geometry* geom = createGeometry(obj);
+                    if (geom)
+                        emit(obj, geom);
+                }
+                break;
+
+            case Object::ROLE_GEOMETRY:
+                current().geometry = createGeometry(obj);
+                break;
+
+            case Object::ROLE_COMPONENT:
+            {
+                Geometry* geom = createGeometry(obj);
+                if (geom)
+                    current().components.push_back(geom);
+                break;
+            }
+            }
+            return true;
+        }
+
+        bool StartArray()
+        {
+            if (_skipDepth > 0u) { ++_skipDepth; return true; }
+            if (_rawDepth > 0u) { ++_rawDepth; return _rawWriter.StartArray(); }
+
+            switch (top())
+            {
+            case FRAME_OBJECT:
+                if (_member == MEMBER_COORDINATES)
+                    pushCoordinates();
+                else if (_member == MEMBER_FEATURES)
+                    _frames.push_back(FRAME_FEATURES);
+                else if (_member == MEMBER_GEOMETRIES)
+                    _frames.push_back(FRAME_GEOMETRIES);
+                else
+                    _skipDepth = 1u;
+                return true;
+
+            case FRAME_COORDINATES:
+                pushCoordinates();
+                return true;
+
+            case FRAME_PROPERTIES:
+                startRaw();
+                return _rawWriter.StartArray();
+
+            default:
+                _skipDepth = 1u;
+                return true;
+            }
+        }
+
+        bool EndArray(rapidjson::SizeType)
+        {
+            if (_skipDepth > 0u) { --_skipDepth; return true; }
+            if (_rawDepth > 0u) return endRaw(_rawWriter.EndArray());
+
+            if (top() == FRAME_COORDINATES)
+                popCoordinates();
+            else
+                _frames.pop_back();
+
+            return true;
+        }
+
+    private:
+        enum FrameType
+        {
+            FRAME_NONE,
+            FRAME_OBJECT,
+            FRAME_FEATURES,
+            FRAME_GEOMETRIES,
+            FRAME_PROPERTIES,
+            FRAME_COORDINATES
+        };
+
+        enum Member
+        {
+            MEMBER_TYPE,
+            MEMBER_COORDINATES,
+            MEMBER_GEOMETRIES,
+            MEMBER_GEOMETRY,
+            MEMBER_PROPERTIES,
+            MEMBER_FEATURES,
+            MEMBER_ID,
+            MEMBER_OTHER
+        };
+
+        // One open array inside "coordinates". Its height is 0 for a
+        // position, 1 for a list of positions, and so on.
+        struct CoordinateArray
+        {
+            unsigned numValues;
+            int childHeight;
+        };
+
+        const SpatialReference* _srs;
+        bool _rewindPolygons;
+        FeatureList& _output;
+
+        std::vector<FrameType> _frames;
+        std::vector<Object> _objects;   // reused across features to keep their capacity
+        unsigned _numObjects;
+        Member _member;
+        std::string _property;
+
+        std::vector<CoordinateArray> _coords;
+        osg::Vec3d _position;
+
+        unsigned _skipDepth;
+
+        unsigned _rawDepth;
+        rapidjson::StringBuffer _rawBuffer;
+        rapidjson::Writer<rapidjson::StringBuffer> _rawWriter;
+
+        FeatureID _featureIndex;
+
+        FrameType top() const
+        {
+            return _frames.empty() ? FRAME_NONE : _frames.back();
+        }
+
+        Object& current()
+        {
+            return _objects[_numObjects - 1];
+        }
+
+        void pushObject(Object::Role role)
+        {
+            if (_numObjects == _objects.size())
+                _objects.push_back(Object());
+            _objects[_numObjects++].reset(role);
+            _frames.push_back(FRAME_OBJECT);
+            _member = MEMBER_OTHER;
+        }
+
+        Feature& getFeature()
+        {
+            Object& obj = current();
+            if (!obj.feature.valid())
+                obj.feature = new Feature(0L, _srs);
+            return *obj.feature.get();
+        }
+
+        void setId(FeatureID id)
+        {
+            current().hasId = true;
+            current().id = id;
+        }
+
+        void emit(Object& obj, Geometry* geom)
+        {
+            Feature* feature = obj.feature.valid() ? obj.feature.release() : new Feature(0L, _srs);
+            feature->setGeometry(geom);
+            feature->setFID(obj.hasId ? obj.id : _featureIndex);
+            ++_featureIndex;
+            _output.push_back(feature);
+        }
+
+        void pushCoordinates()
+        {
+            if (_coords.empty())
+                _frames.push_back(FRAME_COORDINATES);
+            CoordinateArray array = { 0u, -1 };
+            _coords.push_back(array);
+        }
+
+        bool number(double value)
+        {
+            CoordinateArray& array = _coords.back();
+            if (array.numValues < 3u)
+                _position[array.numValues] = value;
+            ++array.numValues;
+            return true;
+        }
+
+        void popCoordinates()
+        {
+            CoordinateArray array = _coords.back();
+            _coords.pop_back();
+
+            Object& obj = current();
+            int height;
+
+            if (array.numValues > 0u)
+            {
+                if (array.numValues == 2u)
+                    _position.z() = 0.0;
+                if (array.numValues >= 2u)
+                    obj.points.push_back(_position);
+                height = 0;
+            }
+            else
+            {
+                height = array.childHeight + 1;
+                if (height == 1)
+                    obj.lineEnds.push_back(obj.points.size());
+                else if (height == 2)
+                    obj.polygonEnds.push_back(obj.lineEnds.size());
+            }
+
+            if (_coords.empty())
+                _frames.pop_back();
+            else
+                _coords.back().childHeight = std::max(_coords.back().childHeight, height);
+        }
+
+        void startRaw()
+        {
+            _rawBuffer.Clear();
+            _rawWriter.Reset(_rawBuffer);
+            _rawDepth = 1u;
+        }
+
+        bool endRaw(bool ok)
+        {
+            if (--_rawDepth == 0u)
+            {
+                // Like OGR, nested objects and arrays are kept as JSON text.
+                current().feature->set(_property, std::string(_rawBuffer.GetString(), _rawBuffer.GetSize()));
+            }
+            return ok;
+        }
+
+        Polygon* createPolygon(const Object& obj, unsigned firstLine, unsigned lastLine)
+        {
+            if (firstLine >= lastLine)
+                return 0L;
+
+            Polygon* poly = new Polygon();
+            for (unsigned line = firstLine; line < lastLine; ++line)
+            {
+                unsigned begin = line > 0u ? obj.lineEnds[line - 1] : 0u;
+                unsigned end = obj.lineEnds[line];
+
+                if (line == firstLine)
+                {
+                    populate(obj.points, begin, end, poly);
+                    if (_rewindPolygons)
+                    {
+                        poly->open();
+                        poly->rewind(Ring::ORIENTATION_CCW);
+                    }
+                }
+                else
+                {
+                    Ring* hole = new Ring();
+                    populate(obj.points, begin, end, hole);
+                    if (_rewindPolygons)
+                    {
+                        hole->open();
+                        hole->rewind(Ring::ORIENTATION_CW);
+                    }
+                    poly->getHoles().push_back(hole);
+                }
+            }
+            return poly;
+        }
+
+        Geometry* createGeometry(const Object& obj)
+        {
+            const std::string& type = obj.type;
+
+            if (type == "Point")
+            {
+                if (obj.points.empty())
+                    return 0L;
+                Point* point = new Point();
+                point->push_back(obj.points.front());
+                return point;
+            }
+
+            else if (type == "MultiPoint")
+            {
+                PointSet* points = new PointSet();
+                populate(obj.points, 0u, obj.points.size(), points);
+                return points;
+            }
+
+            else if (type == "LineString")
+            {
+                LineString* line = new LineString();
+                populate(obj.points, 0u, obj.points.size(), line);
+                return line;
+            }
+
+            else if (type == "MultiLineString")
+            {
+                MultiGeometry* multi = new MultiGeometry();
+                for (unsigned line = 0; line < obj.lineEnds.size(); ++line)
+                {
+                    LineString* part = new LineString();
+                    populate(obj.points, line > 0u ? obj.lineEnds[line - 1] : 0u, obj.lineEnds[line], part);
+                    multi->add(part);
+                }
+                return multi;
+            }
+
+            else if (type == "Polygon")
+            {
+                return createPolygon(obj, 0u, obj.lineEnds.size());
+            }
+
+            else if (type == "MultiPolygon")
+            {
+                MultiGeometry* multi = new MultiGeometry();
+                for (unsigned p = 0; p < obj.polygonEnds.size(); ++p)
+                {
+                    Polygon* part = createPolygon(obj, p > 0u ? obj.polygonEnds[p - 1] : 0u, obj.polygonEnds[p]);
+                    if (part)
+                        multi->add(part);
+                }
+                return multi;
+            }
+
+            else if (type == "GeometryCollection")
+            {
+                return new MultiGeometry(obj.components);
+            }
+
+            return 0L;
+        }
+    };
+
+    template<typename WRITER>
+    void writePosition(WRITER& w, const osg::Vec3d& p)
+    {
+        w.StartArray();
+        w.Double(p.x());
+        w.Double(p.y());
+        w.Double(p.z());
+        w.EndArray();
+    }
+
+    // GeoJSON rings repeat the first point at the end.
+    template<typename WRITER>
+    void writePositions(WRITER& w, const Geometry* geom, bool closeRing)
+    {
+        w.StartArray();
+        for (Geometry::const_iterator i = geom->begin(); i != geom->end(); ++i)
+            writePosition(w, *i);
+        if (closeRing && geom->size() > 2 && geom->front() != geom->back())
+            writePosition(w, geom->front());
+        w.EndArray();
+    }
+
+    template<typename WRITER>
+    void writePolygonRings(WRITER& w, const Geometry* geom)
+    {
+        w.StartArray();
+        writePositions(w, geom, true);
+        if (geom->getType() == Geometry::TYPE_POLYGON)
+        {
+            const RingCollection& holes = static_cast<const Polygon*>(geom)->getHoles();
+            for (RingCollection::const_iterator h = holes.begin(); h != holes.end(); ++h)
+                writePositions(w, h->get(), true);
+        }
+        w.EndArray();
+    }
+
+    // GeoJSON "Multi" type a part belongs to; parts of different kinds
+    // (or nested collections) make a GeometryCollection.
+    const char* multiTypeOf(const Geometry* part)
+    {
+        switch (part->getType())
+        {
+        case Geometry::TYPE_POINT:
+        case Geometry::TYPE_POINTSET:   return "MultiPoint";
+        case Geometry::TYPE_LINESTRING: return "MultiLineString";
+        case Geometry::TYPE_RING:
+        case Geometry::TYPE_POLYGON:    return "MultiPolygon";
+        default:                        return "GeometryCollection";
+        }
+    }
+
+    const char* typeName(const Geometry* geom)
+    {
+        switch (geom->getType())
+        {
+        case Geometry::TYPE_POINT:
+            return geom->size() > 1 ? "MultiPoint" : "Point";
+        case Geometry::TYPE_POINTSET:
+            return "MultiPoint";
+        case Geometry::TYPE_RING:
+        case Geometry::TYPE_POLYGON:
+            return "Polygon";
+        case Geometry::TYPE_MULTI:
+        {
+            const GeometryCollection& parts = static_cast<const MultiGeometry*>(geom)->getComponents();
+            if (parts.empty())
+                return "GeometryCollection";
+            const char* type = multiTypeOf(parts.front().get());
+            for (unsigned p = 1; p < parts.size(); ++p)
+                if (strcmp(multiTypeOf(parts[p].get()), type) != 0)
+                    return "GeometryCollection";
+            return type;
+        }
+        default:
+            return "LineString";
+        }
+    }
+
+    template<typename WRITER>
+    void writeGeometry(WRITER& w, const Geometry* geom)
+    {
+        if (!geom)
+        {
+            w.Null();
+            return;
+        }
+
+        const char* type = typeName(geom);
+
+        w.StartObject();
+        w.Key("type");
+        w.String(type);
+
+        if (geom->getType() == Geometry::TYPE_MULTI)
+        {
+            const GeometryCollection& parts = static_cast<const MultiGeometry*>(geom)->getComponents();
+
+            if (strcmp(type, "GeometryCollection") == 0)
+            {
+                w.Key("geometries");
+                w.StartArray();
+                for (GeometryCollection::const_iterator p = parts.begin(); p != parts.end(); ++p)
+                    writeGeometry(w, p->get());
+                w.EndArray();
+            }
+            else
+            {
+                w.Key("coordinates");
+                w.StartArray();
+                for (GeometryCollection::const_iterator p = parts.begin(); p != parts.end(); ++p)
+                {
+                    if (strcmp(type, "MultiPoint") == 0)
+                    {
+                        // a part may hold several points
+                        for (Geometry::const_iterator i = p->get()->begin(); i != p->get()->end(); ++i)
+                            writePosition(w, *i);
+                    }
+                    else if (strcmp(type, "MultiLineString") == 0)
+                        writePositions(w, p->get(), false);
+                    else
+                        writePolygonRings(w, p->get());
+                }
+                w.EndArray();
+            }
+        }
+        else
+        {
+            w.Key("coordinates");
+            if (strcmp(type, "Point") == 0)
+            {
+                if (geom->empty())
+                {
+                    w.StartArray();
+                    w.EndArray();
+                }
+                else
+                {
+                    writePosition(w, geom->front());
+                }
+            }
+            else if (strcmp(type, "Polygon") == 0)
+            {
+                writePolygonRings(w, geom);
+            }
+            else
+            {
+                writePositions(w, geom, false);
+            }
+        }
+
+        w.EndObject();
+    }
+
+    template<typename WRITER>
+    void writeFeature(WRITER& w, const Feature* feature)
+    {
+        w.StartObject();
+
+        w.Key("type");
+        w.String("Feature");
+
+        w.Key("id");
+        w.Int64(feature->getFID());
+
+        w.Key("geometry");
+        writeGeometry(w, feature->getGeometry());
+
+        w.Key("properties");
+        w.StartObject();
+        const AttributeTable& attrs = feature->getAttrs();
+        for (AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+        {
+            w.Key(a->first.c_str(), a->first.length());
+
+            const AttributeValue& value = a->second;
+            if (!value.second.set)
+            {
+                w.Null();
+            }
+            else if (value.first == ATTRTYPE_INT)
+            {
+                w.Int64(value.getInt());
+            }
+            else if (value.first == ATTRTYPE_DOUBLE)
+            {
+                double d = value.getDouble();
+                if (osg::isNaN(d) || std::isinf(d))
+                    w.Null();
+                else
+                    w.Double(d);
+            }
+            else if (value.first == ATTRTYPE_BOOL)
+            {
+                w.Bool(value.getBool());
+            }
+            else
+            {
+                const std::string& s = value.getString();
+                w.String(s.c_str(), s.length());
+            }
+        }
+        w.EndObject();
+
+        w.EndObject();
+    }
+}
+
+//........................................................................
+
+GeoJSONReader::GeoJSONReader() :
+_rewindPolygons(true)
+{
+    //nop
+}
+
+bool
+GeoJSONReader::read(const std::string& json, FeatureList& output) const
+{
+    FeatureList features;
+    FeatureReader reader(_srs.get(), _rewindPolygons, features);
+    rapidjson::StringStream stream(json.c_str());
+    if (!reader.parse(stream, _error))
+    {
+        OE_DEBUG << LC << _error << std::endl;
+        return false;
+    }
+    _error.clear();
+    output.splice(output.end(), features);
+    return true;
+}
+
+bool
+GeoJSONReader::read(std::istream& in, FeatureList& output) const
+{
+    FeatureList features;
+    FeatureReader reader(_srs.get(), _rewindPolygons, features);
+    rapidjson::IStreamWrapper stream(in);
+    if (!reader.parse(stream, _error))
+    {
+        OE_DEBUG << LC << _error << std::endl;
+        return false;
+    }
+    _error.clear();
+    output.splice(output.end(), features);
+    return true;
+}
+
+Geometry*
+GeoJSONReader::readGeometry(const std::string& json) const
+{
+    FeatureList features;
+    if (read(json, features) && features.size() == 1u)
+    {
+        osg::ref_ptr<Geometry> geom = features.front()->getGeometry();
+        features.front()->setGeometry(0L);
+        return geom.release();
+    }
+    return 0L;
+}
+
+bool
+GeoJSONReader::readFeatures(const std::string& json,
+                            const FeatureProfile* profile,
+                            bool rewindPolygons,
+                            FeatureList& output,
+                            std::string& error)
+{
+    GeoJSONReader reader;
+    reader.setSRS(profile ? profile->getSRS() : 0L);
+    reader.setRewindPolygons(rewindPolygons);
+
+    FeatureList features;
+    if (!reader.read(json, features))
+    {
+        error = reader.getError();
+        return false;
+    }
+
+    if (profile && profile->geoInterp().isSet())
+    {
+        for (FeatureList::iterator f = features.begin(); f != features.end(); ++f)
+            f->get()->geoInterp() = profile->geoInterp().get();
+    }
+
+    output.splice(output.end(), features);
+    return true;
+}
+
+//........................................................................
+
+struct GeoJSONWriter::Impl
+{
+    rapidjson::OStreamWrapper stream;
+    rapidjson::Writer<rapidjson::OStreamWrapper> writer;
+
+    Impl(std::ostream& out) : stream(out), writer(stream) { }
+};
+
+GeoJSONWriter::GeoJSONWriter(std::ostream& out) :
+_impl(new Impl(out))
+{
+    //nop
+}
+
+GeoJSONWriter::~GeoJSONWriter()
+{
+    _impl->stream.Flush();
+    delete _impl;
+}
+
+void
+GeoJSONWriter::beginFeatureCollection()
+{
+    _impl->writer.StartObject();
+    _impl->writer.Key("type");
+    _impl->writer.String("FeatureCollection");
+    _impl->writer.Key("features");
+    _impl->writer.StartArray();
+}
+
+void
+GeoJSONWriter::endFeatureCollection()
+{
+    _impl->writer.EndArray();
+    _impl->writer.EndObject();
+    _impl->stream.Flush();
+}
+
+void
+GeoJSONWriter::write(const Feature* feature)
+{
+    if (feature)
+        writeFeature(_impl->writer, feature);
+}
+
+void
+GeoJSONWriter::write(const Geometry* geometry)
+{
+    writeGeometry(_impl->writer, geometry);
+}
+
+std::string
+GeoJSONWriter::toGeoJSON(const Geometry* geometry)
+{
+    if (!geometry)
+        return std::string();
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writeGeometry(writer, geometry);
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+std::string
+GeoJSONWriter::toGeoJSON(const Feature* feature)
+{
+    if (!feature)
+        return std::string();
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writeFeature(writer, feature);
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
+
+std::string
+GeoJSONWriter::toGeoJSON(const FeatureList& features)
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("type");
+    writer.String("FeatureCollection");
+    writer.Key("features");
+    writer.StartArray();
+    for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f)
+    {
+        if (f->valid())
+            writeFeature(writer, f->get());
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return std::string(buffer.GetString(), buffer.GetSize());
+}
@@ -17,7 +17,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/GeometryClamper>
+#include <osgEarth/Map>
 #include <osg/Geometry>
+#include <osg/Timer>
 
 #define LC "[GeometryClamper] "
 
@@ -26,6 +28,55 @@ using namespace osgEarth::Util;
 
 #define ZOFFSETS_NAME "GeometryClamper::zOffsets"
 
+// Number of vertices re-clamped between budget checks
+#define SAMPLE_CHUNK_SIZE 256u
+
+// Deepest LOD used to index vertices by tile
+#define MAX_INDEX_LOD 16u
+
+namespace
+{
+    // Frame budget shared by all clampers
+    Threading::Mutex s_budgetMutex;
+    double s_frameBudget_ms = 2.0;
+    double s_frameUsed_ms = 0.0;
+    unsigned s_budgetFrame = ~0u;
+
+    void dirtyGeometry(osg::Geometry* geom, osg::Vec3Array* verts)
+    {
+        geom->dirtyBound();
+        if ( geom->getUseVertexBufferObjects() )
+        {
+            verts->getVertexBufferObject()->setUsage( GL_DYNAMIC_DRAW_ARB );
+            verts->dirty();
+        }
+        else
+        {
+#if OSG_VERSION_LESS_THAN(3,6,0)
+            geom->dirtyDisplayList();
+#else
+            geom->dirtyGLObjects();
+#endif
+        }
+    }
+
+    void markVertex(std::vector<osg::Vec4d>& coords, std::vector<unsigned>& pending,
+                    std::vector<bool>& isPending, unsigned k, double resolution, unsigned& count)
+    {
+        // vertex that could not be located in the map SRS
+        if (coords[k].x() == NO_DATA_VALUE)
+            return;
+
+        coords[k].w() = resolution;
+        if (!isPending[k])
+        {
+            isPending[k] = true;
+            pending.push_back(k);
+            ++count;
+        }
+    }
+}
+
 //-----------------------------------------------------------------------
 
 GeometryClamper::GeometryClamper(GeometryClamper::LocalData& localData) :
@@ -34,7 +85,8 @@ _localData(localData),
 _useVertexZ(true),
 _revert(false),
 _scale( 1.0f ),
-_offset( 0.0f )
+_offset( 0.0f ),
+_workingSet( NULL )
 {
     this->setNodeMaskOverride( ~0 );
     _lsi = new osgUtil::LineSegmentIntersector(osg::Vec3d(0,0,0), osg::Vec3d(0,0,0));
@@ -103,6 +155,12 @@ GeometryClamper::apply(osg::Drawable& drawable)
         storeAltitudes = true;
     }
 
+    if (_map.valid())
+    {
+        applyWithElevationPool(geom, data, local2world, storeAltitudes);
+        return;
+    }
+
     for( unsigned k=0; k<verts->size(); ++k )
     {
         osg::Vec3d vw = (*verts)[k];
@@ -165,23 +223,350 @@ GeometryClamper::apply(osg::Drawable& drawable)
 
     if ( geomDirty )
     {
-        geom->dirtyBound();
-        if ( geom->getUseVertexBufferObjects() )
+        dirtyGeometry(geom, verts);
+
+        OE_DEBUG << LC << "clamped " << count << " verts." << std::endl;
+    }
+}
+
+
+void
+GeometryClamper::applyWithElevationPool(osg::Geometry*      geom,
+                                        GeometryData&       data,
+                                        const osg::Matrixd& local2world,
+                                        bool                storeAltitudes)
+{
+    osg::ref_ptr<const Map> map;
+    if (!_map.lock(map) || map->getProfile() == NULL)
+        return;
+
+    const Profile* profile = map->getProfile();
+    const SpatialReference* mapSRS = profile->getSRS();
+    const osg::EllipsoidModel* em = _terrainSRS->getEllipsoid();
+    bool isGeocentric = _terrainSRS->isGeographic();
+    bool transformXY = !_terrainSRS->isHorizEquivalentTo(mapSRS);
+    unsigned numVerts = data._verts->size();
+
+    data._geom = geom;
+    data._local2world = local2world;
+    data._terrainCoords.resize(numVerts);
+    data._mapCoords.resize(numVerts);
+    data._mapBounds.init();
+    data._index.clear();
+    data._pending.clear();
+    data._isPending.assign(numVerts, false);
+
+    // Locate each original vertex in map coordinates:
+    for (unsigned k = 0; k < numVerts; ++k)
+    {
+        const osg::Vec3d local = (*data._verts)[k];
+        osg::Vec3d vw = local * local2world;
+
+        if (isGeocentric)
         {
-            verts->getVertexBufferObject()->setUsage( GL_DYNAMIC_DRAW_ARB );
-            verts->dirty();
+            if (storeAltitudes)
+                data._altitudes->push_back( local.z() );
+
+            double lat, lon, height;
+            em->convertXYZToLatLongHeight(vw.x(), vw.y(), vw.z(), lat, lon, height);
+            data._terrainCoords[k].set(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat));
         }
         else
         {
-#if OSG_VERSION_LESS_THAN(3,6,0)
-            geom->dirtyDisplayList();
-#else
-            geom->dirtyGLObjects();
-#endif
+            if (storeAltitudes)
+                data._altitudes->push_back( float(vw.z()) - _offset );
+
+            data._terrainCoords[k].set(vw.x(), vw.y());
         }
 
-        OE_DEBUG << LC << "clamped " << count << " verts." << std::endl;
+        // The pool samples in map coordinates, which need not be in the
+        // terrain SRS (e.g. a projected map profile on a geocentric terrain)
+        double x = data._terrainCoords[k].x(), y = data._terrainCoords[k].y();
+        if (transformXY && !_terrainSRS->transform2D(x, y, mapSRS, x, y))
+        {
+            // not indexed, and never marked for sampling
+            data._mapCoords[k].set(NO_DATA_VALUE, NO_DATA_VALUE, 0.0, 0.0);
+            continue;
+        }
+
+        data._mapCoords[k].set(x, y, 0.0, 0.0);
+        data._mapBounds.expandBy(x, y, 0.0);
+    }
+
+    // Index the vertices by the tiles they fall in. Pick an LOD at which
+    // the geometry spans a handful of tiles.
+    double span = osg::maximum(
+        data._mapBounds.xMax() - data._mapBounds.xMin(),
+        data._mapBounds.yMax() - data._mapBounds.yMin());
+
+    data._indexLOD = 0u;
+    for (; data._indexLOD < MAX_INDEX_LOD; ++data._indexLOD)
+    {
+        double tw, th;
+        profile->getTileDimensions(data._indexLOD, tw, th);
+        if (tw <= 0.25*span)
+            break;
+    }
+
+    for (unsigned k = 0; k < numVerts; ++k)
+    {
+        if (data._mapCoords[k].x() == NO_DATA_VALUE)
+            continue;
+
+        TileKey key = profile->createTileKey(data._mapCoords[k].x(), data._mapCoords[k].y(), data._indexLOD);
+        if (key.valid())
+            data._index[key].push_back(k);
+    }
+
+    // Initial clamp samples everything at the best available resolution.
+    unsigned count = 0u;
+    for (unsigned k = 0; k < numVerts; ++k)
+        markVertex(data._mapCoords, data._pending, data._isPending, k, 0.0, count);
+
+    samplePending(map.get(), data, numVerts);
+}
+
+unsigned
+GeometryClamper::samplePending(const Map* map, GeometryData& data, unsigned maxCount)
+{
+    osg::ref_ptr<osg::Geometry> geom;
+    osg::Vec3Array* verts = NULL;
+    if (data._geom.lock(geom))
+        verts = dynamic_cast<osg::Vec3Array*>(geom->getVertexArray());
+
+    if (verts == NULL ||
+        verts->size() != data._mapCoords.size() ||
+        !data._altitudes.valid() ||
+        data._altitudes->size() != data._mapCoords.size() ||
+        !_terrainSRS.valid())
+    {
+        data._pending.clear();
+        data._isPending.assign(data._isPending.size(), false);
+        return 0u;
+    }
+
+    unsigned n = osg::minimum(maxCount, (unsigned)data._pending.size());
+    if (n == 0u)
+        return 0u;
+
+    unsigned first = data._pending.size() - n;
+    std::vector<osg::Vec4d> points(n);
+    for (unsigned i = 0; i < n; ++i)
+    {
+        unsigned k = data._pending[first + i];
+        points[i] = data._mapCoords[k];
+        points[i].z() = 0.0;
+        data._isPending[k] = false;
+    }
+
+    map->getElevationPool()->sampleMapCoords(points, _workingSet);
+
+    const osg::EllipsoidModel* em = _terrainSRS->getEllipsoid();
+    bool isGeocentric = _terrainSRS->isGeographic();
+
+    osg::Matrixd world2local;
+    world2local.invert(data._local2world);
+
+    osg::Vec3d n_vector(0,0,1), fw;
+    unsigned count = 0u;
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        if (points[i].z() == NO_DATA_VALUE)
+            continue;
+
+        unsigned k = data._pending[first + i];
+        const osg::Vec2d& t = data._terrainCoords[k];
+
+        if (isGeocentric)
+        {
+            em->convertLatLongHeightToXYZ(
+                osg::DegreesToRadians(t.y()), osg::DegreesToRadians(t.x()), points[i].z(),
+                fw.x(), fw.y(), fw.z());
+            n_vector = em->computeLocalUpVector(fw.x(), fw.y(), fw.z());
+        }
+        else
+        {
+            fw.set(t.x(), t.y(), points[i].z());
+        }
+
+        if ( _offset != 0.0 )
+        {
+            fw += n_vector*_offset;
+        }
+
+        if (_useVertexZ)
+        {
+            fw += n_vector * (*data._altitudes)[k];
+        }
+
+        (*verts)[k] = (fw * world2local);
+        ++count;
+    }
+
+    data._pending.resize(first);
+
+    if (count > 0u)
+    {
+        dirtyGeometry(geom.get(), verts);
+    }
+
+    return n;
+}
+
+unsigned
+GeometryClamper::dirty(const TileKey& key)
+{
+    osg::ref_ptr<const Map> map;
+    if (!_map.lock(map) || map->getProfile() == NULL)
+        return 0u;
+
+    const Profile* profile = map->getProfile();
+    unsigned count = 0u;
+
+    GeoExtent extent;
+    bool sameProfile = false;
+    double resolution = 0.0;
+
+    if (key.valid())
+    {
+        extent = profile->clampAndTransformExtent(key.getExtent());
+        if (!extent.isValid())
+            return 0u;
+
+        sameProfile = key.getProfile()->isHorizEquivalentTo(profile);
+        resolution = extent.width() / 256.0;
     }
+
+    for (LocalData::iterator i = _localData.begin(); i != _localData.end(); ++i)
+    {
+        GeometryData& data = i->second;
+        if (data._mapCoords.empty())
+            continue;
+
+        // no key: re-clamp everything
+        if (!key.valid())
+        {
+            for (unsigned k = 0; k < data._mapCoords.size(); ++k)
+                markVertex(data._mapCoords, data._pending, data._isPending, k, resolution, count);
+            continue;
+        }
+
+        // trivial reject
+        if (extent.xMin() > data._mapBounds.xMax() || extent.xMax() < data._mapBounds.xMin() ||
+            extent.yMin() > data._mapBounds.yMax() || extent.yMax() < data._mapBounds.yMin())
+        {
+            continue;
+        }
+
+        if (sameProfile && key.getLOD() >= data._indexLOD)
+        {
+            // key is inside one index tile; test its vertices
+            std::map<TileKey, std::vector<unsigned> >::const_iterator bucket =
+                data._index.find(key.createAncestorKey(data._indexLOD));
+
+            if (bucket != data._index.end())
+            {
+                for (std::vector<unsigned>::const_iterator k = bucket->second.begin(); k != bucket->second.end(); ++k)
+                {
+                    const osg::Vec4d& p = data._mapCoords[*k];
+                    if (extent.contains(p.x(), p.y()))
+                        markVertex(data._mapCoords, data._pending, data._isPending, *k, resolution, count);
+                }
+            }
+        }
+        else if (sameProfile)
+        {
+            // key covers whole index tiles
+            for (std::map<TileKey, std::vector<unsigned> >::const_iterator bucket = data._index.begin();
+                bucket != data._index.end();
+                ++bucket)
+            {
+                if (bucket->first.createAncestorKey(key.getLOD()) == key)
+                {
+                    for (std::vector<unsigned>::const_iterator k = bucket->second.begin(); k != bucket->second.end(); ++k)
+                        markVertex(data._mapCoords, data._pending, data._isPending, *k, resolution, count);
+                }
+            }
+        }
+        else
+        {
+            for (unsigned k = 0; k < data._mapCoords.size(); ++k)
+            {
+                const osg::Vec4d& p = data._mapCoords[k];
+                if (extent.contains(p.x(), p.y()))
+                    markVertex(data._mapCoords, data._pending, data._isPending, k, resolution, count);
+            }
+        }
+    }
+
+    return count;
+}
+
+bool
+GeometryClamper::update(unsigned frameNumber)
+{
+    osg::ref_ptr<const Map> map;
+    if (!_map.lock(map) || map->getProfile() == NULL)
+        return true;
+
+    for (LocalData::iterator i = _localData.begin(); i != _localData.end(); ++i)
+    {
+        GeometryData& data = i->second;
+
+        while (!data._pending.empty())
+        {
+            {
+                Threading::ScopedMutexLock lock(s_budgetMutex);
+                if (s_budgetFrame != frameNumber)
+                {
+                    s_budgetFrame = frameNumber;
+                    s_frameUsed_ms = 0.0;
+                }
+                if (s_frameBudget_ms > 0.0 && s_frameUsed_ms >= s_frameBudget_ms)
+                {
+                    return false;
+                }
+            }
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+
+            samplePending(map.get(), data, SAMPLE_CHUNK_SIZE);
+
+            double used = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+            {
+                Threading::ScopedMutexLock lock(s_budgetMutex);
+                s_frameUsed_ms += used;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool
+GeometryClamper::hasPendingWork() const
+{
+    for (LocalData::const_iterator i = _localData.begin(); i != _localData.end(); ++i)
+    {
+        if (!i->second._pending.empty())
+            return true;
+    }
+    return false;
+}
+
+void
+GeometryClamper::setFrameBudget(double ms)
+{
+    Threading::ScopedMutexLock lock(s_budgetMutex);
+    s_frameBudget_ms = ms;
+}
+
+double
+GeometryClamper::getFrameBudget()
+{
+    Threading::ScopedMutexLock lock(s_budgetMutex);
+    return s_frameBudget_ms;
 }
 
 
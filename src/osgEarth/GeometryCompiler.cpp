@@ -37,6 +37,9 @@
 #include <osgEarth/ShaderUtils>
 #include <osgEarth/Utils>
 #include <osgEarth/Metrics>
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/FeatureIndex>
+#include <osgEarth/ThreadingUtils>
 
 #include <osg/MatrixTransform>
 #include <osg/Timer>
@@ -44,12 +47,13 @@
 #include <osgUtil/Optimizer>
 
 #include <cstdlib>
+#include <iomanip>
+#include <sstream>
 
 #define LC "[GeometryCompiler] "
 
 using namespace osgEarth;
 
-//#define PROFILING 1
 
 //-----------------------------------------------------------------------
 
@@ -75,7 +79,8 @@ _optimize              ( false ),
 _optimizeVertexOrdering( true ),
 _validate              ( false ),
 _maxPolyTilingAngle    ( 45.0f ),
-_useOSGTessellator     ( false )
+_useOSGTessellator     ( false ),
+_compileThreads        ( 1u )
 {
 
 }
@@ -95,7 +100,8 @@ _optimize              ( s_defaults.optimize().value() ),
 _optimizeVertexOrdering( s_defaults.optimizeVertexOrdering().value() ),
 _validate              ( s_defaults.validate().value() ),
 _maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() ),
-_useOSGTessellator     (s_defaults.useOSGTessellator().value())
+_useOSGTessellator     (s_defaults.useOSGTessellator().value()),
+_compileThreads        ( s_defaults.compileThreads().value() )
 {
     fromConfig(conf.getConfig());
 }
@@ -117,6 +123,7 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.get( "validate", _validate );
     conf.get( "max_polygon_tiling_angle", _maxPolyTilingAngle );
     conf.get( "use_osg_tessellator", _useOSGTessellator);
+    conf.get( "compile_threads", _compileThreads );
 
     conf.get( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.get( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -144,6 +151,7 @@ GeometryCompilerOptions::getConfig() const
     conf.set( "validate", _validate );
     conf.set( "max_polygon_tiling_angle", _maxPolyTilingAngle );
     conf.set( "use_osg_tessellator", _useOSGTessellator);
+    conf.set( "compile_threads", _compileThreads );
 
     conf.set( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.set( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -223,80 +231,133 @@ GeometryCompiler::compile(FeatureCursor*        cursor,
     return compile(workingSet, style, context);
 }
 
-osg::Node*
-GeometryCompiler::compile(FeatureList&          workingSet,
-    const Style&          style,
-    const FilterContext&  context)
+namespace
 {
-    OE_PROFILING_ZONE;
-
-#ifdef PROFILING
-    osg::Timer_t p_start = osg::Timer::instance()->tick();
-    unsigned p_features = workingSet.size();
-#endif
-
-    osg::ref_ptr<osg::Group> extrusionGroup;
-
-    // for debugging/validation.
-    std::vector<std::string> history;
-    bool trackHistory = (_options.validate() == true);
-
-    osg::ref_ptr<osg::Group> resultGroup = new osg::Group();
-
-    // create a filter context that will track feature data through the process
-    FilterContext sharedCX = context;
-
-    if ( !sharedCX.extent().isSet() && sharedCX.profile() )
+    // Filters the compiler runs, in the order they run.
+    enum Stage
     {
-        sharedCX.extent() = sharedCX.profile()->getExtent();
+        STAGE_TESSELLATE,
+        STAGE_RESAMPLE,
+        STAGE_PLACEMENT,
+        STAGE_ALTITUDE,
+        STAGE_SUBSTITUTE,
+        STAGE_EXTRUDE,
+        STAGE_GEOMETRY,
+        STAGE_TEXT,
+        STAGE_SHADERS,
+        STAGE_SHARE_STATE,
+        STAGE_OPTIMIZE,
+        NUM_STAGES
+    };
+
+    const char* s_stageNames[NUM_STAGES] = {
+        "tessellate", "resample", "placement", "altitude", "substitute",
+        "extrude", "geometry", "text", "shaders", "share_state", "optimize"
+    };
+
+    // Time spent in each filter. Partitions compiled in parallel add
+    // their times together, so the totals are CPU time rather than wall time.
+    const StageTimes::Stages& getStages()
+    {
+        static StageTimes::Stages s_stages(
+            "osgearth_geometry_compiler_filter_seconds",
+            "Time spent in each filter of the geometry compiler",
+            "filter", s_stageNames, NUM_STAGES);
+        return s_stages;
     }
 
-    // ref_ptr's to hold defaults in case we need them.
-    osg::ref_ptr<PointSymbol>   defaultPoint;
-    osg::ref_ptr<LineSymbol>    defaultLine;
-    osg::ref_ptr<PolygonSymbol> defaultPolygon;
-
-    // go through the Style and figure out which filters to use.
-    const PointSymbol*     point     = style.get<PointSymbol>();
-    const LineSymbol*      line      = style.get<LineSymbol>();
-    const PolygonSymbol*   polygon   = style.get<PolygonSymbol>();
-    const ExtrusionSymbol* extrusion = style.get<ExtrusionSymbol>();
-    const AltitudeSymbol*  altitude  = style.get<AltitudeSymbol>();
-    const TextSymbol*      text      = style.get<TextSymbol>();
-    const IconSymbol*      icon      = style.get<IconSymbol>();
-    const ModelSymbol*     model     = style.get<ModelSymbol>();
-    const RenderSymbol*    render    = style.get<RenderSymbol>();
-
-    // Perform tessellation first.
-    if ( line )
+    // Serializes access to a feature index that partitions compiling
+    // in parallel all tag their drawables into.
+    class LockingFeatureIndex : public FeatureIndexBuilder
     {
-        if ( line->tessellation().isSet() )
+    public:
+        LockingFeatureIndex(FeatureIndexBuilder* index) : _index(index) { }
+
+        ObjectID tagDrawable(osg::Drawable* drawable, Feature* feature)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            return _index->tagDrawable(drawable, feature);
+        }
+
+        ObjectID tagAllDrawables(osg::Node* node, Feature* feature)
         {
-            TessellateOperator filter;
-            filter.setNumPartitions( *line->tessellation() );
-            filter.setDefaultGeoInterp( _options.geoInterp().get() );
-            sharedCX = filter.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "tessellation" );
+            Threading::ScopedMutexLock lock(_mutex);
+            return _index->tagAllDrawables(node, feature);
         }
-        else if ( line->tessellationSize().isSet() )
+
+        ObjectID tagNode(osg::Node* node, Feature* feature)
         {
-            TessellateOperator filter;
-            filter.setMaxPartitionSize( *line->tessellationSize() );
-            filter.setDefaultGeoInterp( _options.geoInterp().get() );
-            sharedCX = filter.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "tessellationSize" );
+            Threading::ScopedMutexLock lock(_mutex);
+            return _index->tagNode(node, feature);
         }
-    }
 
-    // if the style was empty, use some defaults based on the geometry type of the
-    // first feature.
-    if ( !point && !line && !polygon && !extrusion && !text && !model && !icon && workingSet.size() > 0 )
+    private:
+        FeatureIndexBuilder* _index;
+        Threading::Mutex _mutex;
+    };
+
+    // Fewest features worth handing to a partition of their own.
+    const unsigned MIN_FEATURES_PER_PARTITION = 64u;
+
+    // Runs the filter chain that turns features into geometry, adding the
+    // nodes it creates to "output". Each partition of a parallel compile
+    // calls this with its own features and filter context.
+    void runFilters(const GeometryCompilerOptions& options,
+                    FeatureList&                   workingSet,
+                    const Style&                   style,
+                    FilterContext&                 sharedCX,
+                    Geometry::Type                 defaultType,
+                    osg::Group*                    output,
+                    StageTimes&                    times,
+                    std::vector<std::string>*      history,
+                    osg::ref_ptr<osg::Group>&      extrusionGroup)
     {
-        Feature* first = workingSet.begin()->get();
-        Geometry* geom = first->getGeometry();
-        if ( geom )
+        // ref_ptr's to hold defaults in case we need them.
+        osg::ref_ptr<PointSymbol>   defaultPoint;
+        osg::ref_ptr<LineSymbol>    defaultLine;
+        osg::ref_ptr<PolygonSymbol> defaultPolygon;
+
+        // go through the Style and figure out which filters to use.
+        const PointSymbol*     point     = style.get<PointSymbol>();
+        const LineSymbol*      line      = style.get<LineSymbol>();
+        const PolygonSymbol*   polygon   = style.get<PolygonSymbol>();
+        const ExtrusionSymbol* extrusion = style.get<ExtrusionSymbol>();
+        const AltitudeSymbol*  altitude  = style.get<AltitudeSymbol>();
+        const TextSymbol*      text      = style.get<TextSymbol>();
+        const IconSymbol*      icon      = style.get<IconSymbol>();
+        const ModelSymbol*     model     = style.get<ModelSymbol>();
+        const RenderSymbol*    render    = style.get<RenderSymbol>();
+
+        // Perform tessellation first.
+        if ( line )
+        {
+            if ( line->tessellation().isSet() )
+            {
+                OE_START_TIMER(tessellate);
+                TessellateOperator filter;
+                filter.setNumPartitions( *line->tessellation() );
+                filter.setDefaultGeoInterp( options.geoInterp().get() );
+                sharedCX = filter.push( workingSet, sharedCX );
+                times.add( STAGE_TESSELLATE, OE_GET_TIMER(tessellate) );
+                if ( history ) history->push_back( "tessellation" );
+            }
+            else if ( line->tessellationSize().isSet() )
+            {
+                OE_START_TIMER(tessellate);
+                TessellateOperator filter;
+                filter.setMaxPartitionSize( *line->tessellationSize() );
+                filter.setDefaultGeoInterp( options.geoInterp().get() );
+                sharedCX = filter.push( workingSet, sharedCX );
+                times.add( STAGE_TESSELLATE, OE_GET_TIMER(tessellate) );
+                if ( history ) history->push_back( "tessellationSize" );
+            }
+        }
+
+        // if the style was empty, use some defaults based on the geometry type of the
+        // first feature.
+        if ( !point && !line && !polygon && !extrusion && !text && !model && !icon )
         {
-            switch( geom->getComponentType() )
+            switch( defaultType )
             {
             case Geometry::TYPE_LINESTRING:
             case Geometry::TYPE_RING:
@@ -317,187 +378,331 @@ GeometryCompiler::compile(FeatureList&          workingSet,
                 break;
             }
         }
-    }
 
-    // resample the geometry if necessary:
-    if (_options.resampleMode().isSet())
-    {
-        ResampleFilter resample;
-        resample.resampleMode() = *_options.resampleMode();        
-        if (_options.resampleMaxLength().isSet())
+        // resample the geometry if necessary:
+        if (options.resampleMode().isSet())
         {
-            resample.maxLength() = *_options.resampleMaxLength();
-        }                   
-        sharedCX = resample.push( workingSet, sharedCX ); 
-        if ( trackHistory ) history.push_back( "resample" );
-    }    
-
-    // check whether we need to do elevation clamping:
-    bool altRequired =
-        _options.ignoreAltitudeSymbol() != true &&
-        altitude && (
-            altitude->clamping() != AltitudeSymbol::CLAMP_NONE ||
-            altitude->verticalOffset().isSet() ||
-            altitude->verticalScale().isSet() ||
-            altitude->script().isSet() );    
-
-    // instance substitution (replaces marker)
-    if ( model )
-    {
-        const InstanceSymbol* instance = (const InstanceSymbol*)model;
+            OE_START_TIMER(resample);
+            ResampleFilter resample;
+            resample.resampleMode() = *options.resampleMode();        
+            if (options.resampleMaxLength().isSet())
+            {
+                resample.maxLength() = *options.resampleMaxLength();
+            }                   
+            sharedCX = resample.push( workingSet, sharedCX ); 
+            times.add( STAGE_RESAMPLE, OE_GET_TIMER(resample) );
+            if ( history ) history->push_back( "resample" );
+        }    
+
+        // check whether we need to do elevation clamping:
+        bool altRequired =
+            options.ignoreAltitudeSymbol() != true &&
+            altitude && (
+                altitude->clamping() != AltitudeSymbol::CLAMP_NONE ||
+                altitude->verticalOffset().isSet() ||
+                altitude->verticalScale().isSet() ||
+                altitude->script().isSet() );    
+
+        // instance substitution (replaces marker)
+        if ( model )
+        {
+            const InstanceSymbol* instance = (const InstanceSymbol*)model;
 
-        // use a separate filter context since we'll be munging the data
-        FilterContext localCX = sharedCX;
+            // use a separate filter context since we'll be munging the data
+            FilterContext localCX = sharedCX;
 
-        if ( trackHistory ) history.push_back( "model");
+            if ( history ) history->push_back( "model");
 
-        if ( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM   ||
-            instance->placement() == InstanceSymbol::PLACEMENT_INTERVAL )
-        {
-            ScatterFilter scatter;
-            scatter.setDensity( *instance->density() );
-            scatter.setRandom( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM );
-            scatter.setRandomSeed( *instance->randomSeed() );
-            localCX = scatter.push( workingSet, localCX );
-            if ( trackHistory ) history.push_back( "scatter" );
+            if ( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM   ||
+                instance->placement() == InstanceSymbol::PLACEMENT_INTERVAL )
+            {
+                OE_START_TIMER(scatter);
+                ScatterFilter scatter;
+                scatter.setDensity( *instance->density() );
+                scatter.setRandom( instance->placement() == InstanceSymbol::PLACEMENT_RANDOM );
+                scatter.setRandomSeed( *instance->randomSeed() );
+                localCX = scatter.push( workingSet, localCX );
+                times.add( STAGE_PLACEMENT, OE_GET_TIMER(scatter) );
+                if ( history ) history->push_back( "scatter" );
+            }
+            else if ( instance->placement() == InstanceSymbol::PLACEMENT_CENTROID )
+            {
+                OE_START_TIMER(centroid);
+                CentroidFilter centroid;
+                localCX = centroid.push( workingSet, localCX );
+                times.add( STAGE_PLACEMENT, OE_GET_TIMER(centroid) );
+                if ( history ) history->push_back( "centroid" );
+            }
+
+            if ( altRequired )
+            {
+                OE_START_TIMER(clamp);
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                localCX = clamp.push( workingSet, localCX );
+                times.add( STAGE_ALTITUDE, OE_GET_TIMER(clamp) );
+                if ( history ) history->push_back( "altitude" );
+            }
+
+            OE_START_TIMER(substitute);
+
+            SubstituteModelFilter sub( style );
+
+            // activate clustering
+            sub.setClustering( *options.clustering() );
+
+            // activate draw-instancing
+            sub.setUseDrawInstanced( *options.instancing() );
+
+            sub.setFilterUsage(*options.filterUsage());
+
+            // activate feature naming
+            if ( options.featureName().isSet() )
+                sub.setFeatureNameExpr( *options.featureName() );
+
+
+            osg::Node* node = sub.push( workingSet, localCX );
+            times.add( STAGE_SUBSTITUTE, OE_GET_TIMER(substitute) );
+            if ( node )
+            {
+                if ( history ) history->push_back( "substitute" );
+
+                output->addChild( node );
+            }
         }
-        else if ( instance->placement() == InstanceSymbol::PLACEMENT_CENTROID )
+
+        // extruded geometry
+        if ( extrusion )
         {
-            CentroidFilter centroid;
-            localCX = centroid.push( workingSet, localCX );
-            if ( trackHistory ) history.push_back( "centroid" );
+            if ( altRequired )
+            {
+                OE_START_TIMER(clamp);
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                sharedCX = clamp.push( workingSet, sharedCX );
+                times.add( STAGE_ALTITUDE, OE_GET_TIMER(clamp) );
+                if ( history ) history->push_back( "altitude" );
+                altRequired = false;
+            }
+
+            OE_START_TIMER(extrude);
+
+            ExtrudeGeometryFilter extrude;
+            extrude.setStyle( style );
+
+            // apply per-feature naming if requested.
+            if ( options.featureName().isSet() )
+                extrude.setFeatureNameExpr( *options.featureName() );
+
+            if ( options.mergeGeometry().isSet() )
+                extrude.setMergeGeometry( *options.mergeGeometry() );
+
+            if ( options.filterUsage().isSet() )
+                extrude.setFilterUsage(*options.filterUsage());
+
+            osg::Node* node = extrude.push( workingSet, sharedCX );
+            times.add( STAGE_EXTRUDE, OE_GET_TIMER(extrude) );
+            if ( node )
+            {
+                if ( history ) history->push_back( "extrude" );
+                output->addChild( node );
+
+                extrusionGroup = dynamic_cast<osg::Group*>(node);
+                ASSERT_PREDICATE(extrusionGroup.get());
+            }
         }
 
-        if ( altRequired )
+        // simple geometry
+        else if ( point || line || polygon )
         {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            localCX = clamp.push( workingSet, localCX );
-            if ( trackHistory ) history.push_back( "altitude" );
-        }
+            if ( altRequired )
+            {
+                OE_START_TIMER(clamp);
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                sharedCX = clamp.push( workingSet, sharedCX );
+                times.add( STAGE_ALTITUDE, OE_GET_TIMER(clamp) );
+                if ( history ) history->push_back( "altitude" );
+                altRequired = false;
+            }
 
-        SubstituteModelFilter sub( style );
+            OE_START_TIMER(geometry);
 
-        // activate clustering
-        sub.setClustering( *_options.clustering() );
+            BuildGeometryFilter filter( style );
 
-        // activate draw-instancing
-        sub.setUseDrawInstanced( *_options.instancing() );
+            filter.maxGranularity() = *options.maxGranularity();
+            filter.geoInterp()      = *options.geoInterp();
+            filter.useOSGTessellator() = *options.useOSGTessellator();
 
-        sub.setFilterUsage(*_options.filterUsage());
+            if (options.maxPolygonTilingAngle().isSet())
+                filter.maxPolygonTilingAngle() = *options.maxPolygonTilingAngle();
 
-        // activate feature naming
-        if ( _options.featureName().isSet() )
-            sub.setFeatureNameExpr( *_options.featureName() );
+            if ( options.featureName().isSet() )
+                filter.featureName() = *options.featureName();
 
+            if (options.optimizeVertexOrdering().isSet())
+                filter.optimizeVertexOrdering() = *options.optimizeVertexOrdering();
 
-        osg::Node* node = sub.push( workingSet, localCX );
-        if ( node )
-        {
-            if ( trackHistory ) history.push_back( "substitute" );
+            if (render && render->maxCreaseAngle().isSet())
+                filter.maxCreaseAngle() = render->maxCreaseAngle().get();
 
-            resultGroup->addChild( node );
+            osg::Node* node = filter.push( workingSet, sharedCX );
+            times.add( STAGE_GEOMETRY, OE_GET_TIMER(geometry) );
+            if ( node )
+            {
+                if ( history ) history->push_back( "geometry" );
+                output->addChild( node );
+            }
         }
-    }
 
-    // extruded geometry
-    if ( extrusion )
-    {
-        if ( altRequired )
+        if ( text || icon )
         {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            sharedCX = clamp.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "altitude" );
-            altRequired = false;
+            // Only clamp annotation types when the technique is 
+            // explicity set to MAP. Otherwise, the annotation subsystem
+            // will automatically use SCENE clamping.
+            bool altRequiredForAnnotations =
+                altRequired &&
+                altitude->technique().isSetTo(altitude->TECHNIQUE_MAP);
+
+            if ( altRequiredForAnnotations )
+            {
+                OE_START_TIMER(clamp);
+                AltitudeFilter clamp;
+                clamp.setPropertiesFromStyle( style );
+                sharedCX = clamp.push( workingSet, sharedCX );
+                times.add( STAGE_ALTITUDE, OE_GET_TIMER(clamp) );
+                if ( history ) history->push_back( "altitude" );
+                altRequired = false;
+            }
+
+            OE_START_TIMER(text);
+            BuildTextFilter filter( style );
+            osg::Node* node = filter.push( workingSet, sharedCX );
+            times.add( STAGE_TEXT, OE_GET_TIMER(text) );
+            if ( node )
+            {
+                if ( history ) history->push_back( "text" );
+                output->addChild( node );
+            }
         }
+    }
+}
 
-        ExtrudeGeometryFilter extrude;
-        extrude.setStyle( style );
+osg::Node*
+GeometryCompiler::compile(FeatureList&          workingSet,
+    const Style&          style,
+    const FilterContext&  context)
+{
+    OE_PROFILING_ZONE;
 
-        // apply per-feature naming if requested.
-        if ( _options.featureName().isSet() )
-            extrude.setFeatureNameExpr( *_options.featureName() );
+    OE_START_TIMER(compile);
+    unsigned numFeatures = workingSet.size();
+    StageTimes times(getStages());
 
-        if ( _options.mergeGeometry().isSet() )
-            extrude.setMergeGeometry( *_options.mergeGeometry() );
+    osg::ref_ptr<osg::Group> extrusionGroup;
 
-        if ( _options.filterUsage().isSet() )
-            extrude.setFilterUsage(*_options.filterUsage());
+    // for debugging/validation.
+    std::vector<std::string> history;
+    bool trackHistory = (_options.validate() == true);
 
-        osg::Node* node = extrude.push( workingSet, sharedCX );
-        if ( node )
-        {
-            if ( trackHistory ) history.push_back( "extrude" );
-            resultGroup->addChild( node );
+    osg::ref_ptr<osg::Group> resultGroup = new osg::Group();
 
-            extrusionGroup = dynamic_cast<osg::Group*>(node);
-            ASSERT_PREDICATE(extrusionGroup.get());
-        }
+    // create a filter context that will track feature data through the process
+    FilterContext sharedCX = context;
+
+    if ( !sharedCX.extent().isSet() && sharedCX.profile() )
+    {
+        sharedCX.extent() = sharedCX.profile()->getExtent();
     }
 
-    // simple geometry
-    else if ( point || line || polygon )
+    // an empty style falls back on the geometry type of the first feature.
+    Geometry::Type defaultType = Geometry::TYPE_UNKNOWN;
+    if ( workingSet.size() > 0 && workingSet.front()->getGeometry() )
     {
-        if ( altRequired )
-        {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            sharedCX = clamp.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "altitude" );
-            altRequired = false;
-        }
+        defaultType = workingSet.front()->getGeometry()->getComponentType();
+    }
+
+    const ExtrusionSymbol* extrusion = style.get<ExtrusionSymbol>();
 
-        BuildGeometryFilter filter( style );
+    // Large lists split into contiguous partitions that run the filter chain
+    // concurrently. Model substitution clusters and instances across the
+    // whole list, and zero-work extrusion expects a single extrusion group,
+    // so those always compile in one piece.
+    unsigned threads = osg::maximum(_options.compileThreads().get(), 1u);
+    unsigned numPartitions = Threading::ForkJoin::getNumParts(numFeatures, threads, MIN_FEATURES_PER_PARTITION);
 
-        filter.maxGranularity() = *_options.maxGranularity();
-        filter.geoInterp()      = *_options.geoInterp();
-        filter.useOSGTessellator() = *_options.useOSGTessellator();
+    bool parallel =
+        threads > 1u &&
+        numPartitions >= 2u &&
+        style.get<ModelSymbol>() == 0L &&
+        !(extrusion && *_options.filterUsage() == FILTER_USAGE_ZERO_WORK_CALLBACK_BASED);
 
-        if (_options.maxPolygonTilingAngle().isSet())
-            filter.maxPolygonTilingAngle() = *_options.maxPolygonTilingAngle();
+    if ( !parallel )
+    {
+        numPartitions = 1u;
+
+        runFilters(
+            _options, workingSet, style, sharedCX, defaultType,
+            resultGroup.get(), times, trackHistory ? &history : 0L, extrusionGroup);
+    }
+    else
+    {
+        // Each partition works on features of its own, with a filter context
+        // copy of its own. The copies share the session and its caches, and
+        // tag the shared feature index through a lock.
+        std::vector<FeatureList> partitions(numPartitions);
+        FeatureList::iterator first = workingSet.begin();
+        for (unsigned p = 0; p < numPartitions; ++p)
+        {
+            unsigned count = (numFeatures * (p + 1u)) / numPartitions - (numFeatures * p) / numPartitions;
+            FeatureList::iterator last = first;
+            std::advance(last, count);
+            partitions[p].splice(partitions[p].end(), workingSet, first, last);
+            first = last;
+        }
 
-        if ( _options.featureName().isSet() )
-            filter.featureName() = *_options.featureName();
+        LockingFeatureIndex index(sharedCX.featureIndex());
 
-        if (_options.optimizeVertexOrdering().isSet())
-            filter.optimizeVertexOrdering() = *_options.optimizeVertexOrdering();
+        std::vector<osg::ref_ptr<osg::Group> > outputs(numPartitions);
+        std::vector<StageTimes> partitionTimes(numPartitions, StageTimes(getStages()));
+        std::vector<std::vector<std::string> > partitionHistory(numPartitions);
 
-        if (render && render->maxCreaseAngle().isSet())
-            filter.maxCreaseAngle() = render->maxCreaseAngle().get();
+        osg::ref_ptr<Threading::ForkJoin> job = new Threading::ForkJoin();
 
-        osg::Node* node = filter.push( workingSet, sharedCX );
-        if ( node )
+        for (unsigned p = 0; p < numPartitions; ++p)
         {
-            if ( trackHistory ) history.push_back( "geometry" );
-            resultGroup->addChild( node );
+            job->add([&, p]()
+            {
+                FilterContext localCX = sharedCX;
+                if (sharedCX.featureIndex())
+                    localCX.setFeatureIndex(&index);
+
+                osg::ref_ptr<osg::Group> localExtrusionGroup;
+                outputs[p] = new osg::Group();
+                runFilters(
+                    _options, partitions[p], style, localCX, defaultType,
+                    outputs[p].get(), partitionTimes[p],
+                    trackHistory ? &partitionHistory[p] : 0L, localExtrusionGroup);
+            });
         }
-    }
 
-    if ( text || icon )
-    {
-        // Only clamp annotation types when the technique is 
-        // explicity set to MAP. Otherwise, the annotation subsystem
-        // will automatically use SCENE clamping.
-        bool altRequiredForAnnotations =
-            altRequired &&
-            altitude->technique().isSetTo(altitude->TECHNIQUE_MAP);
-
-        if ( altRequiredForAnnotations )
+        job->run(threads);
+
+        // Gather the results in partition order, so the graph comes out
+        // the same no matter which thread compiled which partition, and
+        // put the (possibly modified) features back in the working set.
+        for (unsigned p = 0; p < numPartitions; ++p)
         {
-            AltitudeFilter clamp;
-            clamp.setPropertiesFromStyle( style );
-            sharedCX = clamp.push( workingSet, sharedCX );
-            if ( trackHistory ) history.push_back( "altitude" );
-            altRequired = false;
+            for (unsigned i = 0; i < outputs[p]->getNumChildren(); ++i)
+                resultGroup->addChild(outputs[p]->getChild(i));
+
+            workingSet.splice(workingSet.end(), partitions[p]);
+            times.add(partitionTimes[p]);
         }
 
-        BuildTextFilter filter( style );
-        osg::Node* node = filter.push( workingSet, sharedCX );
-        if ( node )
+        if ( trackHistory )
         {
-            if ( trackHistory ) history.push_back( "text" );
-            resultGroup->addChild( node );
+            history = partitionHistory.front();
         }
     }
 
@@ -507,10 +712,14 @@ GeometryCompiler::compile(FeatureList&          workingSet,
 
         if (shaderPolicy == SHADERPOLICY_GENERATE)
         {
+            OE_START_TIMER(shadergen);
+
             // no ss cache because we will optimize later.
             Registry::shaderGenerator().run( 
                 resultGroup.get(),
                 "GeometryCompiler shadergen" );
+
+            times.add( STAGE_SHADERS, OE_GET_TIMER(shadergen) );
         }
         else if (shaderPolicy == SHADERPOLICY_DISABLE )
         {
@@ -525,6 +734,8 @@ GeometryCompiler::compile(FeatureList&          workingSet,
     // Optimize stateset sharing.
     if ( _options.optimizeStateSharing() == true )
     {
+        OE_START_TIMER(shareState);
+
         // Common state set cache?
         osg::ref_ptr<StateSetCache> sscache;
         if ( sharedCX.getSession() )
@@ -541,6 +752,8 @@ GeometryCompiler::compile(FeatureList&          workingSet,
             sscache->optimize( resultGroup.get() );
         }
 
+        times.add( STAGE_SHARE_STATE, OE_GET_TIMER(shareState) );
+
         if ( trackHistory ) history.push_back( "share state" );
     }
 
@@ -548,6 +761,8 @@ GeometryCompiler::compile(FeatureList&          workingSet,
     {
         OE_DEBUG << LC << "optimize begin" << std::endl;
 
+        OE_START_TIMER(optimize);
+
         // Run the optimizer on the resulting graph
         int optimizations =
             osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS |
@@ -566,6 +781,8 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         mg.setTargetMaximumNumberOfVertices(65536);
         resultGroup->accept(mg);
 
+        times.add( STAGE_OPTIMIZE, OE_GET_TIMER(optimize) );
+
         OE_DEBUG << LC << "optimize complete" << std::endl;
 
         if ( trackHistory ) history.push_back( "optimize" );
@@ -576,20 +793,18 @@ GeometryCompiler::compile(FeatureList&          workingSet,
     //OE_WARN << "Writing GC node file to out.osgt..." << std::endl;
     //osgDB::writeNodeFile( *(resultGroup.get()), "out.osgt" );
 
-#ifdef PROFILING
-    static double totalTime = 0.0;
-    static Threading::Mutex totalTimeMutex;
-    osg::Timer_t p_end = osg::Timer::instance()->tick();
-    double t = osg::Timer::instance()->delta_s(p_start, p_end);
-    totalTimeMutex.lock();
-    totalTime += t;
-    totalTimeMutex.unlock();
-    OE_INFO << LC
-        << "features = " << p_features
-        << ", time = " << t << " s.  cummulative = " 
-        << totalTime << " s."
-        << std::endl;
-#endif
+    times.record();
+
+    static bool s_profile = ::getenv("OSGEARTH_GEOMETRY_COMPILER_PROFILE") != 0L;
+    if ( s_profile )
+    {
+        OE_INFO << LC
+            << "features = " << numFeatures
+            << ", partitions = " << numPartitions
+            << ", time = " << std::fixed << std::setprecision(1) << (OE_GET_TIMER(compile) * 1000.0) << "ms"
+            << ", filters:" << times.str()
+            << std::endl;
+    }
 
 
     if ( _options.validate() == true )
@@ -22,6 +22,7 @@
 
 #include <osgEarth/GeometryUtils>
 #include <osgEarth/OgrUtils>
+#include <osgEarth/GeoJSON>
 
 using namespace osgEarth;
 
@@ -46,33 +47,15 @@ osgEarth::GeometryUtils::geometryToWKT( const Geometry* geometry )
 std::string 
 osgEarth::GeometryUtils::geometryToGeoJSON( const Geometry* geometry )
 {
-    OGRGeometryH g = OgrUtils::createOgrGeometry( geometry );
-    std::string result;
-    if (g)
-    {
-        char* buf;   
-        buf = OGR_G_ExportToJson( g );
-        if (buf)
-        {
-            result = std::string(buf);
-            OGRFree( buf );
-        }
-        OGR_G_DestroyGeometry( g );
-    }
-    return result;
+    return Util::GeoJSONWriter::toGeoJSON( geometry );
 }
 
 Geometry*
 osgEarth::GeometryUtils::geometryFromGeoJSON(const std::string& geojson, bool rewindPolygons)
 {
-    Geometry* result = 0L;
-    OGRGeometryH g = OGR_G_CreateGeometryFromJson(geojson.c_str());
-    if ( g )
-    {
-        result = OgrUtils::createGeometry( g, rewindPolygons);
-        OGR_G_DestroyGeometry( g );
-    }
-    return result;
+    Util::GeoJSONReader reader;
+    reader.setRewindPolygons( rewindPolygons );
+    return reader.readGeometry( geojson );
 }
 
 std::string 
@@ -20,6 +20,7 @@
 
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/CullingUtils>
+#include <osgEarth/BufferPool>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -514,7 +515,7 @@ HeightFieldUtils::createReferenceHeightField(const GeoExtent& ex,
                                              unsigned         border,
                                              bool             expressAsHAE)
 {
-    osg::HeightField* hf = new osg::HeightField();
+    PooledHeightField* hf = new PooledHeightField();
 
     hf->allocate( numCols + 2*border, numRows + 2*border );
 
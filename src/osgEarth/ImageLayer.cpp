@@ -23,6 +23,8 @@
 #include <osgEarth/Capabilities>
 #include <osgEarth/Metrics>
 #include <osgEarth/NetworkMonitor>
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/Containers>
 #include <cinttypes>
 
 using namespace osgEarth;
@@ -37,6 +39,73 @@ using namespace OpenThreads;
 #define OE_TEXCOMP_NONE    (osg::Texture::USE_IMAGE_DATA_FORMAT)
 #define OE_TEXCOMP_AUTO    ((osg::Texture::InternalFormatMode)(~0))
 #define OE_TEXCOMP_FASTDXT ((osg::Texture::InternalFormatMode)(~0 - 1))
+#define OE_TEXCOMP_BCN     ((osg::Texture::InternalFormatMode)(~0 - 2))
+
+namespace
+{
+    using namespace osgEarth::Util;
+
+    // Per-layer metrics, looked up in the registry once when the layer opens
+    // since building the labels and finding the metric on every tile adds up.
+    struct LayerMetrics : public osg::Referenced
+    {
+        LayerMetrics(const std::string& layerName)
+        {
+            MetricsRegistry* registry = MetricsRegistry::instance();
+
+            MetricsRegistry::Labels labels;
+            labels.push_back(std::make_pair("layer", layerName));
+
+            _misses = registry->counter(
+                "osgearth_layer_cache_misses_total",
+                "Layer tiles not found in any cache", labels);
+
+            _fetchTime = registry->histogram(
+                "osgearth_layer_fetch_seconds",
+                "Time spent fetching and decoding a tile from the layer source", labels);
+
+            _fallbacks = registry->counter(
+                "osgearth_layer_fallback_images_total",
+                "Placeholder tiles synthesized from a cached ancestor", labels);
+
+            labels.push_back(std::make_pair("cache", std::string("memory")));
+            _memoryHits = registry->counter(
+                "osgearth_layer_cache_hits_total",
+                "Layer tiles served from a cache", labels);
+
+            labels.back().second = "bin";
+            _binHits = registry->counter(
+                "osgearth_layer_cache_hits_total",
+                "Layer tiles served from a cache", labels);
+        }
+
+        MetricsRegistry::Counter* _memoryHits;
+        MetricsRegistry::Counter* _binHits;
+        MetricsRegistry::Counter* _misses;
+        MetricsRegistry::Counter* _fallbacks;
+        MetricsRegistry::Histogram* _fetchTime;
+    };
+
+    void count(MetricsRegistry::Counter* counter)
+    {
+        if (counter)
+            counter->add();
+    }
+
+    // Recently created tiles, keyed by revision, tile key and profile, that
+    // createFallbackImage() can upsample from.
+    struct AncestorCache : public osg::Referenced
+    {
+        AncestorCache(unsigned size) : _lru(true, size) { }
+
+        static std::string key(int revision, const TileKey& key)
+        {
+            return Stringify() << revision << "/" << key.str() << "/" << key.getProfile()->getHorizSignature();
+        }
+
+        LRUCache<std::string, GeoImage> _lru;
+    };
+}
 
 //------------------------------------------------------------------------
 
@@ -51,6 +120,7 @@ ImageLayer::Options::fromConfig(const Config& conf)
     _shared.setDefault( false );
     _coverage.setDefault( false );
     _reprojectedTileSize.setDefault( 256 );
+    _ancestorCacheSize.setDefault( 32u );
 
     conf.get( "nodata_image",   _noDataImageFilename );
     conf.get( "shared",         _shared );
@@ -59,6 +129,7 @@ ImageLayer::Options::fromConfig(const Config& conf)
     conf.get( "altitude",       _altitude );
     conf.get( "edge_buffer_ratio", _edgeBufferRatio);
     conf.get( "reprojected_tilesize", _reprojectedTileSize);
+    conf.get( "ancestor_cache_size", _ancestorCacheSize);
 
     if ( conf.hasValue( "transparent_color" ) )
         _transparentColor = stringToColor( conf.value( "transparent_color" ), osg::Vec4ub(0,0,0,0));
@@ -87,6 +158,7 @@ ImageLayer::Options::fromConfig(const Config& conf)
     conf.get("texture_compression", "on",   _textureCompression, OE_TEXCOMP_AUTO);
     conf.get("texture_compression", "fastdxt", _textureCompression, OE_TEXCOMP_FASTDXT);
     conf.get("texture_compression", "dxt", _textureCompression, OE_TEXCOMP_FASTDXT);
+    conf.get("texture_compression", "bcn", _textureCompression, OE_TEXCOMP_BCN);
 
     // uniform names
     conf.get("shared_sampler", _shareTexUniformName);
@@ -105,6 +177,7 @@ ImageLayer::Options::getConfig() const
     conf.set( "altitude",       _altitude );
     conf.set( "edge_buffer_ratio", _edgeBufferRatio);
     conf.set( "reprojected_tilesize", _reprojectedTileSize);
+    conf.set( "ancestor_cache_size", _ancestorCacheSize);
 
     if (_transparentColor.isSet())
         conf.set("transparent_color", colorToString( _transparentColor.value()));
@@ -135,6 +208,7 @@ ImageLayer::Options::getConfig() const
     conf.set("texture_compression", "auto", _textureCompression, OE_TEXCOMP_AUTO);
     conf.set("texture_compression", "fastdxt", _textureCompression, OE_TEXCOMP_FASTDXT);
     conf.set("texture_compression", "dxt", _textureCompression, OE_TEXCOMP_FASTDXT);
+    conf.set("texture_compression", "bcn", _textureCompression, OE_TEXCOMP_BCN);
 
     // uniform names
     conf.set("shared_sampler", _shareTexUniformName);
@@ -224,6 +298,13 @@ ImageLayer::openImplementation()
     if (!options().shareTexMatUniformName().isSet() )
         options().shareTexMatUniformName().init(Stringify() << options().shareTexUniformName().get() << "_matrix");
 
+    if (options().ancestorCacheSize().get() > 0u)
+        _ancestorCache = new AncestorCache(options().ancestorCacheSize().get());
+    else
+        _ancestorCache = 0L;
+
+    _metrics = new LayerMetrics(getName());
+
     return Status::NoError;
 }
 
@@ -349,8 +430,11 @@ ImageLayer::createImage(const TileKey&    key,
 }
 
 GeoImage
-ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progress)
+ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progress, bool* out_final)
 {
+    if (out_final)
+        *out_final = true;
+
     // If the layer is disabled, bail out.
     if ( !isOpen() )
     {
@@ -366,6 +450,8 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
 
     GeoImage result;
 
+    const LayerMetrics* metrics = static_cast<const LayerMetrics*>(_metrics.get());
+
     OE_DEBUG << LC << "create image for \"" << key.str() << "\", ext= "
         << key.getExtent().toString() << std::endl;
 
@@ -377,6 +463,14 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
     // The L2 cache key includes the layer revision of course!
     char memCacheKey[64];
 
+    // Only tiles known to be final may feed the ancestor cache, or
+    // createFallbackImage() would upsample placeholders from placeholders.
+    // Tiles in the layer's own profile are never synthesized, so cache hits
+    // for them qualify; an assembled tile qualifies only when it is fresh
+    // and complete.
+    const bool nativeProfile = getProfile() && key.getProfile()->isHorizEquivalentTo(getProfile());
+    bool isFinal = true;
+
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
 
     // Check the layer L2 cache first
@@ -391,7 +485,11 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         ReadResult result = bin->readObject(memCacheKey, 0L);
         if (result.succeeded())
         {
-            return GeoImage(static_cast<osg::Image*>(result.releaseObject()), key.getExtent());
+            count(metrics ? metrics->_memoryHits : 0L);
+            GeoImage image(static_cast<osg::Image*>(result.releaseObject()), key.getExtent());
+            if (nativeProfile)
+                cacheAncestor(key, image);
+            return image;
         }
     }
 
@@ -420,7 +518,11 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
             if (!expired)
             {
                 OE_DEBUG << "Got cached image for " << key.str() << std::endl;
-                return GeoImage( cachedImage.get(), key.getExtent() );
+                count(metrics ? metrics->_binHits : 0L);
+                GeoImage image( cachedImage.get(), key.getExtent() );
+                if (nativeProfile)
+                    cacheAncestor(key, image);
+                return image;
             }
             else
             {
@@ -435,6 +537,8 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         // If it's cache only and we have an expired but cached image, just return it.
         if (cachedImage.valid())
         {
+            if (out_final)
+                *out_final = false;
             return GeoImage( cachedImage.get(), key.getExtent() );
         }
         else
@@ -443,14 +547,19 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         }
     }
 
-    if (key.getProfile()->isHorizEquivalentTo(getProfile()))
+    count(metrics ? metrics->_misses : 0L);
+
+    if (nativeProfile)
     {
+        MetricsRegistry::ScopedTimer timer(metrics ? metrics->_fetchTime : 0L);
         result = createImageImplementation(key, progress);
     }
     else
     {
         // If the profiles are different, use a compositing method to assemble the tile.
-        result = assembleImage( key, progress );
+        result = assembleImage( key, progress, &isFinal );
+        if (out_final)
+            *out_final = isFinal;
     }
 
     // Check for cancelation before writing to a cache:
@@ -463,6 +572,8 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
     if (result.valid())
     {
         invoke_onCreate(key, result);
+        if (isFinal)
+            cacheAncestor(key, result);
     }
 
     // memory cache first:
@@ -498,6 +609,8 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
         {
             OE_DEBUG << LC << "Using cached but expired image for " << key.str() << std::endl;
             result = GeoImage( cachedImage.get(), key.getExtent());
+            if (out_final)
+                *out_final = false;
         }
     }
 
@@ -505,7 +618,7 @@ ImageLayer::createImageInKeyProfile(const TileKey& key, ProgressCallback* progre
 }
 
 GeoImage
-ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress)
+ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress, bool* out_final)
 {
     // If we got here, asset that there's a non-null layer profile.
     if (!getProfile())
@@ -543,7 +656,10 @@ ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress)
 
         for( std::vector<TileKey>::iterator k = intersectingKeys.begin(); k != intersectingKeys.end(); ++k )
         {
-            GeoImage image = createImageInKeyProfile(*k, progress);
+            bool isFinal = true;
+            GeoImage image = createImageInKeyProfile(*k, progress, &isFinal);
+            if (out_final && !isFinal)
+                *out_final = false;
 
             if ( image.valid() )
             {
@@ -595,9 +711,29 @@ ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress)
         // fall back on a lower resolution.
         // So now we go through the failed keys and try to fall back on lower resolution data
         // to fill in the gaps. The entire mosaic must be populated or this qualifies as a bad tile.
+        if (out_final && !failedKeys.empty())
+            *out_final = false;
+
         for(std::vector<TileKey>::iterator k = failedKeys.begin(); k != failedKeys.end(); ++k)
         {
-            GeoImage image;
+            // Fast path: upsample a resident ancestor with no I/O at all.
+            GeoImage image = createFallbackImage( *k );
+            if ( image.valid() )
+            {
+                if ( !isCoverage() &&
+                     ((image.getImage()->getDataType() != GL_UNSIGNED_BYTE) ||
+                      (image.getImage()->getPixelFormat() != GL_RGBA)) )
+                {
+                    osg::ref_ptr<osg::Image> convertedImg = ImageUtils::convertToRGBA8(image.getImage());
+                    if (convertedImg.valid())
+                    {
+                        image = GeoImage(convertedImg.get(), image.getExtent());
+                    }
+                }
+
+                mosaic.getImages().push_back( TileImage(image.getImage(), *k) );
+                continue;
+            }
 
             for(TileKey parentKey = k->createParentKey();
                 parentKey.valid() && !image.valid();
@@ -606,6 +742,9 @@ ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress)
                 image = createImageImplementation( parentKey, progress );
                 if ( image.valid() )
                 {
+                    // so the sibling tiles can fall back on it without another read.
+                    cacheAncestor( parentKey, image );
+
                     GeoImage cropped;
 
                     if ( !isCoverage() )
@@ -689,6 +828,71 @@ ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress)
     return result;
 }
 
+GeoImage
+ImageLayer::createFallbackImage(const TileKey& key) const
+{
+    if (!_ancestorCache.valid() || !key.valid())
+        return GeoImage::INVALID;
+
+    AncestorCache* cache = static_cast<AncestorCache*>(_ancestorCache.get());
+    const LayerMetrics* metrics = static_cast<const LayerMetrics*>(_metrics.get());
+
+    LRUCache<std::string, GeoImage>::Record rec;
+    for(TileKey parentKey = key.createParentKey();
+        parentKey.valid();
+        parentKey = parentKey.createParentKey())
+    {
+        if (!cache->_lru.get(AncestorCache::key(getRevision(), parentKey), rec))
+            continue;
+
+        const GeoImage& ancestor = rec.value();
+        const osg::Image* image = ancestor.getImage();
+        const GeoExtent& a = ancestor.getExtent();
+        const GeoExtent& e = key.getExtent();
+
+        // The key's window within the ancestor, in normalized coordinates;
+        // coverage data must not be blended, so sample it unfiltered.
+        osg::ref_ptr<osg::Image> result = ImageUtils::cropAndResizeImage(
+            image,
+            (e.xMin() - a.xMin()) / a.width(),
+            (e.yMin() - a.yMin()) / a.height(),
+            (e.xMax() - a.xMin()) / a.width(),
+            (e.yMax() - a.yMin()) / a.height(),
+            image->s(), image->t(),
+            !isCoverage());
+
+        if (!result.valid())
+            return GeoImage::INVALID;
+
+        count(metrics ? metrics->_fallbacks : 0L);
+        return GeoImage(result.get(), e);
+    }
+
+    return GeoImage::INVALID;
+}
+
+void
+ImageLayer::cacheAncestor(const TileKey& key, const GeoImage& image) const
+{
+    if (_ancestorCache.valid() && image.valid())
+    {
+        AncestorCache* cache = static_cast<AncestorCache*>(_ancestorCache.get());
+        cache->_lru.insert(AncestorCache::key(getRevision(), key), image);
+    }
+}
+
+void
+ImageLayer::setAncestorCacheSize(unsigned value)
+{
+    options().ancestorCacheSize() = value;
+}
+
+unsigned
+ImageLayer::getAncestorCacheSize() const
+{
+    return options().ancestorCacheSize().get();
+}
+
 Status
 ImageLayer::writeImage(const TileKey& key, const osg::Image* image, ProgressCallback* progress)
 {
@@ -741,38 +945,35 @@ ImageLayer::applyTextureCompressionMode(osg::Texture* tex) const
     else if ( options().textureCompression() == OE_TEXCOMP_FASTDXT )
     {
         osg::Timer_t start = osg::Timer::instance()->tick();
-        osgDB::ImageProcessor* imageProcessor = osgDB::Registry::instance()->getImageProcessorForExtension("fastdxt");
-        if (imageProcessor)
+        osg::Image* image = tex->getImage(0);
+        if (image && !ImageUtils::isCompressed(image) && compressWithFastDXT(image))
         {
-            osg::Texture::InternalFormatMode mode;
-            // RGB uses DXT1
-            if (tex->getImage(0)->getPixelFormat() == GL_RGB)
-            {
-                mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
-            }
-            // RGBA uses DXT5
-            else if (tex->getImage(0)->getPixelFormat() == GL_RGBA)
-            {
-                mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
-            }
-            else
-            {
-                OE_DEBUG << "FastDXT only works on GL_RGBA or GL_RGB images" << std::endl;
-                return;
-            }
-
-            osg::Image *image = tex->getImage(0);
-            imageProcessor->compress(*image, mode, false, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
-            osg::Timer_t end = osg::Timer::instance()->tick();
             image->dirty();
             tex->setImage(0, image);
-            OE_DEBUG << "Compress took " << osg::Timer::instance()->delta_m(start, end) << std::endl;
+            OE_DEBUG << "Compress took " << osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) << std::endl;
         }
-        else
+    }
+    else if ( options().textureCompression() == OE_TEXCOMP_BCN )
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        osg::Image* image = tex->getImage(0);
+        if (image && !ImageUtils::isCompressed(image))
         {
-            OE_WARN << "Failed to get ImageProcessor fastdxt" << std::endl;
+            // Build the compressed mipmap chain here, if the texture wants one,
+            // so we don't pay for a second mipmapping pass later.
+            osg::Texture::FilterMode minFilter = tex->getFilter(osg::Texture::MIN_FILTER);
+            bool mipmap =
+                minFilter != osg::Texture::LINEAR &&
+                minFilter != osg::Texture::NEAREST &&
+                ImageUtils::isPowerOfTwo(image);
+
+            if (compressWithBCn(image, mipmap))
+            {
+                image->dirty();
+                tex->setImage(0, image);
+                OE_DEBUG << "Compress took " << osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) << std::endl;
+            }
         }
-
     }
     else if ( options().textureCompression().isSet() )
     {
@@ -782,6 +983,203 @@ ImageLayer::applyTextureCompressionMode(osg::Texture* tex) const
 }
 
 
+bool
+ImageLayer::compressWithBCn(osg::Image* image, bool mipmap) const
+{
+    osgDB::ImageProcessor* imageProcessor = osgDB::Registry::instance()->getImageProcessorForExtension("bcn");
+    if (!imageProcessor)
+    {
+        OE_WARN << "Failed to get ImageProcessor bcn" << std::endl;
+        return false;
+    }
+
+    osg::Texture::InternalFormatMode mode;
+    switch (image->getPixelFormat())
+    {
+    case GL_RGB:
+        mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
+        break;
+    case GL_RGBA:
+        mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
+        break;
+    case GL_RED:
+    case GL_LUMINANCE:
+        mode = osg::Texture::USE_RGTC1_COMPRESSION;
+        break;
+    case GL_RG:
+        mode = osg::Texture::USE_RGTC2_COMPRESSION;
+        break;
+    default:
+        OE_DEBUG << "BCn does not support pixel format " << image->getPixelFormat() << std::endl;
+        return false;
+    }
+
+    imageProcessor->compress(*image, mode, mipmap, false, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
+    return ImageUtils::isCompressed(image);
+}
+
+bool
+ImageLayer::compressWithFastDXT(osg::Image* image) const
+{
+    osgDB::ImageProcessor* imageProcessor = osgDB::Registry::instance()->getImageProcessorForExtension("fastdxt");
+    if (!imageProcessor)
+    {
+        OE_WARN << "Failed to get ImageProcessor fastdxt" << std::endl;
+        return false;
+    }
+
+    osg::Texture::InternalFormatMode mode;
+    // RGB uses DXT1
+    if (image->getPixelFormat() == GL_RGB)
+    {
+        mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
+    }
+    // RGBA uses DXT5
+    else if (image->getPixelFormat() == GL_RGBA)
+    {
+        mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
+    }
+    else
+    {
+        OE_DEBUG << "FastDXT only works on GL_RGBA or GL_RGB images" << std::endl;
+        return false;
+    }
+
+    imageProcessor->compress(*image, mode, false, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
+    return ImageUtils::isCompressed(image);
+}
+
+osg::Image*
+ImageLayer::createGPUReadyImage(const osg::Image* input) const
+{
+    // never modify the input; it may live in the L2 cache.
+    osg::ref_ptr<osg::Image> image = new osg::Image(*input, osg::CopyOp::DEEP_COPY_ALL);
+
+    // Coverages and 3D images are never compressed or mipmapped.
+    if (isCoverage() || image->r() > 1 || ImageUtils::isCompressed(image.get()))
+    {
+        return image.release();
+    }
+
+    osg::Texture::FilterMode minFilter = options().minFilter().get();
+    bool mipmap =
+        minFilter != osg::Texture::LINEAR &&
+        minFilter != osg::Texture::NEAREST &&
+        ImageUtils::isPowerOfTwo(image.get());
+
+    // Only the BCn compressor can run ahead of time, since it is the only one
+    // that compresses a mipmap chain. FastDXT drops the mipmaps, and with "auto"
+    // or an explicit GL format the driver compresses on upload (see
+    // applyTextureCompressionMode), so those images stay uncompressed here.
+    bool compressed = false;
+    if (options().textureCompression() == OE_TEXCOMP_BCN)
+    {
+        compressed = compressWithBCn(image.get(), mipmap);
+    }
+
+    if (!compressed && mipmap)
+    {
+        ImageUtils::generateMipmaps(image.get());
+    }
+
+    return image.release();
+}
+
+GeoImage
+ImageLayer::createGPUReadyImage(const TileKey& key, ProgressCallback* progress)
+{
+    const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
+
+    if (policy.gpuReady() != true || isCoverage())
+    {
+        return createImage(key, progress);
+    }
+
+    OE_PROFILING_ZONE;
+    OE_PROFILING_ZONE_TEXT(getName());
+
+    if (!isOpen() || !isKeyInLegalRange(key))
+    {
+        return GeoImage::INVALID;
+    }
+
+    NetworkMonitor::ScopedRequestLayer layerRequest(getName());
+
+    const LayerMetrics* metrics = static_cast<const LayerMetrics*>(_metrics.get());
+
+    // GPU-ready payloads live alongside the raw images under their own prefix,
+    // so other consumers of createImage() still get uncompressed pixels.
+    std::string cacheKey = Cache::makeCacheKey(
+        Stringify() << key.str() << "-" << std::hex << key.getProfile()->getHorizSignature(),
+        "gpu");
+
+    // Check the layer L2 cache first
+    char memCacheKey[64];
+    if (_memCache.valid())
+    {
+        sprintf(memCacheKey, "gpu/%d/%s/%s",
+            getRevision(),
+            key.str().c_str(),
+            key.getProfile()->getHorizSignature().c_str());
+
+        CacheBin* bin = _memCache->getOrCreateDefaultBin();
+        ReadResult r = bin->readObject(memCacheKey, 0L);
+        if (r.succeeded())
+        {
+            count(metrics ? metrics->_memoryHits : 0L);
+            return GeoImage(static_cast<osg::Image*>(r.releaseObject()), key.getExtent());
+        }
+    }
+
+    CacheBin* cacheBin = getCacheBin(key.getProfile());
+
+    if (cacheBin && policy.isCacheReadable())
+    {
+        ReadResult r = cacheBin->readImage(cacheKey, 0L);
+        if (r.succeeded() && !policy.isExpired(r.lastModifiedTime()))
+        {
+            count(metrics ? metrics->_binHits : 0L);
+            GeoImage image(r.releaseImage(), key.getExtent());
+            if (_memCache.valid())
+            {
+                _memCache->getOrCreateDefaultBin()->write(memCacheKey, image.getImage(), 0L);
+            }
+            return image;
+        }
+    }
+
+    bool isFinal = true;
+    GeoImage raw = createImageInKeyProfile(key, progress, &isFinal);
+    if (!raw.valid())
+    {
+        return raw;
+    }
+
+    osg::ref_ptr<osg::Image> gpuImage = createGPUReadyImage(raw.getImage());
+
+    if (progress && progress->isCanceled())
+    {
+        return GeoImage::INVALID;
+    }
+
+    // An expired image, or one filled in from a fallback key, is only a
+    // placeholder; caching it would keep it from ever being replaced.
+    if (isFinal)
+    {
+        if (_memCache.valid())
+        {
+            _memCache->getOrCreateDefaultBin()->write(memCacheKey, gpuImage.get(), 0L);
+        }
+
+        if (cacheBin && policy.isCacheWriteable())
+        {
+            cacheBin->write(cacheKey, gpuImage.get(), 0L);
+        }
+    }
+
+    return GeoImage(gpuImage.get(), raw.getExtent());
+}
+
 void
 ImageLayer::modifyTileBoundingBox(const TileKey& key, osg::BoundingBox& box) const
 {
@@ -18,6 +18,7 @@
  */
 
 #include <osgEarth/ImageMosaic>
+#include <osgEarth/BufferPool>
 
 #define LC "[ImageMosaic] "
 
@@ -106,7 +107,7 @@ ImageMosaic::createImage()
     unsigned int pixelsHigh = tilesHigh * tileHeight;
 	unsigned int tileDepth = tile->_image->r();
 
-    osg::ref_ptr<osg::Image> image = new osg::Image;
+    osg::ref_ptr<PooledImage> image = new PooledImage();
     image->allocateImage(pixelsWide, pixelsHigh, tileDepth, tile->_image->getPixelFormat(), tile->_image->getDataType());
     image->setInternalTextureFormat(tile->_image->getInternalTextureFormat());
 
@@ -106,6 +106,13 @@ ImageToFeatureSource::addedToMap(const Map* map)
     FeatureSource::addedToMap(map);
 }
 
+void
+ImageToFeatureSource::getLayerReferences(std::vector<std::string>& names) const
+{
+    FeatureSource::getLayerReferences(names);
+    options().image().getLayerName(names);
+}
+
 void
 ImageToFeatureSource::removedFromMap(const Map* map)
 {
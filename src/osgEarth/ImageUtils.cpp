@@ -42,6 +42,833 @@
 using namespace osgEarth;
 using namespace osgEarth::Util;
 
+//------------------------------------------------------------------------
+
+// Format-specialized pixel kernels.
+//
+// PixelReader/PixelWriter convert every sample to a Vec4f through a
+// function pointer, which dominates the cost of the per-tile operations
+// below. For the formats that make up nearly all terrain tiles (RGBA8,
+// RGB8, R32F and RG16) the loops are instead instantiated per format,
+// with SSE2 paths for RGBA8. Each kernel reproduces the arithmetic of the
+// generic path exactly, so results do not depend on which path ran.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define OE_IMAGEUTILS_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+namespace
+{
+    bool s_pixelKernelsEnabled = true;
+
+    // ColorReader/ColorWriter scale for normalized unsigned bytes
+    const double s_byteScale = 1.0/255.0;
+
+    enum PixelKernelFormat
+    {
+        KERNEL_NONE,
+        KERNEL_RGBA8,
+        KERNEL_RGB8,
+        KERNEL_R32F,
+        KERNEL_RG16
+    };
+
+    PixelKernelFormat getKernelFormat(const osg::Image* image)
+    {
+        if (!s_pixelKernelsEnabled || !image || !image->data())
+            return KERNEL_NONE;
+
+        GLenum pf = image->getPixelFormat();
+        GLenum dt = image->getDataType();
+
+        if (dt == GL_UNSIGNED_BYTE && pf == GL_RGBA)
+            return KERNEL_RGBA8;
+        if (dt == GL_UNSIGNED_BYTE && pf == GL_RGB)
+            return KERNEL_RGB8;
+        if (dt == GL_FLOAT && (pf == GL_RED || pf == GL_LUMINANCE))
+            return KERNEL_R32F;
+        if (dt == GL_UNSIGNED_SHORT && pf == GL_RG)
+            return KERNEL_RG16;
+
+        return KERNEL_NONE;
+    }
+
+    // Per-format conversions to and from the Vec4f that PixelReader and
+    // PixelWriter would produce/consume.
+    struct RGBA8
+    {
+        typedef GLubyte T;
+        enum { N = 4 };
+        static inline void read(const T* p, float* c) {
+            c[0] = (float)p[0]/255.0f; c[1] = (float)p[1]/255.0f;
+            c[2] = (float)p[2]/255.0f; c[3] = (float)p[3]/255.0f;
+        }
+        static inline void write(const float* c, T* p) {
+            p[0] = (T)(c[0]/s_byteScale); p[1] = (T)(c[1]/s_byteScale);
+            p[2] = (T)(c[2]/s_byteScale); p[3] = (T)(c[3]/s_byteScale);
+        }
+        static inline float alpha(const T* p) { return (float)p[3]/255.0f; }
+    };
+
+    struct RGB8
+    {
+        typedef GLubyte T;
+        enum { N = 3 };
+        static inline void read(const T* p, float* c) {
+            c[0] = (float)p[0]/255.0f; c[1] = (float)p[1]/255.0f;
+            c[2] = (float)p[2]/255.0f; c[3] = 1.0f;
+        }
+        static inline void write(const float* c, T* p) {
+            p[0] = (T)(c[0]/s_byteScale); p[1] = (T)(c[1]/s_byteScale); p[2] = (T)(c[2]/s_byteScale);
+        }
+        static inline float alpha(const T*) { return 1.0f; }
+    };
+
+    struct R32F
+    {
+        typedef GLfloat T;
+        enum { N = 1 };
+        static inline void read(const T* p, float* c) {
+            c[0] = c[1] = c[2] = p[0]; c[3] = 1.0f;
+        }
+        static inline void write(const float* c, T* p) {
+            p[0] = c[0];
+        }
+        static inline float alpha(const T*) { return 1.0f; }
+    };
+
+    struct RG16
+    {
+        typedef GLushort T;
+        enum { N = 2 };
+        static inline void read(const T* p, float* c) {
+            c[0] = (float)p[0]; c[1] = (float)p[1]; c[2] = 0.0f; c[3] = 1.0f;
+        }
+        static inline void write(const float* c, T* p) {
+            p[0] = (T)((double)c[0]); p[1] = (T)((double)c[1]);
+        }
+        static inline float alpha(const T*) { return 1.0f; }
+    };
+
+    // Pixel addressing for one mip level, matching PixelWriter::data().
+    struct Plane
+    {
+        unsigned char* _data;
+        unsigned _colBytes, _rowBytes, _imageBytes;
+
+        Plane(const osg::Image* image, int m =0)
+        {
+            _data = const_cast<unsigned char*>(m == 0 ? image->data() : image->getMipmapData(m));
+            _colBytes = image->getPixelSizeInBits() / 8;
+            _rowBytes = image->getRowStepInBytes() >> m;
+            _imageBytes = image->getImageSizeInBytes() >> m;
+        }
+
+        template<typename T> T* row(int t, int r) const {
+            return (T*)(_data + t*_rowBytes + r*_imageBytes);
+        }
+
+        template<typename T> T* at(int s, int t, int r) const {
+            return (T*)(_data + s*_colBytes + t*_rowBytes + r*_imageBytes);
+        }
+    };
+
+    template<typename F>
+    inline void copyPixel(const typename F::T* from, typename F::T* to)
+    {
+        for (int k = 0; k < F::N; ++k)
+            to[k] = from[k];
+    }
+
+    template<typename F>
+    inline bool samePixel(const typename F::T* a, const typename F::T* b)
+    {
+        return ::memcmp(a, b, sizeof(typename F::T) * F::N) == 0;
+    }
+
+    // Calls op.run<F>() for the kernel format "f".
+    template<typename OP>
+    bool dispatch(PixelKernelFormat f, OP& op)
+    {
+        switch (f)
+        {
+        case KERNEL_RGBA8: op.template run<RGBA8>(); return true;
+        case KERNEL_RGB8:  op.template run<RGB8>();  return true;
+        case KERNEL_R32F:  op.template run<R32F>();  return true;
+        case KERNEL_RG16:  op.template run<RG16>();  return true;
+        default: return false;
+        }
+    }
+
+    template<typename OP, typename S>
+    bool dispatchSecond(PixelKernelFormat d, OP& op)
+    {
+        switch (d)
+        {
+        case KERNEL_RGBA8: op.template run<S, RGBA8>(); return true;
+        case KERNEL_RGB8:  op.template run<S, RGB8>();  return true;
+        case KERNEL_R32F:  op.template run<S, R32F>();  return true;
+        case KERNEL_RG16:  op.template run<S, RG16>();  return true;
+        default: return false;
+        }
+    }
+
+    // Calls op.run<S,D>() for the kernel formats "s" and "d".
+    template<typename OP>
+    bool dispatch(PixelKernelFormat s, PixelKernelFormat d, OP& op)
+    {
+        switch (s)
+        {
+        case KERNEL_RGBA8: return dispatchSecond<OP, RGBA8>(d, op);
+        case KERNEL_RGB8:  return dispatchSecond<OP, RGB8>(d, op);
+        case KERNEL_R32F:  return dispatchSecond<OP, R32F>(d, op);
+        case KERNEL_RG16:  return dispatchSecond<OP, RG16>(d, op);
+        default: return false;
+        }
+    }
+
+#ifdef OE_IMAGEUTILS_SSE2
+    inline __m128 loadRGBA8(const GLubyte* p)
+    {
+        int bits;
+        ::memcpy(&bits, p, 4);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero);
+        return _mm_div_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(255.0f));
+    }
+
+    // Same as RGBA8::write: divide by the scale in double precision and truncate.
+    inline void storeRGBA8(__m128 c, GLubyte* p)
+    {
+        const __m128d scale = _mm_set1_pd(s_byteScale);
+        __m128i lo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtps_pd(c), scale));
+        __m128i hi = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtps_pd(_mm_movehl_ps(c, c)), scale));
+        __m128i v = _mm_unpacklo_epi64(lo, hi);
+        v = _mm_packs_epi32(v, v);
+        v = _mm_packus_epi16(v, v);
+        int bits = _mm_cvtsi128_si32(v);
+        ::memcpy(p, &bits, 4);
+    }
+
+    inline __m128 lerp(__m128 a, __m128 b, __m128 w0, __m128 w1)
+    {
+        return _mm_add_ps(_mm_mul_ps(a, w0), _mm_mul_ps(b, w1));
+    }
+#endif
+
+    //....................................................................
+    // resizeImage
+
+    // Source sample positions along one axis; same arithmetic as the
+    // generic loop in resizeImage.
+    struct Tap
+    {
+        int   i0, i1;   // bilinear neighbors (min, max)
+        float w0, w1;   // bilinear weights for i0, i1
+        bool  same;     // i0 == i1
+        int   nearest;  // nearest neighbor
+    };
+
+    void computeTaps(unsigned in_n, unsigned out_n, std::vector<Tap>& taps)
+    {
+        taps.resize(out_n);
+        for (unsigned o = 0; o < out_n; ++o)
+        {
+            float ratio = (float)o/(float)out_n;
+            float in = ratio * (float)in_n;
+            if ( in >= (int)in_n ) in = in_n-1;
+            else if ( in < 0 ) in = 0.0f;
+
+            Tap& tap = taps[o];
+            tap.i0 = osg::maximum((int)floor(in), 0);
+            tap.i1 = osg::maximum(osg::minimum((int)ceil(in), (int)(in_n-1)), 0);
+            if (tap.i0 > tap.i1) tap.i0 = tap.i1;
+            tap.same = tap.i0 == tap.i1;
+            tap.w0 = (float)((double)tap.i1 - in);
+            tap.w1 = (float)(in - (double)tap.i0);
+
+            tap.nearest = (in-(int)in) <= (ceil(in)-in) ?
+                (int)in :
+                osg::minimum( 1+(int)in, (int)in_n-1 );
+        }
+    }
+
+    template<typename F>
+    void bilinearRow(const typename F::T* row0, const typename F::T* row1, const Tap& ty,
+                     const std::vector<Tap>& cols, typename F::T* out)
+    {
+        const int N = F::N;
+        float a[4], b[4], c[4], d[4], r1[4], r2[4], color[4];
+
+        for (unsigned x = 0; x < cols.size(); ++x)
+        {
+            const Tap& tx = cols[x];
+            if (tx.same && ty.same)
+            {
+                copyPixel<F>(row1 + tx.i1*N, out + x*N);
+                continue;
+            }
+            else if (tx.same)
+            {
+                F::read(row0 + tx.i0*N, a);
+                F::read(row1 + tx.i0*N, b);
+                for (int k = 0; k < 4; ++k)
+                    color[k] = a[k]*ty.w0 + b[k]*ty.w1;
+            }
+            else if (ty.same)
+            {
+                F::read(row0 + tx.i0*N, a);
+                F::read(row0 + tx.i1*N, b);
+                for (int k = 0; k < 4; ++k)
+                    color[k] = a[k]*tx.w0 + b[k]*tx.w1;
+            }
+            else
+            {
+                F::read(row0 + tx.i0*N, a);
+                F::read(row0 + tx.i1*N, b);
+                F::read(row1 + tx.i0*N, c);
+                F::read(row1 + tx.i1*N, d);
+                for (int k = 0; k < 4; ++k)
+                {
+                    r1[k] = a[k]*tx.w0 + b[k]*tx.w1;
+                    r2[k] = c[k]*tx.w0 + d[k]*tx.w1;
+                    color[k] = r1[k]*ty.w0 + r2[k]*ty.w1;
+                }
+            }
+            F::write(color, out + x*N);
+        }
+    }
+
+#ifdef OE_IMAGEUTILS_SSE2
+    template<>
+    void bilinearRow<RGBA8>(const GLubyte* row0, const GLubyte* row1, const Tap& ty,
+                            const std::vector<Tap>& cols, GLubyte* out)
+    {
+        const __m128 tw0 = _mm_set1_ps(ty.w0), tw1 = _mm_set1_ps(ty.w1);
+
+        for (unsigned x = 0; x < cols.size(); ++x)
+        {
+            const Tap& tx = cols[x];
+            const __m128 sw0 = _mm_set1_ps(tx.w0), sw1 = _mm_set1_ps(tx.w1);
+            __m128 color;
+
+            if (tx.same && ty.same)
+            {
+                copyPixel<RGBA8>(row1 + tx.i1*4, out + x*4);
+                continue;
+            }
+            else if (tx.same)
+            {
+                color = lerp(loadRGBA8(row0 + tx.i0*4), loadRGBA8(row1 + tx.i0*4), tw0, tw1);
+            }
+            else if (ty.same)
+            {
+                color = lerp(loadRGBA8(row0 + tx.i0*4), loadRGBA8(row0 + tx.i1*4), sw0, sw1);
+            }
+            else
+            {
+                __m128 r1 = lerp(loadRGBA8(row0 + tx.i0*4), loadRGBA8(row0 + tx.i1*4), sw0, sw1);
+                __m128 r2 = lerp(loadRGBA8(row1 + tx.i0*4), loadRGBA8(row1 + tx.i1*4), sw0, sw1);
+                color = lerp(r1, r2, tw0, tw1);
+            }
+            storeRGBA8(color, out + x*4);
+        }
+    }
+#endif
+
+    struct ResizeOp
+    {
+        const osg::Image* _input;
+        osg::Image* _output;
+        unsigned _out_s, _out_t, _mipmapLevel;
+        bool _bilinear;
+
+        template<typename F>
+        void run()
+        {
+            typedef typename F::T T;
+            const int N = F::N;
+
+            std::vector<Tap> cols, rows;
+            computeTaps(_input->s(), _out_s, cols);
+            computeTaps(_input->t(), _out_t, rows);
+
+            Plane in(_input);
+            Plane out(_output, _mipmapLevel);
+
+            for (int layer = 0; layer < _input->r(); ++layer)
+            {
+                for (unsigned y = 0; y < _out_t; ++y)
+                {
+                    const Tap& ty = rows[y];
+                    T* dst = out.row<T>(y, layer);
+
+                    if (_bilinear)
+                    {
+                        bilinearRow<F>(in.row<T>(ty.i0, layer), in.row<T>(ty.i1, layer), ty, cols, dst);
+                    }
+                    else
+                    {
+                        const T* src = in.row<T>(ty.nearest, layer);
+                        for (unsigned x = 0; x < _out_s; ++x)
+                            copyPixel<F>(src + cols[x].nearest*N, dst + x*N);
+                    }
+                }
+            }
+        }
+    };
+
+    //....................................................................
+    // mix
+
+    struct MixOp
+    {
+        const osg::Image* _src;
+        osg::Image* _dest;
+        float _a;
+        bool _srcHasAlpha, _destHasAlpha;
+
+        template<typename S, typename D>
+        void run()
+        {
+#ifdef OE_IMAGEUTILS_SSE2
+            if (S::N == 4 && D::N == 4 && sizeof(typename S::T) == 1 && sizeof(typename D::T) == 1)
+            {
+                runRGBA8();
+                return;
+            }
+#endif
+            Plane src(_src), dest(_dest);
+            float s[4], d[4];
+
+            for (int r = 0; r < _src->r(); ++r)
+            {
+                for (int t = 0; t < _src->t(); ++t)
+                {
+                    const typename S::T* srow = src.row<typename S::T>(t, r);
+                    typename D::T* drow = dest.row<typename D::T>(t, r);
+
+                    for (int x = 0; x < _src->s(); ++x)
+                    {
+                        S::read(srow + x*S::N, s);
+                        D::read(drow + x*D::N, d);
+
+                        // same as MixImage
+                        float sa = _srcHasAlpha ? _a * s[3] : _a;
+                        float da = _destHasAlpha ? d[3] : 1.0f;
+                        d[0] = d[0]*(1.0f-sa) + s[0]*sa;
+                        d[1] = d[1]*(1.0f-sa) + s[1]*sa;
+                        d[2] = d[2]*(1.0f-sa) + s[2]*sa;
+                        d[3] = osg::maximum(sa, da);
+
+                        D::write(d, drow + x*D::N);
+                    }
+                }
+            }
+        }
+
+#ifdef OE_IMAGEUTILS_SSE2
+        void runRGBA8()
+        {
+            Plane src(_src), dest(_dest);
+
+            for (int r = 0; r < _src->r(); ++r)
+            {
+                for (int t = 0; t < _src->t(); ++t)
+                {
+                    const GLubyte* srow = src.row<GLubyte>(t, r);
+                    GLubyte* drow = dest.row<GLubyte>(t, r);
+
+                    for (int x = 0; x < _src->s(); ++x)
+                    {
+                        __m128 s = loadRGBA8(srow + x*4);
+                        __m128 d = loadRGBA8(drow + x*4);
+
+                        float sa = _srcHasAlpha ? _a * RGBA8::alpha(srow + x*4) : _a;
+                        float da = _destHasAlpha ? RGBA8::alpha(drow + x*4) : 1.0f;
+
+                        __m128 result = lerp(d, s, _mm_set1_ps(1.0f-sa), _mm_set1_ps(sa));
+
+                        float out[4];
+                        _mm_storeu_ps(out, result);
+                        out[3] = osg::maximum(sa, da);
+                        storeRGBA8(_mm_loadu_ps(out), drow + x*4);
+                    }
+                }
+            }
+        }
+#endif
+    };
+
+    //....................................................................
+    // convert
+
+    struct ConvertOp
+    {
+        const osg::Image* _src;
+        osg::Image* _dest;
+
+        template<typename S, typename D>
+        void run()
+        {
+            Plane src(_src), dest(_dest);
+            float c[4];
+
+            for (int r = 0; r < _src->r(); ++r)
+            {
+                for (int t = 0; t < _src->t(); ++t)
+                {
+                    const typename S::T* srow = src.row<typename S::T>(t, r);
+                    typename D::T* drow = dest.row<typename D::T>(t, r);
+
+                    for (int x = 0; x < _src->s(); ++x)
+                    {
+                        S::read(srow + x*S::N, c);
+                        D::write(c, drow + x*D::N);
+                    }
+                }
+            }
+        }
+    };
+
+    //....................................................................
+    // isEmptyImage
+
+    bool isEmptyRGBA8(const osg::Image* image, float alphaThreshold)
+    {
+        // smallest alpha value that exceeds the threshold:
+        int minAlpha = 256;
+        for (int a = 0; a < 256 && minAlpha == 256; ++a)
+            if ((float)a/255.0f > alphaThreshold)
+                minAlpha = a;
+
+        if (minAlpha > 255)
+            return true;
+
+        Plane p(image);
+
+        for (int r = 0; r < image->r(); ++r)
+        {
+            for (int t = 0; t < image->t(); ++t)
+            {
+                const GLubyte* row = p.row<GLubyte>(t, r);
+                int s = 0;
+
+#ifdef OE_IMAGEUTILS_SSE2
+                const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+                __m128i amax = _mm_setzero_si128();
+                for (; s + 4 <= image->s(); s += 4)
+                {
+                    __m128i v = _mm_loadu_si128((const __m128i*)(row + s*4));
+                    amax = _mm_max_epu8(amax, _mm_and_si128(v, alphaMask));
+                }
+                GLubyte lanes[16];
+                _mm_storeu_si128((__m128i*)lanes, amax);
+                if (lanes[3] >= minAlpha || lanes[7] >= minAlpha || lanes[11] >= minAlpha || lanes[15] >= minAlpha)
+                    return false;
+#endif
+                for (; s < image->s(); ++s)
+                {
+                    if (row[s*4+3] >= minAlpha)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    //....................................................................
+    // isSingleColorImage
+
+    struct SingleColorOp
+    {
+        const osg::Image* _image;
+        float _threshold;
+        bool _result;
+
+        template<typename F>
+        void run()
+        {
+            typedef typename F::T T;
+            const int N = F::N;
+
+            Plane p(_image);
+            const T* refPixel = p.row<T>(0, 0);
+            float ref[4], c[4];
+            F::read(refPixel, ref);
+
+            _result = true;
+
+            for (int r = 0; r < _image->r(); ++r)
+            {
+                for (int t = 0; t < _image->t(); ++t)
+                {
+                    const T* row = p.row<T>(t, r);
+                    int s = 0;
+
+#ifdef OE_IMAGEUTILS_SSE2
+                    if (N == 4 && sizeof(T) == 1)
+                    {
+                        // skip runs of pixels that are bitwise equal to the reference
+                        int bits;
+                        ::memcpy(&bits, refPixel, 4);
+                        const __m128i refv = _mm_set1_epi32(bits);
+                        for (; s + 4 <= _image->s(); s += 4)
+                        {
+                            __m128i v = _mm_loadu_si128((const __m128i*)(row + s*4));
+                            if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, refv)) != 0xFFFF)
+                                break;
+                        }
+                    }
+#endif
+                    for (; s < _image->s(); ++s)
+                    {
+                        const T* pixel = row + s*N;
+                        if (samePixel<F>(pixel, refPixel))
+                            continue;
+
+                        F::read(pixel, c);
+                        if (   (fabs(c[0]-ref[0]) > _threshold)
+                            || (fabs(c[1]-ref[1]) > _threshold)
+                            || (fabs(c[2]-ref[2]) > _threshold)
+                            || (fabs(c[3]-ref[3]) > _threshold) )
+                        {
+                            _result = false;
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    //....................................................................
+    // featherAlphaRegions
+
+    // Since reading and writing a pixel of a kernel format is lossless,
+    // "write(read(n))" becomes a plain copy.
+    struct FeatherOp
+    {
+        osg::Image* _image;
+        float _maxAlpha;
+
+        template<typename F>
+        void run()
+        {
+            typedef typename F::T T;
+
+            Plane p(_image);
+            int ns = _image->s();
+            int nt = _image->t();
+            int nr = _image->r();
+
+            for( int r=0; r<nr; ++r )
+            {
+                for( int t=0; t<nt; ++t )
+                {
+                    bool rowdone = false;
+                    for( int s=0; s<ns && !rowdone; ++s )
+                    {
+                        T* pixel = p.at<T>(s, t, r);
+                        if ( F::alpha(pixel) <= _maxAlpha )
+                        {
+                            bool wrote = false;
+                            if ( s < ns-1 ) {
+                                const T* n = p.at<T>(s+1, t, r);
+                                if ( F::alpha(n) > _maxAlpha ) {
+                                    copyPixel<F>(n, pixel);
+                                    wrote = true;
+                                }
+                            }
+                            if ( !wrote && s > 0 ) {
+                                const T* n = p.at<T>(s-1, t, r);
+                                if ( F::alpha(n) > _maxAlpha ) {
+                                    copyPixel<F>(n, pixel);
+                                    rowdone = true;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                for( int s=0; s<ns; ++s )
+                {
+                    bool coldone = false;
+                    for( int t=0; t<nt && !coldone; ++t )
+                    {
+                        T* pixel = p.at<T>(s, t, r);
+                        if ( F::alpha(pixel) <= _maxAlpha )
+                        {
+                            bool wrote = false;
+                            if ( t < nt-1 ) {
+                                const T* n = p.at<T>(s, t+1, r);
+                                if ( F::alpha(n) > _maxAlpha ) {
+                                    copyPixel<F>(n, pixel);
+                                    wrote = true;
+                                }
+                            }
+                            if ( !wrote && t > 0 ) {
+                                const T* n = p.at<T>(s, t-1, r);
+                                if ( F::alpha(n) > _maxAlpha ) {
+                                    copyPixel<F>(n, pixel);
+                                    coldone = true;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    //....................................................................
+    // bicubicUpsample
+
+    struct BicubicOp
+    {
+        const osg::Image* _source;
+        osg::Image* _target;
+        unsigned _quadrant, _stride;
+
+        template<typename F>
+        void run()
+        {
+            typedef typename F::T T;
+
+            const int border = 1;
+            const int stride = (int)_stride;
+
+            int width = ((_source->s() - 2*border)/2)+1 + 2*border;
+            int height = ((_source->t() - 2*border)/2)+1 + 2*border;
+
+            int s_off = _quadrant == 0 || _quadrant == 2 ? 0 : _source->s()-width;
+            int t_off = _quadrant == 2 || _quadrant == 3 ? 0 : _source->t()-height;
+
+            Plane src(_source), dst(_target);
+            const int ts = _target->s(), tt = _target->t();
+
+            // copy the main box, which is all odd-numbered cells when there is a border size = 1.
+            for (int t = 1; t<height-1; ++t)
+                for (int s = 1; s<width-1; ++s)
+                    copyPixel<F>(src.at<T>(s_off+s, t_off+t, 0), dst.at<T>((s-1)*2+1, (t-1)*2+1, 0));
+
+            // copy the corner border cells.
+            copyPixel<F>(src.at<T>(s_off, t_off, 0), dst.at<T>(0, 0, 0));
+            copyPixel<F>(src.at<T>(s_off + width - 1, t_off, 0), dst.at<T>(ts-1, 0, 0));
+            copyPixel<F>(src.at<T>(s_off, t_off + height - 1, 0), dst.at<T>(0, tt-1, 0));
+            copyPixel<F>(src.at<T>(s_off + width - 1, t_off + height - 1, 0), dst.at<T>(ts-1, tt-1, 0));
+
+            // copy the border intermediate cells.
+            for (int s=1; s<width-1; ++s)
+            {
+                copyPixel<F>(src.at<T>(s_off+s, t_off, 0), dst.at<T>((s-1)*2+1, 0, 0));
+                copyPixel<F>(src.at<T>(s_off+s, t_off + height - 1, 0), dst.at<T>((s-1)*2+1, tt-1, 0));
+            }
+            for (int t = 1; t < height-1; ++t)
+            {
+                copyPixel<F>(src.at<T>(s_off, t_off+t, 0), dst.at<T>(0, (t-1)*2+1, 0));
+                copyPixel<F>(src.at<T>(s_off + width - 1, t_off + t, 0), dst.at<T>(ts-1, (t-1)*2+1, 0));
+            }
+
+            float p1[4], p2[4], v[4];
+
+            // now interpolate the missing columns, including the border cells.
+            for (int s = 2; s<ts-2; s += 2)
+            {
+                int offset = (s-1) % stride;
+                int s0 = osg::maximum(s - offset, 0);
+                int s1 = osg::minimum(s0 + stride, ts-1);
+                double mu = (double)offset / (double)(s1-s0);
+                double mu2 = (1.0 - cos(mu*osg::PI))*0.5;
+                float w0 = (float)(1.0-mu2), w1 = (float)mu2;
+
+                for (int t = 0; t < tt; )
+                {
+                    F::read(dst.at<T>(s0, t, 0), p1);
+                    F::read(dst.at<T>(s1, t, 0), p2);
+                    for (int k = 0; k < 4; ++k)
+                        v[k] = (p1[k]*w0) + (p2[k]*w1);
+                    F::write(v, dst.at<T>(s, t, 0));
+
+                    if (t == 0 || t == tt-2) t+=1; else t+=2;
+                }
+            }
+
+            // next interpolate the odd numbered rows
+            for (int s = 0; s < ts;)
+            {
+                for (int t = 2; t<tt-2; t += 2)
+                {
+                    int offset = (t-1) % stride;
+                    int t0 = osg::maximum(t - offset, 0);
+                    int t1 = osg::minimum(t0 + stride, tt-1);
+                    double mu = (double)offset / double(t1-t0);
+                    double mu2 = (1.0 - cos(mu*osg::PI))*0.5;
+
+                    F::read(dst.at<T>(s, t0, 0), p1);
+                    F::read(dst.at<T>(s, t1, 0), p2);
+                    for (int k = 0; k < 4; ++k)
+                        v[k] = (p1[k]*(float)(1.0-mu2)) + (p2[k]*(float)mu2);
+                    F::write(v, dst.at<T>(s, t, 0));
+                }
+
+                if (s == 0 || s == ts-2) s+=1; else s+=2;
+            }
+
+            float v1[4], v2[4];
+
+            // then interpolate the centers
+            for (int s = 2; s<ts-2; s += 2)
+            {
+                int s_offset = (s-1) % stride;
+                int s0 = osg::maximum(s - s_offset, 0);
+                int s1 = osg::minimum(s0 + stride, ts-1);
+                double smu = (double)s_offset / (double)(s1-s0);
+                double smu2 = (1.0 - cos(smu*osg::PI))*0.5;
+
+                for (int t = 2; t<tt-2; t += 2)
+                {
+                    int t_offset = (t-1) % stride;
+                    int t0 = osg::maximum(t - t_offset, 0);
+                    int t1 = osg::minimum(t0 + stride, tt-1);
+                    double tmu = (double)t_offset / (double)(t1-t0);
+                    double tmu2 = (1.0 - cos(tmu*osg::PI))*0.5;
+
+                    F::read(dst.at<T>(s0, t, 0), p1);
+                    F::read(dst.at<T>(s1, t, 0), p2);
+                    for (int k = 0; k < 4; ++k)
+                        v1[k] = (p1[k]*(float)(1.0-smu2)) + (p2[k]*(float)smu2);
+
+                    F::read(dst.at<T>(s, t0, 0), p1);
+                    F::read(dst.at<T>(s, t1, 0), p2);
+                    for (int k = 0; k < 4; ++k)
+                        v2[k] = (p1[k]*(float)(1.0-tmu2)) + (p2[k]*(float)tmu2);
+
+                    for (int k = 0; k < 4; ++k)
+                        v[k] = (v1[k]+v2[k])*0.5f;
+
+                    F::write(v, dst.at<T>(s, t, 0));
+                }
+            }
+        }
+    };
+}
+
+bool
+ImageUtils::setPixelKernelsEnabled(bool value)
+{
+    bool old = s_pixelKernelsEnabled;
+    s_pixelKernelsEnabled = value;
+    return old;
+}
+
+bool
+ImageUtils::getPixelKernelsEnabled()
+{
+    return s_pixelKernelsEnabled;
+}
+
 
 osg::Image*
 ImageUtils::cloneImage( const osg::Image* input )
@@ -215,6 +1042,17 @@ ImageUtils::resizeImage(const osg::Image* input,
     }
     else
     {
+        PixelKernelFormat kernel = getKernelFormat(input);
+        if (kernel != KERNEL_NONE &&
+            kernel == getKernelFormat(output.get()) &&
+            output->r() >= input->r() &&
+            (mipmapLevel == 0 || output->getMipmapData(mipmapLevel) != 0L))
+        {
+            ResizeOp op = { input, output.get(), out_s, out_t, mipmapLevel, bilinear };
+            dispatch(kernel, op);
+            return true;
+        }
+
         PixelReader read( input );
         PixelWriter write( output.get() );
 
@@ -302,6 +1140,67 @@ ImageUtils::resizeImage(const osg::Image* input,
     return true;
 }
 
+osg::Image*
+ImageUtils::cropAndResizeImage(const osg::Image* input,
+                               double u0, double v0, double u1, double v1,
+                               unsigned int out_s, unsigned int out_t,
+                               bool bilinear)
+{
+    if ( !input || out_s == 0 || out_t == 0 || u1 <= u0 || v1 <= v0 )
+        return 0L;
+
+    if ( !PixelReader::supports(input) )
+    {
+        OE_WARN << LC << "cropAndResizeImage: unsupported format" << std::endl;
+        return 0L;
+    }
+
+    osg::ref_ptr<osg::Image> output = new osg::Image();
+
+    if ( PixelWriter::supports(input) )
+    {
+        output->allocateImage( out_s, out_t, input->r(), input->getPixelFormat(), input->getDataType(), input->getPacking() );
+        output->setInternalTextureFormat( input->getInternalTextureFormat() );
+    }
+    else
+    {
+        // for unsupported write formats, convert to normalized RGBA8 automatically.
+        output->allocateImage( out_s, out_t, input->r(), GL_RGBA, GL_UNSIGNED_BYTE );
+        output->setInternalTextureFormat( GL_RGB8A_INTERNAL );
+    }
+
+    PixelReader read( input );
+    read.setBilinear( bilinear );
+    read.setSampleAsTexture( true );
+
+    PixelWriter write( output.get() );
+
+    // sample each output pixel center directly from the source window,
+    // so the crop and the resample happen in one pass.
+    const double du = (u1 - u0) / (double)out_s;
+    const double dv = (v1 - v0) / (double)out_t;
+
+    osg::Vec4f color;
+
+    for( unsigned int output_row = 0; output_row < out_t; ++output_row )
+    {
+        double v = v0 + ((double)output_row + 0.5) * dv;
+
+        for( unsigned int output_col = 0; output_col < out_s; ++output_col )
+        {
+            double u = u0 + ((double)output_col + 0.5) * du;
+
+            for(int layer = 0; layer < input->r(); ++layer)
+            {
+                read( color, u, v, layer );
+                write( color, output_col, output_row, layer );
+            }
+        }
+    }
+
+    return output.release();
+}
+
 bool
 ImageUtils::flattenImage(osg::Image*                             input,
                          std::vector<osg::ref_ptr<osg::Image> >& output)
@@ -339,6 +1238,14 @@ ImageUtils::bicubicUpsample(const osg::Image* source,
                             unsigned quadrant,
                             unsigned stride)
 {
+    PixelKernelFormat kernel = getKernelFormat(source);
+    if (kernel != KERNEL_NONE && kernel == getKernelFormat(target))
+    {
+        BicubicOp op = { source, target, quadrant, stride };
+        dispatch(kernel, op);
+        return true;
+    }
+
     const int border = 1; // don't change this.
 
     int width = ((source->s() - 2*border)/2)+1 + 2*border;
@@ -753,6 +1660,15 @@ ImageUtils::mix(osg::Image* dest, const osg::Image* src, float a)
         return false;
     }
 
+    PixelKernelFormat srcKernel = getKernelFormat(src);
+    PixelKernelFormat destKernel = getKernelFormat(dest);
+    if (srcKernel != KERNEL_NONE && destKernel != KERNEL_NONE)
+    {
+        MixOp op = { src, dest, osg::clampBetween(a, 0.0f, 1.0f), hasAlphaChannel(src), hasAlphaChannel(dest) };
+        dispatch(srcKernel, destKernel, op);
+        return true;
+    }
+
     PixelVisitor<MixImage> mixer;
     mixer._a = osg::clampBetween( a, 0.0f, 1.0f );
     mixer._srcHasAlpha = hasAlphaChannel(src); //src->getPixelSizeInBits() == 32;
@@ -901,6 +1817,9 @@ ImageUtils::isEmptyImage(const osg::Image* image, float alphaThreshold)
     if ( !hasAlphaChannel(image) || !PixelReader::supports(image) )
         return false;
 
+    if (getKernelFormat(image) == KERNEL_RGBA8)
+        return isEmptyRGBA8(image, alphaThreshold);
+
     PixelReader read(image);
     for(unsigned r=0; r<(unsigned)image->r(); ++r)
     {
@@ -934,6 +1853,14 @@ ImageUtils::isSingleColorImage(const osg::Image* image, float threshold)
     if ( !PixelReader::supports(image) )
         return false;
 
+    PixelKernelFormat kernel = getKernelFormat(image);
+    if (kernel != KERNEL_NONE)
+    {
+        SingleColorOp op = { image, threshold, true };
+        dispatch(kernel, op);
+        return op._result;
+    }
+
     PixelReader read(image);
 
     osg::Vec4 referenceColor = read(0, 0, 0);
@@ -1144,6 +2071,15 @@ ImageUtils::convert(const osg::Image* image, GLenum pixelFormat, GLenum dataType
     else
         result->setInternalTextureFormat( pixelFormat );
 
+    PixelKernelFormat srcKernel = getKernelFormat(image);
+    PixelKernelFormat destKernel = getKernelFormat(result);
+    if (srcKernel != KERNEL_NONE && destKernel != KERNEL_NONE)
+    {
+        ConvertOp op = { image, result };
+        dispatch(srcKernel, destKernel, op);
+        return result;
+    }
+
     PixelVisitor<CopyImage>().accept( image, result );
 
     return result;
@@ -1259,6 +2195,14 @@ ImageUtils::featherAlphaRegions(osg::Image* image, float maxAlpha)
     if ( !PixelReader::supports(image) || !PixelWriter::supports(image) )
         return false;
 
+    PixelKernelFormat kernel = getKernelFormat(image);
+    if (kernel != KERNEL_NONE)
+    {
+        FeatherOp op = { image, maxAlpha };
+        dispatch(kernel, op);
+        return true;
+    }
+
     PixelReader read (image);
     PixelWriter write(image);
 
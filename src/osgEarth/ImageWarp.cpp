@@ -0,0 +1,769 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ImageWarp>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/Containers>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/Notify>
+#include <OpenThreads/Thread>
+#include <cmath>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define OE_IMAGEWARP_SSE2 1
+#  include <emmintrin.h>
+#endif
+
+#define LC "[ImageWarp] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    double   s_maxError = 0.125;
+    unsigned s_maxCachedGrids = 128u;
+    unsigned s_numThreads = 0u; // 0 = number of processors
+
+    // grid spacing (in destination pixels) to try first
+    const unsigned INITIAL_STEP = 32u;
+
+    // don't bother with threads for images smaller than this
+    const unsigned MIN_PIXELS_TO_PARALLELIZE = 128u * 128u;
+
+    // fewest rows worth handing to a thread
+    const unsigned MIN_ROWS_PER_PART = 16u;
+
+    inline bool isFinite(double v)
+    {
+        return v == v && v != HUGE_VAL && v != -HUGE_VAL;
+    }
+
+    //....................................................................
+
+    /**
+     * Source-SRS coordinates for a lattice of destination pixel centers.
+     * Node i along an axis sits on pixel min(i*step, size-1); values in
+     * between are bilinearly interpolated.
+     */
+    struct WarpGrid : public osg::Referenced
+    {
+        unsigned _step;
+        unsigned _nx, _ny;
+        std::vector<double> _x, _y;
+        std::vector<unsigned char> _valid; // per node; empty if all are valid
+        double _errorX, _errorY;           // max interpolation error (source units)
+
+        unsigned pos(unsigned i, unsigned size) const {
+            return osg::minimum(i*_step, size-1);
+        }
+    };
+
+    struct GridKey
+    {
+        SpatialReference::Key _src, _dest;
+        double _xmin, _ymin, _xmax, _ymax;
+        unsigned _width, _height;
+
+        bool operator < (const GridKey& rhs) const {
+            if (_width != rhs._width) return _width < rhs._width;
+            if (_height != rhs._height) return _height < rhs._height;
+            if (_xmin != rhs._xmin) return _xmin < rhs._xmin;
+            if (_ymin != rhs._ymin) return _ymin < rhs._ymin;
+            if (_xmax != rhs._xmax) return _xmax < rhs._xmax;
+            if (_ymax != rhs._ymax) return _ymax < rhs._ymax;
+            if (_src < rhs._src) return true;
+            if (rhs._src < _src) return false;
+            return _dest < rhs._dest;
+        }
+    };
+
+    typedef LRUCache<GridKey, osg::ref_ptr<WarpGrid> > GridCache;
+
+    GridCache& gridCache()
+    {
+        static GridCache s_cache(true, 128u);
+        return s_cache;
+    }
+
+    // Transforms "points" from destSRS into srcSRS in place. If some points
+    // fail and "valid" is given, fills it in per point and returns false.
+    bool transformPoints(
+        const SpatialReference* destSRS,
+        const SpatialReference* srcSRS,
+        std::vector<osg::Vec3d>& points,
+        std::vector<unsigned char>* valid)
+    {
+        std::vector<osg::Vec3d> input;
+        if (valid)
+            input = points;
+
+        bool ok = destSRS->transform(points, srcSRS);
+        for (unsigned i = 0; ok && i < points.size(); ++i)
+            ok = isFinite(points[i].x()) && isFinite(points[i].y());
+
+        if (ok || !valid)
+            return ok;
+
+        valid->assign(points.size(), 1);
+        for (unsigned i = 0; i < input.size(); ++i)
+        {
+            osg::Vec3d out;
+            if (destSRS->transform(input[i], srcSRS, out) && isFinite(out.x()) && isFinite(out.y()))
+                points[i] = out;
+            else
+                (*valid)[i] = 0;
+        }
+        return false;
+    }
+
+    // Builds a grid whose interpolation error is within the tolerances,
+    // halving the node spacing until it is (or until every pixel is a node).
+    WarpGrid* buildGrid(
+        const GeoExtent& destExtent,
+        const SpatialReference* srcSRS,
+        unsigned width, unsigned height,
+        double tolX, double tolY)
+    {
+        const SpatialReference* destSRS = destExtent.getSRS();
+        const double dx = destExtent.width() / (double)width;
+        const double dy = destExtent.height() / (double)height;
+        const double x0 = destExtent.xMin() + 0.5*dx;
+        const double y0 = destExtent.yMin() + 0.5*dy;
+
+        osg::ref_ptr<WarpGrid> grid = new WarpGrid();
+
+        // the error is measured at cell centers, which needs cells in both directions
+        unsigned step = width > 1u && height > 1u ? INITIAL_STEP : 1u;
+
+        while (true)
+        {
+            grid->_step = step;
+            grid->_nx = (width - 1 + step - 1) / step + 1;
+            grid->_ny = (height - 1 + step - 1) / step + 1;
+            grid->_valid.clear();
+
+            std::vector<osg::Vec3d> nodes;
+            nodes.reserve(grid->_nx * grid->_ny);
+            for (unsigned j = 0; j < grid->_ny; ++j)
+                for (unsigned i = 0; i < grid->_nx; ++i)
+                    nodes.push_back(osg::Vec3d(x0 + dx*grid->pos(i, width), y0 + dy*grid->pos(j, height), 0.0));
+
+            bool allValid = transformPoints(destSRS, srcSRS, nodes, step == 1u ? &grid->_valid : 0L);
+
+            if (!allValid && step > 1u)
+            {
+                // part of the extent doesn't map into the source SRS;
+                // interpolation is meaningless there, so go per-pixel.
+                step = 1u;
+                continue;
+            }
+
+            grid->_x.resize(nodes.size());
+            grid->_y.resize(nodes.size());
+            for (unsigned n = 0; n < nodes.size(); ++n)
+            {
+                grid->_x[n] = nodes[n].x();
+                grid->_y[n] = nodes[n].y();
+            }
+
+            grid->_errorX = grid->_errorY = 0.0;
+            if (step == 1u)
+                break;
+
+            // Measure the interpolation error at the center of each cell.
+            std::vector<osg::Vec3d> centers;
+            centers.reserve((grid->_nx-1) * (grid->_ny-1));
+            for (unsigned j = 0; j+1 < grid->_ny; ++j)
+            {
+                double cy = 0.5*(grid->pos(j, height) + grid->pos(j+1, height));
+                for (unsigned i = 0; i+1 < grid->_nx; ++i)
+                {
+                    double cx = 0.5*(grid->pos(i, width) + grid->pos(i+1, width));
+                    centers.push_back(osg::Vec3d(x0 + dx*cx, y0 + dy*cy, 0.0));
+                }
+            }
+
+            if (!transformPoints(destSRS, srcSRS, centers, 0L))
+            {
+                step = 1u;
+                continue;
+            }
+
+            unsigned c = 0;
+            for (unsigned j = 0; j+1 < grid->_ny; ++j)
+            {
+                for (unsigned i = 0; i+1 < grid->_nx; ++i, ++c)
+                {
+                    unsigned n00 = j*grid->_nx + i, n10 = n00 + 1;
+                    unsigned n01 = n00 + grid->_nx, n11 = n01 + 1;
+                    double ix = 0.25*(grid->_x[n00] + grid->_x[n10] + grid->_x[n01] + grid->_x[n11]);
+                    double iy = 0.25*(grid->_y[n00] + grid->_y[n10] + grid->_y[n01] + grid->_y[n11]);
+                    grid->_errorX = osg::maximum(grid->_errorX, fabs(ix - centers[c].x()));
+                    grid->_errorY = osg::maximum(grid->_errorY, fabs(iy - centers[c].y()));
+                }
+            }
+
+            if (grid->_errorX <= tolX && grid->_errorY <= tolY)
+                break;
+
+            step /= 2u;
+        }
+
+        OE_DEBUG << LC << "Built " << grid->_nx << "x" << grid->_ny << " warp grid (step "
+            << grid->_step << ") for " << width << "x" << height << std::endl;
+
+        return grid.release();
+    }
+
+    //....................................................................
+
+    /**
+     * Samples destination rows from the source image using a warp grid.
+     * Safe to call rows() from several threads on disjoint row ranges.
+     */
+    class Warper
+    {
+    public:
+        Warper(
+            const osg::Image* image,
+            const GeoExtent& srcExtent,
+            ImageWarp::PixelRegistration registration,
+            const WarpGrid* grid,
+            bool bilinear,
+            osg::Image* result) :
+            _image(image),
+            _grid(grid),
+            _bilinear(bilinear),
+            _result(result)
+        {
+            _width = result->s();
+            _height = result->t();
+
+            // source SRS -> source pixel coordinates:
+            if (registration == ImageWarp::PIXEL_IS_POINT)
+            {
+                _xfac = (double)(image->s() - 1) / srcExtent.width();
+                _yfac = (double)(image->t() - 1) / srcExtent.height();
+                _xoff = _yoff = 0.0;
+            }
+            else
+            {
+                _xfac = (double)image->s() / srcExtent.width();
+                _yfac = (double)image->t() / srcExtent.height();
+                _xoff = _yoff = -0.5;
+            }
+            _srcXMin = srcExtent.xMin();
+            _srcYMin = srcExtent.yMin();
+
+            // valid pixel-space range equals the source extent's bounds:
+            _pxMin = _xoff;
+            _pxMax = srcExtent.width() * _xfac + _xoff;
+            _pyMin = _yoff;
+            _pyMax = srcExtent.height() * _yfac + _yoff;
+
+            GLenum dt = image->getDataType();
+            unsigned comps = osg::Image::computeNumComponents(image->getPixelFormat());
+            unsigned pixelBytes = image->getPixelSizeInBits() / 8;
+
+            if (dt == GL_UNSIGNED_BYTE && comps >= 1 && comps <= 4 && pixelBytes == comps)
+                _format = comps;
+            else if (dt == GL_FLOAT && comps == 1 && pixelBytes == 4)
+                _format = FORMAT_FLOAT;
+            else
+                _format = FORMAT_GENERIC;
+        }
+
+        void rows(unsigned begin, unsigned end)
+        {
+            std::vector<float> sx(_width), sy(_width);
+            std::vector<unsigned char> mask(_width);
+
+            for (unsigned row = begin; row < end; ++row)
+            {
+                if (!computeRow(row, &sx[0], &sy[0], &mask[0]))
+                    continue;
+
+                for (int layer = 0; layer < _image->r(); ++layer)
+                {
+                    switch (_format)
+                    {
+                    case 1: sampleBytes<1>(row, layer, &sx[0], &sy[0], &mask[0]); break;
+                    case 2: sampleBytes<2>(row, layer, &sx[0], &sy[0], &mask[0]); break;
+                    case 3: sampleBytes<3>(row, layer, &sx[0], &sy[0], &mask[0]); break;
+                    case 4: sampleBytes<4>(row, layer, &sx[0], &sy[0], &mask[0]); break;
+                    case FORMAT_FLOAT: sampleFloat(row, layer, &sx[0], &sy[0], &mask[0]); break;
+                    default: sampleGeneric(row, layer, &sx[0], &sy[0], &mask[0]); break;
+                    }
+                }
+            }
+        }
+
+    private:
+        enum { FORMAT_FLOAT = 5, FORMAT_GENERIC = 6 };
+
+        // Interpolates source pixel coordinates for every pixel in a row.
+        // Returns false if no pixel in the row has a source sample.
+        bool computeRow(unsigned row, float* sx, float* sy, unsigned char* mask) const
+        {
+            const WarpGrid& g = *_grid;
+            const unsigned nx = g._nx;
+
+            if (g._step == 1u)
+            {
+                // Every pixel is a node, so there is nothing to interpolate,
+                // and a failed node is exactly a failed pixel. (Failed nodes
+                // hold no usable coordinates, so they must never be blended.)
+                const double* x = &g._x[row*nx];
+                const double* y = &g._y[row*nx];
+                const unsigned char* valid = g._valid.empty() ? 0L : &g._valid[row*nx];
+
+                bool any = false;
+                for (unsigned col = 0; col < _width; ++col)
+                {
+                    if (valid && valid[col] == 0)
+                    {
+                        mask[col] = 0;
+                        sx[col] = sy[col] = 0.0f;
+                        continue;
+                    }
+                    any = store(col,
+                        (x[col] - _srcXMin) * _xfac + _xoff,
+                        (y[col] - _srcYMin) * _yfac + _yoff,
+                        sx, sy, mask) || any;
+                }
+                return any;
+            }
+
+            // Coarser grids only exist when every node transformed.
+            unsigned j = osg::minimum(row / g._step, g._ny > 1 ? g._ny - 2 : 0u);
+            double fy = 0.0;
+            if (g._ny > 1)
+            {
+                unsigned y0 = g.pos(j, _height), y1 = g.pos(j+1, _height);
+                fy = (double)(row - y0) / (double)(y1 - y0);
+            }
+
+            // interpolate the two node rows, then convert to pixel space
+            // (the conversion is affine, so it commutes with interpolation)
+            std::vector<double> px(nx), py(nx);
+            const double* x0 = &g._x[j*nx];
+            const double* y0 = &g._y[j*nx];
+            const double* x1 = g._ny > 1 ? x0 + nx : x0;
+            const double* y1 = g._ny > 1 ? y0 + nx : y0;
+            for (unsigned i = 0; i < nx; ++i)
+            {
+                px[i] = ((x0[i] + (x1[i] - x0[i])*fy) - _srcXMin) * _xfac + _xoff;
+                py[i] = ((y0[i] + (y1[i] - y0[i])*fy) - _srcYMin) * _yfac + _yoff;
+            }
+
+            bool any = false;
+            for (unsigned col = 0; col < _width; ++col)
+            {
+                double x, y;
+                if (nx > 1)
+                {
+                    unsigned i = osg::minimum(col / g._step, nx - 2);
+                    unsigned c0 = g.pos(i, _width), c1 = g.pos(i+1, _width);
+                    double fx = (double)(col - c0) / (double)(c1 - c0);
+                    x = px[i] + (px[i+1] - px[i])*fx;
+                    y = py[i] + (py[i+1] - py[i])*fx;
+                }
+                else
+                {
+                    x = px[0];
+                    y = py[0];
+                }
+
+                any = store(col, x, y, sx, sy, mask) || any;
+            }
+            return any;
+        }
+
+        // Records one pixel's source position; returns whether it is in the source.
+        inline bool store(unsigned col, double x, double y, float* sx, float* sy, unsigned char* mask) const
+        {
+            bool ok = x >= _pxMin && x <= _pxMax && y >= _pyMin && y <= _pyMax;
+            mask[col] = ok ? 1 : 0;
+            sx[col] = ok ? (float)osg::clampBetween(x, 0.0, (double)(_image->s() - 1)) : 0.0f;
+            sy[col] = ok ? (float)osg::clampBetween(y, 0.0, (double)(_image->t() - 1)) : 0.0f;
+            return ok;
+        }
+
+        inline void taps(float x, float y, int& x0, int& x1, int& y0, int& y1, float& fx, float& fy) const
+        {
+            x0 = (int)x;
+            y0 = (int)y;
+            x1 = osg::minimum(x0 + 1, _image->s() - 1);
+            y1 = osg::minimum(y0 + 1, _image->t() - 1);
+            fx = x - (float)x0;
+            fy = y - (float)y0;
+        }
+
+        template<int N>
+        void sampleBytes(unsigned row, int layer, const float* sx, const float* sy, const unsigned char* mask)
+        {
+            const unsigned char* src = _image->data(0, 0, layer);
+            const unsigned rowBytes = _image->getRowStepInBytes();
+            unsigned char* out = _result->data(0, row, layer);
+
+            for (unsigned col = 0; col < _width; ++col, out += N)
+            {
+                if (!mask[col])
+                    continue;
+
+                if (!_bilinear)
+                {
+                    int x = (int)(sx[col] + 0.5f), y = (int)(sy[col] + 0.5f);
+                    x = osg::minimum(x, _image->s() - 1);
+                    y = osg::minimum(y, _image->t() - 1);
+                    const unsigned char* p = src + y*rowBytes + x*N;
+                    for (int k = 0; k < N; ++k)
+                        out[k] = p[k];
+                    continue;
+                }
+
+                int x0, x1, y0, y1;
+                float fx, fy;
+                taps(sx[col], sy[col], x0, x1, y0, y1, fx, fy);
+
+                const unsigned char* p00 = src + y0*rowBytes + x0*N;
+                const unsigned char* p10 = src + y0*rowBytes + x1*N;
+                const unsigned char* p01 = src + y1*rowBytes + x0*N;
+                const unsigned char* p11 = src + y1*rowBytes + x1*N;
+
+                float w00 = (1.0f-fx)*(1.0f-fy), w10 = fx*(1.0f-fy);
+                float w01 = (1.0f-fx)*fy,        w11 = fx*fy;
+
+#ifdef OE_IMAGEWARP_SSE2
+                if (N == 4)
+                {
+                    bilinear4(p00, p10, p01, p11, w00, w10, w01, w11, out);
+                    continue;
+                }
+#endif
+                for (int k = 0; k < N; ++k)
+                {
+                    float v = p00[k]*w00 + p10[k]*w10 + p01[k]*w01 + p11[k]*w11;
+                    out[k] = (unsigned char)osg::minimum(v + 0.5f, 255.0f);
+                }
+            }
+        }
+
+#ifdef OE_IMAGEWARP_SSE2
+        static inline __m128 load4(const unsigned char* p)
+        {
+            int bits;
+            ::memcpy(&bits, p, 4);
+            const __m128i zero = _mm_setzero_si128();
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero));
+        }
+
+        static inline void bilinear4(
+            const unsigned char* p00, const unsigned char* p10,
+            const unsigned char* p01, const unsigned char* p11,
+            float w00, float w10, float w01, float w11,
+            unsigned char* out)
+        {
+            __m128 v = _mm_mul_ps(load4(p00), _mm_set1_ps(w00));
+            v = _mm_add_ps(v, _mm_mul_ps(load4(p10), _mm_set1_ps(w10)));
+            v = _mm_add_ps(v, _mm_mul_ps(load4(p01), _mm_set1_ps(w01)));
+            v = _mm_add_ps(v, _mm_mul_ps(load4(p11), _mm_set1_ps(w11)));
+            __m128i i = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+            i = _mm_packs_epi32(i, i);
+            i = _mm_packus_epi16(i, i);
+            int bits = _mm_cvtsi128_si32(i);
+            ::memcpy(out, &bits, 4);
+        }
+#endif
+
+        void sampleFloat(unsigned row, int layer, const float* sx, const float* sy, const unsigned char* mask)
+        {
+            const unsigned char* src = _image->data(0, 0, layer);
+            const unsigned rowBytes = _image->getRowStepInBytes();
+            float* out = (float*)_result->data(0, row, layer);
+
+            for (unsigned col = 0; col < _width; ++col)
+            {
+                if (!mask[col])
+                    continue;
+
+                if (!_bilinear)
+                {
+                    int x = osg::minimum((int)(sx[col] + 0.5f), _image->s() - 1);
+                    int y = osg::minimum((int)(sy[col] + 0.5f), _image->t() - 1);
+                    out[col] = ((const float*)(src + y*rowBytes))[x];
+                    continue;
+                }
+
+                int x0, x1, y0, y1;
+                float fx, fy;
+                taps(sx[col], sy[col], x0, x1, y0, y1, fx, fy);
+
+                const float* r0 = (const float*)(src + y0*rowBytes);
+                const float* r1 = (const float*)(src + y1*rowBytes);
+                const float v[4] = { r0[x0], r0[x1], r1[x0], r1[x1] };
+                float w[4];
+                weights(fx, fy, w);
+
+                // blend only the taps that carry weight and hold data, so a
+                // NaN or no-data neighbour never leaks into a valid sample:
+                float sum = 0.0f, total = 0.0f;
+                for (int k = 0; k < 4; ++k)
+                {
+                    if (w[k] > 0.0f && isValidSample(v[k]))
+                    {
+                        sum += v[k] * w[k];
+                        total += w[k];
+                    }
+                }
+
+                // mostly over missing data: keep the nearest tap, hole and all
+                out[col] = total >= 0.5f ? sum / total : v[nearestTap(w)];
+            }
+        }
+
+        // Bilinear weights of the taps (x0,y0), (x1,y0), (x0,y1), (x1,y1)
+        static inline void weights(float fx, float fy, float* w)
+        {
+            w[0] = (1.0f-fx)*(1.0f-fy);
+            w[1] = fx*(1.0f-fy);
+            w[2] = (1.0f-fx)*fy;
+            w[3] = fx*fy;
+        }
+
+        static inline int nearestTap(const float* w)
+        {
+            int best = 0;
+            for (int k = 1; k < 4; ++k)
+                if (w[k] > w[best])
+                    best = k;
+            return best;
+        }
+
+        static inline bool isValidSample(float v)
+        {
+            return v == v && v != NO_DATA_VALUE;
+        }
+
+        void sampleGeneric(unsigned row, int layer, const float* sx, const float* sy, const unsigned char* mask)
+        {
+            ImageUtils::PixelReader read(_image);
+            ImageUtils::PixelWriter write(_result);
+            osg::Vec4 color, c[4];
+
+            for (unsigned col = 0; col < _width; ++col)
+            {
+                if (!mask[col])
+                    continue;
+
+                if (!_bilinear)
+                {
+                    int x = osg::minimum((int)(sx[col] + 0.5f), _image->s() - 1);
+                    int y = osg::minimum((int)(sy[col] + 0.5f), _image->t() - 1);
+                    read(color, x, y, layer);
+                }
+                else
+                {
+                    int x0, x1, y0, y1;
+                    float fx, fy;
+                    taps(sx[col], sy[col], x0, x1, y0, y1, fx, fy);
+                    read(c[0], x0, y0, layer);
+                    read(c[1], x1, y0, layer);
+                    read(c[2], x0, y1, layer);
+                    read(c[3], x1, y1, layer);
+                    float w[4];
+                    weights(fx, fy, w);
+
+                    // same rules as sampleFloat, per pixel rather than per channel
+                    osg::Vec4 sum;
+                    float total = 0.0f;
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        if (w[k] > 0.0f &&
+                            isValidSample(c[k].r()) && c[k].g() == c[k].g() &&
+                            c[k].b() == c[k].b() && c[k].a() == c[k].a())
+                        {
+                            sum += c[k] * w[k];
+                            total += w[k];
+                        }
+                    }
+                    color = total >= 0.5f ? sum / total : c[nearestTap(w)];
+                }
+                write(color, col, row, layer);
+            }
+        }
+
+        const osg::Image* _image;
+        const WarpGrid*   _grid;
+        bool              _bilinear;
+        osg::Image*       _result;
+        unsigned          _width, _height;
+        unsigned          _format;
+        double            _xfac, _yfac, _xoff, _yoff;
+        double            _srcXMin, _srcYMin;
+        double            _pxMin, _pxMax, _pyMin, _pyMax;
+    };
+
+    //....................................................................
+
+    unsigned resolveNumThreads()
+    {
+        return s_numThreads > 0u ? s_numThreads : (unsigned)osg::maximum(OpenThreads::GetNumberOfProcessors(), 1);
+    }
+}
+
+//........................................................................
+
+osg::Image*
+ImageWarp::warp(const osg::Image* image,
+                const GeoExtent&  srcExtent,
+                const GeoExtent&  destExtent,
+                unsigned          width,
+                unsigned          height,
+                bool              bilinear,
+                PixelRegistration registration)
+{
+    if (!image || !srcExtent.isValid() || !destExtent.isValid() || width == 0 || height == 0)
+        return 0L;
+
+    if (!ImageUtils::PixelReader::supports(image) || !ImageUtils::PixelWriter::supports(image))
+    {
+        OE_WARN << LC << "Unsupported image format" << std::endl;
+        return 0L;
+    }
+
+    // tolerances in source SRS units:
+    double tolX = s_maxError * srcExtent.width() / (double)image->s();
+    double tolY = s_maxError * srcExtent.height() / (double)image->t();
+
+    osg::ref_ptr<WarpGrid> grid;
+
+    GridKey key;
+    key._src = srcExtent.getSRS()->getKey();
+    key._dest = destExtent.getSRS()->getKey();
+    key._xmin = destExtent.xMin(), key._ymin = destExtent.yMin();
+    key._xmax = destExtent.xMax(), key._ymax = destExtent.yMax();
+    key._width = width, key._height = height;
+
+    GridCache& cache = gridCache();
+    if (s_maxCachedGrids > 0u)
+    {
+        GridCache::Record rec;
+        if (cache.get(key, rec) && rec.value()->_errorX <= tolX && rec.value()->_errorY <= tolY)
+            grid = rec.value();
+    }
+
+    if (!grid.valid())
+    {
+        grid = buildGrid(destExtent, srcExtent.getSRS(), width, height, tolX, tolY);
+        if (s_maxCachedGrids > 0u)
+            cache.insert(key, grid);
+    }
+
+    osg::ref_ptr<osg::Image> result = new osg::Image();
+    result->allocateImage(width, height, image->r(), image->getPixelFormat(), image->getDataType(), image->getPacking());
+    result->setInternalTextureFormat(image->getInternalTextureFormat());
+    memset(result->data(), 0, result->getTotalSizeInBytes());
+
+    Warper warper(image, srcExtent, registration, grid.get(), bilinear, result.get());
+
+    unsigned numThreads = resolveNumThreads();
+    unsigned numParts = width*height >= MIN_PIXELS_TO_PARALLELIZE ?
+        Threading::ForkJoin::getNumParts(height, numThreads, MIN_ROWS_PER_PART) : 0u;
+
+    if (numThreads > 1u && numParts > 1u)
+    {
+        // contiguous runs of rows, on the shared fork-join pool:
+        osg::ref_ptr<Threading::ForkJoin> job = new Threading::ForkJoin();
+        for (unsigned p = 0; p < numParts; ++p)
+        {
+            unsigned begin = (unsigned)((size_t)height * p / numParts);
+            unsigned end = (unsigned)((size_t)height * (p + 1) / numParts);
+            job->add([&warper, begin, end]() { warper.rows(begin, end); });
+        }
+        job->run(numThreads);
+    }
+    else
+    {
+        warper.rows(0u, height);
+    }
+
+    return result.release();
+}
+
+void
+ImageWarp::setMaxError(double pixels)
+{
+    s_maxError = osg::maximum(pixels, 0.0);
+}
+
+double
+ImageWarp::getMaxError()
+{
+    return s_maxError;
+}
+
+void
+ImageWarp::setMaxCachedGrids(unsigned value)
+{
+    s_maxCachedGrids = value;
+    if (value > 0u)
+        gridCache().setMaxSize(value);
+    else
+        gridCache().clear();
+}
+
+unsigned
+ImageWarp::getMaxCachedGrids()
+{
+    return s_maxCachedGrids;
+}
+
+void
+ImageWarp::setNumThreads(unsigned value)
+{
+    s_numThreads = value;
+}
+
+unsigned
+ImageWarp::getNumThreads()
+{
+    return resolveNumThreads();
+}
+
+void
+ImageWarp::clearCache()
+{
+    gridCache().clear();
+}
+
+unsigned
+ImageWarp::getCacheQueries()
+{
+    return gridCache().getStats()._queries;
+}
+
+unsigned
+ImageWarp::getCacheHits()
+{
+    CacheStats stats = gridCache().getStats();
+    return (unsigned)(stats._hitRatio * (float)stats._queries + 0.5f);
+}
@@ -24,6 +24,7 @@
 #include <osgEarth/TileKey>
 #include <osgEarth/TerrainResources>
 #include <osg/StateSet>
+#include <osg/Timer>
 
 using namespace osgEarth;
 
@@ -253,6 +254,7 @@ Layer::init()
 {
     _uid = osgEarth::Registry::instance()->createUID();
     _renderType = RENDERTYPE_NONE;
+    _openDuration = 0.0;
     _status.set(Status::ResourceUnavailable, getEnabled() ? "Layer closed" : "Layer disabled");
 
     // For detecting scene graph changes at runtime
@@ -291,8 +293,14 @@ Layer::open()
         getOrCreateStateSet()->setDefine(options().shaderDefine().get());
     }
 
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
     setStatus(openImplementation());
 
+    _openDuration = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+    OE_DEBUG << LC << "Opened in " << (_openDuration*1000.0) << " ms\n";
+
     if (isOpen())
     {
         fireCallback(&LayerCallback::onOpen);
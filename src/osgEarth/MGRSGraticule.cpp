@@ -370,6 +370,13 @@ MGRSGraticule::addedToMap(const Map* map)
     rebuild();
 }
 
+void
+MGRSGraticule::getLayerReferences(std::vector<std::string>& names) const
+{
+    VisibleLayer::getLayerReferences(names);
+    options().styleSheet().getLayerName(names);
+}
+
 void
 MGRSGraticule::removedFromMap(const Map* map)
 {
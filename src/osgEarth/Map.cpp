@@ -19,8 +19,13 @@
 #include <osgEarth/Map>
 #include <osgEarth/MapModelChange>
 #include <osgEarth/Registry>
+#include <osg/Timer>
+#include <algorithm>
+#include <map>
+#include <set>
 
 using namespace osgEarth;
+using namespace osgEarth::Threading;
 
 #define LC "[Map] "
 
@@ -60,6 +65,8 @@ Map::Options::getConfig() const
     conf.set( "elevation_interpolation", "triangulate", elevationInterpolation(), INTERP_TRIANGULATE);
 
     conf.set( "profile_layer", profileLayer() );
+    conf.set( "open_threads",  openThreads() );
+    conf.set( "open_timeout",  openTimeout() );
 
     return conf;
 }
@@ -68,6 +75,8 @@ void
 Map::Options::fromConfig(const Config& conf)
 {
     elevationInterpolation().init(INTERP_BILINEAR);
+    openThreads().init(1u);
+    openTimeout().init(0.0);
     
     conf.get( "name",         name() );
     conf.get( "profile",      profile() );
@@ -87,10 +96,249 @@ Map::Options::fromConfig(const Config& conf)
     conf.get( "elevation_interpolation", "triangulate", elevationInterpolation(), INTERP_TRIANGULATE);
 
     conf.get( "profile_layer", profileLayer() );
+    conf.get( "open_threads",  openThreads() );
+    conf.get( "open_timeout",  openTimeout() );
 }
 
 //...................................................................
 
+/**
+ * Opens a batch of layers on a thread pool, in batch order, never
+ * starting a layer before the layers it references have finished.
+ */
+class Map::OpenJob : public osg::Referenced
+{
+public:
+    enum State { WAITING, RUNNING, DONE };
+
+    OpenJob(const LayerVector& layers) :
+        _layers(layers),
+        _states(layers.size(), WAITING),
+        _joined(layers.size(), false),
+        _deps(layers.size()),
+        _numDone(0u),
+        _start(osg::Timer::instance()->tick())
+    {
+        std::map<std::string, unsigned> names;
+        for (unsigned i = 0; i < _layers.size(); ++i)
+        {
+            const std::string& name = _layers[i]->getName();
+            if (!name.empty() && names.find(name) == names.end())
+                names[name] = i;
+        }
+
+        for (unsigned i = 0; i < _layers.size(); ++i)
+        {
+            std::vector<std::string> refNames;
+            _layers[i]->getLayerReferences(refNames);
+
+            std::set<unsigned> refs;
+            for (unsigned r = 0; r < refNames.size(); ++r)
+            {
+                std::map<std::string, unsigned>::const_iterator n = names.find(refNames[r]);
+                if (n != names.end() && n->second != i)
+                    refs.insert(n->second);
+            }
+            _deps[i].assign(refs.begin(), refs.end());
+        }
+
+        breakCycles();
+    }
+
+    //! Worker that opens layers until none remain
+    struct Worker : public osg::Operation
+    {
+        Worker(OpenJob* job) : osg::Operation("osgEarth.Map.OpenJob", false), _job(job) { }
+        void operator()(osg::Object*) { _job->run(); }
+        osg::ref_ptr<OpenJob> _job;
+    };
+
+    //! Opens layers in the calling thread until there are none left to start.
+    void run()
+    {
+        for (;;)
+        {
+            int i;
+            {
+                ScopedMutexLock lock(_mutex);
+                i = next();
+                if (i < 0)
+                    return;
+                _states[i] = RUNNING;
+            }
+
+            Layer* layer = _layers[i].get();
+            const Status& status = layer->open();
+            if (status.isError())
+            {
+                OE_WARN << LC << "Failed to open layer \"" << layer->getName() << "\" ... " << status.message() << std::endl;
+            }
+            else if (layer->isOpen())
+            {
+                OE_INFO << LC << "Opened layer \"" << layer->getName() << "\" in "
+                    << (layer->getOpenDuration()*1000.0) << " ms" << std::endl;
+            }
+
+            {
+                ScopedMutexLock lock(_mutex);
+                _states[i] = DONE;
+                ++_numDone;
+                _cond.broadcast();
+            }
+        }
+    }
+
+    //! Waits for all layers to finish opening, or until timeout_s elapses
+    //! (0 = no timeout). Returns true if all layers are done.
+    bool wait(double timeout_s)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        ScopedMutexLock lock(_mutex);
+        while (_numDone < _layers.size())
+        {
+            if (timeout_s > 0.0)
+            {
+                double remaining = timeout_s - osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+                if (remaining <= 0.0)
+                    break;
+                _cond.wait(&_mutex, (unsigned long)(remaining*1000.0) + 1u);
+            }
+            else
+            {
+                _cond.wait(&_mutex);
+            }
+        }
+        return _numDone == _layers.size();
+    }
+
+    //! Marks and returns (in batch order) the layers that are done opening
+    //! and whose references have already joined the map.
+    void collectJoinable(std::vector<unsigned>& output)
+    {
+        ScopedMutexLock lock(_mutex);
+        bool progress = true;
+        while (progress)
+        {
+            progress = false;
+            for (unsigned i = 0; i < _layers.size(); ++i)
+            {
+                if (_joined[i] || _states[i] != DONE)
+                    continue;
+
+                bool ready = true;
+                for (unsigned d = 0; d < _deps[i].size() && ready; ++d)
+                    ready = _joined[_deps[i][d]];
+
+                if (ready)
+                {
+                    _joined[i] = true;
+                    output.push_back(i);
+                    progress = true;
+                }
+            }
+        }
+        std::sort(output.begin(), output.end());
+    }
+
+    unsigned getNumUnjoined() const
+    {
+        ScopedMutexLock lock(_mutex);
+        unsigned count = 0u;
+        for (unsigned i = 0; i < _joined.size(); ++i)
+            if (!_joined[i]) ++count;
+        return count;
+    }
+
+    double getElapsedTime() const
+    {
+        return osg::Timer::instance()->delta_s(_start, osg::Timer::instance()->tick());
+    }
+
+    LayerVector _layers;
+    std::vector<State> _states;
+    std::vector<bool> _joined;
+
+private:
+    std::vector<std::vector<unsigned> > _deps;
+    unsigned _numDone;
+    osg::Timer_t _start;
+    mutable Mutex _mutex;
+    OpenThreads::Condition _cond;
+
+    // First waiting layer (in batch order) whose references are all done.
+    // Blocks while the only candidates are waiting on running layers.
+    int next()
+    {
+        for (;;)
+        {
+            bool waiting = false;
+            for (unsigned i = 0; i < _layers.size(); ++i)
+            {
+                if (_states[i] != WAITING)
+                    continue;
+
+                waiting = true;
+
+                bool ready = true;
+                for (unsigned d = 0; d < _deps[i].size() && ready; ++d)
+                    ready = (_states[_deps[i][d]] == DONE);
+
+                if (ready)
+                    return (int)i;
+            }
+
+            if (!waiting)
+                return -1;
+
+            _cond.wait(&_mutex);
+        }
+    }
+
+    // Drop references that would form a cycle so that every layer is
+    // guaranteed to eventually open and join.
+    void breakCycles()
+    {
+        std::vector<bool> resolved(_layers.size(), false);
+        unsigned numResolved = 0u;
+        while (numResolved < _layers.size())
+        {
+            bool progress = false;
+            for (unsigned i = 0; i < _layers.size(); ++i)
+            {
+                if (resolved[i])
+                    continue;
+
+                bool ready = true;
+                for (unsigned d = 0; d < _deps[i].size() && ready; ++d)
+                    ready = resolved[_deps[i][d]];
+
+                if (ready)
+                {
+                    resolved[i] = true;
+                    ++numResolved;
+                    progress = true;
+                }
+            }
+
+            if (!progress)
+            {
+                for (unsigned i = 0; i < _layers.size(); ++i)
+                {
+                    if (!resolved[i])
+                    {
+                        OE_WARN << LC << "Circular layer reference involving \""
+                            << _layers[i]->getName() << "\"; opening it without waiting" << std::endl;
+                        _deps[i].clear();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
+
+//...................................................................
+
 Map::Map() :
 osg::Object()
 {
@@ -454,6 +702,12 @@ Map::insertLayer(Layer* layer, unsigned index)
 
     layer->open();
 
+    insertOpenedLayer(layer, index);
+}
+
+void
+Map::insertOpenedLayer(Layer* layer, unsigned index)
+{
     if (layer->isOpen() && getProfile() != NULL)
     {
         layer->addedToMap(this);
@@ -585,17 +839,19 @@ Map::moveLayer(Layer* layer, unsigned newIndex)
 }
 
 void
-Map::addLayers(const LayerVector& layers)
+Map::addLayers(const LayerVector& input)
 {
     // This differs from addLayer() in a loop because it will
-    // (a) call addedToMap only after all the layers are added, and
-    // (b) invoke all the MapModelChange callbacks with the same 
+    // (a) open the layers in parallel when openThreads > 1,
+    // (b) call addedToMap only after all the layers are added, and
+    // (c) invoke all the MapModelChange callbacks with the same 
     // new revision number.
 
     //osgEarth::Registry::instance()->clearBlacklist();
 
-    for(LayerVector::const_iterator layerRef = layers.begin();
-        layerRef != layers.end();
+    LayerVector batch;
+    for(LayerVector::const_iterator layerRef = input.begin();
+        layerRef != input.end();
         ++layerRef)
     {
         Layer* layer = layerRef->get();
@@ -603,9 +859,52 @@ Map::addLayers(const LayerVector& layers)
             continue;
 
         layer->setReadOptions(getReadOptions());
+        batch.push_back(layer);
+    }
+
+    if (batch.empty())
+        return;
+
+    // open, but don't call addedToMap(layer) yet.
+    osg::ref_ptr<OpenJob> job = new OpenJob(batch);
+
+    unsigned numThreads = std::min(options().openThreads().get(), (unsigned)batch.size());
+    if (numThreads > 1u)
+    {
+        {
+            ScopedMutexLock lock(_openJobsMutex);
+            if (!_openPool.valid())
+                _openPool = new ThreadPool(options().openThreads().get());
+        }
+
+        for (unsigned i = 0; i < numThreads; ++i)
+            _openPool->getQueue()->add(new OpenJob::Worker(job.get()));
+
+        job->wait(options().openTimeout().get());
+    }
+    else
+    {
+        job->run();
+    }
+
+    OE_INFO << LC << "Opened " << batch.size() << " layer(s) in "
+        << job->getElapsedTime() << " s" << std::endl;
+
+    // Layers still opening (or referencing a layer that is) join later.
+    std::vector<unsigned> ready;
+    job->collectJoinable(ready);
+
+    LayerVector layers;
+    for (unsigned i = 0; i < ready.size(); ++i)
+        layers.push_back(batch[ready[i]]);
+
+    if (ready.size() < batch.size())
+    {
+        OE_INFO << LC << (batch.size() - ready.size())
+            << " layer(s) still opening; they will join the map when ready" << std::endl;
 
-        // open, but don't call addedToMap(layer) yet.
-        layer->open();
+        ScopedMutexLock lock(_openJobsMutex);
+        _openJobs.push_back(job.get());
     }
 
     unsigned firstIndex;
@@ -659,6 +958,82 @@ Map::addLayers(const LayerVector& layers)
     }
 }
 
+unsigned
+Map::joinPendingLayers()
+{
+    std::vector<osg::ref_ptr<osg::Referenced> > jobs;
+    {
+        ScopedMutexLock lock(_openJobsMutex);
+        if (_openJobs.empty())
+            return 0u;
+        jobs = _openJobs;
+    }
+
+    unsigned count = 0u;
+
+    for (unsigned j = 0; j < jobs.size(); ++j)
+    {
+        OpenJob* job = static_cast<OpenJob*>(jobs[j].get());
+
+        std::vector<unsigned> ready;
+        job->collectJoinable(ready);
+
+        for (unsigned r = 0; r < ready.size(); ++r)
+        {
+            unsigned b = ready[r];
+
+            // Keep the batch order: go right after the closest preceding
+            // batch layer already in the map, or else right before the
+            // closest following one.
+            unsigned numLayers = getNumLayers();
+            unsigned index = numLayers;
+            for (int k = (int)b - 1; k >= 0 && index == numLayers; --k)
+            {
+                unsigned i = getIndexOfLayer(job->_layers[k].get());
+                if (i < numLayers)
+                    index = i + 1;
+            }
+            for (unsigned k = b + 1; k < job->_layers.size() && index == numLayers; ++k)
+            {
+                unsigned i = getIndexOfLayer(job->_layers[k].get());
+                if (i < numLayers)
+                    index = i;
+            }
+
+            Layer* layer = job->_layers[b].get();
+
+            OE_INFO << LC << "Layer \"" << layer->getName() << "\" joined the map "
+                << job->getElapsedTime() << " s after load" << std::endl;
+
+            insertOpenedLayer(layer, index);
+            ++count;
+        }
+    }
+
+    {
+        ScopedMutexLock lock(_openJobsMutex);
+        for (std::vector<osg::ref_ptr<osg::Referenced> >::iterator i = _openJobs.begin(); i != _openJobs.end(); )
+        {
+            if (static_cast<OpenJob*>(i->get())->getNumUnjoined() == 0u)
+                i = _openJobs.erase(i);
+            else
+                ++i;
+        }
+    }
+
+    return count;
+}
+
+unsigned
+Map::getNumPendingLayers() const
+{
+    ScopedMutexLock lock(_openJobsMutex);
+    unsigned count = 0u;
+    for (unsigned i = 0; i < _openJobs.size(); ++i)
+        count += static_cast<OpenJob*>(_openJobs[i].get())->getNumUnjoined();
+    return count;
+}
+
 void
 Map::installLayerCallbacks(Layer* layer)
 {
@@ -755,6 +1130,12 @@ Map::getIndexOfLayer(const Layer* layer) const
 void
 Map::clear()
 {
+    // forget about any layers that have not joined yet
+    {
+        ScopedMutexLock lock(_openJobsMutex);
+        _openJobs.clear();
+    }
+
     LayerVector layersRemoved;
     Revision newRevision;
     {
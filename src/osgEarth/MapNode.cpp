@@ -851,6 +851,14 @@ MapNode::traverse( osg::NodeVisitor& nv )
             cv->popStateSet();
     }
 
+    else if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
+    {
+        // bring in any layers that were still opening when the map loaded
+        _map->joinPendingLayers();
+
+        osg::Group::traverse( nv );
+    }
+
     else
     {
         if (dynamic_cast<osgUtil::BaseOptimizerVisitor*>(&nv) == 0L)
@@ -0,0 +1,482 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/Notify>
+#include <osg/Math>
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+#define LC "[MetricsRegistry] "
+
+namespace
+{
+    // Highest bit position a bucketed value may have (2^40 us ~ 12 days)
+    const unsigned MAX_MSB = 40u;
+
+    inline unsigned msb(uint64_t v)
+    {
+        unsigned r = 0u;
+        while (v >>= 1) ++r;
+        return r;
+    }
+
+    // Values below 64 get their own bucket; above that, each power of two
+    // is split into 32 linear sub-buckets.
+    inline unsigned bucketIndex(uint64_t v)
+    {
+        if (v < 64u)
+            return (unsigned)v;
+
+        unsigned m = msb(v);
+        if (m > MAX_MSB)
+            return MetricsRegistry::Histogram::NUM_BUCKETS - 1;
+
+        unsigned shift = m - MetricsRegistry::Histogram::SUB_BITS;
+        return 64u + (m - 6u) * 32u + (unsigned)((v >> shift) & 31u);
+    }
+
+    // Midpoint (in microseconds) of a bucket's range
+    inline double bucketValue(unsigned index)
+    {
+        if (index < 64u)
+            return (double)index;
+
+        unsigned m = (index - 64u) / 32u + 6u;
+        unsigned sub = (index - 64u) % 32u;
+        unsigned shift = m - MetricsRegistry::Histogram::SUB_BITS;
+        uint64_t low = (uint64_t)(32u + sub) << shift;
+        uint64_t width = (uint64_t)1u << shift;
+        return (double)low + 0.5*(double)(width - 1u);
+    }
+
+    std::string escape(const std::string& in)
+    {
+        std::string out;
+        out.reserve(in.size());
+        for (std::string::const_iterator c = in.begin(); c != in.end(); ++c)
+        {
+            if (*c == '\\') out += "\\\\";
+            else if (*c == '"') out += "\\\"";
+            else if (*c == '\n') out += "\\n";
+            else out += *c;
+        }
+        return out;
+    }
+
+    std::string labelsKey(const MetricsRegistry::Labels& labels)
+    {
+        std::string key;
+        for (MetricsRegistry::Labels::const_iterator i = labels.begin(); i != labels.end(); ++i)
+        {
+            key += i->first;
+            key += '=';
+            key += i->second;
+            key += '\n';
+        }
+        return key;
+    }
+
+    // {a="1",b="2"} with an optional extra label; empty if no labels
+    std::string promLabels(const MetricsRegistry::Labels& labels,
+                           const std::string& extraName = std::string(),
+                           const std::string& extraValue = std::string())
+    {
+        if (labels.empty() && extraName.empty())
+            return std::string();
+
+        std::string out = "{";
+        for (MetricsRegistry::Labels::const_iterator i = labels.begin(); i != labels.end(); ++i)
+        {
+            if (i != labels.begin()) out += ',';
+            out += i->first + "=\"" + escape(i->second) + "\"";
+        }
+        if (!extraName.empty())
+        {
+            if (!labels.empty()) out += ',';
+            out += extraName + "=\"" + extraValue + "\"";
+        }
+        out += "}";
+        return out;
+    }
+
+    std::string jsonLabels(const MetricsRegistry::Labels& labels)
+    {
+        std::string out = "{";
+        for (MetricsRegistry::Labels::const_iterator i = labels.begin(); i != labels.end(); ++i)
+        {
+            if (i != labels.begin()) out += ',';
+            out += "\"" + escape(i->first) + "\":\"" + escape(i->second) + "\"";
+        }
+        out += "}";
+        return out;
+    }
+
+    const double QUANTILES[3] = { 0.5, 0.9, 0.99 };
+}
+
+//........................................................................
+
+void
+MetricsRegistry::Gauge::add(double delta)
+{
+    double current = _value.load(std::memory_order_relaxed);
+    while (!_value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed));
+}
+
+//........................................................................
+
+MetricsRegistry::Histogram::Histogram()
+{
+    reset();
+}
+
+void
+MetricsRegistry::Histogram::reset()
+{
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+        _buckets[i].store(0u);
+    _count.store(0u);
+    _sum_us.store(0u);
+    _min_us.store(std::numeric_limits<uint64_t>::max());
+    _max_us.store(0u);
+}
+
+void
+MetricsRegistry::Histogram::record(double seconds)
+{
+    uint64_t us = seconds > 0.0 ? (uint64_t)(seconds*1e6 + 0.5) : 0u;
+
+    _buckets[bucketIndex(us)].fetch_add(1u, std::memory_order_relaxed);
+    _count.fetch_add(1u, std::memory_order_relaxed);
+    _sum_us.fetch_add(us, std::memory_order_relaxed);
+
+    uint64_t current = _min_us.load(std::memory_order_relaxed);
+    while (us < current && !_min_us.compare_exchange_weak(current, us, std::memory_order_relaxed));
+
+    current = _max_us.load(std::memory_order_relaxed);
+    while (us > current && !_max_us.compare_exchange_weak(current, us, std::memory_order_relaxed));
+}
+
+double
+MetricsRegistry::Histogram::sum() const
+{
+    return (double)_sum_us.load(std::memory_order_relaxed) * 1e-6;
+}
+
+double
+MetricsRegistry::Histogram::min() const
+{
+    return count() > 0u ? (double)_min_us.load(std::memory_order_relaxed) * 1e-6 : 0.0;
+}
+
+double
+MetricsRegistry::Histogram::max() const
+{
+    return (double)_max_us.load(std::memory_order_relaxed) * 1e-6;
+}
+
+double
+MetricsRegistry::Histogram::quantile(double q) const
+{
+    uint64_t total = count();
+    if (total == 0u)
+        return 0.0;
+
+    q = osg::clampBetween(q, 0.0, 1.0);
+    uint64_t rank = (uint64_t)(q * (double)(total - 1u)) + 1u;
+
+    uint64_t seen = 0u;
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+    {
+        seen += _buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            // never report outside the observed range
+            double value = bucketValue(i) * 1e-6;
+            return osg::clampBetween(value, min(), max());
+        }
+    }
+    return max();
+}
+
+//........................................................................
+
+MetricsRegistry*
+MetricsRegistry::instance()
+{
+    // never destroyed, so metric pointers stay valid during static destruction
+    static MetricsRegistry* s_instance = new MetricsRegistry();
+    return s_instance;
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    for (Families::iterator f = _families.begin(); f != _families.end(); ++f)
+    {
+        for (std::map<std::string, std::pair<Labels, void*> >::iterator m = f->second._metrics.begin();
+            m != f->second._metrics.end();
+            ++m)
+        {
+            if (f->second._type == COUNTER)
+                delete static_cast<Counter*>(m->second.second);
+            else if (f->second._type == GAUGE)
+                delete static_cast<Gauge*>(m->second.second);
+            else
+                delete static_cast<Histogram*>(m->second.second);
+        }
+    }
+}
+
+void*
+MetricsRegistry::get(const std::string& name, const std::string& help, const Labels& labels, Type type)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    Families::iterator f = _families.find(name);
+    if (f == _families.end())
+    {
+        f = _families.insert(std::make_pair(name, Family())).first;
+        f->second._type = type;
+        f->second._help = help;
+    }
+    else if (f->second._type != type)
+    {
+        OE_WARN << LC << "Metric \"" << name << "\" already exists with a different type" << std::endl;
+        return 0L;
+    }
+
+    std::string key = labelsKey(labels);
+    std::map<std::string, std::pair<Labels, void*> >::iterator m = f->second._metrics.find(key);
+    if (m != f->second._metrics.end())
+        return m->second.second;
+
+    void* metric =
+        type == COUNTER ? (void*)new Counter() :
+        type == GAUGE ? (void*)new Gauge() :
+        (void*)new Histogram();
+
+    f->second._metrics[key] = std::make_pair(labels, metric);
+    return metric;
+}
+
+MetricsRegistry::Counter*
+MetricsRegistry::counter(const std::string& name, const std::string& help, const Labels& labels)
+{
+    return static_cast<Counter*>(get(name, help, labels, COUNTER));
+}
+
+MetricsRegistry::Gauge*
+MetricsRegistry::gauge(const std::string& name, const std::string& help, const Labels& labels)
+{
+    return static_cast<Gauge*>(get(name, help, labels, GAUGE));
+}
+
+MetricsRegistry::Histogram*
+MetricsRegistry::histogram(const std::string& name, const std::string& help, const Labels& labels)
+{
+    return static_cast<Histogram*>(get(name, help, labels, HISTOGRAM));
+}
+
+void
+MetricsRegistry::reset()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    for (Families::iterator f = _families.begin(); f != _families.end(); ++f)
+    {
+        for (std::map<std::string, std::pair<Labels, void*> >::iterator m = f->second._metrics.begin();
+            m != f->second._metrics.end();
+            ++m)
+        {
+            if (f->second._type == COUNTER)
+                static_cast<Counter*>(m->second.second)->reset();
+            else if (f->second._type == GAUGE)
+                static_cast<Gauge*>(m->second.second)->reset();
+            else
+                static_cast<Histogram*>(m->second.second)->reset();
+        }
+    }
+}
+
+std::string
+MetricsRegistry::toPrometheus() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    std::ostringstream buf;
+    buf << std::setprecision(9);
+
+    for (Families::const_iterator f = _families.begin(); f != _families.end(); ++f)
+    {
+        const std::string& name = f->first;
+        const Family& family = f->second;
+
+        if (!family._help.empty())
+            buf << "# HELP " << name << " " << family._help << "\n";
+
+        buf << "# TYPE " << name << " "
+            << (family._type == COUNTER ? "counter" : family._type == GAUGE ? "gauge" : "summary") << "\n";
+
+        for (std::map<std::string, std::pair<Labels, void*> >::const_iterator m = family._metrics.begin();
+            m != family._metrics.end();
+            ++m)
+        {
+            const Labels& labels = m->second.first;
+
+            if (family._type == COUNTER)
+            {
+                buf << name << promLabels(labels) << " " << static_cast<const Counter*>(m->second.second)->value() << "\n";
+            }
+            else if (family._type == GAUGE)
+            {
+                buf << name << promLabels(labels) << " " << static_cast<const Gauge*>(m->second.second)->value() << "\n";
+            }
+            else
+            {
+                const Histogram* h = static_cast<const Histogram*>(m->second.second);
+                for (unsigned q = 0; q < 3; ++q)
+                {
+                    std::ostringstream qs;
+                    qs << QUANTILES[q];
+                    buf << name << promLabels(labels, "quantile", qs.str()) << " " << h->quantile(QUANTILES[q]) << "\n";
+                }
+                buf << name << "_sum" << promLabels(labels) << " " << h->sum() << "\n";
+                buf << name << "_count" << promLabels(labels) << " " << h->count() << "\n";
+            }
+        }
+    }
+
+    return buf.str();
+}
+
+std::string
+MetricsRegistry::toJSON() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    std::ostringstream counters, gauges, histograms;
+    counters << std::setprecision(9);
+    gauges << std::setprecision(9);
+    histograms << std::setprecision(9);
+
+    for (Families::const_iterator f = _families.begin(); f != _families.end(); ++f)
+    {
+        const std::string& name = f->first;
+        const Family& family = f->second;
+
+        for (std::map<std::string, std::pair<Labels, void*> >::const_iterator m = family._metrics.begin();
+            m != family._metrics.end();
+            ++m)
+        {
+            const Labels& labels = m->second.first;
+
+            if (family._type == COUNTER)
+            {
+                if (counters.tellp() > 0) counters << ",";
+                counters << "{\"name\":\"" << escape(name) << "\",\"labels\":" << jsonLabels(labels)
+                    << ",\"value\":" << static_cast<const Counter*>(m->second.second)->value() << "}";
+            }
+            else if (family._type == GAUGE)
+            {
+                if (gauges.tellp() > 0) gauges << ",";
+                gauges << "{\"name\":\"" << escape(name) << "\",\"labels\":" << jsonLabels(labels)
+                    << ",\"value\":" << static_cast<const Gauge*>(m->second.second)->value() << "}";
+            }
+            else
+            {
+                const Histogram* h = static_cast<const Histogram*>(m->second.second);
+                if (histograms.tellp() > 0) histograms << ",";
+                histograms << "{\"name\":\"" << escape(name) << "\",\"labels\":" << jsonLabels(labels)
+                    << ",\"count\":" << h->count()
+                    << ",\"sum\":" << h->sum()
+                    << ",\"min\":" << h->min()
+                    << ",\"max\":" << h->max()
+                    << ",\"p50\":" << h->quantile(0.5)
+                    << ",\"p90\":" << h->quantile(0.9)
+                    << ",\"p99\":" << h->quantile(0.99) << "}";
+            }
+        }
+    }
+
+    return
+        "{\"counters\":[" + counters.str() +
+        "],\"gauges\":[" + gauges.str() +
+        "],\"histograms\":[" + histograms.str() + "]}";
+}
+
+//........................................................................
+
+StageTimes::Stages::Stages(const std::string& name,
+                           const std::string& help,
+                           const std::string& label,
+                           const char* const* stageNames,
+                           unsigned numStages)
+{
+    for (unsigned i = 0; i < numStages; ++i)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair(label, std::string(stageNames[i])));
+        _names.push_back(stageNames[i]);
+        _histograms.push_back(MetricsRegistry::instance()->histogram(name, help, labels));
+    }
+}
+
+StageTimes::StageTimes(const Stages& stages) :
+_stages(&stages),
+_seconds(stages.size(), -1.0)
+{
+    //nop
+}
+
+void
+StageTimes::add(unsigned stage, double seconds)
+{
+    _seconds[stage] = _seconds[stage] < 0.0 ? seconds : _seconds[stage] + seconds;
+}
+
+void
+StageTimes::add(const StageTimes& rhs)
+{
+    for (unsigned i = 0; i < _seconds.size() && i < rhs._seconds.size(); ++i)
+        if (rhs._seconds[i] >= 0.0)
+            add(i, rhs._seconds[i]);
+}
+
+void
+StageTimes::record() const
+{
+    for (unsigned i = 0; i < _seconds.size(); ++i)
+        if (_seconds[i] >= 0.0 && _stages->_histograms[i])
+            _stages->_histograms[i]->record(_seconds[i]);
+}
+
+std::string
+StageTimes::str() const
+{
+    std::stringstream buf;
+    for (unsigned i = 0; i < _seconds.size(); ++i)
+        if (_seconds[i] >= 0.0)
+            buf << " " << _stages->_names[i] << "=" << std::fixed << std::setprecision(1) << (_seconds[i] * 1000.0) << "ms";
+    return buf.str();
+}
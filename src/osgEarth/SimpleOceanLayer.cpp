@@ -251,6 +251,13 @@ SimpleOceanLayer::addedToMap(const Map* map)
     updateMaskLayer();
 }
 
+void
+SimpleOceanLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    VisibleLayer::getLayerReferences(names);
+    options().maskLayer().getLayerName(names);
+}
+
 void
 SimpleOceanLayer::removedFromMap(const Map* map)
 {
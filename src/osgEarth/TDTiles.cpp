@@ -28,8 +28,16 @@
 #include <osgDB/Registry>
 #include <osgUtil/IncrementalCompileOperation>
 #include <osg/ShapeDrawable>
+#include <osg/Geometry>
+#include <osg/Texture>
 #include <osg/PolygonMode>
 #include <osgEarth/LineDrawable>
+#include <rapidjson/reader.h>
+#include <rapidjson/error/en.h>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <sstream>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -103,6 +111,439 @@ namespace osgEarth { namespace Contrib { namespace ThreeDTiles
 
 //........................................................................
 
+namespace osgEarth { namespace Contrib { namespace ThreeDTiles
+{
+    /**
+     * Streaming (SAX) tileset parser. Builds Tile objects straight from
+     * the JSON events without an intermediate DOM. Children deeper than
+     * the preload depth are only scanned; the parser records where their
+     * JSON text starts and ends so Tile::loadChildren can parse them later.
+     */
+    class TilesetReader : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, TilesetReader>
+    {
+    public:
+        //! Parses a whole tileset document
+        static Tileset* readTileset(TilesetSource* source, unsigned preloadDepth)
+        {
+            TilesetReader reader(source, 0u, preloadDepth, true);
+            return reader.parse() ? reader._tileset.release() : 0L;
+        }
+
+        //! Parses the single tile object starting at an offset in the source
+        static Tile* readTile(TilesetSource* source, unsigned offset, unsigned preloadDepth)
+        {
+            TilesetReader reader(source, offset, preloadDepth, false);
+            return reader.parse() ? reader._tile.release() : 0L;
+        }
+
+        //! Parses the deferred children of a tile
+        static bool readChildren(Tile* tile, unsigned preloadDepth)
+        {
+            if (tile->_childrenLoaded)
+                return true;
+
+            if (!tile->_source.valid())
+                return false;
+
+            std::vector<osg::ref_ptr<Tile> > children;
+            children.reserve(tile->_childSpans.size());
+
+            for (unsigned i = 0; i < tile->_childSpans.size(); ++i)
+            {
+                osg::ref_ptr<Tile> child = readTile(tile->_source.get(), tile->_childSpans[i].first, preloadDepth);
+                if (!child.valid())
+                    return false;
+                children.push_back(child.get());
+            }
+
+            tile->children().swap(children);
+            tile->_childrenLoaded = true;
+            return true;
+        }
+
+    public: // rapidjson::Handler
+
+        bool StartObject();
+        bool EndObject(rapidjson::SizeType);
+        bool StartArray();
+        bool EndArray(rapidjson::SizeType);
+        bool Key(const char* str, rapidjson::SizeType len, bool);
+        bool String(const char* str, rapidjson::SizeType len, bool);
+        bool Int(int i) { return number((double)i); }
+        bool Uint(unsigned i) { return number((double)i); }
+        bool Int64(int64_t i) { return number((double)i); }
+        bool Uint64(uint64_t i) { return number((double)i); }
+        bool Double(double d) { return number(d); }
+        bool Default() { return !_stack.empty(); }
+
+    private:
+        enum FrameType
+        {
+            FRAME_TILESET,
+            FRAME_ASSET,
+            FRAME_TILE,
+            FRAME_CONTENT,
+            FRAME_VOLUME,
+            FRAME_NUMBERS,
+            FRAME_CHILDREN,
+            FRAME_SKIP
+        };
+
+        struct Frame
+        {
+            FrameType type;
+            std::string key;        // current member of an object
+            Tile* tile;             // TILE; CHILDREN (the parent tile)
+            BoundingVolume* volume; // VOLUME
+            TileContent* content;   // CONTENT
+            unsigned depth;         // TILE, CHILDREN: depth of the tile below the parse root
+            unsigned begin;         // offset of the opening brace
+            unsigned nesting;       // SKIP
+            bool childSpan;         // TILE, SKIP: an element of a "children" array
+        };
+
+        TilesetReader(TilesetSource* source, unsigned base, unsigned preloadDepth, bool tileset) :
+            _source(source),
+            _lc(source->getLoadContext()),
+            _base(base),
+            _preloadDepth(preloadDepth),
+            _parseTileset(tileset),
+            _stream(0L) { }
+
+        bool parse()
+        {
+            rapidjson::StringStream stream(_source->getJSON().c_str() + _base);
+            _stream = &stream;
+
+            rapidjson::Reader reader;
+            rapidjson::ParseResult result = reader.Parse<rapidjson::kParseStopWhenDoneFlag>(stream, *this);
+            _stream = 0L;
+
+            if (result.IsError())
+            {
+                OE_WARN << LC << "Invalid tileset JSON at offset " << (_base + result.Offset()) << ": "
+                    << rapidjson::GetParseError_En(result.Code()) << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        unsigned offset() const
+        {
+            return _base + (unsigned)_stream->Tell();
+        }
+
+        Frame& push(FrameType type)
+        {
+            _stack.push_back(Frame());
+            Frame& f = _stack.back();
+            f.type = type;
+            f.tile = 0L;
+            f.volume = 0L;
+            f.content = 0L;
+            f.depth = 0u;
+            f.begin = 0u;
+            f.nesting = 1u;
+            f.childSpan = false;
+            return f;
+        }
+
+        void pushTile(Tile* tile, unsigned depth, unsigned begin, bool childSpan)
+        {
+            Frame& f = push(FRAME_TILE);
+            f.tile = tile;
+            f.depth = depth;
+            f.begin = begin;
+            f.childSpan = childSpan;
+        }
+
+        void pushVolume(BoundingVolume* volume)
+        {
+            push(FRAME_VOLUME).volume = volume;
+        }
+
+        Tile* createTile()
+        {
+            Tile* tile = new Tile();
+            tile->_source = _source.get();
+            return tile;
+        }
+
+        bool number(double value);
+
+        void applyNumbers(Frame& owner);
+
+        std::vector<Frame> _stack;
+        std::vector<double> _numbers;
+        osg::ref_ptr<TilesetSource> _source;
+        LoadContext _lc;
+        unsigned _base;
+        unsigned _preloadDepth;
+        bool _parseTileset;
+        rapidjson::StringStream* _stream;
+        osg::ref_ptr<Tileset> _tileset;
+        osg::ref_ptr<Tile> _tile;
+    };
+
+    bool
+    TilesetReader::StartObject()
+    {
+        if (_stack.empty())
+        {
+            if (_parseTileset)
+            {
+                _tileset = new Tileset();
+                push(FRAME_TILESET);
+            }
+            else
+            {
+                _tile = createTile();
+                pushTile(_tile.get(), 0u, offset() - 1u, false);
+            }
+            return true;
+        }
+
+        // careful: push() invalidates this reference
+        Frame& top = _stack.back();
+
+        if (top.type == FRAME_SKIP)
+        {
+            ++top.nesting;
+        }
+
+        else if (top.type == FRAME_CHILDREN)
+        {
+            Tile* parent = top.tile;
+            unsigned depth = top.depth + 1u;
+            unsigned begin = offset() - 1u;
+
+            if (depth > _preloadDepth)
+            {
+                // just find the end of it:
+                Frame& f = push(FRAME_SKIP);
+                f.begin = begin;
+                f.childSpan = true;
+            }
+            else
+            {
+                Tile* child = createTile();
+                parent->children().push_back(child);
+                pushTile(child, depth, begin, true);
+            }
+        }
+
+        else if (top.type == FRAME_TILESET && top.key == "asset")
+            push(FRAME_ASSET);
+        else if (top.type == FRAME_TILESET && top.key == "boundingVolume")
+            pushVolume(&_tileset->boundingVolume().mutable_value());
+        else if (top.type == FRAME_TILESET && top.key == "root")
+        {
+            Tile* root = createTile();
+            _tileset->root() = root;
+            pushTile(root, 0u, offset() - 1u, false);
+        }
+
+        else if (top.type == FRAME_TILE && top.key == "boundingVolume")
+            pushVolume(&top.tile->boundingVolume().mutable_value());
+        else if (top.type == FRAME_TILE && top.key == "viewerRequestVolume")
+            pushVolume(&top.tile->viewerRequestVolume().mutable_value());
+        else if (top.type == FRAME_TILE && top.key == "content")
+        {
+            TileContent* content = &top.tile->content().mutable_value();
+            push(FRAME_CONTENT).content = content;
+        }
+
+        else if (top.type == FRAME_CONTENT && top.key == "boundingVolume")
+            pushVolume(&top.content->boundingVolume().mutable_value());
+
+        else
+            push(FRAME_SKIP);
+
+        return true;
+    }
+
+    bool
+    TilesetReader::EndObject(rapidjson::SizeType)
+    {
+        Frame& top = _stack.back();
+
+        if (top.type == FRAME_SKIP && --top.nesting > 0u)
+            return true;
+
+        bool childSpan = top.childSpan;
+        unsigned begin = top.begin;
+        _stack.pop_back();
+
+        // the frame below a child is its parent's CHILDREN frame:
+        if (childSpan)
+            _stack.back().tile->_childSpans.push_back(std::make_pair(begin, offset()));
+
+        return true;
+    }
+
+    bool
+    TilesetReader::StartArray()
+    {
+        if (_stack.empty())
+            return false;
+
+        Frame& top = _stack.back();
+
+        if (top.type == FRAME_SKIP)
+        {
+            ++top.nesting;
+        }
+        else if (top.type == FRAME_TILE && top.key == "children")
+        {
+            Tile* tile = top.tile;
+            unsigned depth = top.depth;
+            tile->children().clear();
+            tile->_childSpans.clear();
+            tile->_childrenLoaded = depth < _preloadDepth;
+
+            Frame& f = push(FRAME_CHILDREN);
+            f.tile = tile;
+            f.depth = depth;
+        }
+        else if (
+            (top.type == FRAME_TILE && top.key == "transform") ||
+            (top.type == FRAME_VOLUME && (top.key == "region" || top.key == "sphere" || top.key == "box")))
+        {
+            _numbers.clear();
+            push(FRAME_NUMBERS);
+        }
+        else
+        {
+            push(FRAME_SKIP);
+        }
+        return true;
+    }
+
+    bool
+    TilesetReader::EndArray(rapidjson::SizeType)
+    {
+        Frame& top = _stack.back();
+
+        if (top.type == FRAME_SKIP && --top.nesting > 0u)
+            return true;
+
+        FrameType type = top.type;
+        _stack.pop_back();
+
+        if (type == FRAME_NUMBERS)
+            applyNumbers(_stack.back());
+
+        return true;
+    }
+
+    bool
+    TilesetReader::Key(const char* str, rapidjson::SizeType len, bool)
+    {
+        Frame& top = _stack.back();
+        if (top.type != FRAME_SKIP)
+            top.key.assign(str, len);
+        return true;
+    }
+
+    bool
+    TilesetReader::String(const char* str, rapidjson::SizeType len, bool)
+    {
+        if (_stack.empty())
+            return false;
+
+        Frame& top = _stack.back();
+
+        if (top.type == FRAME_ASSET)
+        {
+            if (top.key == "version")
+                _tileset->asset()->version() = std::string(str, len);
+            else if (top.key == "tilesetVersion")
+                _tileset->asset()->tilesetVersion() = std::string(str, len);
+        }
+        else if (top.type == FRAME_TILE && top.key == "refine")
+        {
+            top.tile->refine() = osgEarth::ciEquals(std::string(str, len), "ADD") ? REFINE_ADD : REFINE_REPLACE;
+        }
+        else if (top.type == FRAME_CONTENT && (top.key == "uri" || top.key == "url"))
+        {
+            top.content->uri() = URI(std::string(str, len), _lc._uc);
+        }
+        return true;
+    }
+
+    bool
+    TilesetReader::number(double value)
+    {
+        if (_stack.empty())
+            return false;
+
+        Frame& top = _stack.back();
+
+        if (top.type == FRAME_NUMBERS)
+            _numbers.push_back(value);
+        else if (top.type == FRAME_TILE && top.key == "geometricError")
+            top.tile->geometricError() = value;
+        else if (top.type == FRAME_TILESET && top.key == "geometricError")
+            _tileset->geometricError() = value;
+
+        return true;
+    }
+
+    void
+    TilesetReader::applyNumbers(Frame& owner)
+    {
+        const std::vector<double>& a = _numbers;
+
+        if (owner.type == FRAME_TILE)
+        {
+            if (a.size() == 16)
+                owner.tile->transform() = osg::Matrix(&a[0]);
+        }
+
+        else if (owner.key == "region")
+        {
+            if (a.size() == 6)
+            {
+                osg::BoundingBoxd& region = owner.volume->region().mutable_value();
+                region.set(a[0], a[1], a[4], a[2], a[3], a[5]);
+            }
+            else OE_WARN << "Invalid region array" << std::endl;
+        }
+
+        else if (owner.key == "sphere")
+        {
+            if (a.size() == 4)
+            {
+                osg::BoundingSphere& sphere = owner.volume->sphere().mutable_value();
+                sphere.center().set(a[0], a[1], a[2]);
+                sphere.radius() = a[3];
+            }
+        }
+
+        else if (owner.key == "box")
+        {
+            if (a.size() == 12)
+            {
+                osg::Vec3d center(a[0], a[1], a[2]);
+                osg::Vec3d xvec(a[3], a[4], a[5]);
+                osg::Vec3d yvec(a[6], a[7], a[8]);
+                osg::Vec3d zvec(a[9], a[10], a[11]);
+
+                osg::BoundingBoxd& box = owner.volume->box().mutable_value();
+                box.expandBy(center+xvec);
+                box.expandBy(center-xvec);
+                box.expandBy(center+yvec);
+                box.expandBy(center-yvec);
+                box.expandBy(center+zvec);
+                box.expandBy(center-zvec);
+            }
+            else OE_WARN << "Invalid box array" << std::endl;
+        }
+    }
+}}}
+
+//........................................................................
+
 void
 Asset::fromJSON(const Json::Value& value)
 {
@@ -279,6 +720,49 @@ TileContent::getJSON() const
 
 //........................................................................
 
+Tile::Tile() :
+    _refine(REFINE_ADD),
+    _childrenLoaded(true)
+{
+    //nop
+}
+
+Tile::Tile(const Json::Value& value, LoadContext& uc) :
+    _childrenLoaded(true)
+{
+    fromJSON(value, uc);
+}
+
+Tile::~Tile()
+{
+    //nop
+}
+
+unsigned
+Tile::getNumChildren() const
+{
+    return _childrenLoaded ? children().size() : _childSpans.size();
+}
+
+bool
+Tile::loadChildren()
+{
+    // Parse just the children; their own children stay as text
+    // until they are needed in turn.
+    return TilesetReader::readChildren(this, 0u);
+}
+
+bool
+Tile::unloadChildren()
+{
+    if (!_source.valid())
+        return false;
+
+    children().clear();
+    _childrenLoaded = _childSpans.empty();
+    return true;
+}
+
 void
 Tile::fromJSON(const Json::Value& value, LoadContext& uc)
 {
@@ -339,8 +823,20 @@ Tile::getJSON() const
     if (content().isSet())
         value["content"] = content()->getJSON();
 
-
-    if (!children().empty())
+    if (!_childrenLoaded && _source.valid())
+    {
+        Json::Value collection(Json::arrayValue);
+        for(unsigned i=0; i<_childSpans.size(); ++i)
+        {
+            osg::ref_ptr<Tile> child = TilesetReader::readTile(_source.get(), _childSpans[i].first, ~0u);
+            if (child.valid())
+            {
+                collection.append(child->getJSON());
+            }
+        }
+        value["children"] = collection;
+    }
+    else if (!children().empty())
     {
         Json::Value collection(Json::arrayValue);
         for(unsigned i=0; i<children().size(); ++i)
@@ -433,17 +929,10 @@ Tileset::getJSON() const
 }
 
 Tileset*
-Tileset::create(const std::string& json, const URIContext& uc)
+Tileset::create(const std::string& json, const URIContext& uc, unsigned preloadDepth)
 {
-    Json::Reader reader;
-    Json::Value root(Json::objectValue);
-    if (!reader.parse(json, root, false))
-        return NULL;
-
-    LoadContext lc;
-    lc._uc = uc;
-
-    return new Tileset(root, lc);
+    osg::ref_ptr<TilesetSource> source = new TilesetSource(json, uc);
+    return TilesetReader::readTileset(source.get(), preloadDepth);
 }
 
 static VirtualProgram* getOrCreateDebugVirtualProgram()
@@ -592,20 +1081,269 @@ namespace
 
         osg::ref_ptr< osg::Operation > operation = new LoadTilesetOperation(parentTileset, uri, options, promise);
 
-        if (operation.valid())
+        if (operation.valid())
+        {
+            if (threadPool.valid())
+            {
+                threadPool->getQueue()->add(operation.get());
+            }
+            else
+            {
+                OE_WARN << "Immediately resolving async operation, please set a ThreadPool on the Options object" << std::endl;
+                operation->operator()(0);
+            }
+        }
+
+        return promise.getFuture();
+    }
+
+    // Cancels a content read once nothing waits on its result any more.
+    class AbandonedRequestCallback : public ProgressCallback
+    {
+    public:
+        AbandonedRequestCallback(const osgEarth::Threading::Promise<osg::Node>* promise) : _promise(promise) { }
+
+    protected:
+        bool shouldCancel() const { return _promise->isAbandoned(); }
+
+        const osgEarth::Threading::Promise<osg::Node>* _promise;
+    };
+
+    class LoadContentOperation : public osg::Operation, public osgUtil::IncrementalCompileOperation::CompileCompletedCallback
+    {
+    public:
+        LoadContentOperation(const URI& uri, osgDB::Options* options, osgEarth::Threading::Promise<osg::Node> promise) :
+            _uri(uri),
+            _promise(promise),
+            _options(options)
+        {
+            // Get the currently active request layer and reuse it when the operator actually occurs, which will probably be on a different thread.
+            _requestLayer = NetworkMonitor::getRequestLayer();
+        }
+
+        void operator()(osg::Object*)
+        {
+            OE_PROFILING_ZONE_NAMED("loadTileContent");
+            OE_PROFILING_ZONE_TEXT(_uri.full());
+
+            NetworkMonitor::ScopedRequestLayer layerRequest(_requestLayer);
+
+            if (_promise.isAbandoned())
+            {
+                return;
+            }
+
+            osg::ref_ptr<ProgressCallback> progress = new AbandonedRequestCallback(&_promise);
+            osg::ref_ptr<osg::Node> node = read(progress.get());
+
+            if (node.valid() && !progress->isCanceled())
+            {
+                osg::ref_ptr<osgUtil::IncrementalCompileOperation> ico = OptionsData<osgUtil::IncrementalCompileOperation>::get(_options.get(), "osg::ico");
+
+                // If we have an ICO, wait for it to be compiled
+                if (ico.valid())
+                {
+                    OE_PROFILING_ZONE_NAMED("ICO compile");
+
+                    _compileSet = new osgUtil::IncrementalCompileOperation::CompileSet(node.get());
+                    _compileSet->_compileCompletedCallback = this;
+                    ico->add(_compileSet.get());
+
+                    unsigned int numTries = 0;
+                    // block until the compile completes, checking once and a while for
+                    // an abandoned operation (to avoid deadlock)
+                    while (!_block.wait(10)) // 10ms
+                    {
+                        // Limit the number of tries and give up after awhile to avoid the case where the ICO still has work to do but the application has exited.
+                        ++numTries;
+                        if (_promise.isAbandoned() || numTries == 1000)
+                        {
+                            _compileSet->_compileCompletedCallback = NULL;
+                            ico->remove(_compileSet.get());
+                            _compileSet = 0;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            _promise.resolve(node.get());
+        }
+
+        // Reads the payload as a string so that it goes through the cache
+        // bin in the read options (the layer's), then decodes it in memory.
+        osg::Node* read(ProgressCallback* progress)
+        {
+            ReadResult rr = _uri.readString(_options.get(), progress);
+            if (rr.failed())
+            {
+                if (!progress->isCanceled())
+                {
+                    OE_WARN << LC << "Failed to read \"" << _uri.full() << "\": " << rr.errorDetail() << std::endl;
+                }
+                return 0L;
+            }
+
+            osg::ref_ptr<osgDB::Options> localOptions = Registry::instance()->cloneOrCreateOptions(_options.get());
+            URIContext(_uri.full()).store(localOptions.get());
+
+            // The glTF plugin recognizes b3dm, glb and gltf payloads; anything
+            // else goes to the plugin for the file extension.
+            osgDB::ReaderWriter* readers[2] = {
+                osgDB::Registry::instance()->getReaderWriterForExtension("b3dm"),
+                osgDB::Registry::instance()->getReaderWriterForExtension(osgDB::getLowerCaseFileExtension(_uri.base()))
+            };
+
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                if (!readers[i] || (i > 0 && readers[i] == readers[0]))
+                    continue;
+
+                std::istringstream in(rr.getString());
+                osgDB::ReaderWriter::ReadResult result = readers[i]->readNode(in, localOptions.get());
+                if (result.validNode())
+                {
+                    return result.takeNode();
+                }
+                if (result.status() != osgDB::ReaderWriter::ReadResult::FILE_NOT_HANDLED)
+                {
+                    OE_WARN << LC << "Failed to decode \"" << _uri.full() << "\": " << result.message() << std::endl;
+                    return 0L;
+                }
+            }
+
+            OE_WARN << LC << "No reader for \"" << _uri.full() << "\"" << std::endl;
+            return 0L;
+        }
+
+        bool compileCompleted(osgUtil::IncrementalCompileOperation::CompileSet* compileSet)
+        {
+            // Clear the _compileSet to avoid keeping a circular reference to the content.
+            _compileSet = 0;
+            // release the wait.
+            _block.set();
+            return true;
+        }
+
+        URI _uri;
+        osgEarth::Threading::Promise<osg::Node> _promise;
+        osg::ref_ptr<osgDB::Options> _options;
+        osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> _compileSet;
+        Threading::Event _block;
+        std::string _requestLayer;
+    };
+
+    Threading::Future<osg::Node> readContentAsync(const URI& uri, osgDB::Options* options)
+    {
+        osg::ref_ptr<ThreadPool> threadPool;
+        if (options)
+        {
+            threadPool = ThreadPool::get(options);
+        }
+
+        Threading::Promise<osg::Node> promise;
+
+        osg::ref_ptr< osg::Operation > operation = new LoadContentOperation(uri, options, promise);
+
+        if (threadPool.valid())
+        {
+            threadPool->getQueue()->add(operation.get());
+        }
+        else
+        {
+            OE_WARN << "Immediately resolving async operation, please set a ThreadPool on the Options object" << std::endl;
+            operation->operator()(0);
+        }
+
+        return promise.getFuture();
+    }
+
+    osg::Node* readContent(const URI& uri, osgDB::Options* options)
+    {
+        Threading::Promise<osg::Node> promise;
+        Threading::Future<osg::Node> future = promise.getFuture();
+
+        osg::ref_ptr<LoadContentOperation> operation = new LoadContentOperation(uri, options, promise);
+        operation->operator()(0);
+
+        return future.release();
+    }
+
+    // Approximate memory used by a tile's content: vertex and index data
+    // plus texture images, each shared object counted once.
+    class ContentSizeVisitor : public osg::NodeVisitor
+    {
+    public:
+        ContentSizeVisitor() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), _bytes(0u)
+        {
+            setNodeMaskOverride(~0);
+        }
+
+        void apply(osg::Node& node)
+        {
+            applyStateSet(node.getStateSet());
+            traverse(node);
+        }
+
+        void apply(osg::Drawable& drawable)
+        {
+            applyStateSet(drawable.getStateSet());
+
+            osg::Geometry* geom = drawable.asGeometry();
+            if (geom && _seen.insert(geom).second)
+            {
+                osg::Geometry::ArrayList arrays;
+                geom->getArrayList(arrays);
+                for (unsigned i = 0; i < arrays.size(); ++i)
+                {
+                    if (_seen.insert(arrays[i].get()).second)
+                        _bytes += arrays[i]->getTotalDataSize();
+                }
+
+                for (unsigned i = 0; i < geom->getNumPrimitiveSets(); ++i)
+                {
+                    osg::PrimitiveSet* ps = geom->getPrimitiveSet(i);
+                    if (_seen.insert(ps).second)
+                        _bytes += ps->getTotalDataSize();
+                }
+            }
+        }
+
+        void applyStateSet(osg::StateSet* stateSet)
         {
-            if (threadPool.valid())
-            {
-                threadPool->getQueue()->add(operation.get());
-            }
-            else
+            if (!stateSet || !_seen.insert(stateSet).second)
+                return;
+
+            const osg::StateSet::TextureAttributeList& texAttrs = stateSet->getTextureAttributeList();
+            for (unsigned unit = 0; unit < texAttrs.size(); ++unit)
             {
-                OE_WARN << "Immediately resolving async operation, please set a ThreadPool on the Options object" << std::endl;
-                operation->operator()(0);
+                osg::StateAttribute* sa = stateSet->getTextureAttribute(unit, osg::StateAttribute::TEXTURE);
+                osg::Texture* texture = sa ? sa->asTexture() : 0L;
+                if (texture)
+                {
+                    for (unsigned i = 0; i < texture->getNumImages(); ++i)
+                    {
+                        osg::Image* image = texture->getImage(i);
+                        if (image && _seen.insert(image).second)
+                            _bytes += image->getTotalSizeInBytesIncludingMipmaps();
+                    }
+                }
             }
         }
 
-        return promise.getFuture();
+        std::set<const osg::Referenced*> _seen;
+        unsigned _bytes;
+    };
+
+    unsigned computeContentBytes(osg::Node* content)
+    {
+        // a nested tileset accounts for its own tiles
+        if (!content || dynamic_cast<ThreeDTilesetContentNode*>(content))
+            return 0u;
+
+        ContentSizeVisitor visitor;
+        content->accept(visitor);
+        return visitor._bytes;
     }
 }
 
@@ -613,12 +1351,18 @@ ThreeDTileNode::ThreeDTileNode(ThreeDTilesetNode* tileset, Tile* tile, bool imme
     _tileset(tileset),
     _tile(tile),
     _requestedContent(false),
+    _contentFailed(false),
+    _usesICO(false),
     _immediateLoad(immediateLoad),
     _firstVisit(true),
     _options(options),
     _trackerItrValid(false),
     _lastCulledFrameNumber(0),
     _lastCulledFrameTime(0.0f),
+    _lastTraversedFrameTime(0.0f),
+    _lastScreenSpaceError(0.0),
+    _contentBytes(0u),
+    _childrenFailed(false),
     _refine(REFINE_ADD)
 {
     OE_PROFILING_ZONE;
@@ -664,39 +1408,145 @@ ThreeDTileNode::ThreeDTileNode(ThreeDTilesetNode* tileset, Tile* tile, bool imme
         }
         else
         {
-            _content = uri.getNode(_options.get());
+            _content = readContent(uri, _options.get());
         }
         if (_content.valid())
         {
+            _contentBytes = computeContentBytes(_content.get());
+            _tileset->addResidentBytes(_contentBytes);
+
             _tileset->runPreMergeOperations(_content.get());
             _tileset->runPostMergeOperations(_content.get());
         }
+        else
+        {
+            _contentFailed = true;
+        }
         OE_PROFILING_ZONE_TEXT("Immediate load");
     }
 
-    if (_tile->children().size() > 0)
+    // Child nodes are created by createChildren() when the cull first reaches this tile.
+
+    _debugColor = randomColor();
+
+    getOrCreateStateSet()->getOrCreateUniform("debugColor", osg::Uniform::FLOAT_VEC4)->set(_debugColor);
+
+    computeBoundingVolume();
+
+    createDebugBounds();
+}
+
+void ThreeDTileNode::createChildren()
+{
+    if (_children.valid() || _childrenFailed || _tile->getNumChildren() == 0)
+    {
+        return;
+    }
+
     {
-        _children = new osg::Group;
+        ScopedMutexLock lock(_childrenMutex);
+
+        if (_children.valid() || _childrenFailed)
+        {
+            return;
+        }
+
+        // Hydrate the children from the tileset JSON if they were deferred.
+        if (!_tile->loadChildren())
+        {
+            OE_WARN << LC << "Failed to parse child tiles" << std::endl;
+            _childrenFailed = true;
+            return;
+        }
+
+        osg::ref_ptr<osg::Group> children = new osg::Group;
         for (unsigned int i = 0; i < _tile->children().size(); ++i)
         {
             ThreeDTileNode* child = new ThreeDTileNode(_tileset, _tile->children()[i].get(), false, _options.get());
             child->setParentTile(this);
-            _children->addChild(child);
+            children->addChild(child);
         }
 
-        if (_children->getNumChildren() == 0)
+        if (children->getNumChildren() == 0)
         {
-            _children = 0;
+            return;
         }
+
+        _children = children;
     }
 
-    _debugColor = randomColor();
+    // Outside the lock, since the tileset locks tiles in the other order.
+    _tileset->trackHydratedTile(this);
+}
 
-    getOrCreateStateSet()->getOrCreateUniform("debugColor", osg::Uniform::FLOAT_VEC4)->set(_debugColor);
+bool ThreeDTileNode::isSubtreeCold() const
+{
+    if (!_children.valid())
+    {
+        return true;
+    }
 
-    computeBoundingVolume();
+    for (unsigned int i = 0; i < _children->getNumChildren(); ++i)
+    {
+        const ThreeDTileNode* child = dynamic_cast<const ThreeDTileNode*>(_children->getChild(i));
+        if (child)
+        {
+            if (child->_content.valid() || child->_requestedContent || !child->isSubtreeCold())
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-    createDebugBounds();
+void ThreeDTileNode::untrack(TileTracker& tracker)
+{
+    if (_trackerItrValid)
+    {
+        tracker.erase(_trackerItr);
+        _trackerItrValid = false;
+    }
+
+    if (_children.valid())
+    {
+        for (unsigned int i = 0; i < _children->getNumChildren(); ++i)
+        {
+            ThreeDTileNode* child = dynamic_cast<ThreeDTileNode*>(_children->getChild(i));
+            if (child)
+            {
+                child->untrack(tracker);
+            }
+        }
+    }
+}
+
+bool ThreeDTileNode::releaseChildren(TileTracker& tracker)
+{
+    ScopedMutexLock lock(_childrenMutex);
+
+    if (!_children.valid() || !isSubtreeCold())
+    {
+        return false;
+    }
+
+    // Only tiles that can be parsed again may give up their children.
+    if (!_tile->unloadChildren())
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < _children->getNumChildren(); ++i)
+    {
+        ThreeDTileNode* child = dynamic_cast<ThreeDTileNode*>(_children->getChild(i));
+        if (child)
+        {
+            child->untrack(tracker);
+        }
+    }
+
+    _children = 0;
+    return true;
 }
 
 void ThreeDTileNode::setParentTile(ThreeDTileNode* parentTile)
@@ -889,39 +1739,74 @@ osg::Node* ThreeDTileNode::getContent()
 bool ThreeDTileNode::isContentReady()
 {
     resolveContent();
-    return _content.valid();
+
+    // Failed content will never arrive, so don't hold up refinement for it.
+    return _content.valid() || _contentFailed;
 }
 
 void ThreeDTileNode::resolveContent()
 {
     // Resolve the future
-    if (!_content.valid() && _requestedContent && _contentFuture.isAvailable())
+    if (!_content.valid() && !_compilingContent.valid() && _requestedContent && _contentFuture.isAvailable())
     {
-        _content = _contentFuture.release();
+        _compilingContent = _contentFuture.release();
 
-        if (_content.valid())
+        // An ICO has already compiled it; otherwise queue the GL objects
+        // and keep showing the parent until they are done.
+        GLObjectCompiler* compiler = _tileset->getGLObjectCompiler();
+        if (_compilingContent.valid() && !_usesICO && compiler)
+        {
+            _compileJob = new GLObjectCompiler::Job();
+            _compileJob->add(_compilingContent.get());
+            compiler->submit(_compileJob.get());
+        }
+
+        if (!_compilingContent.valid())
+        {
+            // The read failed. Remember that, so the scheduler releases the
+            // request and the tile is not requested again.
+            _contentFailed = true;
+            _requestedContent = false;
+            _contentFuture = Future<osg::Node>();
+        }
+    }
+
+    if (_compilingContent.valid() && (!_compileJob.valid() || _compileJob->isComplete()))
+    {
+        _content = _compilingContent.release();
+        _compileJob = 0L;
+
+        _contentBytes = computeContentBytes(_content.get());
+        _tileset->addResidentBytes(_contentBytes);
+
+        // Assign the parent node if we just loaded a tileset
+        ThreeDTilesetContentNode* tilesetContentNode = dynamic_cast<ThreeDTilesetContentNode*>(_content.get());
+        if (tilesetContentNode)
         {
-            // Assign the parent node if we just loaded a tileset
-            ThreeDTilesetContentNode* tilesetContentNode = dynamic_cast<ThreeDTilesetContentNode*>(_content.get());
-            if (tilesetContentNode)
+            ThreeDTileNode* tileNode = tilesetContentNode->getTileNode();
+            if (tileNode)
             {
-                ThreeDTileNode* tileNode = tilesetContentNode->getTileNode();
-                if (tileNode)
-                {
-                    tileNode->setParentTile(this);
-                }
+                tileNode->setParentTile(this);
             }
-
-            _tileset->runPreMergeOperations(_content.get());
-            _tileset->runPostMergeOperations(_content.get());
         }
+
+        _tileset->runPreMergeOperations(_content.get());
+        _tileset->runPostMergeOperations(_content.get());
     }
 }
 
 
-void ThreeDTileNode::requestContent(osgUtil::IncrementalCompileOperation* ico)
+void ThreeDTileNode::requestContent(osgUtil::IncrementalCompileOperation* ico, double deficit, double distance)
+{
+    if (!_content.valid() && !_contentFailed && hasContent())
+    {
+        _tileset->requestContent(this, deficit, distance, ico);
+    }
+}
+
+void ThreeDTileNode::startRequest(osgUtil::IncrementalCompileOperation* ico)
 {
-    if (!_content.valid() && !_requestedContent && hasContent())
+    if (!_content.valid() && !_requestedContent && !_contentFailed && hasContent())
     {
         // if there's an ICO, install it:
         osg::ref_ptr<osgDB::Options> localOptions;
@@ -934,6 +1819,7 @@ void ThreeDTileNode::requestContent(osgUtil::IncrementalCompileOperation* ico)
         {
             localOptions = _options.get();
         }
+        _usesICO = (ico != 0L);
 
         URIContext context = _tile->content()->uri()->context();
         if (!_tileset->getAuthorizationHeader().empty())
@@ -951,12 +1837,23 @@ void ThreeDTileNode::requestContent(osgUtil::IncrementalCompileOperation* ico)
         }
         else
         {
-            _contentFuture = uri.readNodeAsync(localOptions.get(), NULL);
+            _contentFuture = readContentAsync(uri, localOptions.get());
         }
         _requestedContent = true;
     }
 }
 
+void ThreeDTileNode::cancelRequest()
+{
+    if (_requestedContent && !_content.valid())
+    {
+        _contentFuture = Future<osg::Node>();
+        _compilingContent = 0L;
+        _compileJob = 0L;
+        _requestedContent = false;
+    }
+}
+
 double ThreeDTileNode::getDistanceToTile(osgUtil::CullVisitor* cv)
 {
     osg::BoundingSphere bs = _localBoundingSphere;
@@ -999,8 +1896,13 @@ bool ThreeDTileNode::unloadContent()
         }
     }
 
+    _tileset->removeResidentBytes(_contentBytes);
+    _contentBytes = 0u;
+
     _firstVisit = true;
     _content = 0;
+    _compilingContent = 0L;
+    _compileJob = 0L;
     _requestedContent = false;
     _contentFuture = Future<osg::Node>();
 
@@ -1085,6 +1987,11 @@ void ThreeDTileNode::traverse(osg::NodeVisitor& nv)
             }
         }
 
+        _lastTraversedFrameTime = cv->getFrameStamp()->getReferenceTime();
+
+        // Make sure the children exist so their content can be requested ahead of refinement.
+        createChildren();
+
         // Get the ICO so we can do incremental compiliation
         osgUtil::IncrementalCompileOperation* ico = 0;
         osgViewer::View* osgView = dynamic_cast<osgViewer::View*>(cv->getCurrentCamera()->getView());
@@ -1093,12 +2000,20 @@ void ThreeDTileNode::traverse(osg::NodeVisitor& nv)
             ico = osgView->getDatabasePager()->getIncrementalCompileOperation();
         }
 
-        // This allows nodes to reload themselves
-        requestContent(ico);
-        resolveContent();
-
         // Compute the SSE
         double error = computeScreenSpaceError(cv);
+        _lastScreenSpaceError = error;
+
+        // This allows nodes to reload themselves. The request is as urgent as
+        // the refinement of the parent that led here.
+        double deficit = std::numeric_limits<double>::max();
+        osg::ref_ptr< ThreeDTileNode > parentTile;
+        if (_parentTile.lock(parentTile))
+        {
+            deficit = parentTile->_lastScreenSpaceError - _tileset->getMaximumScreenSpaceError();
+        }
+        requestContent(ico, deficit, getDistanceToTile(cv));
+        resolveContent();
 
         updateTracking(cv);
 
@@ -1115,7 +2030,7 @@ void ThreeDTileNode::traverse(osg::NodeVisitor& nv)
                     // Can we traverse the child?
                     if (childTile->hasContent() && !childTile->isContentReady())
                     {
-                        childTile->requestContent(ico);
+                        childTile->requestContent(ico, error - _tileset->getMaximumScreenSpaceError(), childTile->getDistanceToTile(cv));
                         areChildrenReady = false;
                     }
                 }
@@ -1220,6 +2135,11 @@ ThreeDTilesetNode::ThreeDTilesetNode(Tileset* tileset, const std::string& author
     _tileset(tileset),
     _options(options),
     _maximumScreenSpaceError(15.0f),
+    _maxConcurrentRequests(4u),
+    _numActiveRequests(0u),
+    _cullFrameNumber(0u),
+    _maxResidentBytes(0u),
+    _residentBytes(0u),
     _maxTiles(50),
     _showBoundingVolumes(false),
     _showColorPerTile(false),
@@ -1230,6 +2150,8 @@ ThreeDTilesetNode::ThreeDTilesetNode(Tileset* tileset, const std::string& author
 	_sseDenominator(1.0)
 {
     ADJUST_UPDATE_TRAV_COUNT(this, +1);
+
+    _compiler = new GLObjectCompiler();
     const char* c = ::getenv("OSGEARTH_3DTILES_CACHE_SIZE");
     if (c)
     {
@@ -1242,6 +2164,18 @@ ThreeDTilesetNode::ThreeDTilesetNode(Tileset* tileset, const std::string& author
         setMaxAge((float)atof(c));
     }
 
+    c = ::getenv("OSGEARTH_3DTILES_MAX_REQUESTS");
+    if (c)
+    {
+        setMaxConcurrentRequests((unsigned)atoi(c));
+    }
+
+    c = ::getenv("OSGEARTH_3DTILES_MAX_BYTES");
+    if (c)
+    {
+        setMaxResidentBytes((size_t)atof(c));
+    }
+
     _tracker.push_back(0);
     // Pointer to last element
     _sentryItr = --_tracker.end();
@@ -1289,6 +2223,46 @@ void ThreeDTilesetNode::setMaxAge(float maxAge)
     _maxAge = maxAge;
 }
 
+unsigned int ThreeDTilesetNode::getMaxConcurrentRequests() const
+{
+    return _maxConcurrentRequests;
+}
+
+void ThreeDTilesetNode::setMaxConcurrentRequests(unsigned int value)
+{
+    _maxConcurrentRequests = osg::maximum(value, 1u);
+}
+
+unsigned int ThreeDTilesetNode::getNumActiveRequests() const
+{
+    return _numActiveRequests;
+}
+
+size_t ThreeDTilesetNode::getMaxResidentBytes() const
+{
+    return _maxResidentBytes;
+}
+
+void ThreeDTilesetNode::setMaxResidentBytes(size_t value)
+{
+    _maxResidentBytes = value;
+}
+
+size_t ThreeDTilesetNode::getResidentBytes() const
+{
+    return _residentBytes;
+}
+
+void ThreeDTilesetNode::addResidentBytes(unsigned bytes)
+{
+    _residentBytes += bytes;
+}
+
+void ThreeDTilesetNode::removeResidentBytes(unsigned bytes)
+{
+    _residentBytes -= bytes;
+}
+
 float ThreeDTilesetNode::getMaximumScreenSpaceError() const
 {
     return _maximumScreenSpaceError;
@@ -1376,6 +2350,180 @@ void ThreeDTilesetNode::touchTile(ThreeDTileNode* node)
     node->_trackerItr = --_tracker.end();
 }
 
+void ThreeDTilesetNode::trackHydratedTile(ThreeDTileNode* node)
+{
+    ScopedMutexLock lock(_mutex);
+    _hydrated.push_back(node);
+}
+
+void ThreeDTilesetNode::releaseColdSubtrees(const osg::NodeVisitor& nv)
+{
+    OE_PROFILING_ZONE;
+
+    float frameTime = nv.getFrameStamp()->getReferenceTime();
+
+    osg::Timer_t startTime = osg::Timer::instance()->tick();
+
+    ScopedMutexLock lock(_mutex);
+
+    // Max time in ms to allocate to releasing subtrees
+    float maxTime = 1.0f;
+
+    // Tiles that stay hydrated move to the back, so each frame
+    // picks up where the last one ran out of time.
+    unsigned int count = _hydrated.size();
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        HydratedTiles::iterator itr = _hydrated.begin();
+
+        osg::ref_ptr< ThreeDTileNode > tile;
+        if (!itr->lock(tile))
+        {
+            _hydrated.erase(itr);
+        }
+        else if (frameTime - tile->getLastTraversedFrameTime() >= _maxAge && tile->releaseChildren(_tracker))
+        {
+            _hydrated.erase(itr);
+        }
+        else
+        {
+            _hydrated.splice(_hydrated.end(), _hydrated, itr);
+        }
+
+        if (osg::Timer::instance()->delta_m(startTime, osg::Timer::instance()->tick()) > maxTime)
+        {
+            break;
+        }
+    }
+}
+
+void ThreeDTilesetNode::requestContent(ThreeDTileNode* node, double deficit, double distance, osgUtil::IncrementalCompileOperation* ico)
+{
+    ScopedMutexLock lock(_requestsMutex);
+
+    ContentRequests::iterator itr = _requests.find(node);
+
+    // New request, or a new tile at the address of a dead one
+    if (itr == _requests.end() || !itr->second._node.valid())
+    {
+        if (itr != _requests.end() && itr->second._active)
+        {
+            --_numActiveRequests;
+        }
+
+        ContentRequest& request = _requests[node];
+        request._node = node;
+        request._ico = ico;
+        request._deficit = deficit;
+        request._distance = distance;
+        request._lastFrame = _cullFrameNumber;
+        request._active = false;
+        return;
+    }
+
+    ContentRequest& request = itr->second;
+
+    // Keep the most urgent ranking if several cameras or parents ask in the same frame.
+    if (request._lastFrame != _cullFrameNumber ||
+        deficit > request._deficit ||
+        (deficit == request._deficit && distance < request._distance))
+    {
+        request._deficit = deficit;
+        request._distance = distance;
+    }
+
+    request._lastFrame = _cullFrameNumber;
+
+    if (ico)
+    {
+        request._ico = ico;
+    }
+}
+
+void ThreeDTilesetNode::dispatchRequests(const osg::NodeVisitor& nv)
+{
+    OE_PROFILING_ZONE;
+
+    unsigned int frameNumber = nv.getFrameStamp()->getFrameNumber();
+
+    ScopedMutexLock lock(_requestsMutex);
+
+    std::vector< ContentRequest* > pending;
+
+    ContentRequests::iterator itr = _requests.begin();
+    while (itr != _requests.end())
+    {
+        ContentRequest& request = itr->second;
+
+        // The cull renews every request it still wants each frame, so
+        // anything it did not ask for last frame is out of view or no
+        // longer needed for refinement.
+        bool stale = frameNumber > request._lastFrame + 1u;
+
+        bool done;
+        osg::ref_ptr< ThreeDTileNode > node;
+        if (!request._node.lock(node))
+        {
+            done = true;
+        }
+        else if (request._active)
+        {
+            // finished, or failed (which also clears the request)
+            done = stale || !node->isContentRequested();
+            if (stale)
+            {
+                node->cancelRequest();
+            }
+        }
+        else
+        {
+            done = stale || node->getContent() != 0L || node->isContentRequested() || node->isContentFailed();
+        }
+
+        if (done)
+        {
+            if (request._active)
+            {
+                --_numActiveRequests;
+            }
+            _requests.erase(itr++);
+        }
+        else
+        {
+            if (!request._active)
+            {
+                pending.push_back(&request);
+            }
+            ++itr;
+        }
+    }
+
+    if (_numActiveRequests >= _maxConcurrentRequests || pending.empty())
+    {
+        return;
+    }
+
+    // Most urgent first: the largest SSE deficit, then the closest tile.
+    std::sort(pending.begin(), pending.end(), [](const ContentRequest* lhs, const ContentRequest* rhs)
+    {
+        if (lhs->_deficit != rhs->_deficit)
+            return lhs->_deficit > rhs->_deficit;
+        return lhs->_distance < rhs->_distance;
+    });
+
+    for (unsigned int i = 0; i < pending.size() && _numActiveRequests < _maxConcurrentRequests; ++i)
+    {
+        osg::ref_ptr< ThreeDTileNode > node;
+        osg::ref_ptr< osgUtil::IncrementalCompileOperation > ico;
+        pending[i]->_node.lock(node);
+        pending[i]->_ico.lock(ico);
+
+        node->startRequest(ico.get());
+        pending[i]->_active = true;
+        ++_numActiveRequests;
+    }
+}
+
 void ThreeDTilesetNode::expireTiles(const osg::NodeVisitor& nv)
 {
     OE_PROFILING_ZONE;
@@ -1395,7 +2543,7 @@ void ThreeDTilesetNode::expireTiles(const osg::NodeVisitor& nv)
 
     unsigned int numErased = 0;
     unsigned int numSkipped = 0;
-    while (_tracker.size() > _maxTiles && itr != _sentryItr)
+    while ((_tracker.size() > _maxTiles || (_maxResidentBytes > 0u && _residentBytes > _maxResidentBytes)) && itr != _sentryItr)
     {
         osg::ref_ptr< ThreeDTileNode > tile = dynamic_cast<ThreeDTileNode*>(itr->get());
         if (tile.valid())
@@ -1445,17 +2593,22 @@ void ThreeDTilesetNode::traverse(osg::NodeVisitor& nv)
         if (nv.getFrameStamp()->getFrameNumber() > _lastExpiredFrame)
         {
             expireTiles(nv);
+            releaseColdSubtrees(nv);
+            dispatchRequests(nv);
             _lastExpiredFrame = nv.getFrameStamp()->getFrameNumber();
         }
     }
 	else if (nv.getVisitorType() == nv.CULL_VISITOR)
 	{
 		osgUtil::CullVisitor* cv = static_cast<osgUtil::CullVisitor*>(&nv);
+		_cullFrameNumber = cv->getFrameStamp()->getFrameNumber();
 		const osg::Matrix& proj = cv->getCurrentCamera()->getProjectionMatrix();
 		double height = cv->getCurrentCamera()->getViewport()->height();
 		double fovy, ar, zn, zf;
 		proj.getPerspective(fovy, ar, zn, zf);
 		_sseDenominator = 2.0 * tan(0.5 * osg::DegreesToRadians(fovy));
+
+		_compiler->accept(nv);
 	}
 
     osg::Group::traverse(nv);
@@ -29,6 +29,7 @@
 #include <osgEarth/MVT>
 #include <osgEarth/OgrUtils>
 #include <osgEarth/FeatureCursor>
+#include <osgEarth/GeoJSON>
 
 #include <osg/Notify>
 #include <osgDB/FileNameUtils>
@@ -343,6 +344,23 @@ TFSFeatureSource::getFeatures(const std::string& buffer, const TileKey& key, con
         return false;
 #endif
     }
+    else if (isJSON(mimeType))
+    {
+        // GeoJSON decodes straight into features without going through OGR.
+        FeatureList result;
+        std::string error;
+        if (!Util::GeoJSONReader::readFeatures(buffer, getFeatureProfile(), *_options->rewindPolygons(), result, error))
+        {
+            OE_WARN << LC << "Error reading TFS response: " << error << std::endl;
+            return false;
+        }
+
+        for (FeatureList::iterator f = result.begin(); f != result.end(); ++f)
+        {
+            if (!isBlacklisted(f->get()->getFID()))
+                features.push_back(f->get());
+        }
+    }
     else
     {
         // find the right driver for the given mime type
@@ -350,7 +368,6 @@ TFSFeatureSource::getFeatures(const std::string& buffer, const TileKey& key, con
 
         // find the right driver for the given mime type
         OGRSFDriverH ogrDriver =
-            isJSON(mimeType) ? OGRGetDriverByName("GeoJSON") :
             isGML(mimeType) ? OGRGetDriverByName("GML") :
             0L;
 
@@ -63,6 +63,11 @@ TerrainOptions::getConfig() const
     conf.set( "morph_imagery", morphImagery() );
     conf.set( "merges_per_frame", mergesPerFrame() );
     conf.set( "priority_scale", priorityScale() );
+    conf.set( "native_loader", nativeLoader() );
+    conf.set( "loader_threads", loaderThreads() );
+    conf.set( "merge_budget", mergeBudget() );
+    conf.set( "compile_budget", compileBudget() );
+    conf.set( "layer_threads", layerThreads() );
 
     return conf;
 }
@@ -102,6 +107,11 @@ TerrainOptions::fromConfig(const Config& conf)
     morphImagery().init(true);
     mergesPerFrame().init(20u);
     priorityScale().init(1.0f);
+    nativeLoader().init(false);
+    loaderThreads().init(0u);
+    mergeBudget().init(4.0f);
+    compileBudget().init(2.0f);
+    layerThreads().init(0u);
 
     conf.get( "tile_size", _tileSize );
     conf.get( "vertical_scale", _verticalScale );
@@ -137,6 +147,11 @@ TerrainOptions::fromConfig(const Config& conf)
     conf.get( "morph_imagery", morphImagery() );
     conf.get( "merges_per_frame", mergesPerFrame() );
     conf.get( "priority_scale", priorityScale());
+    conf.get( "native_loader", nativeLoader() );
+    conf.get( "loader_threads", loaderThreads() );
+    conf.get( "merge_budget", mergeBudget() );
+    conf.get( "compile_budget", compileBudget() );
+    conf.get( "layer_threads", layerThreads() );
 }
 
 //...................................................................
@@ -179,6 +194,11 @@ OE_PROPERTY_IMPL(TerrainOptionsAPI, bool, MorphTerrain, morphTerrain);
 OE_PROPERTY_IMPL(TerrainOptionsAPI, bool, MorphImagery, morphImagery);
 OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, MergesPerFrame, mergesPerFrame);
 OE_PROPERTY_IMPL(TerrainOptionsAPI, float, PriorityScale, priorityScale);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, bool, NativeLoader, nativeLoader);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, LoaderThreads, loaderThreads);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, float, MergeBudget, mergeBudget);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, float, CompileBudget, compileBudget);
+OE_PROPERTY_IMPL(TerrainOptionsAPI, unsigned, LayerThreads, layerThreads);
 
 void
 TerrainOptionsAPI::setDriver(const std::string& value)
@@ -22,8 +22,9 @@
 #include <osgEarth/Registry>
 #include <osgEarth/LandCoverLayer>
 #include <osgEarth/Metrics>
-
 #include <osgEarth/Metrics>
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/ThreadingUtils>
 #include <osg/ConcurrencyViewerMacros>
 #include <osg/Texture2D>
 #include <osg/Texture2DArray>
@@ -31,6 +32,20 @@
 #define LC "[TerrainTileModelFactory] "
 
 using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    MetricsRegistry::Histogram* layerCreateTime(const std::string& layerName)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("layer", layerName));
+        return MetricsRegistry::instance()->histogram(
+            "osgearth_tile_layer_create_seconds",
+            "Time spent creating one tile's data for a layer",
+            labels);
+    }
+}
 
 //.........................................................................
 
@@ -38,6 +53,7 @@ CreateTileManifest::CreateTileManifest()
 {
     _includesElevation = false;
     _includesLandCover = false;
+    _useFallbackImages = false;
 }
 
 void CreateTileManifest::insert(const Layer* layer)
@@ -116,6 +132,16 @@ bool CreateTileManifest::includesLandCover() const
     return empty() || _includesLandCover;
 }
 
+void CreateTileManifest::setUseFallbackImages(bool value)
+{
+    _useFallbackImages = value;
+}
+
+bool CreateTileManifest::getUseFallbackImages() const
+{
+    return _useFallbackImages;
+}
+
 //.........................................................................
 
 TerrainTileModelFactory::TerrainTileModelFactory(const TerrainOptions& options) :
@@ -141,22 +167,35 @@ TerrainTileModelFactory::createTileModel(
     ProgressCallback*                progress)
 {
     OE_PROFILING_ZONE;
+
+    static MetricsRegistry::Histogram* s_createTime = MetricsRegistry::instance()->histogram(
+        "osgearth_tile_model_create_seconds",
+        "Time spent creating a complete terrain tile model");
+    MetricsRegistry::ScopedTimer timer(s_createTime);
+
     // Make a new model:
     osg::ref_ptr<TerrainTileModel> model = new TerrainTileModel(
         key,
         map->getDataModelRevision() );
 
     // assemble all the components:
-    addColorLayers(model.get(), map, requirements, key, manifest, progress, false);
-
-    if ( requirements == 0L || requirements->elevationTexturesRequired() )
+    if (_options.layerThreads().get() > 1u)
     {
-        unsigned border = (requirements && requirements->elevationBorderRequired()) ? 1u : 0u;
-
-        addElevation( model.get(), map, key, manifest, border, progress );
+        assembleConcurrently(model.get(), map, key, manifest, requirements, progress);
     }
+    else
+    {
+        addColorLayers(model.get(), map, requirements, key, manifest, progress, false);
 
-    addLandCover(model.get(), map, key, requirements, manifest, progress);
+        if ( requirements == 0L || requirements->elevationTexturesRequired() )
+        {
+            unsigned border = (requirements && requirements->elevationBorderRequired()) ? 1u : 0u;
+
+            addElevation( model.get(), map, key, manifest, border, progress );
+        }
+
+        addLandCover(model.get(), map, key, requirements, manifest, progress);
+    }
 
     //addPatchLayers(model.get(), map, key, filter, progress, false);
 
@@ -164,6 +203,106 @@ TerrainTileModelFactory::createTileModel(
     return model.release();
 }
 
+void
+TerrainTileModelFactory::assembleConcurrently(
+    TerrainTileModel*                model,
+    const Map*                       map,
+    const TileKey&                   key,
+    const CreateTileManifest&        manifest,
+    const TerrainEngineRequirements* requirements,
+    ProgressCallback*                progress)
+{
+    OE_PROFILING_ZONE;
+
+    static MetricsRegistry::Histogram* s_criticalPath = MetricsRegistry::instance()->histogram(
+        "osgearth_tile_model_critical_path_seconds",
+        "Longest single layer subtask of a concurrently assembled tile model");
+    static MetricsRegistry::Histogram* s_serialTime = MetricsRegistry::instance()->histogram(
+        "osgearth_tile_model_serial_seconds",
+        "Sum of the layer subtasks of a concurrently assembled tile model");
+
+    // Once the tile is abandoned, subtasks that have not started are skipped.
+    osg::ref_ptr<Threading::ForkJoin> job = new Threading::ForkJoin(progress);
+
+    // Each color layer builds into a scratch model of its own so the
+    // subtasks share nothing; the results go into the real model in map
+    // order after the join. Non-image layers need no work and take their
+    // slot directly.
+    LayerVector layers;
+    map->getLayers(layers);
+
+    std::vector<osg::ref_ptr<TerrainTileModel> > scratch;
+    std::vector<osg::ref_ptr<TerrainTileColorLayerModel> > direct;
+
+    for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        Layer* layer = i->get();
+
+        if (!layer->isOpen())
+            continue;
+
+        if (layer->getRenderType() != layer->RENDERTYPE_TERRAIN_SURFACE)
+            continue;
+
+        if (manifest.excludes(layer))
+            continue;
+
+        ImageLayer* imageLayer = dynamic_cast<ImageLayer*>(layer);
+        if (imageLayer)
+        {
+            TerrainTileModel* layerModel = new TerrainTileModel(key, model->getRevision());
+            scratch.push_back(layerModel);
+            direct.push_back(0L);
+            job->add([=]() { addImageLayer(layerModel, imageLayer, key, manifest, requirements, progress); });
+        }
+        else
+        {
+            TerrainTileColorLayerModel* colorModel = new TerrainTileColorLayerModel();
+            colorModel->setLayer(layer);
+            colorModel->setRevision(layer->getRevision());
+            scratch.push_back(0L);
+            direct.push_back(colorModel);
+        }
+    }
+
+    // Elevation and land cover write to separate members of the model,
+    // so they can build straight into it.
+    if (requirements == 0L || requirements->elevationTexturesRequired())
+    {
+        unsigned border = (requirements && requirements->elevationBorderRequired()) ? 1u : 0u;
+        job->add([=]() { addElevation(model, map, key, manifest, border, progress); });
+    }
+
+    job->add([=]() { addLandCover(model, map, key, requirements, manifest, progress); });
+
+    job->run(_options.layerThreads().get());
+
+    for (unsigned i = 0; i < scratch.size(); ++i)
+    {
+        if (direct[i].valid())
+        {
+            model->colorLayers().push_back(direct[i].get());
+        }
+        else if (!scratch[i]->colorLayers().empty())
+        {
+            TerrainTileModel* layerModel = scratch[i].get();
+            model->colorLayers().insert(model->colorLayers().end(),
+                layerModel->colorLayers().begin(), layerModel->colorLayers().end());
+            model->sharedLayers().insert(model->sharedLayers().end(),
+                layerModel->sharedLayers().begin(), layerModel->sharedLayers().end());
+            if (layerModel->requiresUpdateTraverse())
+                model->setRequiresUpdateTraverse(true);
+        }
+    }
+
+    // An abandoned tile skips work, so its timings would only skew the stats.
+    if (progress == 0L || !progress->isCanceled())
+    {
+        s_criticalPath->record(job->getLongestTask());
+        s_serialTime->record(job->getTotalTime());
+    }
+}
+
 TerrainTileModel*
 TerrainTileModelFactory::createStandaloneTileModel(
     const Map*                       map,
@@ -196,11 +335,22 @@ TerrainTileModelFactory::createStandaloneTileModel(
     return model.release();
 }
 
+MetricsRegistry::Histogram*
+TerrainTileModelFactory::getLayerCreateTime(const Layer* layer) const
+{
+    Threading::ScopedMutexLock lock(_layerCreateTimeMutex);
+    MetricsRegistry::Histogram*& histogram = _layerCreateTime[layer->getUID()];
+    if (histogram == NULL)
+        histogram = layerCreateTime(layer->getName());
+    return histogram;
+}
+
 TerrainTileImageLayerModel*
 TerrainTileModelFactory::addImageLayer(
     TerrainTileModel* model,
     ImageLayer* imageLayer,
     const TileKey& key,
+    const CreateTileManifest& manifest,
     const TerrainEngineRequirements* reqs,
     ProgressCallback* progress)
 {
@@ -208,10 +358,31 @@ TerrainTileModelFactory::addImageLayer(
     osg::Texture* tex = 0L;
     TextureWindow window;
     osg::Matrix scaleBiasMatrix;
+    bool fallback = false;
         
     if (imageLayer->isKeyInLegalRange(key) && imageLayer->mayHaveData(key))
     {
-        if (imageLayer->useCreateTexture())
+        // A placeholder from the ancestor cache costs no I/O; the caller
+        // sees the fallback flag and fetches the real tile afterwards.
+        GeoImage placeholder;
+        if (manifest.getUseFallbackImages() && !imageLayer->useCreateTexture())
+        {
+            placeholder = imageLayer->createFallbackImage(key);
+        }
+
+        MetricsRegistry::ScopedTimer timer(placeholder.valid() ? 0L : getLayerCreateTime(imageLayer));
+
+        if (placeholder.valid())
+        {
+            if (imageLayer->isCoverage())
+                tex = createCoverageTexture(placeholder.getImage());
+            else
+                tex = createImageTexture(placeholder.getImage(), imageLayer);
+
+            fallback = true;
+        }
+
+        else if (imageLayer->useCreateTexture())
         {
             window = imageLayer->createTexture(key, progress);
             tex = window.getTexture();
@@ -220,7 +391,7 @@ TerrainTileModelFactory::addImageLayer(
 
         else
         {
-            GeoImage geoImage = imageLayer->createImage(key, progress);
+            GeoImage geoImage = imageLayer->createGPUReadyImage(key, progress);
 
             if (geoImage.valid())
             {
@@ -252,6 +423,7 @@ TerrainTileModelFactory::addImageLayer(
         layerModel->setTexture(tex);
         layerModel->setMatrix(new osg::RefMatrixf(scaleBiasMatrix));
         layerModel->setRevision(imageLayer->getRevision());
+        layerModel->setFallback(fallback);
 
         model->colorLayers().push_back(layerModel);
 
@@ -282,7 +454,7 @@ TerrainTileModelFactory::addStandaloneImageLayer(
     osg::Matrixf scaleBiasMatrix;
     while (keyToUse.valid() && !layerModel)
     {
-        layerModel = addImageLayer(model, imageLayer, keyToUse, reqs, progress);
+        layerModel = addImageLayer(model, imageLayer, keyToUse, CreateTileManifest(), reqs, progress);
         if (!layerModel)
         {
             TileKey parentKey = keyToUse.createParentKey();
@@ -343,7 +515,7 @@ TerrainTileModelFactory::addColorLayers(
             }
             else
             {
-                addImageLayer(model, imageLayer, key, reqs, progress);
+                addImageLayer(model, imageLayer, key, manifest, reqs, progress);
             }
         }
         else // non-image kind of TILE layer:
@@ -433,7 +605,15 @@ TerrainTileModelFactory::addElevation(
 
     const bool acceptLowerRes = false;
 
-    if (map->getElevationPool()->getTile(key, acceptLowerRes, elevTex, NULL))
+    static MetricsRegistry::Histogram* s_elevationCreateTime = layerCreateTime("elevation");
+
+    bool gotTile;
+    {
+        MetricsRegistry::ScopedTimer timer(s_elevationCreateTime);
+        gotTile = map->getElevationPool()->getTile(key, acceptLowerRes, elevTex, NULL);
+    }
+
+    if (gotTile)
     {
         osg::ref_ptr<TerrainTileElevationModel> layerModel = new TerrainTileElevationModel();
 
@@ -659,14 +839,25 @@ TerrainTileModelFactory::createImageTexture(osg::Image*       image,
     // For GL_RED, swizzle the RGBA all to RED in order to match old GL_LUMINANCE behavior
     for(unsigned i=0; i<tex->getNumImages(); ++i)
     {
-        if (tex->getImage(i) && tex->getImage(i)->getPixelFormat() == GL_RED)
+        if (tex->getImage(i) &&
+            (tex->getImage(i)->getPixelFormat() == GL_RED ||
+             tex->getImage(i)->getPixelFormat() == GL_COMPRESSED_RED_RGTC1_EXT))
         {
             tex->setSwizzle(osg::Vec4i(GL_RED, GL_RED, GL_RED, GL_RED));
             break;
         }
     }
 
+    // Pre-compressed, pre-mipmapped (GPU-ready) images go straight to the GPU.
+    if (ImageUtils::isCompressed(image))
+    {
+        tex->setInternalFormatMode(osg::Texture::USE_IMAGE_DATA_FORMAT);
+        return tex;
+    }
+
     layer->applyTextureCompressionMode(tex);
+
+    if (!image->isMipmap())
     {
         Threading::ScopedMutexLock lock(_mipmapMutex);
         ImageUtils::generateMipmaps(tex);
@@ -721,8 +912,11 @@ TerrainTileModelFactory::createNormalTexture(osg::Image* image, bool compress) c
         // Only compress the image if it's not already compressed.
         if (image->getPixelFormat() != GL_COMPRESSED_RED_GREEN_RGTC2_EXT)
         {
-            // See if we have a CPU compressor generator:
-            osgDB::ImageProcessor* ip = osgDB::Registry::instance()->getImageProcessor();
+            // Prefer the BCn compressor (which builds the mipmap chain itself),
+            // falling back on any other CPU compressor we have:
+            osgDB::ImageProcessor* ip = osgDB::Registry::instance()->getImageProcessorForExtension("bcn");
+            if (!ip)
+                ip = osgDB::Registry::instance()->getImageProcessor();
             if (ip)
             {
                 ip->compress(*image, osg::Texture::USE_RGTC2_COMPRESSION, true, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::NORMAL);
@@ -26,20 +26,32 @@
 
 #ifdef OSGEARTH_CXX11
 
+#include <algorithm>
+#include <limits>
 #include <osgEarth/earcut.hpp>
+
+namespace
+{
+    // A ring vertex projected onto the polygon's plane.
+    struct PlanePoint
+    {
+        double x, y;
+    };
+}
+
 namespace mapbox {
     namespace util {
         template <>
-        struct nth<0, osg::Vec2> {
-            inline static float get(const osg::Vec2 &t) {
-                return t.x();
+        struct nth<0, PlanePoint> {
+            inline static double get(const PlanePoint &t) {
+                return t.x;
             };
         };
 
         template <>
-        struct nth<1, osg::Vec2> {
-            inline static float get(const osg::Vec2 &t) {
-                return t.y();
+        struct nth<1, PlanePoint> {
+            inline static double get(const PlanePoint &t) {
+                return t.y;
             };
         };
     }
@@ -149,44 +161,135 @@ struct TriIndices
 
 typedef std::vector<TriIndices> TriList;
 
-enum AreaPlane{
-    AREA_PLANE_XY,
-    AREA_PLANE_XZ,
-    AREA_PLANE_YZ
-};
+}
 
-AreaPlane polygonPlane(osg::Vec3Array& verts) 
+
+#ifdef USE_EARCUT
+namespace
 {
-    double area[3];
+    // One ring of a polygon, read in place from the vertex array and
+    // projected onto two of the coordinate axes.
+    struct RingView
+    {
+        typedef PlanePoint value_type;
+
+        const osg::Vec3Array* verts;
+        unsigned first;
+        unsigned count;
+        int u, v;
+
+        std::size_t size() const { return count; }
+        bool empty() const { return count == 0u; }
+
+        PlanePoint operator[](std::size_t i) const
+        {
+            const osg::Vec3f& p = (*verts)[first + i];
+            PlanePoint pp = { p[u], p[v] };
+            return pp;
+        }
+
+        // Area in the projection plane; positive when counter-clockwise.
+        double signedArea() const
+        {
+            double sum = 0.0;
+            for (unsigned i = 0, j = count - 1; i < count; j = i++)
+            {
+                PlanePoint a = (*this)[j], b = (*this)[i];
+                sum += a.x * b.y - b.x * a.y;
+            }
+            return 0.5 * sum;
+        }
+    };
 
-    area[0] = area[1] = area[2] = 0;
+    typedef std::vector<RingView> RingViews;
 
-    // Calculate value of shoelace formula 
-    int j = verts.size() - 1;
-    for (int i = 0; i < verts.size(); i++)
+    bool addRing(RingViews& rings, const osg::Vec3Array* verts, unsigned first, unsigned count)
     {
-        area[AREA_PLANE_XY] += (verts[j].x() + verts[i].x()) * (verts[j].y() - verts[i].y());
-        area[AREA_PLANE_XZ] += (verts[j].x() + verts[i].x()) * (verts[j].z() - verts[i].z());
-        area[AREA_PLANE_YZ] += (verts[j].y() + verts[i].y()) * (verts[j].z() - verts[i].z());
-        j = i;  
-    }
+        if (first + count > verts->size())
+            return false;
 
-    double absArea[] = { abs(area[AREA_PLANE_XY] / 2.0), abs(area[AREA_PLANE_XZ] / 2.0), abs(area[AREA_PLANE_YZ] / 2.0) };
-    if (absArea[0] > absArea[1] && absArea[0] > absArea[2]) {
-        return AREA_PLANE_XY;
-    }
-    if (absArea[1] > absArea[0] && absArea[1] > absArea[2]) {
-        return AREA_PLANE_XZ;
+        if (count > 0u)
+        {
+            RingView ring = { verts, first, count, 0, 1 };
+            rings.push_back(ring);
+        }
+        return true;
     }
-    if (absArea[2] > absArea[0] && absArea[2] > absArea[1]) {
-        return AREA_PLANE_YZ;
+
+    // Collects the rings of a geometry; false if it has anything else.
+    bool getRings(osg::Geometry& geom, const osg::Vec3Array* verts, RingViews& rings)
+    {
+        for (unsigned i = 0; i < geom.getNumPrimitiveSets(); ++i)
+        {
+            osg::PrimitiveSet* pset = geom.getPrimitiveSet(i);
+            if (pset->getMode() != osg::PrimitiveSet::POLYGON && pset->getMode() != osg::PrimitiveSet::LINE_LOOP)
+                return false;
+
+            if (pset->getType() == osg::PrimitiveSet::DrawArraysPrimitiveType)
+            {
+                osg::DrawArrays* da = static_cast<osg::DrawArrays*>(pset);
+                if (!addRing(rings, verts, da->getFirst(), da->getCount()))
+                    return false;
+            }
+            else if (pset->getType() == osg::PrimitiveSet::DrawArrayLengthsPrimitiveType)
+            {
+                osg::DrawArrayLengths* dal = static_cast<osg::DrawArrayLengths*>(pset);
+                unsigned first = dal->getFirst();
+                for (osg::DrawArrayLengths::const_iterator len = dal->begin(); len != dal->end(); ++len)
+                {
+                    if (!addRing(rings, verts, first, *len))
+                        return false;
+                    first += *len;
+                }
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return !rings.empty() && rings.front().count >= 3u;
     }
 
-    return AREA_PLANE_XY;
-}
+    // Picks the projection axes from the Newell normal of the outer ring,
+    // ordered so that a counter-clockwise triangle in the projection faces
+    // the same way as the ring. False if the ring has no area.
+    bool getProjection(const RingView& outer, int& u, int& v)
+    {
+        const osg::Vec3Array& verts = *outer.verts;
+        osg::Vec3d normal;
+        for (unsigned i = 0, j = outer.count - 1; i < outer.count; j = i++)
+        {
+            osg::Vec3d a = verts[outer.first + j], b = verts[outer.first + i];
+            normal.x() += (a.y() - b.y()) * (a.z() + b.z());
+            normal.y() += (a.z() - b.z()) * (a.x() + b.x());
+            normal.z() += (a.x() - b.x()) * (a.y() + b.y());
+        }
 
+        double ax = fabs(normal.x()), ay = fabs(normal.y()), az = fabs(normal.z());
+        if (az >= ax && az >= ay && az > 0.0)
+        {
+            u = normal.z() > 0.0 ? 0 : 1;
+            v = normal.z() > 0.0 ? 1 : 0;
+        }
+        else if (ax >= ay && ax > 0.0)
+        {
+            u = normal.x() > 0.0 ? 1 : 2;
+            v = normal.x() > 0.0 ? 2 : 1;
+        }
+        else if (ay > 0.0)
+        {
+            u = normal.y() > 0.0 ? 2 : 0;
+            v = normal.y() > 0.0 ? 0 : 2;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
 }
-
+#endif
 
 bool
 Tessellator::tessellateGeometry(osg::Geometry &geom)
@@ -261,43 +364,81 @@ Tessellator::tessellateGeometry(osg::Geometry &geom)
     }
     return success;
 #else
-    // Create array
-    std::vector< std::vector< osg::Vec2 > > polygon;
-    osg::Vec3Array* verts = static_cast<osg::Vec3Array*>(geom.getVertexArray());
-    int areaPlane = polygonPlane(*verts);
+    const osg::Vec3Array* verts = dynamic_cast<const osg::Vec3Array*>(geom.getVertexArray());
+    if (!verts || verts->empty())
+        return false;
+
+    RingViews rings;
+    rings.reserve(geom.getNumPrimitiveSets());
+    if (!getRings(geom, verts, rings))
+        return false;
+
+    int u, v;
+    if (!getProjection(rings.front(), u, v))
+        return false;
+
+    // the area the triangles should cover:
+    double expectedArea = 0.0;
+    for (RingViews::iterator ring = rings.begin(); ring != rings.end(); ++ring)
+    {
+        ring->u = u;
+        ring->v = v;
+        double area = fabs(ring->signedArea());
+        expectedArea += ring == rings.begin() ? area : -area;
+    }
+
+    mapbox::detail::Earcut<GLuint> earcut;
+    earcut(rings);
+    std::vector<GLuint>& indices = earcut.indices;
+
+    if (indices.empty() || expectedArea <= 0.0)
+        return false;
 
-    for (unsigned int i = 0; i < geom.getNumPrimitiveSets(); i++)
+    // earcut numbers the vertices of all rings consecutively; map those
+    // numbers back to the vertex array.
+    std::vector<unsigned> ringStart(rings.size());
+    bool contiguous = true;
+    for (unsigned r = 0, start = 0; r < rings.size(); start += rings[r++].count)
     {
-        std::vector< osg::Vec2 > ring;
-        osg::PrimitiveSet* pset = geom.getPrimitiveSet(i);
-        if (pset->getType() == osg::PrimitiveSet::DrawArraysPrimitiveType)
+        ringStart[r] = start;
+        contiguous = contiguous && rings[r].first == rings[0].first + start;
+    }
+
+    double area = 0.0;
+    for (unsigned i = 0; i < indices.size(); i += 3)
+    {
+        for (unsigned k = i; k < i + 3; ++k)
         {
-            osg::DrawArrays* drawArray = static_cast<osg::DrawArrays*>(pset);
-            unsigned int first = drawArray->getFirst();
-            unsigned int last = first + drawArray->getCount();
-            ring.reserve(drawArray->getCount());
-            for (unsigned int j = first; j < last; j++)
+            if (contiguous)
             {
-                const osg::Vec3& v = verts->at(j);
-                switch (areaPlane) {
-                    case AREA_PLANE_XY: ring.push_back(osg::Vec2(v.x(), v.y())); break;
-                    case AREA_PLANE_XZ: ring.push_back(osg::Vec2(v.x(), v.z())); break;
-                    case AREA_PLANE_YZ: ring.push_back(osg::Vec2(v.y(), v.z())); break;
-                }
+                indices[k] += rings[0].first;
+            }
+            else
+            {
+                unsigned r = (std::upper_bound(ringStart.begin(), ringStart.end(), indices[k]) - ringStart.begin()) - 1;
+                indices[k] = rings[r].first + (indices[k] - ringStart[r]);
             }
         }
-        polygon.push_back(ring);
+
+        const osg::Vec3f& a = (*verts)[indices[i]];
+        const osg::Vec3f& b = (*verts)[indices[i+1]];
+        const osg::Vec3f& c = (*verts)[indices[i+2]];
+        area += 0.5 * fabs(((double)b[u] - a[u]) * ((double)c[v] - a[v]) - ((double)c[u] - a[u]) * ((double)b[v] - a[v]));
     }
 
-    // The index type. Defaults to uint32_t, but you can also pass uint16_t if you know that your
-    // data won't have more than 65536 vertices.
-    std::vector<uint32_t> indices = mapbox::earcut<uint32_t>(polygon);
-    // Remove the existing primitive sets
+    // earcut does not report failure; on self-intersecting or overlapping
+    // rings it leaves part of the polygon uncovered.
+    if (fabs(area - expectedArea) > 1e-3 * expectedArea)
+    {
+        OE_DEBUG << LC << "earcut covered " << area << " of " << expectedArea << std::endl;
+        return false;
+    }
+
+    osg::DrawElementsUInt* triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+    triangles->asVector().swap(indices);
+
     geom.removePrimitiveSet(0, geom.getNumPrimitiveSets());
-    osg::DrawElementsUInt* drawElements = new osg::DrawElementsUInt(GL_TRIANGLES);
-    drawElements->reserve(indices.size());
-    std::copy(indices.begin(), indices.end(), std::back_inserter(*drawElements));
-    geom.addPrimitiveSet(drawElements);
+    geom.addPrimitiveSet(triangles);
     return true;
 #endif
 }
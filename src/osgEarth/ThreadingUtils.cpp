@@ -21,6 +21,8 @@
 #include <osgDB/ReadFile>
 #include <osgEarth/Utils>
 #include <osgEarth/URI>
+#include <osg/Math>
+#include <osg/Timer>
 
 #ifdef _WIN32
     extern "C" unsigned long __stdcall GetCurrentThreadId();
@@ -283,3 +285,111 @@ ThreadPool::get(const osgDB::Options* options)
     return OptionsData<ThreadPool>::get(options, "osgEarth::ThreadPool");
 }
 
+//------------------------------------------------------------------------
+
+namespace
+{
+    // Pool that runs the helpers of every ForkJoin. It only grows, so
+    // the largest thread count asked for sets its size.
+    Mutex s_forkJoinPoolMutex;
+
+    osg::ref_ptr<ThreadPool> getForkJoinPool(unsigned helpers)
+    {
+        static osg::ref_ptr<ThreadPool> s_pool;
+        static unsigned s_poolSize = 0u;
+
+        ScopedMutexLock lock(s_forkJoinPoolMutex);
+        if (!s_pool.valid() || s_poolSize < helpers)
+        {
+            s_pool = new ThreadPool(helpers);
+            s_poolSize = helpers;
+        }
+        return s_pool;
+    }
+}
+
+struct ForkJoin::Helper : public osg::Operation
+{
+    Helper(ForkJoin* job) : osg::Operation("osgEarth::ForkJoin", false), _job(job) { }
+    void operator()(osg::Object*) { _job->runHelper(); }
+    osg::ref_ptr<ForkJoin> _job;
+};
+
+ForkJoin::ForkJoin(const Cancelable* cancelable) :
+_cancelable(cancelable),
+_next(0u),
+_active(0),
+_closed(false),
+_longest_s(0.0),
+_total_s(0.0)
+{
+    //nop
+}
+
+void
+ForkJoin::run(unsigned numThreads)
+{
+    // Fork: the calling thread is one of the workers.
+    unsigned helpers = numThreads > 1u && size() > 1u ? osg::minimum(numThreads, size()) - 1u : 0u;
+    if (helpers > 0u)
+    {
+        osg::ref_ptr<ThreadPool> pool = getForkJoinPool(numThreads - 1u);
+        for (unsigned i = 0; i < helpers; ++i)
+            pool->getQueue()->add(new Helper(this));
+    }
+
+    work();
+
+    // Join: helpers that have not started by now find the job closed.
+    ScopedMutexLock lock(_mutex);
+    _closed = true;
+    while (_active > 0)
+        _cond.wait(&_mutex);
+}
+
+void
+ForkJoin::runHelper()
+{
+    {
+        ScopedMutexLock lock(_mutex);
+        if (_closed) return;
+        ++_active;
+    }
+
+    work();
+
+    ScopedMutexLock lock(_mutex);
+    if (--_active == 0)
+        _cond.broadcast();
+}
+
+bool
+ForkJoin::claim(unsigned& index)
+{
+    ScopedMutexLock lock(_mutex);
+    if (_closed || _next >= _tasks.size())
+        return false;
+    if (_cancelable && _cancelable->isCanceled())
+    {
+        _next = _tasks.size();
+        return false;
+    }
+    index = _next++;
+    return true;
+}
+
+void
+ForkJoin::work()
+{
+    unsigned index;
+    while (claim(index))
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        _tasks[index]();
+        double t = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        ScopedMutexLock lock(_mutex);
+        _longest_s = osg::maximum(_longest_s, t);
+        _total_s += t;
+    }
+}
@@ -38,6 +38,8 @@ ThreeDTilesLayer::Options::getConfig() const
     Config conf = VisibleLayer::Options::getConfig();
     conf.set("url", _url);
     conf.set("max_sse", _maximumScreenSpaceError);
+    conf.set("max_concurrent_requests", _maxConcurrentRequests);
+    conf.set("max_resident_mb", _maxResidentMB);
     return conf;
 }
 
@@ -45,8 +47,12 @@ void
 ThreeDTilesLayer::Options::fromConfig( const Config& conf )
 {
     _maximumScreenSpaceError.init(15.0f);
+    _maxConcurrentRequests.init(4u);
+    _maxResidentMB.init(0u);
     conf.get("url", _url);
     conf.get("max_sse", _maximumScreenSpaceError);
+    conf.get("max_concurrent_requests", _maxConcurrentRequests);
+    conf.get("max_resident_mb", _maxResidentMB);
 }
 
 //........................................................................
@@ -101,6 +107,8 @@ ThreeDTilesLayer::openImplementation()
 
     _tilesetNode = new ThreeDTilesetNode(tileset, "", getSceneGraphCallbacks(), readOptions.get());
     _tilesetNode->setMaximumScreenSpaceError(*options().maximumScreenSpaceError());
+    _tilesetNode->setMaxConcurrentRequests(*options().maxConcurrentRequests());
+    _tilesetNode->setMaxResidentBytes((size_t)*options().maxResidentMB() * 1048576u);
     _tilesetNode->setOwnerName(getName());
 
     return STATUS_OK;
@@ -122,6 +130,38 @@ ThreeDTilesLayer::setMaximumScreenSpaceError(float maximumScreenSpaceError)
     }
 }
 
+unsigned
+ThreeDTilesLayer::getMaxConcurrentRequests() const
+{
+    return *options().maxConcurrentRequests();
+}
+
+void
+ThreeDTilesLayer::setMaxConcurrentRequests(unsigned value)
+{
+    options().maxConcurrentRequests() = value;
+    if (_tilesetNode)
+    {
+        _tilesetNode->setMaxConcurrentRequests(value);
+    }
+}
+
+unsigned
+ThreeDTilesLayer::getMaxResidentMB() const
+{
+    return *options().maxResidentMB();
+}
+
+void
+ThreeDTilesLayer::setMaxResidentMB(unsigned value)
+{
+    options().maxResidentMB() = value;
+    if (_tilesetNode)
+    {
+        _tilesetNode->setMaxResidentBytes((size_t)value * 1048576u);
+    }
+}
+
 osg::Node*
 ThreeDTilesLayer::getNode() const
 {
@@ -22,6 +22,8 @@
 #include <osgEarth/URI>
 #include <osgEarth/Map>
 #include <osgEarth/MemCache>
+#include <osgEarth/rtree.h>
+#include <algorithm>
 
 using namespace osgEarth;
 using namespace OpenThreads;
@@ -30,6 +32,91 @@ using namespace OpenThreads;
 
 //------------------------------------------------------------------------
 
+namespace
+{
+    typedef RTree<unsigned, double, 2> DataExtentTree;
+
+    // Spatial index of a layer's data extents, in the layer's profile SRS.
+    // Each entry is the index of the extent in the DataExtentList.
+    struct DataExtentIndex : public osg::Referenced
+    {
+        DataExtentIndex(const DataExtentList& de, const Profile* profile) :
+            _source(&de),
+            _size(de.size())
+        {
+            for (unsigned i = 0; i < de.size(); ++i)
+            {
+                GeoExtent extent = profile->clampAndTransformExtent(de[i]);
+                if (extent.isValid())
+                    insert(extent, i);
+                else
+                    _unindexed.push_back(i);
+            }
+        }
+
+        bool isCurrent(const DataExtentList& de) const
+        {
+            return _source == &de && _size == de.size();
+        }
+
+        // Indices of all extents whose boxes intersect the input
+        // extent (which must be in the profile SRS).
+        void find(const GeoExtent& extent, std::vector<unsigned>& output) const
+        {
+            output = _unindexed;
+
+            GeoExtent first, second;
+            if (extent.crossesAntimeridian() && extent.splitAcrossAntimeridian(first, second))
+            {
+                search(first, output);
+                search(second, output);
+                std::sort(output.begin(), output.end());
+                output.erase(std::unique(output.begin(), output.end()), output.end());
+            }
+            else
+            {
+                search(extent, output);
+            }
+        }
+
+        void insert(const GeoExtent& extent, unsigned i)
+        {
+            GeoExtent first, second;
+            if (extent.crossesAntimeridian() && extent.splitAcrossAntimeridian(first, second))
+            {
+                insert(first, i);
+                insert(second, i);
+                return;
+            }
+
+            double minv[2] = { extent.xMin(), extent.yMin() };
+            double maxv[2] = { extent.xMax(), extent.yMax() };
+            _tree.Insert(minv, maxv, i);
+        }
+
+        void search(const GeoExtent& extent, std::vector<unsigned>& output) const
+        {
+            // Pad the query a little. This is only a pre-filter, and the
+            // extents were transformed into this SRS, so err on the side
+            // of returning too many.
+            double pad = 0.01 * osg::maximum(extent.width(), extent.height());
+            double minv[2] = { extent.xMin() - pad, extent.yMin() - pad };
+            double maxv[2] = { extent.xMax() + pad, extent.yMax() + pad };
+
+            std::vector<unsigned> hits;
+            _tree.Search(minv, maxv, &hits, 2 * _size + 1);
+            output.insert(output.end(), hits.begin(), hits.end());
+        }
+
+        DataExtentTree _tree;
+        const DataExtentList* _source;
+        unsigned _size;
+        std::vector<unsigned> _unindexed;
+    };
+}
+
+//------------------------------------------------------------------------
+
 Config
 TileLayer::Options::getConfig() const
 {
@@ -742,6 +829,45 @@ TileLayer::dirtyDataExtents()
 {
     Threading::ScopedMutexLock lock(_mutex);
     _dataExtentsUnion = GeoExtent::INVALID;
+    _dataExtentsIndex = 0L;
+}
+
+void
+TileLayer::findDataExtents(const TileKey& key, std::vector<unsigned>& output) const
+{
+    const DataExtentList& de = getDataExtents();
+    const Profile* profile = getProfile();
+
+    output.clear();
+
+    GeoExtent keyExtent;
+    if (profile)
+    {
+        keyExtent = profile->clampAndTransformExtent(key.getExtent());
+    }
+
+    // Without a profile, or if the key doesn't map into it, check them all.
+    if (!keyExtent.isValid())
+    {
+        output.reserve(de.size());
+        for (unsigned i = 0; i < de.size(); ++i)
+            output.push_back(i);
+        return;
+    }
+
+    osg::ref_ptr<osg::Referenced> index;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        if (!_dataExtentsIndex.valid() ||
+            !static_cast<DataExtentIndex*>(_dataExtentsIndex.get())->isCurrent(de))
+        {
+            _dataExtentsIndex = new DataExtentIndex(de, profile);
+        }
+        index = _dataExtentsIndex.get();
+    }
+
+    static_cast<DataExtentIndex*>(index.get())->find(keyExtent, output);
 }
 
 const DataExtent&
@@ -840,9 +966,15 @@ TileLayer::getBestAvailableTileKey(const TileKey& key) const
     bool     intersects = false;
     unsigned highestLOD = 0;
 
-    // Check each data extent in turn:
-    for (DataExtentList::const_iterator itr = de.begin(); itr != de.end(); ++itr)
+    // Find the data extents that might intersect the key:
+    std::vector<unsigned> candidates;
+    findDataExtents(key, candidates);
+
+    // Check each one in turn:
+    for (std::vector<unsigned>::const_iterator c = candidates.begin(); c != candidates.end(); ++c)
     {
+        DataExtentList::const_iterator itr = de.begin() + *c;
+
         // check for 2D intersection:
         if (key.getExtent().intersects(*itr))
         {
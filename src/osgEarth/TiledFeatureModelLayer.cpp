@@ -228,6 +228,14 @@ TiledFeatureModelLayer::addedToMap(const Map* map)
     }
 }
 
+void
+TiledFeatureModelLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    VisibleLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+    options().styleSheet().getLayerName(names);
+}
+
 void
 TiledFeatureModelLayer::removedFromMap(const Map* map)
 {
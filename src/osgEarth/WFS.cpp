@@ -25,6 +25,7 @@
 
 #include <osgEarth/Filter>
 #include <osgEarth/OgrUtils>
+#include <osgEarth/GeoJSON>
 
 #include <osg/Notify>
 #include <osgDB/FileNameUtils>
@@ -326,15 +327,30 @@ WFSFeatureSource::saveResponse(const std::string buffer, const std::string& file
 bool
 WFSFeatureSource::getFeatures(const std::string& buffer, const std::string& mimeType, FeatureList& features)
 {
-    OGR_SCOPED_LOCK;
+    if (isJSON(mimeType))
+    {
+        // GeoJSON decodes straight into features without going through OGR.
+        FeatureList result;
+        std::string error;
+        if (!Util::GeoJSONReader::readFeatures(buffer, getFeatureProfile(), *_options->rewindPolygons(), result, error))
+        {
+            OE_WARN << LC << "Error reading WFS response: " << error << std::endl;
+            return false;
+        }
 
-    bool json = isJSON(mimeType);
-    bool gml = isGML(mimeType);
+        for (FeatureList::iterator f = result.begin(); f != result.end(); ++f)
+        {
+            if (!isBlacklisted(f->get()->getFID()))
+                features.push_back(f->get());
+        }
+        return true;
+    }
+
+    OGR_SCOPED_LOCK;
 
     // find the right driver for the given mime type
     OGRSFDriverH ogrDriver =
-        json ? OGRGetDriverByName("GeoJSON") :
-        gml ? OGRGetDriverByName("GML") :
+        isGML(mimeType) ? OGRGetDriverByName("GML") :
         0L;
 
     // fail if we can't find an appropriate OGR driver:
@@ -345,25 +361,12 @@ WFSFeatureSource::getFeatures(const std::string& buffer, const std::string& mime
         return false;
     }
 
-    std::string tmpName;
-
-    OGRDataSourceH ds = 0;
-    //GML needs to be saved to a temp file to load from disk.  GeoJSON can be loaded directly from memory
-    if (gml)
-    {
-        std::string ext = getExtensionForMimeType(mimeType);
-        //Save the response to a temp file
-        std::string tmpPath = getTempPath();
-        tmpName = getTempName(tmpPath, ext);
-        saveResponse(buffer, tmpName);
-        ds = OGROpen(tmpName.c_str(), FALSE, &ogrDriver);
-    }
-    else if (json)
-    {
-        //Open GeoJSON directly from memory
-        ds = OGROpen(buffer.c_str(), FALSE, &ogrDriver);
-    }
-
+    // GML needs to be saved to a temp file to load from disk.
+    std::string ext = getExtensionForMimeType(mimeType);
+    std::string tmpPath = getTempPath();
+    std::string tmpName = getTempName(tmpPath, ext);
+    saveResponse(buffer, tmpName);
+    OGRDataSourceH ds = OGROpen(tmpName.c_str(), FALSE, &ogrDriver);
 
     if (!ds)
     {
@@ -125,6 +125,14 @@ BuildingLayer::addedToMap(const Map* map)
     createSceneGraph();
 }
 
+void
+BuildingLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    VisibleLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+    options().styleSheet().getLayerName(names);
+}
+
 void
 BuildingLayer::createSceneGraph()
 {
@@ -23,6 +23,8 @@
 #include <osgEarth/Query>
 #include <osgEarth/StyleSheet>
 #include <osgEarth/Metrics>
+#include <osgEarth/MetricsRegistry>
+#include <osgEarth/ThreadingUtils>
 #include <osgUtil/Optimizer>
 #include <osgUtil/Statistics>
 #include <osg/Version>
@@ -38,6 +40,7 @@
 
 using namespace osgEarth::Buildings;
 using namespace osgEarth;
+using namespace osgEarth::Util;
 
 #define OE_TEST OE_DEBUG
 
@@ -80,10 +83,53 @@ namespace
         osg::ref_ptr<osgDB::ObjectCache> _cache;
     };
 
+    // Callback that puts the GL object compiler in the render bins each
+    // frame so that it gets to run during the draw.
+    struct GLObjectCompilerCallback : public osg::NodeCallback
+    {
+        GLObjectCompilerCallback(GLObjectCompiler* compiler) : _compiler(compiler) { }
+
+        void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            _compiler->accept(*nv);
+            traverse(node, nv);
+        }
+
+        osg::ref_ptr<GLObjectCompiler> _compiler;
+    };
+
     struct ArtCache : public osgDB::ObjectCache
     {
         unsigned size() const { return this->_objectCache.size(); }
     };
+
+    // Fewest features worth building as a separate chunk
+    const unsigned MIN_FEATURES_PER_CHUNK = 32u;
+
+    enum Stage
+    {
+        STAGE_QUERY,
+        STAGE_BUILD,
+        STAGE_MERGE,
+        STAGE_SCENE_GRAPH,
+        STAGE_POST_PROCESS,
+        STAGE_CACHE_WRITE,
+        NUM_STAGES
+    };
+
+    const char* s_stageNames[NUM_STAGES] = {
+        "query", "build", "merge", "scene_graph", "post_process", "cache_write"
+    };
+
+    // Time spent in each stage of one tile
+    const StageTimes::Stages& getStages()
+    {
+        static StageTimes::Stages s_stages(
+            "osgearth_buildings_stage_seconds",
+            "Time spent in each stage of creating a building tile",
+            "stage", s_stageNames, NUM_STAGES);
+        return s_stages;
+    }
 }
 
 
@@ -111,6 +157,11 @@ _filterUsage(FILTER_USAGE_NORMAL)
     this->addCullCallback(new TendArtCacheCallback(_artCache.get()));
 #endif
 
+    // Compiles the GL objects of each new tile a little at a time in
+    // the draw, before the pager hands the tile to the scene graph.
+    _glCompiler = new GLObjectCompiler();
+    this->addCullCallback(new GLObjectCompilerCallback(_glCompiler.get()));
+
     this->getOrCreateStateSet()->setAttributeAndModes(
         new osg::CullFace(), osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
 }
@@ -264,6 +315,7 @@ BuildingPager::createNode(const TileKey& tileKey, ProgressCallback* progress)
     
     bool canceled = false;
     bool caching = true;
+    StageTimes times(getStages());
 
     osg::CVMarkerSeries series2("SubloadParentTask");
     // Try to load from the cache.
@@ -292,57 +344,117 @@ BuildingPager::createNode(const TileKey& tileKey, ProgressCallback* progress)
         osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor(query, progress);
         if (cursor.valid() && cursor->hasMore() && !canceled)
         {
-           osg::CVSpan UpdateTick(series, 4, "buildFromScratch");
-           
-           osg::ref_ptr<BuildingFactory> factory = new BuildingFactory();
+            osg::CVSpan UpdateTick(series, 4, "buildFromScratch");
 
-            factory->setSession(_session.get());
-            factory->setCatalog(_catalog.get());
-            factory->setOutputSRS(_session->getMapSRS());
-
-            // Prepare the terrain envelope, for clamping.
-            // TODO: review the LOD selection..
-            OE_START_TIMER(envelope);
+            // Read all the features up front so they can be split into chunks.
+            OE_START_TIMER(query);
+            std::vector<osg::ref_ptr<Feature> > features;
+            while (cursor->hasMore())
+            {
+                features.push_back(cursor->nextFeature());
+            }
+            numFeatures = features.size();
+            times.add(STAGE_QUERY, OE_GET_TIMER(query));
 
-            // Localized cache for clamping
-            ElevationPool::WorkingSet workingSet;
+            // Resolution of the localized cache for clamping
             std::pair<double,double> resPair = tileKey.getResolution(osgEarth::ELEVATION_TILE_SIZE);
             Distance clampingResolution(resPair.second, tileKey.getProfile()->getSRS()->getUnits());
 
-            //canceled = canceled || !pool.valid();
+            // Every chunk compiles into the same local frame, centered on the tile,
+            // so their outputs can merge without transforming any vertices.
+            GeoPoint centroid;
+            tileKey.getExtent().getCentroid(centroid);
+            osg::Matrixd local2world;
+            centroid.transform(_session->getMapSRS()).createLocalToWorld(local2world);
+            output.setLocalToWorld(local2world);
 
-            while (cursor->hasMore() && !canceled)
+            _compiler->setUsage(_filterUsage);
+
+            // Builds and compiles features [begin, end) into an output.
+            // Each call has its own factory and elevation working set.
+            auto build = [&](unsigned begin, unsigned end, CompilerOutput& out) -> bool
             {
-                Feature* feature = cursor->nextFeature();
-                numFeatures++;
-                
-                BuildingVector buildings;
-                if (!factory->create(feature, tileKey.getExtent(), &workingSet, clampingResolution, style, buildings, readOptions.get(), progress))
-                {
-                    canceled = true;
-                }
+                osg::ref_ptr<BuildingFactory> factory = new BuildingFactory();
+                factory->setSession(_session.get());
+                factory->setCatalog(_catalog.get());
+                factory->setOutputSRS(_session->getMapSRS());
+
+                ElevationPool::WorkingSet workingSet;
 
-                if (!canceled && !buildings.empty())
+                for (unsigned i = begin; i < end; ++i)
                 {
-                    if (output.getLocalToWorld().isIdentity())
+                    Feature* feature = features[i].get();
+
+                    BuildingVector buildings;
+                    if (!factory->create(feature, tileKey.getExtent(), &workingSet, clampingResolution, style, buildings, readOptions.get(), progress))
+                        return false;
+
+                    if (!buildings.empty())
                     {
-                        output.setLocalToWorld(buildings.front()->getReferenceFrame());
+                        // for indexing, if enabled:
+                        out.setCurrentFeature(feature);
+
+                        if (!_compiler->compile(buildings, out, readOptions.get(), progress))
+                            return false;
                     }
+                }
+                return true;
+            };
 
-                    // for indexing, if enabled:
-                    output.setCurrentFeature(feature);
+            unsigned threads = osg::maximum(_compilerSettings.buildThreads().get(), 1u);
+            unsigned numChunks = Threading::ForkJoin::getNumParts(numFeatures, threads, MIN_FEATURES_PER_CHUNK);
 
-                    _compiler->setUsage(_filterUsage);
+            OE_START_TIMER(build);
 
-                    if (!_compiler->compile(buildings, output, readOptions.get(), progress))
-                    {
+            if (threads == 1u || numChunks < 2u)
+            {
+                canceled = !build(0u, numFeatures, output);
+                times.add(STAGE_BUILD, OE_GET_TIMER(build));
+            }
+            else
+            {
+                // Each chunk compiles into an output of its own.
+                std::vector<CompilerOutput> outputs(numChunks);
+                std::vector<int> succeeded(numChunks, 0);
+
+                // Once the tile is canceled, chunks that have not started are skipped.
+                osg::ref_ptr<Threading::ForkJoin> job = new Threading::ForkJoin(progress);
+
+                for (unsigned c = 0; c < numChunks; ++c)
+                {
+                    CompilerOutput& out = outputs[c];
+                    out.setLocalToWorld(local2world);
+                    out.setTextureCache(_texCache.get());
+                    out.setFilterUsage(_filterUsage);
+                    out.setDeferIndexing(_index != 0L);
+
+                    unsigned begin = (numFeatures * c) / numChunks;
+                    unsigned end = (numFeatures * (c + 1u)) / numChunks;
+                    job->add([&, c, begin, end]() { succeeded[c] = build(begin, end, outputs[c]) ? 1 : 0; });
+                }
+
+                job->run(threads);
+                times.add(STAGE_BUILD, OE_GET_TIMER(build));
+
+                // Gather the chunks in feature order. This also tags
+                // their drawables in the feature index, if there is one.
+                OE_START_TIMER(merge);
+                for (unsigned c = 0; c < numChunks && !canceled; ++c)
+                {
+                    if (succeeded[c])
+                        output.merge(outputs[c]);
+                    else
                         canceled = true;
-                    }
                 }
+                times.add(STAGE_MERGE, OE_GET_TIMER(merge));
             }
 
+            canceled = canceled || (progress && progress->isCanceled());
+
             if (!canceled)
             {
+                OE_START_TIMER(sceneGraph);
+
                 // set the distance at which details become visible.
                 osg::BoundingSphere tileBound = getBounds(tileKey);
                 output.setRange(tileBound.radius() * getRangeFactor());
@@ -367,6 +479,8 @@ BuildingPager::createNode(const TileKey& tileKey, ProgressCallback* progress)
                    }
 
                 }
+
+                times.add(STAGE_SCENE_GRAPH, OE_GET_TIMER(sceneGraph));
             }
             else
             {
@@ -385,6 +499,8 @@ BuildingPager::createNode(const TileKey& tileKey, ProgressCallback* progress)
                 applyRenderSymbology(node.get(), *style);
 
             output.postProcess(node.get(), _compilerSettings, progress);
+
+            times.add(STAGE_POST_PROCESS, OE_GET_TIMER(postProcess));
         }
 
         if (node.valid() && cacheWritesEnabled(readOptions.get()) && !canceled)
@@ -394,9 +510,34 @@ BuildingPager::createNode(const TileKey& tileKey, ProgressCallback* progress)
             osg::CVSpan UpdateTick(series2, 4, "writeToCache");
 
             output.writeToCache(node.get(), readOptions.get(), progress);
+
+            times.add(STAGE_CACHE_WRITE, OE_GET_TIMER(writeCache));
+        }
+
+        // An abandoned tile skips work, so its timings would only skew the stats.
+        if (node.valid() && !canceled)
+        {
+            times.record();
+
+            if (_profile)
+            {
+                OE_INFO << LC << "Tile " << tileKey.str() << ": " << numFeatures << " features;" << times.str() << std::endl;
+            }
         }
     }
 
+    // Compile the merged geometry and its textures before the tile goes
+    // live, so its first draw does not stall. Only wait while the
+    // compiler is being drawn; otherwise the job could never finish.
+    if (node.valid() && !canceled && _glCompiler->isDrawing())
+    {
+        osg::ref_ptr<GLObjectCompiler::Job> job = new GLObjectCompiler::Job();
+        job->add(node.get());
+        _glCompiler->submit(job.get());
+        job->wait(progress);
+        canceled = progress && progress->isCanceled();
+    }
+
     Registry::instance()->endActivity(activityName);
 
     if (canceled)
@@ -19,6 +19,8 @@
 #include "CompilerOutput"
 #include "InstancedModelNode"
 #include "ElevationsLodNode"
+#include "ExternalModelNode"
+#include "GeometryMerger"
 #include <osgEarth/OEAssert>
 #include <osg/LOD>
 #include <osg/MatrixTransform>
@@ -52,6 +54,7 @@ CompilerOutput::CompilerOutput() :
 _range( FLT_MAX ),
 _index( 0L ),
 _currentFeature( 0L ),
+_deferIndexing( false ),
 _filterUsage(FILTER_USAGE_NORMAL)
 {
     _externalModelsGroup = new osg::Group();
@@ -96,6 +99,10 @@ CompilerOutput::addDrawable(osg::Drawable* drawable, const std::string& tag)
     {
         _index->tagDrawable( drawable, _currentFeature );
     }
+    else if ( _deferIndexing && _currentFeature )
+    {
+        _deferredTags.push_back( std::make_pair(drawable, _currentFeature) );
+    }
 }
 
 void
@@ -106,6 +113,90 @@ CompilerOutput::addInstance(ModelResource* model, const osg::Matrix& matrix)
     //TODO: index it. the vector needs to be a vector of pair<matrix,feature>
 }
 
+void
+CompilerOutput::merge(CompilerOutput& rhs)
+{
+    // Skin StateSets are unique to each output. Point the incoming drawables
+    // at ours so they can merge with our own drawables later on.
+    std::map<osg::StateSet*, osg::StateSet*> remap;
+    for (SkinStateSetCache::iterator i = rhs._skinStateSetCache.begin(); i != rhs._skinStateSetCache.end(); ++i)
+    {
+        osg::ref_ptr<osg::StateSet>& ss = _skinStateSetCache[i->first];
+        if (!ss.valid())
+            ss = i->second.get();
+        else if (ss.get() != i->second.get())
+            remap[i->second.get()] = ss.get();
+    }
+
+    for (TaggedGeodes::iterator g = rhs._geodes.begin(); g != rhs._geodes.end(); ++g)
+    {
+        osg::Geode* source = g->second.get();
+
+        if (!remap.empty())
+        {
+            for (unsigned i = 0; i < source->getNumDrawables(); ++i)
+            {
+                osg::Drawable* drawable = source->getDrawable(i);
+                std::map<osg::StateSet*, osg::StateSet*>::const_iterator r = remap.find(drawable->getStateSet());
+                if (r != remap.end())
+                    drawable->setStateSet(r->second);
+            }
+        }
+
+        osg::ref_ptr<osg::Geode>& geode = _geodes[g->first];
+        if (!geode.valid())
+        {
+            geode = source;
+        }
+        else
+        {
+            for (unsigned i = 0; i < source->getNumDrawables(); ++i)
+                geode->addDrawable(source->getDrawable(i));
+        }
+    }
+
+    for (InstanceMap::const_iterator i = rhs._instances.begin(); i != rhs._instances.end(); ++i)
+    {
+        MatrixVector& mats = _instances[i->first];
+        mats.insert(mats.end(), i->second.begin(), i->second.end());
+    }
+
+    // Outside of normal usage, external models are a list attached to a single child.
+    osg::Group* externals = rhs._externalModelsGroup.get();
+    if (_filterUsage != FILTER_USAGE_NORMAL && externals->getNumChildren() > 0 && _externalModelsGroup->getNumChildren() > 0)
+    {
+        ExternalModelNode* from = static_cast<ExternalModelNode*>(externals->getChild(0)->getUserData());
+        ExternalModelNode* to = static_cast<ExternalModelNode*>(_externalModelsGroup->getChild(0)->getUserData());
+        to->vectorExternalModels.insert(to->vectorExternalModels.end(),
+            from->vectorExternalModels.begin(), from->vectorExternalModels.end());
+    }
+    else
+    {
+        for (unsigned i = 0; i < externals->getNumChildren(); ++i)
+            _externalModelsGroup->addChild(externals->getChild(i));
+    }
+
+    for (unsigned i = 0; i < rhs._debugGroup->getNumChildren(); ++i)
+    {
+        _debugGroup->addChild(rhs._debugGroup->getChild(i));
+    }
+
+    for (DeferredTags::const_iterator t = rhs._deferredTags.begin(); t != rhs._deferredTags.end(); ++t)
+    {
+        if (_index)
+            _index->tagDrawable(t->first, t->second);
+        else if (_deferIndexing)
+            _deferredTags.push_back(*t);
+    }
+
+    rhs._geodes.clear();
+    rhs._instances.clear();
+    rhs._externalModelsGroup->removeChildren(0, externals->getNumChildren());
+    rhs._debugGroup->removeChildren(0, rhs._debugGroup->getNumChildren());
+    rhs._skinStateSetCache.clear();
+    rhs._deferredTags.clear();
+}
+
 std::string
 CompilerOutput::createCacheKey() const
 {
@@ -396,6 +487,15 @@ CompilerOutput::createSceneGraph(Session*                session,
 
     if (_geodes.empty()==false)
     {
+       // Merge each geode's drawables into pre-sized batches. This replaces
+       // the MergeGeometryVisitor, which copies arrays pairwise and is
+       // very slow on tiles with thousands of buildings.
+       GeometryMerger merger;
+       for (TaggedGeodes::const_iterator g = _geodes.begin(); g != _geodes.end(); ++g)
+       {
+          merger.merge(g->second.get());
+       }
+
        // The Geode LOD holds each geode in its range.
        osg::LOD* elevationsLod = new osg::LOD();
        elevationsLod->setName(GEODES_ROOT);
@@ -421,11 +521,7 @@ CompilerOutput::createSceneGraph(Session*                session,
        {
           osg::Group* elevationsGroup = new osg::Group();
           elevationsGroup->setName("BuildingElevationsGroup");
-          // because the default merge limit is 10000 and there's no other way to change it
-          osgUtil::Optimizer::MergeGeometryVisitor mergeGeometry;
-          mergeGeometry.setTargetMaximumNumberOfVertices(250000u);
-          elevationsLod->accept(mergeGeometry);
-          
+
           ElevationsLodNode* elevationsLodNode = new ElevationsLodNode();
           elevationsLodNode->setName("elevationsLodNode");
           elevationsLodNode->elevationsLOD = elevationsLod;
@@ -440,15 +536,13 @@ CompilerOutput::createSceneGraph(Session*                session,
     if ( _externalModelsGroup->getNumChildren() > 0 )
     {
         root->addChild( _externalModelsGroup.get() );
-    }
-    
-    // Run an optimization pass before adding any debug data or models
-    // NOTE: be careful; don't mess with state during optimization.
-    {
+
+        // Run an optimization pass on the external models before adding any debug data
+        // NOTE: be careful; don't mess with state during optimization.
         // because the default merge limit is 10000 and there's no other way to change it
         osgUtil::Optimizer::MergeGeometryVisitor mergeGeometry;
         mergeGeometry.setTargetMaximumNumberOfVertices( 250000u );
-        root->accept( mergeGeometry );
+        _externalModelsGroup->accept( mergeGeometry );
     }
 
     addInstances(root, session, settings, readOptions, progress);
@@ -23,7 +23,8 @@ using namespace osgEarth::Buildings;
 
 CompilerSettings::CompilerSettings() :
 _rangeFactor  ( 6.0f ),
-_useClustering( false )
+_useClustering( false ),
+_buildThreads ( 1u )
 {
     //nop
 }
@@ -31,6 +32,8 @@ _useClustering( false )
 CompilerSettings::CompilerSettings(const CompilerSettings& rhs) :
 _rangeFactor( rhs._rangeFactor ),
 _useClustering( rhs._useClustering ),
+_maxVertsPerCluster( rhs._maxVertsPerCluster ),
+_buildThreads( rhs._buildThreads ),
 _lodBins( rhs._lodBins )
 {
     //nop
@@ -71,7 +74,8 @@ CompilerSettings::getLODBin(const TagSet& tags) const
 
 
 CompilerSettings::CompilerSettings(const Config& conf) :
-_rangeFactor( 6.0f )
+_rangeFactor( 6.0f ),
+_buildThreads( 1u )
 {
     const Config* bins = conf.child_ptr("bins");
     if ( bins )
@@ -87,6 +91,7 @@ _rangeFactor( 6.0f )
     conf.get("range_factor", _rangeFactor);
     conf.get("clustering", _useClustering);
     conf.get("max_verts_per_cluster", _maxVertsPerCluster);
+    conf.get("build_threads", _buildThreads);
 }
 
 Config
@@ -113,6 +118,7 @@ CompilerSettings::getConfig() const
     conf.set("range_factor", _rangeFactor);
     conf.set("clustering", _useClustering);
     conf.set("max_verts_per_cluster", _maxVertsPerCluster);
+    conf.set("build_threads", _buildThreads);
 
     return conf;
 }
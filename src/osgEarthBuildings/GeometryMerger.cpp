@@ -0,0 +1,366 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "GeometryMerger"
+#include <osg/Geometry>
+#include <osg/TriangleIndexFunctor>
+#include <cstring>
+#include <map>
+
+using namespace osgEarth;
+using namespace osgEarth::Buildings;
+
+#define LC "[GeometryMerger] "
+
+namespace
+{
+    // Array slots of a geometry, in a fixed order.
+    enum
+    {
+        SLOT_VERTEX,
+        SLOT_NORMAL,
+        SLOT_COLOR,
+        SLOT_SECONDARY_COLOR,
+        SLOT_FOG_COORD,
+        SLOT_TEXCOORD = 16,
+        SLOT_ATTRIB = 64
+    };
+
+    typedef std::vector<std::pair<unsigned, osg::Array*> > ArraySlots;
+
+    void getArrays(osg::Geometry* geom, ArraySlots& out)
+    {
+        out.clear();
+        out.push_back(std::make_pair((unsigned)SLOT_VERTEX, geom->getVertexArray()));
+
+        if (geom->getNormalArray())
+            out.push_back(std::make_pair((unsigned)SLOT_NORMAL, geom->getNormalArray()));
+        if (geom->getColorArray())
+            out.push_back(std::make_pair((unsigned)SLOT_COLOR, geom->getColorArray()));
+        if (geom->getSecondaryColorArray())
+            out.push_back(std::make_pair((unsigned)SLOT_SECONDARY_COLOR, geom->getSecondaryColorArray()));
+        if (geom->getFogCoordArray())
+            out.push_back(std::make_pair((unsigned)SLOT_FOG_COORD, geom->getFogCoordArray()));
+
+        for (unsigned i = 0; i < geom->getNumTexCoordArrays(); ++i)
+            if (geom->getTexCoordArray(i))
+                out.push_back(std::make_pair(SLOT_TEXCOORD + i, geom->getTexCoordArray(i)));
+
+        for (unsigned i = 0; i < geom->getNumVertexAttribArrays(); ++i)
+            if (geom->getVertexAttribArray(i))
+                out.push_back(std::make_pair(SLOT_ATTRIB + i, geom->getVertexAttribArray(i)));
+    }
+
+    void setArray(osg::Geometry* geom, unsigned slot, osg::Array* array)
+    {
+        osg::Array::Binding binding = array->getBinding();
+
+        if (slot == SLOT_VERTEX)
+            geom->setVertexArray(array);
+        else if (slot == SLOT_NORMAL)
+            geom->setNormalArray(array, binding);
+        else if (slot == SLOT_COLOR)
+            geom->setColorArray(array, binding);
+        else if (slot == SLOT_SECONDARY_COLOR)
+            geom->setSecondaryColorArray(array, binding);
+        else if (slot == SLOT_FOG_COORD)
+            geom->setFogCoordArray(array, binding);
+        else if (slot >= SLOT_ATTRIB)
+            geom->setVertexAttribArray(slot - SLOT_ATTRIB, array, binding);
+        else
+            geom->setTexCoordArray(slot - SLOT_TEXCOORD, array, binding);
+    }
+
+    // Number of indices a primitive set adds to a triangle list,
+    // or -1 if it does not draw plain triangles.
+    int countTriangleIndices(const osg::PrimitiveSet* ps)
+    {
+        if (ps->getNumInstances() > 0)
+            return -1;
+
+        switch (ps->getType())
+        {
+        case osg::PrimitiveSet::DrawArraysPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+            break;
+        default:
+            return -1;
+        }
+
+        int n = ps->getNumIndices();
+        switch (ps->getMode())
+        {
+        case GL_TRIANGLES:
+            return (n / 3) * 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+            return n >= 3 ? (n - 2) * 3 : 0;
+        default:
+            return -1;
+        }
+    }
+
+    template<typename T>
+    void appendBytes(std::string& key, const T& value)
+    {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Builds the merge key of a geometry: its StateSet and array layout.
+    // Returns false if the geometry cannot merge with anything.
+    bool makeKey(osg::Geometry* geom, unsigned& numVerts, unsigned& numIndices, std::string& key)
+    {
+        if (geom->getUpdateCallback() ||
+            geom->getCullCallback() ||
+            geom->getDrawCallback() ||
+            geom->getUserData() ||
+            geom->getNumPrimitiveSets() == 0)
+        {
+            return false;
+        }
+
+        osg::Array* verts = geom->getVertexArray();
+        if (!verts || verts->getNumElements() == 0 || verts->getBinding() != osg::Array::BIND_PER_VERTEX)
+            return false;
+
+        numVerts = verts->getNumElements();
+        numIndices = 0u;
+
+        for (unsigned i = 0; i < geom->getNumPrimitiveSets(); ++i)
+        {
+            int count = countTriangleIndices(geom->getPrimitiveSet(i));
+            if (count < 0)
+                return false;
+            numIndices += count;
+        }
+
+        key.clear();
+        appendBytes(key, geom->getStateSet());
+
+        ArraySlots arrays;
+        getArrays(geom, arrays);
+
+        for (ArraySlots::const_iterator i = arrays.begin(); i != arrays.end(); ++i)
+        {
+            osg::Array* array = i->second;
+            osg::Array::Binding binding = array->getBinding();
+
+            if (binding == osg::Array::BIND_PER_VERTEX)
+            {
+                if (array->getNumElements() != numVerts)
+                    return false;
+            }
+            else if (binding != osg::Array::BIND_OVERALL || array->getNumElements() == 0)
+            {
+                return false;
+            }
+
+            appendBytes(key, i->first);
+            appendBytes(key, array->getType());
+            appendBytes(key, binding);
+            appendBytes(key, array->getNormalize());
+
+            // overall values must match exactly for the drawables to merge
+            if (binding == osg::Array::BIND_OVERALL)
+                key.append(static_cast<const char*>(array->getDataPointer()), array->getElementSize());
+        }
+
+        return true;
+    }
+
+    template<typename DE>
+    struct AppendTriangles
+    {
+        DE* _out;
+        unsigned _base;
+
+        void operator()(unsigned a, unsigned b, unsigned c)
+        {
+            _out->push_back(static_cast<typename DE::value_type>(_base + a));
+            _out->push_back(static_cast<typename DE::value_type>(_base + b));
+            _out->push_back(static_cast<typename DE::value_type>(_base + c));
+        }
+    };
+
+    struct Entry
+    {
+        osg::ref_ptr<osg::Geometry> geom;
+        unsigned numVerts;
+        unsigned numIndices;
+    };
+
+    typedef std::vector<Entry> Entries;
+
+    template<typename DE>
+    DE* createIndices(const Entries& entries, unsigned first, unsigned last, unsigned numIndices)
+    {
+        DE* de = new DE(GL_TRIANGLES);
+        de->reserve(numIndices);
+
+        osg::TriangleIndexFunctor<AppendTriangles<DE> > append;
+        append._out = de;
+        append._base = 0u;
+
+        for (unsigned i = first; i < last; ++i)
+        {
+            entries[i].geom->accept(append);
+            append._base += entries[i].numVerts;
+        }
+        return de;
+    }
+
+    // Merges entries [first, last), which share a key, into one geometry.
+    osg::Geometry* mergeRun(const Entries& entries, unsigned first, unsigned last, unsigned numVerts, unsigned numIndices)
+    {
+        osg::Geometry* proto = entries[first].geom.get();
+
+        osg::Geometry* geom = new osg::Geometry();
+        geom->setStateSet(proto->getStateSet());
+        geom->setDataVariance(proto->getDataVariance());
+        geom->setUseDisplayList(false);
+        geom->setUseVertexBufferObjects(true);
+
+        // Allocate each per-vertex array once at its final size; overall
+        // arrays are identical across the run, so share the first one.
+        ArraySlots arrays;
+        getArrays(proto, arrays);
+
+        std::vector<char*> dest(arrays.size(), (char*)0L);
+        std::vector<unsigned> elementSize(arrays.size(), 0u);
+
+        for (unsigned s = 0; s < arrays.size(); ++s)
+        {
+            osg::Array* src = arrays[s].second;
+            if (src->getBinding() == osg::Array::BIND_OVERALL)
+            {
+                setArray(geom, arrays[s].first, src);
+            }
+            else
+            {
+                osg::Array* dst = static_cast<osg::Array*>(src->cloneType());
+                dst->setBinding(osg::Array::BIND_PER_VERTEX);
+                dst->setNormalize(src->getNormalize());
+                dst->resizeArray(numVerts);
+                setArray(geom, arrays[s].first, dst);
+
+                dest[s] = static_cast<char*>(const_cast<GLvoid*>(dst->getDataPointer()));
+                elementSize[s] = src->getElementSize();
+            }
+        }
+
+        for (unsigned i = first; i < last; ++i)
+        {
+            getArrays(entries[i].geom.get(), arrays);
+            for (unsigned s = 0; s < arrays.size(); ++s)
+            {
+                if (dest[s])
+                {
+                    unsigned bytes = entries[i].numVerts * elementSize[s];
+                    ::memcpy(dest[s], arrays[s].second->getDataPointer(), bytes);
+                    dest[s] += bytes;
+                }
+            }
+        }
+
+        if (numVerts > 0xFFFF)
+            geom->addPrimitiveSet(createIndices<osg::DrawElementsUInt>(entries, first, last, numIndices));
+        else
+            geom->addPrimitiveSet(createIndices<osg::DrawElementsUShort>(entries, first, last, numIndices));
+
+        return geom;
+    }
+}
+
+GeometryMerger::GeometryMerger() :
+_maxVerts(250000u)
+{
+    //nop
+}
+
+void
+GeometryMerger::merge(osg::Geode* geode) const
+{
+    if (!geode || geode->getNumDrawables() < 2)
+        return;
+
+    // Sort the drawables into batches of identical keys, keeping the
+    // order in which each batch first appears.
+    std::vector<Entries> batches;
+    std::map<std::string, unsigned> batchIndex;
+    std::vector<osg::ref_ptr<osg::Drawable> > keep;
+    std::string key;
+
+    for (unsigned i = 0; i < geode->getNumDrawables(); ++i)
+    {
+        osg::Drawable* drawable = geode->getDrawable(i);
+        osg::Geometry* geom = drawable->asGeometry();
+
+        Entry entry;
+        if (geom && makeKey(geom, entry.numVerts, entry.numIndices, key))
+        {
+            entry.geom = geom;
+
+            std::map<std::string, unsigned>::iterator b = batchIndex.find(key);
+            if (b == batchIndex.end())
+            {
+                b = batchIndex.insert(std::make_pair(key, (unsigned)batches.size())).first;
+                batches.push_back(Entries());
+            }
+            batches[b->second].push_back(entry);
+        }
+        else
+        {
+            keep.push_back(drawable);
+        }
+    }
+
+    geode->removeDrawables(0, geode->getNumDrawables());
+
+    for (std::vector<Entries>::const_iterator b = batches.begin(); b != batches.end(); ++b)
+    {
+        const Entries& entries = *b;
+        unsigned first = 0u;
+
+        while (first < entries.size())
+        {
+            // extend the run until it would exceed the vertex limit:
+            unsigned last = first, numVerts = 0u, numIndices = 0u;
+            while (last < entries.size() &&
+                (last == first || numVerts + entries[last].numVerts <= _maxVerts))
+            {
+                numVerts += entries[last].numVerts;
+                numIndices += entries[last].numIndices;
+                ++last;
+            }
+
+            if (last - first == 1u)
+                geode->addDrawable(entries[first].geom.get());
+            else
+                geode->addDrawable(mergeRun(entries, first, last, numVerts, numIndices));
+
+            first = last;
+        }
+    }
+
+    for (unsigned i = 0; i < keep.size(); ++i)
+    {
+        geode->addDrawable(keep[i].get());
+    }
+}
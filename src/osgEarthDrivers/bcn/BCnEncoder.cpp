@@ -0,0 +1,789 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "BCnEncoder.h"
+
+#include <osgEarth/ThreadingUtils>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BCN_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace osgEarth::BCn;
+
+namespace
+{
+    // Images with fewer blocks than this are encoded on the calling thread;
+    // below this size the hand-off costs more than it saves.
+    const int MIN_BLOCKS_FOR_PARALLEL = 1024;
+
+    //........................................................................
+    // Endpoint helpers
+
+    inline unsigned short to565(const byte* c)
+    {
+        return (unsigned short)(
+            (((c[0] * 31 + 127) / 255) << 11) |
+            (((c[1] * 63 + 127) / 255) << 5) |
+            ((c[2] * 31 + 127) / 255));
+    }
+
+    inline void from565(unsigned short v, byte* c)
+    {
+        int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+        c[0] = (byte)((r << 3) | (r >> 2));
+        c[1] = (byte)((g << 2) | (g >> 4));
+        c[2] = (byte)((b << 3) | (b >> 2));
+        c[3] = 255;
+    }
+
+    inline byte clampByte(float v)
+    {
+        return v <= 0.0f ? 0 : v >= 255.0f ? 255 : (byte)(v + 0.5f);
+    }
+
+    // Builds the 4-color palette for a BC1 block (the only mode we emit).
+    inline void buildPalette4(unsigned short c0, unsigned short c1, byte pal[16])
+    {
+        from565(c0, pal + 0);
+        from565(c1, pal + 4);
+        for (int k = 0; k < 3; ++k)
+        {
+            pal[8 + k] = (byte)((2 * pal[k] + pal[4 + k]) / 3);
+            pal[12 + k] = (byte)((pal[k] + 2 * pal[4 + k]) / 3);
+        }
+        pal[11] = pal[15] = 255;
+    }
+
+    //........................................................................
+    // Block min/max
+
+    inline void minMaxRGBA(const byte* block, byte* mn, byte* mx)
+    {
+#ifdef BCN_USE_SSE2
+        __m128i r0 = _mm_loadu_si128((const __m128i*)(block + 0));
+        __m128i r1 = _mm_loadu_si128((const __m128i*)(block + 16));
+        __m128i r2 = _mm_loadu_si128((const __m128i*)(block + 32));
+        __m128i r3 = _mm_loadu_si128((const __m128i*)(block + 48));
+        __m128i lo = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+        __m128i hi = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+        int l = _mm_cvtsi128_si32(lo), h = _mm_cvtsi128_si32(hi);
+        memcpy(mn, &l, 4);
+        memcpy(mx, &h, 4);
+#else
+        for (int k = 0; k < 4; ++k) { mn[k] = 255; mx[k] = 0; }
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                mn[k] = std::min(mn[k], block[i * 4 + k]);
+                mx[k] = std::max(mx[k], block[i * 4 + k]);
+            }
+        }
+#endif
+    }
+
+    inline void minMax16(const byte* v, byte& mn, byte& mx)
+    {
+#ifdef BCN_USE_SSE2
+        __m128i x = _mm_loadu_si128((const __m128i*)v);
+        __m128i lo = _mm_min_epu8(x, _mm_srli_si128(x, 8));
+        __m128i hi = _mm_max_epu8(x, _mm_srli_si128(x, 8));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 2));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 2));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 1));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 1));
+        mn = (byte)(_mm_cvtsi128_si32(lo) & 0xFF);
+        mx = (byte)(_mm_cvtsi128_si32(hi) & 0xFF);
+#else
+        mn = 255; mx = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            mn = std::min(mn, v[i]);
+            mx = std::max(mx, v[i]);
+        }
+#endif
+    }
+
+    //........................................................................
+    // BC1 color
+
+    // Projects each pixel onto (pal0 - pal1) and returns the nearest of the
+    // four palette entries, packed as 2-bit indices.
+    unsigned computeColorIndices(const byte* block, const byte* pal)
+    {
+        int dir[3] = { pal[0] - pal[4], pal[1] - pal[5], pal[2] - pal[6] };
+
+        int stops[4];
+        for (int i = 0; i < 4; ++i)
+            stops[i] = pal[i * 4 + 0] * dir[0] + pal[i * 4 + 1] * dir[1] + pal[i * 4 + 2] * dir[2];
+
+        // palette order along the axis is 1 < 3 < 2 < 0
+        int ta = stops[1] + stops[3];
+        int tb = stops[3] + stops[2];
+        int tc = stops[2] + stops[0];
+        static const unsigned remap[4] = { 1, 3, 2, 0 };
+
+        int counts[16];
+
+#ifdef BCN_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i d = _mm_setr_epi16(
+            (short)dir[0], (short)dir[1], (short)dir[2], 0,
+            (short)dir[0], (short)dir[1], (short)dir[2], 0);
+        const __m128i va = _mm_set1_epi32(ta);
+        const __m128i vb = _mm_set1_epi32(tb);
+        const __m128i vc = _mm_set1_epi32(tc);
+
+        for (int row = 0; row < 4; ++row)
+        {
+            __m128i px = _mm_loadu_si128((const __m128i*)(block + row * 16));
+            __m128i mlo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), d);
+            __m128i mhi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), d);
+            __m128 flo = _mm_castsi128_ps(mlo), fhi = _mm_castsi128_ps(mhi);
+            __m128i even = _mm_castps_si128(_mm_shuffle_ps(flo, fhi, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odd = _mm_castps_si128(_mm_shuffle_ps(flo, fhi, _MM_SHUFFLE(3, 1, 3, 1)));
+            __m128i dot2 = _mm_slli_epi32(_mm_add_epi32(even, odd), 1);
+
+            // each compare yields -1 where true; negate the sum to count
+            __m128i c = _mm_add_epi32(
+                _mm_add_epi32(_mm_cmpgt_epi32(dot2, va), _mm_cmpgt_epi32(dot2, vb)),
+                _mm_cmpgt_epi32(dot2, vc));
+            c = _mm_sub_epi32(zero, c);
+            _mm_storeu_si128((__m128i*)(counts + row * 4), c);
+        }
+#else
+        for (int i = 0; i < 16; ++i)
+        {
+            const byte* p = block + i * 4;
+            int dot2 = 2 * (p[0] * dir[0] + p[1] * dir[1] + p[2] * dir[2]);
+            counts[i] = (dot2 > ta ? 1 : 0) + (dot2 > tb ? 1 : 0) + (dot2 > tc ? 1 : 0);
+        }
+#endif
+
+        unsigned indices = 0u;
+        for (int i = 15; i >= 0; --i)
+            indices = (indices << 2) | remap[counts[i]];
+        return indices;
+    }
+
+    unsigned colorError(const byte* block, const byte* pal, unsigned indices)
+    {
+        unsigned err = 0u;
+        for (int i = 0; i < 16; ++i)
+        {
+            const byte* p = block + i * 4;
+            const byte* q = pal + ((indices >> (2 * i)) & 3) * 4;
+            int dr = p[0] - q[0], dg = p[1] - q[1], db = p[2] - q[2];
+            err += dr * dr + dg * dg + db * db;
+        }
+        return err;
+    }
+
+    // Chooses a diagonal of the bounding box by the sign of the covariance
+    // between the widest channel and the other two.
+    void selectDiagonal(const byte* block, byte* mn, byte* mx)
+    {
+        int mean[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+            for (int k = 0; k < 3; ++k)
+                mean[k] += block[i * 4 + k];
+        for (int k = 0; k < 3; ++k)
+            mean[k] = (mean[k] + 8) >> 4;
+
+        int primary = 0;
+        for (int k = 1; k < 3; ++k)
+            if (mx[k] - mn[k] > mx[primary] - mn[primary])
+                primary = k;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            if (k == primary) continue;
+            int cov = 0;
+            for (int i = 0; i < 16; ++i)
+                cov += (block[i * 4 + primary] - mean[primary]) * (block[i * 4 + k] - mean[k]);
+            if (cov < 0)
+                std::swap(mn[k], mx[k]);
+        }
+    }
+
+    // Endpoints at the extremes of the block's principal axis.
+    void principalAxisEndpoints(const byte* block, const byte* mn, const byte* mx, byte* e0, byte* e1)
+    {
+        float mean[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+            for (int k = 0; k < 3; ++k)
+                mean[k] += block[i * 4 + k];
+        for (int k = 0; k < 3; ++k)
+            mean[k] /= 16.0f;
+
+        float cov[6] = { 0, 0, 0, 0, 0, 0 }; // rr rg rb gg gb bb
+        for (int i = 0; i < 16; ++i)
+        {
+            float r = block[i * 4 + 0] - mean[0];
+            float g = block[i * 4 + 1] - mean[1];
+            float b = block[i * 4 + 2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+
+        // power iteration, seeded with the bounding box diagonal
+        float v[3] = { (float)(mx[0] - mn[0]), (float)(mx[1] - mn[1]), (float)(mx[2] - mn[2]) };
+        for (int iter = 0; iter < 4; ++iter)
+        {
+            float r = v[0] * cov[0] + v[1] * cov[1] + v[2] * cov[2];
+            float g = v[0] * cov[1] + v[1] * cov[3] + v[2] * cov[4];
+            float b = v[0] * cov[2] + v[1] * cov[4] + v[2] * cov[5];
+            float m = std::max(std::max(std::fabs(r), std::fabs(g)), std::fabs(b));
+            if (m < 1e-4f) break;
+            v[0] = r / m; v[1] = g / m; v[2] = b / m;
+        }
+
+        float minDot = 1e30f, maxDot = -1e30f;
+        int minIdx = 0, maxIdx = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            const byte* p = block + i * 4;
+            float d = p[0] * v[0] + p[1] * v[1] + p[2] * v[2];
+            if (d < minDot) { minDot = d; minIdx = i; }
+            if (d > maxDot) { maxDot = d; maxIdx = i; }
+        }
+        memcpy(e0, block + maxIdx * 4, 4);
+        memcpy(e1, block + minIdx * 4, 4);
+    }
+
+    // One least-squares pass solving for the endpoints that best fit the
+    // current index assignment. Returns false if the system is degenerate.
+    bool refineEndpoints(const byte* block, unsigned indices, byte* e0, byte* e1)
+    {
+        static const float weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+        float aa = 0, bb = 0, ab = 0;
+        float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+        {
+            float a = weight[(indices >> (2 * i)) & 3];
+            float b = 1.0f - a;
+            aa += a * a; bb += b * b; ab += a * b;
+            for (int k = 0; k < 3; ++k)
+            {
+                ax[k] += a * block[i * 4 + k];
+                bx[k] += b * block[i * 4 + k];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if (det > -1e-6f && det < 1e-6f)
+            return false;
+
+        float inv = 1.0f / det;
+        for (int k = 0; k < 3; ++k)
+        {
+            e0[k] = clampByte((ax[k] * bb - bx[k] * ab) * inv);
+            e1[k] = clampByte((bx[k] * aa - ax[k] * ab) * inv);
+        }
+        return true;
+    }
+
+    // Quantizes a pair of endpoints and emits a complete 4-color block.
+    // Returns the squared error of the emitted block.
+    unsigned emitColorBlock(const byte* block, const byte* e0, const byte* e1, byte* out)
+    {
+        unsigned short c0 = to565(e0), c1 = to565(e1);
+        unsigned indices = 0u;
+        unsigned err = 0u;
+
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+        }
+
+        byte pal[16];
+        buildPalette4(c0, c1, pal);
+
+        if (c0 != c1)
+        {
+            indices = computeColorIndices(block, pal);
+        }
+
+        err = colorError(block, pal, indices);
+
+        out[0] = (byte)(c0 & 0xFF); out[1] = (byte)(c0 >> 8);
+        out[2] = (byte)(c1 & 0xFF); out[3] = (byte)(c1 >> 8);
+        out[4] = (byte)(indices & 0xFF);
+        out[5] = (byte)((indices >> 8) & 0xFF);
+        out[6] = (byte)((indices >> 16) & 0xFF);
+        out[7] = (byte)((indices >> 24) & 0xFF);
+        return err;
+    }
+
+    void encodeColorBlock(const byte* block, byte* out, Quality quality)
+    {
+        byte mn[4], mx[4];
+        minMaxRGBA(block, mn, mx);
+
+        if (quality == QUALITY_FAST)
+        {
+            emitColorBlock(block, mx, mn, out);
+            return;
+        }
+
+        if (quality == QUALITY_NORMAL)
+        {
+            selectDiagonal(block, mn, mx);
+            for (int k = 0; k < 3; ++k)
+            {
+                int inset = (mx[k] - mn[k]) / 16;
+                mx[k] = (byte)(mx[k] - inset);
+                mn[k] = (byte)(mn[k] + inset);
+            }
+            emitColorBlock(block, mx, mn, out);
+            return;
+        }
+
+        // QUALITY_HIGH: principal axis, then refine, keeping the best result.
+        byte e0[4], e1[4];
+        principalAxisEndpoints(block, mn, mx, e0, e1);
+
+        byte best[8], trial[8];
+        unsigned bestErr = emitColorBlock(block, e0, e1, best);
+
+        for (int pass = 0; pass < 2 && bestErr > 0u; ++pass)
+        {
+            unsigned indices =
+                best[4] | (best[5] << 8) | (best[6] << 16) | ((unsigned)best[7] << 24);
+            if (!refineEndpoints(block, indices, e0, e1))
+                break;
+            unsigned err = emitColorBlock(block, e0, e1, trial);
+            if (err >= bestErr)
+                break;
+            bestErr = err;
+            memcpy(best, trial, 8);
+        }
+
+        memcpy(out, best, 8);
+    }
+
+    //........................................................................
+    // BC4 single channel
+
+    void buildPalette8(byte r0, byte r1, int* pal)
+    {
+        pal[0] = r0;
+        pal[1] = r1;
+        if (r0 > r1)
+        {
+            for (int i = 2; i < 8; ++i)
+                pal[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+        }
+        else
+        {
+            for (int i = 2; i < 6; ++i)
+                pal[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+            pal[6] = 0;
+            pal[7] = 255;
+        }
+    }
+
+    void writeChannelBlock(byte r0, byte r1, const byte* idx, byte* out)
+    {
+        out[0] = r0;
+        out[1] = r1;
+        unsigned long long bits = 0ull;
+        for (int i = 15; i >= 0; --i)
+            bits = (bits << 3) | (unsigned long long)(idx[i] & 7);
+        for (int i = 0; i < 6; ++i)
+            out[2 + i] = (byte)((bits >> (8 * i)) & 0xFF);
+    }
+
+    // Fast path: 8-value mode with indices from a direct linear quantization.
+    void quantizeChannel8(const byte* v, byte r0, byte r1, byte* idx)
+    {
+        static const byte remap[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+        float scale = 7.0f / (float)(r0 - r1);
+
+#ifdef BCN_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 s = _mm_set1_ps(scale);
+        const __m128 lo = _mm_set1_ps((float)r1);
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        __m128i x = _mm_loadu_si128((const __m128i*)v);
+        __m128i x16lo = _mm_unpacklo_epi8(x, zero);
+        __m128i x16hi = _mm_unpackhi_epi8(x, zero);
+        __m128i q[4];
+        q[0] = _mm_unpacklo_epi16(x16lo, zero);
+        q[1] = _mm_unpackhi_epi16(x16lo, zero);
+        q[2] = _mm_unpacklo_epi16(x16hi, zero);
+        q[3] = _mm_unpackhi_epi16(x16hi, zero);
+
+        int steps[16];
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128 f = _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(q[i]), lo), s);
+            _mm_storeu_si128((__m128i*)(steps + i * 4), _mm_cvttps_epi32(_mm_add_ps(f, half)));
+        }
+        for (int i = 0; i < 16; ++i)
+            idx[i] = remap[std::min(std::max(steps[i], 0), 7)];
+#else
+        for (int i = 0; i < 16; ++i)
+        {
+            int step = (int)((v[i] - r1) * scale + 0.5f);
+            idx[i] = remap[std::min(std::max(step, 0), 7)];
+        }
+#endif
+    }
+
+    unsigned nearestChannel(const byte* v, byte r0, byte r1, byte* idx)
+    {
+        int pal[8];
+        buildPalette8(r0, r1, pal);
+        unsigned err = 0u;
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestErr = 1 << 30;
+            for (int j = 0; j < 8; ++j)
+            {
+                int d = v[i] - pal[j];
+                d *= d;
+                if (d < bestErr) { bestErr = d; best = j; }
+            }
+            idx[i] = (byte)best;
+            err += bestErr;
+        }
+        return err;
+    }
+
+    void encodeChannelBlock(const byte* v, byte* out, Quality quality)
+    {
+        byte mn, mx;
+        minMax16(v, mn, mx);
+
+        byte idx[16];
+
+        if (mn == mx)
+        {
+            memset(idx, 0, 16);
+            writeChannelBlock(mx, mn, idx, out);
+            return;
+        }
+
+        if (quality == QUALITY_FAST)
+        {
+            quantizeChannel8(v, mx, mn, idx);
+            writeChannelBlock(mx, mn, idx, out);
+            return;
+        }
+
+        unsigned bestErr = nearestChannel(v, mx, mn, idx);
+        byte r0 = mx, r1 = mn;
+
+        if (quality == QUALITY_HIGH && bestErr > 0u)
+        {
+            byte trial[16];
+
+            // inset 8-value endpoints
+            int inset = (mx - mn) / 32;
+            if (inset > 0)
+            {
+                byte a = (byte)(mx - inset), b = (byte)(mn + inset);
+                unsigned err = nearestChannel(v, a, b, trial);
+                if (err < bestErr) { bestErr = err; r0 = a; r1 = b; memcpy(idx, trial, 16); }
+            }
+
+            // 6-value mode, letting the explicit 0 and 255 cover the extremes
+            byte imn = 255, imx = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                if (v[i] != 0 && v[i] != 255)
+                {
+                    imn = std::min(imn, v[i]);
+                    imx = std::max(imx, v[i]);
+                }
+            }
+            if (imn <= imx)
+            {
+                unsigned err = nearestChannel(v, imn, imx, trial);
+                if (err < bestErr) { bestErr = err; r0 = imn; r1 = imx; memcpy(idx, trial, 16); }
+            }
+        }
+
+        writeChannelBlock(r0, r1, idx, out);
+    }
+
+    inline void extractChannel(const byte* block, int channel, byte* v)
+    {
+        for (int i = 0; i < 16; ++i)
+            v[i] = block[i * 4 + channel];
+    }
+
+    //........................................................................
+    // Decoding
+
+    void decodeColorBlock(const byte* in, byte* rgba, bool allowThreeColor)
+    {
+        unsigned short c0 = (unsigned short)(in[0] | (in[1] << 8));
+        unsigned short c1 = (unsigned short)(in[2] | (in[3] << 8));
+        unsigned indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned)in[7] << 24);
+
+        byte pal[16];
+        if (c0 > c1 || !allowThreeColor)
+        {
+            buildPalette4(c0, c1, pal);
+        }
+        else
+        {
+            from565(c0, pal + 0);
+            from565(c1, pal + 4);
+            for (int k = 0; k < 3; ++k)
+            {
+                pal[8 + k] = (byte)((pal[k] + pal[4 + k]) / 2);
+                pal[12 + k] = 0;
+            }
+            pal[11] = 255;
+            pal[15] = 0;
+        }
+
+        for (int i = 0; i < 16; ++i)
+            memcpy(rgba + i * 4, pal + ((indices >> (2 * i)) & 3) * 4, 4);
+    }
+
+    void decodeChannelBlock(const byte* in, byte* rgba, int channel)
+    {
+        int pal[8];
+        buildPalette8(in[0], in[1], pal);
+        unsigned long long bits = 0ull;
+        for (int i = 5; i >= 0; --i)
+            bits = (bits << 8) | in[2 + i];
+        for (int i = 0; i < 16; ++i)
+            rgba[i * 4 + channel] = (byte)pal[(bits >> (3 * i)) & 7];
+    }
+}
+
+//...................................................................
+
+unsigned
+osgEarth::BCn::getBlockSize(Format format)
+{
+    return format == FORMAT_BC1 || format == FORMAT_BC4 ? 8u : 16u;
+}
+
+size_t
+osgEarth::BCn::getEncodedSize(Format format, int width, int height)
+{
+    size_t bw = (size_t)std::max(1, (width + 3) / 4);
+    size_t bh = (size_t)std::max(1, (height + 3) / 4);
+    return bw * bh * getBlockSize(format);
+}
+
+bool
+osgEarth::BCn::hasSIMD()
+{
+#ifdef BCN_USE_SSE2
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+osgEarth::BCn::encodeBlock(const byte* rgba, byte* out, Format format, Quality quality)
+{
+    byte v[16];
+
+    switch (format)
+    {
+    case FORMAT_BC1:
+        encodeColorBlock(rgba, out, quality);
+        break;
+
+    case FORMAT_BC3:
+        extractChannel(rgba, 3, v);
+        encodeChannelBlock(v, out, quality);
+        encodeColorBlock(rgba, out + 8, quality);
+        break;
+
+    case FORMAT_BC4:
+        extractChannel(rgba, 0, v);
+        encodeChannelBlock(v, out, quality);
+        break;
+
+    case FORMAT_BC5:
+        extractChannel(rgba, 0, v);
+        encodeChannelBlock(v, out, quality);
+        extractChannel(rgba, 1, v);
+        encodeChannelBlock(v, out + 8, quality);
+        break;
+    }
+}
+
+void
+osgEarth::BCn::decodeBlock(const byte* in, byte* rgba, Format format)
+{
+    switch (format)
+    {
+    case FORMAT_BC1:
+        decodeColorBlock(in, rgba, true);
+        break;
+
+    case FORMAT_BC3:
+        decodeColorBlock(in + 8, rgba, false);
+        decodeChannelBlock(in, rgba, 3);
+        break;
+
+    case FORMAT_BC4:
+        for (int i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        decodeChannelBlock(in, rgba, 0);
+        break;
+
+    case FORMAT_BC5:
+        for (int i = 0; i < 16; ++i)
+        {
+            rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        decodeChannelBlock(in, rgba, 0);
+        decodeChannelBlock(in + 8, rgba, 1);
+        break;
+    }
+}
+
+size_t
+osgEarth::BCn::encodeImage(
+    const byte* rgba,
+    int width,
+    int height,
+    byte* out,
+    Format format,
+    Quality quality,
+    unsigned numThreads)
+{
+    if (rgba == 0L || out == 0L || width <= 0 || height <= 0)
+        return 0;
+
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const unsigned blockSize = getBlockSize(format);
+    const size_t rowBytes = (size_t)blocksX * blockSize;
+
+    std::function<void(int)> encodeRow = [=](int by)
+    {
+        byte block[64];
+        byte* dst = out + (size_t)by * rowBytes;
+        for (int bx = 0; bx < blocksX; ++bx)
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                int sy = std::min(by * 4 + y, height - 1);
+                const byte* srcRow = rgba + (size_t)sy * width * 4;
+                int sx = bx * 4;
+                if (sx + 3 < width)
+                {
+                    memcpy(block + y * 16, srcRow + sx * 4, 16);
+                }
+                else
+                {
+                    for (int x = 0; x < 4; ++x)
+                        memcpy(block + y * 16 + x * 4, srcRow + std::min(sx + x, width - 1) * 4, 4);
+                }
+            }
+            encodeBlock(block, dst, format, quality);
+            dst += blockSize;
+        }
+    };
+
+    unsigned threads = numThreads > 0u ? numThreads :
+        (unsigned)std::max(OpenThreads::GetNumberOfProcessors(), 1);
+
+    unsigned numParts = blocksX * blocksY >= MIN_BLOCKS_FOR_PARALLEL ?
+        osgEarth::Threading::ForkJoin::getNumParts(blocksY, threads, 1u) : 0u;
+
+    if (threads > 1u && numParts > 1u)
+    {
+        // contiguous runs of block rows, on the shared fork-join pool:
+        osg::ref_ptr<osgEarth::Threading::ForkJoin> job = new osgEarth::Threading::ForkJoin();
+        for (unsigned p = 0; p < numParts; ++p)
+        {
+            int begin = (int)((size_t)blocksY * p / numParts);
+            int end = (int)((size_t)blocksY * (p + 1) / numParts);
+            job->add([&encodeRow, begin, end]()
+            {
+                for (int by = begin; by < end; ++by)
+                    encodeRow(by);
+            });
+        }
+        job->run(threads);
+    }
+    else
+    {
+        for (int by = 0; by < blocksY; ++by)
+            encodeRow(by);
+    }
+
+    return rowBytes * blocksY;
+}
+
+void
+osgEarth::BCn::decodeImage(
+    const byte* in,
+    int width,
+    int height,
+    byte* rgba,
+    Format format)
+{
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const unsigned blockSize = getBlockSize(format);
+
+    byte block[64];
+    for (int by = 0; by < blocksY; ++by)
+    {
+        for (int bx = 0; bx < blocksX; ++bx)
+        {
+            decodeBlock(in, block, format);
+            in += blockSize;
+
+            for (int y = 0; y < 4 && by * 4 + y < height; ++y)
+            {
+                for (int x = 0; x < 4 && bx * 4 + x < width; ++x)
+                {
+                    memcpy(
+                        rgba + ((size_t)(by * 4 + y) * width + (bx * 4 + x)) * 4,
+                        block + (y * 4 + x) * 4,
+                        4);
+                }
+            }
+        }
+    }
+}
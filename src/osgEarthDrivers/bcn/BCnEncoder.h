@@ -0,0 +1,89 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#ifndef OSGEARTH_BCN_ENCODER_H
+#define OSGEARTH_BCN_ENCODER_H 1
+
+#include <stddef.h>
+
+namespace osgEarth { namespace BCn
+{
+    typedef unsigned char byte;
+
+    //! Block-compressed formats supported by the encoder.
+    enum Format
+    {
+        FORMAT_BC1,     // RGB, 4bpp     (S3TC DXT1)
+        FORMAT_BC3,     // RGBA, 8bpp    (S3TC DXT5)
+        FORMAT_BC4,     // R, 4bpp       (RGTC1)
+        FORMAT_BC5      // RG, 8bpp      (RGTC2)
+    };
+
+    //! Speed/quality presets.
+    enum Quality
+    {
+        QUALITY_FAST,   // bounding-box endpoints
+        QUALITY_NORMAL, // inset bounding-box endpoints on the dominant diagonal
+        QUALITY_HIGH    // principal-axis endpoints with least-squares refinement
+    };
+
+    //! Number of bytes in one 4x4 block of the given format (8 or 16).
+    extern unsigned getBlockSize(Format format);
+
+    //! Number of bytes required to encode an image of the given size.
+    extern size_t getEncodedSize(Format format, int width, int height);
+
+    //! Encode one 4x4 block of RGBA8 pixels (64 bytes, row-major).
+    extern void encodeBlock(const byte* rgba, byte* out, Format format, Quality quality);
+
+    //! Decode one block back into 64 bytes of RGBA8. Channels not
+    //! stored in the format are written as 0 (color) or 255 (alpha).
+    extern void decodeBlock(const byte* in, byte* rgba, Format format);
+
+    /**
+     * Encodes a whole RGBA8 image. Partial edge blocks are padded by
+     * clamping to the last row/column. Block rows are distributed
+     * across "numThreads" threads of the shared fork-join pool
+     * (0 = one per core); small images are always encoded on the
+     * calling thread.
+     *
+     * Returns the number of bytes written to "out", which must hold
+     * at least getEncodedSize(format, width, height) bytes.
+     */
+    extern size_t encodeImage(
+        const byte* rgba,
+        int width,
+        int height,
+        byte* out,
+        Format format,
+        Quality quality,
+        unsigned numThreads = 0u);
+
+    //! Decodes a whole image encoded with encodeImage into RGBA8.
+    extern void decodeImage(
+        const byte* in,
+        int width,
+        int height,
+        byte* rgba,
+        Format format);
+
+    //! True if the encoder was compiled with SSE2 kernels.
+    extern bool hasSIMD();
+} }
+
+#endif // OSGEARTH_BCN_ENCODER_H
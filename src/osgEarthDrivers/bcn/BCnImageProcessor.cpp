@@ -0,0 +1,275 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osg/Texture>
+#include <osg/Timer>
+#include <osgDB/Registry>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Notify>
+#include <algorithm>
+#include <vector>
+#include <string.h>
+#include "BCnEncoder.h"
+
+#define LC "[BCn] "
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+/**
+ * CPU texture compressor for the BC1/BC3/BC4/BC5 block formats
+ * (a.k.a. DXT1, DXT5, RGTC1 and RGTC2). Blocks are encoded in parallel
+ * using SSE2 kernels where available, and mipmap chains are generated
+ * and compressed in the same pass. generateMipMap() builds an
+ * uncompressed RGBA8 chain with the same box filter.
+ *
+ * Registered under the "bcn" extension.
+ */
+class BCnImageProcessor : public osgDB::ImageProcessor
+{
+public:
+    virtual void compress(
+        osg::Image& image,
+        osg::Texture::InternalFormatMode compressedFormat,
+        bool generateMipMap,
+        bool resizeToPowerOfTwo,
+        CompressionMethod method,
+        CompressionQuality quality)
+    {
+        BCn::Format format;
+        GLenum pixelFormat;
+
+        switch (compressedFormat)
+        {
+        case osg::Texture::USE_S3TC_DXT1_COMPRESSION:
+        case osg::Texture::USE_S3TC_DXT1c_COMPRESSION:
+            format = BCn::FORMAT_BC1;
+            pixelFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            break;
+        case osg::Texture::USE_S3TC_DXT5_COMPRESSION:
+            format = BCn::FORMAT_BC3;
+            pixelFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            break;
+        case osg::Texture::USE_RGTC1_COMPRESSION:
+            format = BCn::FORMAT_BC4;
+            pixelFormat = GL_COMPRESSED_RED_RGTC1_EXT;
+            break;
+        case osg::Texture::USE_RGTC2_COMPRESSION:
+            format = BCn::FORMAT_BC5;
+            pixelFormat = GL_COMPRESSED_RED_GREEN_RGTC2_EXT;
+            break;
+        default:
+            OE_WARN << LC << "Unhandled compressed format " << compressedFormat << std::endl;
+            return;
+        }
+
+        if (ImageUtils::isCompressed(&image))
+        {
+            OE_DEBUG << LC << "Image is already compressed" << std::endl;
+            return;
+        }
+
+        if (image.r() > 1)
+        {
+            OE_WARN << LC << "3D images are not supported" << std::endl;
+            return;
+        }
+
+        if (resizeToPowerOfTwo && !ImageUtils::isPowerOfTwo(&image))
+        {
+            unsigned int s = osg::Image::computeNearestPowerOfTwo(image.s());
+            unsigned int t = osg::Image::computeNearestPowerOfTwo(image.t());
+            image.scaleImage(s, t, image.r());
+        }
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        // The encoder works on tightly packed RGBA8:
+        osg::ref_ptr<osg::Image> rgba;
+        const unsigned char* src = image.data();
+        if (image.getPixelFormat() != GL_RGBA ||
+            image.getDataType() != GL_UNSIGNED_BYTE ||
+            image.getRowStepInBytes() != (unsigned)image.s() * 4u)
+        {
+            rgba = ImageUtils::convertToRGBA8(&image);
+            if (!rgba.valid())
+            {
+                OE_WARN << LC << "Failed to convert image to RGBA8" << std::endl;
+                return;
+            }
+            src = rgba->data();
+        }
+
+        BCn::Quality q =
+            quality == FASTEST ? BCn::QUALITY_FAST :
+            quality == NORMAL  ? BCn::QUALITY_NORMAL :
+            BCn::QUALITY_HIGH;
+
+        int s = image.s(), t = image.t();
+
+        int numLevels = generateMipMap ? osg::Image::computeNumberOfMipmapLevels(s, t, 1) : 1;
+
+        // compute the size of the whole chain up front so we allocate once.
+        osg::Image::MipmapDataType mipOffsets;
+        size_t totalBytes = 0;
+        for (int level = 0, w = s, h = t; level < numLevels; ++level)
+        {
+            if (level > 0)
+                mipOffsets.push_back((unsigned)totalBytes);
+            totalBytes += BCn::getEncodedSize(format, w, h);
+            w = std::max(1, w >> 1);
+            h = std::max(1, h >> 1);
+        }
+
+        unsigned char* data = new unsigned char[totalBytes];
+
+        std::vector<unsigned char> levelBuf[2];
+        const unsigned char* levelSrc = src;
+        int w = s, h = t;
+        size_t offset = 0;
+
+        for (int level = 0; level < numLevels; ++level)
+        {
+            offset += BCn::encodeImage(levelSrc, w, h, data + offset, format, q);
+
+            if (level + 1 < numLevels)
+            {
+                int nw = std::max(1, w >> 1), nh = std::max(1, h >> 1);
+                std::vector<unsigned char>& next = levelBuf[level & 1];
+                next.resize((size_t)nw * nh * 4);
+                downsample(levelSrc, w, h, &next[0], nw, nh);
+                levelSrc = &next[0];
+                w = nw;
+                h = nh;
+            }
+        }
+
+        image.setImage(
+            s, t, 1,
+            pixelFormat, pixelFormat, GL_UNSIGNED_BYTE,
+            data,
+            osg::Image::USE_NEW_DELETE);
+
+        if (numLevels > 1)
+        {
+            image.setMipmapLevels(mipOffsets);
+        }
+
+        OE_DEBUG << LC << "Compressed " << s << "x" << t << " (" << numLevels << " levels) in "
+            << osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) << "ms" << std::endl;
+    }
+
+    virtual void generateMipMap(osg::Image& image, bool resizeToPowerOfTwo, CompressionMethod method)
+    {
+        if (ImageUtils::isCompressed(&image))
+        {
+            OE_WARN << LC << "Cannot generate mipmaps for a compressed image" << std::endl;
+            return;
+        }
+
+        if (image.r() > 1)
+        {
+            OE_WARN << LC << "3D images are not supported" << std::endl;
+            return;
+        }
+
+        if (resizeToPowerOfTwo && !ImageUtils::isPowerOfTwo(&image))
+        {
+            unsigned int s = osg::Image::computeNearestPowerOfTwo(image.s());
+            unsigned int t = osg::Image::computeNearestPowerOfTwo(image.t());
+            image.scaleImage(s, t, image.r());
+        }
+
+        // The filter works on tightly packed RGBA8:
+        osg::ref_ptr<osg::Image> rgba;
+        const unsigned char* src = image.data();
+        if (image.getPixelFormat() != GL_RGBA ||
+            image.getDataType() != GL_UNSIGNED_BYTE ||
+            image.getRowStepInBytes() != (unsigned)image.s() * 4u)
+        {
+            rgba = ImageUtils::convertToRGBA8(&image);
+            if (!rgba.valid())
+            {
+                OE_WARN << LC << "Failed to convert image to RGBA8" << std::endl;
+                return;
+            }
+            src = rgba->data();
+        }
+
+        int s = image.s(), t = image.t();
+        int numLevels = osg::Image::computeNumberOfMipmapLevels(s, t, 1);
+
+        osg::Image::MipmapDataType mipOffsets;
+        size_t totalBytes = 0;
+        for (int level = 0, w = s, h = t; level < numLevels; ++level)
+        {
+            if (level > 0)
+                mipOffsets.push_back((unsigned)totalBytes);
+            totalBytes += (size_t)w * h * 4;
+            w = std::max(1, w >> 1);
+            h = std::max(1, h >> 1);
+        }
+
+        // level 0 is the image itself; each level filters the one before.
+        unsigned char* data = new unsigned char[totalBytes];
+        memcpy(data, src, (size_t)s * t * 4);
+        for (int level = 1, w = s, h = t; level < numLevels; ++level)
+        {
+            int nw = std::max(1, w >> 1), nh = std::max(1, h >> 1);
+            unsigned char* prev = data + (level == 1 ? 0u : mipOffsets[level - 2]);
+            downsample(prev, w, h, data + mipOffsets[level - 1], nw, nh);
+            w = nw;
+            h = nh;
+        }
+
+        image.setImage(
+            s, t, 1,
+            GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE,
+            data,
+            osg::Image::USE_NEW_DELETE);
+
+        if (numLevels > 1)
+        {
+            image.setMipmapLevels(mipOffsets);
+        }
+    }
+
+private:
+
+    // 2x2 box filter for RGBA8 (handles odd and 1-pixel dimensions)
+    static void downsample(const unsigned char* src, int w, int h, unsigned char* dst, int nw, int nh)
+    {
+        for (int y = 0; y < nh; ++y)
+        {
+            int y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+            for (int x = 0; x < nw; ++x)
+            {
+                int x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+                const unsigned char* a = src + (y0 * w + x0) * 4;
+                const unsigned char* b = src + (y0 * w + x1) * 4;
+                const unsigned char* c = src + (y1 * w + x0) * 4;
+                const unsigned char* d = src + (y1 * w + x1) * 4;
+                unsigned char* o = dst + (y * nw + x) * 4;
+                for (int k = 0; k < 4; ++k)
+                    o[k] = (unsigned char)((a[k] + b[k] + c[k] + d[k] + 2) >> 2);
+            }
+        }
+    }
+};
+
+REGISTER_OSGIMAGEPROCESSOR(bcn, BCnImageProcessor)
@@ -164,6 +164,12 @@ namespace
 
 namespace
 {
+    CacheMetrics& metrics()
+    {
+        static CacheMetrics s_metrics("filesystem");
+        return s_metrics;
+    }
+
     FileSystemCache::FileSystemCache( const CacheOptions& options ) :
     Cache( options )
     {
@@ -338,6 +344,8 @@ namespace
     ReadResult
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
+        CacheMetrics::ScopedRead probe(metrics());
+
         if ( !binValidForReading() )
             return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
@@ -380,6 +388,7 @@ namespace
             if (_debug)
                 OE_NOTICE << LC << "Read image \"" << key << "\" from cache bin [" << getID() << "] path=" << fileURI.full() << "." << OSG_EXT << std::endl;
 
+            probe.hit();
             return rr;
         }
     }
@@ -387,6 +396,8 @@ namespace
     ReadResult
     FileSystemCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
     {
+        CacheMetrics::ScopedRead probe(metrics());
+
         if ( !binValidForReading() )
             return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
@@ -429,6 +440,7 @@ namespace
             if (_debug)
                 OE_NOTICE << LC << "Read object \"" << key << "\" from cache bin [" << getID() << "] path=" << fileURI.full() << "." << OSG_EXT << std::endl;
 
+            probe.hit();
             return rr;
         }
     }
@@ -508,6 +520,8 @@ namespace
 
         if ( objWriteOK )
         {
+            metrics().wrote();
+
             if (_debug)
                 OE_NOTICE << LC << "Wrote \"" << key << "\" to cache bin [" << getID() << "] path=" << fileURI.full() << "." << OSG_EXT << std::endl;
         }
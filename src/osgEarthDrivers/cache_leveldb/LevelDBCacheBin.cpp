@@ -32,6 +32,12 @@ using namespace osgEarth::Drivers::LevelDBCache;
 
 namespace
 {
+    CacheMetrics& metrics()
+    {
+        static CacheMetrics s_metrics("leveldb");
+        return s_metrics;
+    }
+
     void encodeMeta(const Config& meta, std::string& out)
     {
         out = Stringify() << meta.toJSON(false);
@@ -248,6 +254,8 @@ LevelDBCacheBin::readNode(const std::string& key, const osgDB::Options* readOpti
 ReadResult
 LevelDBCacheBin::read(const std::string& key, const Reader& reader)
 {
+    CacheMetrics::ScopedRead probe(metrics());
+
     if ( !binValidForReading() ) 
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
@@ -310,6 +318,7 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     }
 
     ++_tracker->hits;
+    probe.hit();
     ReadResult rr(r.getObject(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
@@ -400,6 +409,7 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
         if ( objWriteOK )
         {
             ++_tracker->writes;
+            metrics().wrote();
             postWrite();
             
             if ( _debug )
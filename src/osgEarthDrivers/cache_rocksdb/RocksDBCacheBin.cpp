@@ -32,6 +32,12 @@ using namespace osgEarth::RocksDBCache;
 
 namespace
 {
+    CacheMetrics& metrics()
+    {
+        static CacheMetrics s_metrics("rocksdb");
+        return s_metrics;
+    }
+
     void encodeMeta(const Config& meta, std::string& out)
     {
         out = Stringify() << meta.toJSON(false);
@@ -242,6 +248,8 @@ RocksDBCacheBin::readObject(const std::string& key, const osgDB::Options* readOp
 ReadResult
 RocksDBCacheBin::read(const std::string& key, const Reader& reader)
 {
+    CacheMetrics::ScopedRead probe(metrics());
+
     if ( !binValidForReading() ) 
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
@@ -304,6 +312,7 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
     }
 
     ++_tracker->hits;
+    probe.hit();
     ReadResult rr(r.getObject(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
@@ -394,6 +403,7 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
         if ( objWriteOK )
         {
             ++_tracker->writes;
+            metrics().wrote();
             postWrite();
             
             if ( _debug )
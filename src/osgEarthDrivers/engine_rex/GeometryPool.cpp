@@ -20,6 +20,7 @@
 #include <osgEarth/Locators>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/TopologyGraph>
+#include <osgEarth/BufferPool>
 #include <osg/Point>
 #include <osgUtil/MeshOptimizers>
 #include <cstdlib> // for getenv
@@ -372,16 +373,14 @@ GeometryPool::createGeometry(const TileKey& tileKey,
     osg::DrawElements* primSet = NULL;
 
     // the vertex locations:
-    osg::ref_ptr<osg::Vec3Array> verts = new osg::Vec3Array();
+    osg::ref_ptr<osg::Vec3Array> verts = new PooledArray<osg::Vec3Array>(BufferPools::vec3fs(), numVerts);
     verts->setVertexBufferObject(vbo.get());
-    verts->reserve( numVerts );
     verts->setBinding(verts->BIND_PER_VERTEX);
     geom->setVertexArray( verts.get() );
 
     // the surface normals (i.e. extrusion vectors)
-    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array();
+    osg::ref_ptr<osg::Vec3Array> normals = new PooledArray<osg::Vec3Array>(BufferPools::vec3fs(), numVerts);
     normals->setVertexBufferObject(vbo.get());
-    normals->reserve( numVerts );
     normals->setBinding(normals->BIND_PER_VERTEX);
     geom->setNormalArray( normals.get() );
 
@@ -390,15 +389,13 @@ GeometryPool::createGeometry(const TileKey& tileKey,
     if ( _options.morphTerrain() == true )
     {
         // neighbor positions (for morphing)
-        neighbors = new osg::Vec3Array();
+        neighbors = new PooledArray<osg::Vec3Array>(BufferPools::vec3fs(), numVerts);
         neighbors->setBinding(neighbors->BIND_PER_VERTEX);
         neighbors->setVertexBufferObject(vbo.get());
-        neighbors->reserve( numVerts );
         geom->setNeighborArray(neighbors.get());
 
-        neighborNormals = new osg::Vec3Array();
+        neighborNormals = new PooledArray<osg::Vec3Array>(BufferPools::vec3fs(), numVerts);
         neighborNormals->setVertexBufferObject(vbo.get());
-        neighborNormals->reserve( numVerts );
         neighborNormals->setBinding(neighborNormals->BIND_PER_VERTEX);
         geom->setNeighborNormalArray( neighborNormals.get() );
     }
@@ -406,10 +403,9 @@ GeometryPool::createGeometry(const TileKey& tileKey,
     // tex coord is [0..1] across the tile. The 3rd dimension tracks whether the
     // vert is masked: 0=yes, 1=no
     bool populateTexCoords = true;
-    osg::ref_ptr<osg::Vec3Array> texCoords = new osg::Vec3Array();
+    osg::ref_ptr<osg::Vec3Array> texCoords = new PooledArray<osg::Vec3Array>(BufferPools::vec3fs(), numVerts);
     texCoords->setBinding(texCoords->BIND_PER_VERTEX);
     texCoords->setVertexBufferObject(vbo.get());
-    texCoords->reserve( numVerts );
 
     geom->setTexCoordArray(texCoords.get());
 
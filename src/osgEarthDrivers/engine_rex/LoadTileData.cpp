@@ -214,3 +214,23 @@ LoadTileData::createStateSet() const
 
     return out.release();
 }
+
+void
+LoadTileData::getGLObjects(GLObjectCompiler::Job& job) const
+{
+    if (!_dataModel.valid())
+        return;
+
+    // one item per texture so the compiler can spread a tile across frames.
+    const TerrainTileColorLayerModelVector& colorLayers = _dataModel->colorLayers();
+    for (TerrainTileColorLayerModelVector::const_iterator i = colorLayers.begin();
+        i != colorLayers.end();
+        ++i)
+    {
+        job.add(i->get()->getTexture());
+    }
+
+    job.add(_dataModel->getNormalTexture());
+    job.add(_dataModel->getElevationTexture());
+    job.add(_dataModel->getLandCoverTexture());
+}
@@ -23,6 +23,7 @@
 #include <osgEarth/Utils>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/Metrics>
+#include <osgEarth/MetricsRegistry>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -30,11 +31,46 @@
 #include <osgDB/ReaderWriter>
 
 #include <string>
+#include <algorithm>
 
 #define REPORT_ACTIVITY true
 
 using namespace osgEarth::REX;
 
+namespace
+{
+    using namespace osgEarth::Util;
+
+    MetricsRegistry::Histogram* mergeTime(const char* loader)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("loader", std::string(loader)));
+        return MetricsRegistry::instance()->histogram(
+            "osgearth_loader_merge_seconds",
+            "Time spent merging one loaded tile request into the scene graph",
+            labels);
+    }
+
+    MetricsRegistry::Gauge* queueDepth(const char* loader, const char* queue)
+    {
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("loader", std::string(loader)));
+        labels.push_back(std::make_pair("queue", std::string(queue)));
+        return MetricsRegistry::instance()->gauge(
+            "osgearth_loader_queue_depth",
+            "Number of tile requests in a loader queue",
+            labels);
+    }
+
+    //! Publishes the loader's queue depths once per frame
+    void publishQueueDepths(const char* loader, const Loader::Stats& stats)
+    {
+        queueDepth(loader, "queued")->set(stats._queued);
+        queueDepth(loader, "running")->set(stats._running);
+        queueDepth(loader, "merging")->set(stats._merging);
+    }
+}
+
 
 Loader::Request::Request() :
     _delay_s(0.0),
@@ -59,6 +95,11 @@ Loader::Request::setState(Loader::Request::State value)
         _lastFrameSubmitted = 0;
         _lastTick = 0;
     }
+
+    if ( _state == IDLE || _state == FINISHED )
+    {
+        _compileJob = 0L;
+    }
 }
 
 void
@@ -73,6 +114,14 @@ Loader::Request::setDelay(double seconds)
     //OE_WARN << _key.str() << "setDelay(" << osg::Timer::instance()->delta_s(now, _readyTick) << ")" << std::endl;
 }
 
+void
+Loader::Request::getGLObjects(GLObjectCompiler::Job& job) const
+{
+    osg::ref_ptr<osg::StateSet> stateSet = createStateSet();
+    if (stateSet.valid())
+        job.add(stateSet.get());
+}
+
 namespace osgEarth { namespace REX
 {
     /**
@@ -233,7 +282,9 @@ PagerLoader::PagerLoader(TerrainEngineNode* engine) :
 _checkpoint    (0.0),
 _mergesPerFrame( 0 ),
 _frameLastUpdated( 0u ),
-_numLODs       ( 20u )
+_numLODs       ( 20u ),
+_completed     ( 0u ),
+_canceled      ( 0u )
 {
     _myNodePath.push_back( this );
 
@@ -321,6 +372,9 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
         }
         request->unlock();
 
+        if (addToRequestSet)
+            ++_requested;
+
         // is this request eligible to run (based on a possible setDelay call)?
         if (now >= request->_readyTick)
         {
@@ -369,17 +423,21 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
             // process pending merges.
             {
                 OE_PROFILING_ZONE_NAMED("loader.merge");
+                static MetricsRegistry::Histogram* s_mergeTime = mergeTime("pager");
+
                 int count;
                 for(count=0; count < _mergesPerFrame && !_mergeQueue.empty(); ++count)
                 {
                     Request* req = _mergeQueue.begin()->get();
                     if ( req && req->_lastTick >= _checkpoint )
                     {
+                        MetricsRegistry::ScopedTimer timer(s_mergeTime);
                         bool merged = req->merge();
                     
                         if (merged)
                         {
                             req->setState(Request::FINISHED);
+                            ++_completed;
                             //OE_INFO << LC << req->_key.str() << " finished (delays = " << req->_delayCount << ")" << std::endl;
                         }
                         else
@@ -425,6 +483,7 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
                     {
                         OE_DEBUG << LC << req->getName() << "(" << i->second->getUID() << ") was abandoned waiting to be serviced" << std::endl; 
                         req->setState(Request::IDLE);
+                        ++_canceled;
                         if ( REPORT_ACTIVITY )
                             Registry::instance()->endActivity( req->getName() );
                         _requests.erase( i++ );
@@ -453,6 +512,8 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
 
                 //OE_NOTICE << LC << "PagerLoader: requests=" << _requests.size() << "; mergeQueue=" << _mergeQueue.size() << std::endl;
             }
+
+            publishQueueDepths("pager", getStats());
         }
     }
 
@@ -489,7 +550,10 @@ PagerLoader::addChild(osg::Node* node)
                 else
                 {
                     if (req->merge())
+                    {
                         req->setState( Request::FINISHED );
+                        ++_completed;
+                    }
                     else
                         req->setState( Request::IDLE ); // retry
 
@@ -516,6 +580,22 @@ PagerLoader::addChild(osg::Node* node)
     return true;
 }
 
+Loader::Stats
+PagerLoader::getStats() const
+{
+    Stats stats;
+
+    _requests.lock();
+    stats._merging = _mergeQueue.size();
+    stats._queued = _requests.size() > stats._merging ? _requests.size() - stats._merging : 0u;
+    _requests.unlock();
+
+    stats._requested = _requested;
+    stats._completed = _completed;
+    stats._canceled = _canceled;
+    return stats;
+}
+
 TileKey
 PagerLoader::getTileKeyForRequest(UID requestUID) const
 {
@@ -571,6 +651,517 @@ PagerLoader::runAndRelease(UID requestUID)
 }
 
 
+//...............................................
+
+#undef  LC
+#define LC "[ThreadedLoader] "
+
+namespace
+{
+    // Frames a request may go without being re-submitted before the
+    // loader drops it. A tile that is in view submits every frame.
+    const int MAX_FRAMES_UNREQUESTED = 2;
+
+    // Poll interval (ms) for workers when every queued request is delayed
+    const unsigned DELAYED_POLL_MS = 10u;
+
+    /**
+     * Progress callback for requests running in the loader's workers.
+     * The update traversal cancels it when the tile stops asking for
+     * the request; it also cancels if the loader is shutting down.
+     */
+    struct ThreadedProgressCallback : public ProgressCallback
+    {
+        const volatile bool& _done;
+
+        ThreadedProgressCallback(const volatile bool& done) :
+            _done(done) { }
+
+        virtual bool shouldCancel() const
+        {
+            return _done;
+        }
+    };
+
+    struct SortByPriority
+    {
+        typedef std::pair<float, osg::ref_ptr<Loader::Request> > Entry;
+        bool operator()(const Entry& lhs, const Entry& rhs) const {
+            return lhs.first < rhs.first;
+        }
+    };
+
+    // Sorts requests by ascending priority. The priorities are sampled
+    // first since cull threads can update them during the sort.
+    void sortByPriority(std::vector<osg::ref_ptr<Loader::Request> >& requests)
+    {
+        if (requests.size() < 2)
+            return;
+
+        std::vector<SortByPriority::Entry> entries;
+        entries.reserve(requests.size());
+        for (unsigned i = 0; i < requests.size(); ++i)
+            entries.push_back(SortByPriority::Entry(requests[i]->_priority, requests[i]));
+
+        std::stable_sort(entries.begin(), entries.end(), SortByPriority());
+
+        for (unsigned i = 0; i < entries.size(); ++i)
+            requests[i] = entries[i].second;
+    }
+}
+
+class ThreadedLoader::Worker : public OpenThreads::Thread
+{
+public:
+    Worker(ThreadedLoader* loader) : _loader(loader) { }
+
+    void run()
+    {
+        ThreadedLoader* loader = _loader;
+
+        while (true)
+        {
+            osg::ref_ptr<Request> request;
+            osg::ref_ptr<ProgressCallback> progress;
+
+            // wait for the highest-priority request that is ready to run:
+            {
+                Threading::ScopedMutexLock lock(loader->_mutex);
+
+                while (!loader->_done && !request.valid())
+                {
+                    request = loader->nextRequest();
+                    if (!request.valid())
+                    {
+                        if (loader->_queue.empty())
+                            loader->_workAvailable.wait(&loader->_mutex);
+                        else
+                            loader->_workAvailable.wait(&loader->_mutex, DELAYED_POLL_MS);
+                    }
+                }
+
+                if (loader->_done)
+                    return;
+
+                progress = new ThreadedProgressCallback(loader->_done);
+
+                Job job;
+                job._request = request.get();
+                job._progress = progress.get();
+                loader->_running.push_back(job);
+            }
+
+            if (REPORT_ACTIVITY)
+                Registry::instance()->startActivity(request->getName());
+
+            bool ok = request->run(progress.get());
+
+            if (REPORT_ACTIVITY)
+                Registry::instance()->endActivity(request->getName());
+
+            {
+                Threading::ScopedMutexLock lock(loader->_mutex);
+
+                for (std::vector<Job>::iterator i = loader->_running.begin(); i != loader->_running.end(); ++i)
+                {
+                    if (i->_request.get() == request.get())
+                    {
+                        loader->_running.erase(i);
+                        break;
+                    }
+                }
+
+                // A request that finished is merged even if it was canceled
+                // along the way, since the work is already done.
+                request->lock();
+                if (ok && !loader->_done)
+                {
+                    request->setState(Request::MERGING);
+                    loader->_merges.push_back(request.get());
+                }
+                else
+                {
+                    // back to idle; the tile will resubmit it if still needed.
+                    request->setState(Request::IDLE);
+                    if (progress->isCanceled())
+                        ++loader->_canceled;
+                }
+                request->unlock();
+            }
+        }
+    }
+
+    ThreadedLoader* _loader;
+};
+
+
+ThreadedLoader::ThreadedLoader(TerrainEngineNode* engine) :
+_done            ( false ),
+_numThreads      ( 0u ),
+_mergeBudget_ms  ( 4.0 ),
+_checkpoint      ( 0.0 ),
+_frameLastUpdated( 0u ),
+_numLODs         ( 20u ),
+_requested       ( 0u ),
+_completed       ( 0u ),
+_canceled        ( 0u ),
+_clock           ( 0L )
+{
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        _priorityScales[i] = 1.0f;
+        _priorityOffsets[i] = 0.0f;
+    }
+
+    // needs an update traversal to merge and re-sort.
+    ADJUST_UPDATE_TRAV_COUNT(this, +1);
+}
+
+ThreadedLoader::~ThreadedLoader()
+{
+    stopThreads();
+}
+
+void
+ThreadedLoader::setNumThreads(unsigned value)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    if (_workers.empty())
+        _numThreads = value;
+}
+
+void
+ThreadedLoader::setMergeBudget(double value_ms)
+{
+    _mergeBudget_ms = osg::maximum(value_ms, 0.0);
+}
+
+void
+ThreadedLoader::setNumLODs(unsigned lods)
+{
+    _numLODs = osg::maximum(lods, 1u);
+}
+
+void
+ThreadedLoader::setLODPriorityScale(unsigned lod, float priorityScale)
+{
+    if (lod < 64)
+        _priorityScales[lod] = priorityScale;
+}
+
+void
+ThreadedLoader::setLODPriorityOffset(unsigned lod, float offset)
+{
+    if (lod < 64)
+        _priorityOffsets[lod] = offset;
+}
+
+void
+ThreadedLoader::setOverallPriorityScale(float value)
+{
+    for(int i=0; i<64; ++i)
+    {
+        _priorityScales[i] = value;
+    }
+}
+
+void
+ThreadedLoader::startThreads()
+{
+    // call with _mutex held
+    unsigned num = _numThreads;
+    if (num == 0u)
+    {
+        // leave a core for the draw/cull threads, but always keep at least two.
+        int procs = OpenThreads::GetNumberOfProcessors();
+        num = (unsigned)osg::clampBetween(procs - 1, 2, 8);
+    }
+
+    for (unsigned i = 0; i < num; ++i)
+    {
+        Worker* worker = new Worker(this);
+        worker->start();
+        _workers.push_back(worker);
+    }
+
+    _numThreads = num;
+    OE_INFO << LC << "Started " << num << " loader threads" << std::endl;
+}
+
+void
+ThreadedLoader::stopThreads()
+{
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        _done = true;
+        _workAvailable.broadcast();
+    }
+
+    for (unsigned i = 0; i < _workers.size(); ++i)
+    {
+        _workers[i]->join();
+        delete _workers[i];
+    }
+    _workers.clear();
+
+    _queue.clear();
+    _running.clear();
+    _merges.clear();
+}
+
+bool
+ThreadedLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv)
+{
+    if (request == 0L || request->isMerging() || request->isFinished() || _done)
+        return false;
+
+    bool isNew = false;
+
+    // lock the request since multiple cull traversals might hit this function.
+    request->lock();
+    {
+        request->_lastTick = _clock->getTime();
+
+        // update the priority, scale and bias it, and then normalize it to [0..1] range.
+        unsigned lod = request->getTileKey().getLOD();
+        float p = priority * _priorityScales[lod] + _priorityOffsets[lod];
+        request->_priority = p / (float)(_numLODs+1);
+
+        request->setFrameNumber(_clock->getFrame());
+
+        // the first submission since the request went idle queues it;
+        // later ones just refresh its priority and timestamp.
+        isNew = request->isIdle() && (++request->_loadCount == 1);
+    }
+    request->unlock();
+
+    if (isNew)
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        if (_workers.empty())
+            startThreads();
+
+        _queue.push_back(request);
+        ++_requested;
+        _workAvailable.signal();
+    }
+
+    return true;
+}
+
+void
+ThreadedLoader::clear()
+{
+    // Set a time checkpoint for invalidating old requests.
+    _checkpoint = _clock->getTime();
+}
+
+Loader::Request*
+ThreadedLoader::nextRequest()
+{
+    // call with _mutex held.
+    // The queue is sorted by ascending priority, so search from the back
+    // for the best request that is not delayed.
+    osg::Timer_t now = osg::Timer::instance()->tick();
+
+    for (int i = (int)_queue.size() - 1; i >= 0; --i)
+    {
+        Request* request = _queue[i].get();
+        if (now >= request->_readyTick)
+        {
+            osg::ref_ptr<Request> result = request;
+            _queue.erase(_queue.begin() + i);
+
+            request->lock();
+            request->setState(Request::RUNNING);
+            request->unlock();
+
+            return result.release();
+        }
+    }
+    return 0L;
+}
+
+void
+ThreadedLoader::update()
+{
+    const unsigned frame = _clock->getFrame();
+
+    std::vector<RefRequest> merges;
+
+    {
+        OE_PROFILING_ZONE_NAMED("loader.purge");
+
+        Threading::ScopedMutexLock lock(_mutex);
+
+        // Drop waiting requests from tiles that stopped asking for them
+        // (the tile left the view or was unloaded), or that predate clear().
+        unsigned kept = 0;
+        for (unsigned i = 0; i < _queue.size(); ++i)
+        {
+            Request* req = _queue[i].get();
+            const int frameDiff = (int)frame - (int)req->getLastFrameSubmitted();
+
+            if (frameDiff > MAX_FRAMES_UNREQUESTED || req->_lastTick < _checkpoint)
+            {
+                req->lock();
+                req->setState(Request::IDLE);
+                req->unlock();
+                ++_canceled;
+            }
+            else
+            {
+                if (kept != i)
+                    _queue[kept] = _queue[i];
+                ++kept;
+            }
+        }
+        _queue.resize(kept);
+
+        // Cancel running requests for the same reasons.
+        for (std::vector<Job>::iterator i = _running.begin(); i != _running.end(); ++i)
+        {
+            Request* req = i->_request.get();
+            const int frameDiff = (int)frame - (int)req->getLastFrameSubmitted();
+
+            if (frameDiff > MAX_FRAMES_UNREQUESTED || req->_lastTick < _checkpoint)
+            {
+                i->_progress->cancel();
+            }
+        }
+
+        // Re-prioritize everything still waiting so the workers
+        // always pick up the most important tile next.
+        sortByPriority(_queue);
+
+        merges.swap(_merges);
+    }
+
+    if (merges.empty())
+        return;
+
+    OE_PROFILING_ZONE_NAMED("loader.merge");
+
+    // Merge the highest priority results first, until the time budget runs out.
+    sortByPriority(merges);
+
+    static MetricsRegistry::Histogram* s_mergeTime = mergeTime("threaded");
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    unsigned completed = 0u, canceled = 0u;
+
+    // results whose GL objects are still compiling; the tile keeps
+    // showing its current (parent) data until they are ready.
+    std::vector<RefRequest> compiling;
+
+    int i;
+    for (i = (int)merges.size() - 1; i >= 0; --i)
+    {
+        Request* req = merges[i].get();
+
+        if (req->_lastTick < _checkpoint)
+        {
+            // stale results from before a clear(); let the tile try again.
+            req->lock();
+            req->setState(Request::IDLE);
+            req->unlock();
+            ++canceled;
+            continue;
+        }
+
+        if (_compiler.valid())
+        {
+            if (!req->_compileJob.valid())
+            {
+                req->_compileJob = new GLObjectCompiler::Job();
+                req->getGLObjects(*req->_compileJob.get());
+                _compiler->submit(req->_compileJob.get());
+            }
+
+            if (!req->_compileJob->isComplete())
+            {
+                req->_compileJob->setPriority(req->_priority);
+                compiling.push_back(req);
+                continue;
+            }
+        }
+
+        bool merged;
+        {
+            MetricsRegistry::ScopedTimer timer(s_mergeTime);
+            merged = req->merge();
+        }
+
+        req->lock();
+        if (merged)
+        {
+            req->setState(Request::FINISHED);
+            ++completed;
+        }
+        else
+        {
+            // results were invalid (probably a revision mismatch)
+            // and the request must be requeued.
+            req->setState(Request::IDLE);
+        }
+        req->unlock();
+
+        if (_mergeBudget_ms > 0.0 &&
+            osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) >= _mergeBudget_ms)
+        {
+            --i;
+            break;
+        }
+    }
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    _completed += completed;
+    _canceled += canceled;
+
+    // anything left over waits for the next frame.
+    if (i >= 0)
+    {
+        _merges.insert(_merges.end(), merges.begin(), merges.begin() + (i + 1));
+    }
+
+    _merges.insert(_merges.end(), compiling.begin(), compiling.end());
+}
+
+void
+ThreadedLoader::traverse(osg::NodeVisitor& nv)
+{
+    if (nv.getVisitorType() == nv.UPDATE_VISITOR && _clock)
+    {
+        // prevent UPDATE from running more than once per frame
+        unsigned frame = _clock->getFrame();
+        if (_frameLastUpdated < frame)
+        {
+            _frameLastUpdated = frame;
+            update();
+            publishQueueDepths("threaded", getStats());
+        }
+    }
+
+    LoaderGroup::traverse(nv);
+}
+
+Loader::Stats
+ThreadedLoader::getStats() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    Stats stats;
+    stats._queued = _queue.size();
+    stats._running = _running.size();
+    stats._merging = _merges.size();
+    stats._requested = _requested;
+    stats._completed = _completed;
+    stats._canceled = _canceled;
+    return stats;
+}
+
+
 
 namespace osgEarth { namespace REX
 {
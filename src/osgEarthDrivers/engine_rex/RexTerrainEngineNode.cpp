@@ -284,14 +284,46 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& inOptions)
     _geometryPool->setReleaser( _releaser.get());
     this->addChild( _geometryPool.get() );
 
-    // Make a tile loader
-    PagerLoader* loader = new PagerLoader( this );
-    loader->setFrameClock(&_clock);
-    loader->setNumLODs(options().maxLOD().getOrUse(DEFAULT_MAX_LOD));
-    loader->setMergesPerFrame(options().mergesPerFrame().get() );
-    loader->setOverallPriorityScale(options().priorityScale().get());
-
-    _loader = loader;
+    // Make a tile loader; if the envvar is set, override the options setting
+    bool nativeLoader = options().nativeLoader().get();
+    const char* nativeLoaderVal = ::getenv("OSGEARTH_REX_NATIVE_LOADER");
+    if (nativeLoaderVal)
+    {
+        nativeLoader = as<bool>(nativeLoaderVal, true);
+        OE_INFO << LC << "Native loader " << (nativeLoader ? "enabled" : "disabled") << " by env var\n";
+    }
+
+    if (nativeLoader)
+    {
+        ThreadedLoader* loader = new ThreadedLoader( this );
+        loader->setFrameClock(&_clock);
+        loader->setNumLODs(options().maxLOD().getOrUse(DEFAULT_MAX_LOD));
+        loader->setNumThreads(options().loaderThreads().get());
+        loader->setMergeBudget(options().mergeBudget().get());
+        loader->setOverallPriorityScale(options().priorityScale().get());
+
+        // Pre-compile new tile data under a per-frame budget so merges
+        // don't stall the first draw.
+        if (options().compileBudget().get() > 0.0f)
+        {
+            _compiler = new GLObjectCompiler();
+            _compiler->setFrameBudget(options().compileBudget().get());
+            this->addChild(_compiler.get());
+            loader->setCompiler(_compiler.get());
+        }
+
+        _loader = loader;
+    }
+    else
+    {
+        PagerLoader* loader = new PagerLoader( this );
+        loader->setFrameClock(&_clock);
+        loader->setNumLODs(options().maxLOD().getOrUse(DEFAULT_MAX_LOD));
+        loader->setMergesPerFrame(options().mergesPerFrame().get() );
+        loader->setOverallPriorityScale(options().priorityScale().get());
+        _loader = loader;
+    }
+
     this->addChild( _loader.get() );
 
     // if the envvar for tile expiration is set, override the options setting
@@ -522,6 +554,30 @@ RexTerrainEngineNode::setupRenderBindings()
     }
 }
 
+TerrainEngineNode::PagingStats
+RexTerrainEngineNode::getPagingStats() const
+{
+    PagingStats stats;
+
+    if (_loader.valid())
+    {
+        Loader::Stats loaderStats = _loader->getStats();
+        stats._requested = loaderStats._requested;
+        stats._loaded = loaderStats._completed;
+        stats._canceled = loaderStats._canceled;
+        stats._pending = loaderStats._queued + loaderStats._running + loaderStats._merging;
+    }
+
+    if (_liveTiles.valid())
+    {
+        stats._expired = _liveTiles->getNumExpired();
+        stats._expiredUnused = _liveTiles->getNumExpiredUnused();
+        stats._resident = _liveTiles->size();
+    }
+
+    return stats;
+}
+
 void
 RexTerrainEngineNode::dirtyTerrain()
 {
@@ -771,6 +827,9 @@ RexTerrainEngineNode::cull_traverse(osg::NodeVisitor& nv)
     _loader->accept(nv);
     _unloader->accept(nv);
     _releaser->accept(nv);
+
+    if (_compiler.valid())
+        _compiler->accept(nv);
 }
 
 void
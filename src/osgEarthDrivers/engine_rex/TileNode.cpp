@@ -67,7 +67,9 @@ _lastTraversalFrame(0.0),
 _empty(false),              // an "empty" node exists but has no geometry or children.,
 _imageUpdatesActive(false),
 _doNotExpire(false),
-_revision(0u)
+_revision(0u),
+_merged(false),
+_used(false)
 {
     //nop
 }
@@ -225,8 +227,12 @@ TileNode::create(const TileKey& key, TileNode* parent, EngineContext* context)
     // register me.
     context->liveTiles()->add( this );
 
-    // signal the tile to start loading data:
-    refreshAllLayers();
+    // signal the tile to start loading data. Image layers with an ancestor
+    // in memory answer right away with an upsampled placeholder; merge()
+    // then queues the real fetch for those layers.
+    CreateTileManifest manifest;
+    manifest.setUseFallbackImages(true);
+    refreshLayers(manifest);
 
     // tell the world.
     OE_DEBUG << LC << "notify (create) key " << getKey().str() << std::endl;
@@ -549,6 +555,9 @@ TileNode::cull(TerrainCuller* culler)
     if ( canAcceptSurface )
     {
         _surface->accept( *culler );
+
+        if (_merged)
+            _used = true;
     }
 
     // If this tile is marked dirty, try loading data.
@@ -717,6 +726,7 @@ TileNode::merge(const TerrainTileModel* model, LoadTileData* request)
     RenderingPasses& myPasses = _renderModel._passes;
     const CreateTileManifest& manifest = request->getManifest();
     vector_set<UID> uidsLoaded;
+    CreateTileManifest pending;
 
     // First deal with the rendering passes (for color data):
     const SamplerBinding& color = bindings[SamplerBinding::COLOR];
@@ -766,6 +776,9 @@ TileNode::merge(const TerrainTileModel* model, LoadTileData* request)
                 }
 
                 uidsLoaded.insert(pass->sourceUID());
+
+                if (model->isFallback())
+                    pending.insert(model->getLayer());
             }
 
             else // non-image color layer (like splatting, e.g.)
@@ -950,6 +963,9 @@ TileNode::merge(const TerrainTileModel* model, LoadTileData* request)
                 int revision = layerModel->getRevision();
                 _renderModel.setSharedSampler(bindingIndex, tex, revision);
                 uidsLoaded.insert(uid);
+
+                if (layerModel->isFallback())
+                    pending.insert(layerModel->getLayer());
             }
         }
     }
@@ -992,6 +1008,8 @@ TileNode::merge(const TerrainTileModel* model, LoadTileData* request)
         _context->getEngine()->getTerrain()->notifyTileUpdate(getKey(), this);
     }
 
+    _merged = true;
+
     // Remove the load request that spawned this merge.
     // The only time the request will NOT be in the queue is if it was
     // loadSync() was called.
@@ -1001,6 +1019,12 @@ TileNode::merge(const TerrainTileModel* model, LoadTileData* request)
     _loadsInQueue = _loadQueue.size();
     _loadQueue.unlock();
 
+    // Layers that only got a placeholder still need their real data.
+    if (!pending.empty())
+    {
+        refreshLayers(pending);
+    }
+
     // Bump the data revision for the tile.
     ++_revision;
 }
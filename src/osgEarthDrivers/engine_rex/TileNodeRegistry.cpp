@@ -38,7 +38,9 @@ TileNodeRegistry::TileNodeRegistry(const std::string& name) :
 _name              ( name ),
 _revisioningEnabled( false ),
 _notifyNeighbors   ( false ),
-_firstLOD          ( 0u )
+_firstLOD          ( 0u ),
+_numExpired        ( 0u ),
+_numExpiredUnused  ( 0u )
 {
     _tracker.push_front(SENTRY_VALUE);
     _sentryptr = _tracker.begin();
@@ -351,6 +353,10 @@ TileNodeRegistry::collectDormantTiles(
             // put the tile on the output list:
             output.push_back(se->_tile);
 
+            ++_numExpired;
+            if (se->_tile->isUnused())
+                ++_numExpiredUnused;
+
             // remove it from the main tile table:
             _tiles.erase(key);
 
@@ -83,21 +83,6 @@ public:
                                          bool isBinary,
                                          const osgDB::Options* readOptions) const
     {
-        std::string err, warn;
-        tinygltf::Model model;
-        tinygltf::TinyGLTF loader;
-
-        tinygltf::FsCallbacks fs;
-        fs.FileExists = &tinygltf::FileExists;
-        fs.ExpandFilePath = &GLTFReader::ExpandFilePath;
-        fs.ReadWholeFile = &tinygltf::ReadWholeFile;
-        fs.WriteWholeFile = &tinygltf::WriteWholeFile;
-        fs.user_data = (void*)&location;
-        loader.SetFsCallbacks(fs);
-
-        tinygltf::Options opt;
-        opt.skip_imagery = readOptions && readOptions->getOptionString().find("gltfSkipImagery") != std::string::npos;
-
         if (osgDB::containsServerAddress(location))
         {
             osgEarth::ReadResult rr = osgEarth::URI(location).readString(readOptions);
@@ -106,29 +91,73 @@ public:
                 return osgDB::ReaderWriter::ReadResult::FILE_NOT_FOUND;
             }
 
-            std::string mem = rr.getString();
+            return read(location, isBinary, rr.getString(), readOptions);
+        }
+
+        std::string err, warn;
+        tinygltf::Model model;
+        tinygltf::TinyGLTF loader;
+        tinygltf::Options opt;
+        setup(loader, opt, location, readOptions);
 
-            if (isBinary)
-            {
-                loader.LoadBinaryFromMemory(&model, &err, &warn, (const unsigned char*)mem.data(), mem.size(), location, REQUIRE_VERSION, &opt);
-            }
-            else
-            {
-                loader.LoadASCIIFromString(&model, &err, &warn, mem.data(), mem.size(), location, REQUIRE_VERSION, &opt);
-            }
+        if (isBinary)
+        {
+            loader.LoadBinaryFromFile(&model, &err, &warn, location, REQUIRE_VERSION, &opt);
         }
         else
         {
-            if (isBinary)
-            {
-                loader.LoadBinaryFromFile(&model, &err, &warn, location, REQUIRE_VERSION, &opt);
-            }
-            else
-            {
-                loader.LoadASCIIFromFile(&model, &err, &warn, location, REQUIRE_VERSION, &opt);
-            }
+            loader.LoadASCIIFromFile(&model, &err, &warn, location, REQUIRE_VERSION, &opt);
         }
 
+        return finish(model, err, location, readOptions);
+    }
+
+    //! Reads a model that is already in memory; location is used to
+    //! resolve external references.
+    osgDB::ReaderWriter::ReadResult read(const std::string& location,
+                                         bool isBinary,
+                                         const std::string& mem,
+                                         const osgDB::Options* readOptions) const
+    {
+        std::string err, warn;
+        tinygltf::Model model;
+        tinygltf::TinyGLTF loader;
+        tinygltf::Options opt;
+        setup(loader, opt, location, readOptions);
+
+        if (isBinary)
+        {
+            loader.LoadBinaryFromMemory(&model, &err, &warn, (const unsigned char*)mem.data(), mem.size(), location, REQUIRE_VERSION, &opt);
+        }
+        else
+        {
+            loader.LoadASCIIFromString(&model, &err, &warn, mem.data(), mem.size(), location, REQUIRE_VERSION, &opt);
+        }
+
+        return finish(model, err, location, readOptions);
+    }
+
+    void setup(tinygltf::TinyGLTF& loader,
+               tinygltf::Options& opt,
+               const std::string& location,
+               const osgDB::Options* readOptions) const
+    {
+        tinygltf::FsCallbacks fs;
+        fs.FileExists = &tinygltf::FileExists;
+        fs.ExpandFilePath = &GLTFReader::ExpandFilePath;
+        fs.ReadWholeFile = &tinygltf::ReadWholeFile;
+        fs.WriteWholeFile = &tinygltf::WriteWholeFile;
+        fs.user_data = (void*)&location;
+        loader.SetFsCallbacks(fs);
+
+        opt.skip_imagery = readOptions && readOptions->getOptionString().find("gltfSkipImagery") != std::string::npos;
+    }
+
+    osgDB::ReaderWriter::ReadResult finish(const tinygltf::Model& model,
+                                           const std::string& err,
+                                           const std::string& location,
+                                           const osgDB::Options* readOptions) const
+    {
         if (!err.empty()) {
             OE_WARN << LC << "gltf Error loading " << location << std::endl;
             OE_WARN << LC << err << std::endl;
@@ -110,14 +110,13 @@ public:
 
         // Determine format by peeking the magic header:
         std::string magic(buffer, 0, 4);
+        std::string::size_type start = buffer.find_first_not_of(" \t\r\n");
 
         if (magic == "glTF")
         {
-            // non-functional -- fix - TODO
             GLTFReader reader;
             reader.setTextureCache(&_cache);
-            tinygltf::Model model;
-            return reader.read(context.referrer(), true, options); // binary=yes
+            return reader.read(context.referrer(), true, buffer, options); // binary=yes
         }
         else if (magic == "b3dm")
         {
@@ -125,6 +124,12 @@ public:
             reader.setTextureCache(&_cache);
             return reader.read(context.referrer(), buffer, options);
         }
+        else if (start != std::string::npos && buffer[start] == '{')
+        {
+            GLTFReader reader;
+            reader.setTextureCache(&_cache);
+            return reader.read(context.referrer(), false, buffer, options); // binary=no
+        }
         else return ReadResult::FILE_NOT_HANDLED;
     }
 
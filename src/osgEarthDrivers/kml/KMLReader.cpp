@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include "KMLReader"
+#include "KMLStreamReader"
 #include "KML_Root"
 #include "KML_Geometry"
 #include <osgEarth/Registry>
@@ -43,6 +44,14 @@ _options( options )
 osg::Node*
 KMLReader::read( std::istream& in, const osgDB::Options* dbOptions )
 {
+    // incremental parse; a sink means we are running in the background.
+    KMLStreamSink* sink = KMLStreamSink::get(dbOptions);
+    if (sink || (_options && (_options->streaming() == true || _options->progressive() == true)))
+    {
+        KMLStreamReader streamReader(_mapNode, _options);
+        return streamReader.read(in, dbOptions, sink);
+    }
+
     OE_INFO << LC << "Loading KML.." << std::endl;
     // pull the URI context out of the DB options:
     URIContext context(dbOptions);
@@ -0,0 +1,1086 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "KMLStreamReader"
+#include "KML_Common"
+#include "KML_Container"
+#include "KML_Style"
+#include "KML_StyleMap"
+#include "KML_Schema"
+#include "KML_Placemark"
+#include "KML_GroundOverlay"
+#include "KML_ScreenOverlay"
+#include "KML_PhotoOverlay"
+#include "KML_NetworkLink"
+#include "KML_NetworkLinkControl"
+#include <osgEarth/Registry>
+#include <osgEarth/GeoData>
+#include <osgEarth/NodeUtils>
+#include <osgEarth/PagedNode>
+#include <osgEarth/StringUtils>
+#include <osgDB/Registry>
+#include <osg/Timer>
+#include <map>
+#include <cmath>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+using namespace osgEarth_kml;
+using namespace osgEarth;
+
+#undef LC
+#define LC "[KMLStreamReader] "
+
+//........................................................................
+
+namespace
+{
+    // bytes to pull from the input stream at a time
+    const size_t CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * Minimal pull tokenizer over an XML input stream. It does not build
+     * a DOM; it only reports element start/end tags and their byte ranges
+     * so the caller can cut out complete elements and hand them to
+     * rapidxml one at a time. Comments, CDATA, processing instructions and
+     * DOCTYPE declarations are skipped; quoted attribute values may
+     * contain '>'.
+     */
+    class TagScanner
+    {
+    public:
+        enum Type { START, END, EMPTY, OTHER };
+
+        struct Tag
+        {
+            Type        type;
+            std::string name;   // lower case, namespace prefix stripped
+            size_t      begin;  // offset of '<'
+            size_t      end;    // offset one past '>'
+        };
+
+        TagScanner(std::istream& in) : _in(in), _pos(0), _mark(std::string::npos) { }
+
+        //! Advance to the next tag; returns false at end of stream.
+        bool next(Tag& tag)
+        {
+            compact();
+
+            for(;;)
+            {
+                size_t lt = _buf.find('<', _pos);
+                if (lt != std::string::npos) { _pos = lt; break; }
+                _pos = _buf.size();
+                if (!fill()) return false;
+            }
+
+            if (!require(_pos + 9))
+                require(_pos + 2);
+
+            tag.begin = _pos;
+            tag.type = OTHER;
+            tag.name.clear();
+
+            size_t end;
+            if (_buf.compare(_pos, 4, "<!--") == 0)
+                end = find("-->", _pos + 4);
+            else if (_buf.compare(_pos, 9, "<![CDATA[") == 0)
+                end = find("]]>", _pos + 9);
+            else if (_buf.compare(_pos, 2, "<?") == 0)
+                end = find("?>", _pos + 2);
+            else if (_buf.compare(_pos, 2, "<!") == 0)
+                end = find(">", _pos + 2);
+            else
+                end = scanElement(tag);
+
+            if (end == std::string::npos)
+            {
+                // truncated document
+                _pos = _buf.size();
+                return false;
+            }
+
+            _pos = tag.end = end;
+            return true;
+        }
+
+        //! Keep everything from "offset" on in the buffer until take() is called.
+        void mark(size_t offset) { _mark = offset; }
+
+        //! Return the text between the mark and "end" and release the mark.
+        std::string take(size_t end)
+        {
+            std::string text = _buf.substr(_mark, end - _mark);
+            _mark = std::string::npos;
+            return text;
+        }
+
+        //! Raw text of a tag returned by the last call to next().
+        std::string text(const Tag& tag) const
+        {
+            return _buf.substr(tag.begin, tag.end - tag.begin);
+        }
+
+    private:
+        std::istream& _in;
+        std::string   _buf;
+        size_t        _pos;
+        size_t        _mark;
+
+        bool fill()
+        {
+            if (!_in.good())
+                return false;
+            size_t size = _buf.size();
+            _buf.resize(size + CHUNK_SIZE);
+            _in.read(&_buf[size], CHUNK_SIZE);
+            _buf.resize(size + (size_t)_in.gcount());
+            return _buf.size() > size;
+        }
+
+        bool require(size_t size)
+        {
+            while (_buf.size() < size)
+                if (!fill()) return false;
+            return true;
+        }
+
+        // discard consumed data so the buffer never holds more than the
+        // element being captured plus one chunk.
+        void compact()
+        {
+            size_t keep = _mark != std::string::npos ? _mark : _pos;
+            if (keep >= CHUNK_SIZE)
+            {
+                _buf.erase(0, keep);
+                _pos -= keep;
+                if (_mark != std::string::npos)
+                    _mark -= keep;
+            }
+        }
+
+        // offset one past the end of "pattern", searching from "from"
+        size_t find(const char* pattern, size_t from)
+        {
+            size_t len = strlen(pattern);
+            for(;;)
+            {
+                size_t i = _buf.find(pattern, from);
+                if (i != std::string::npos)
+                    return i + len;
+                if (_buf.size() >= len)
+                    from = std::max(from, _buf.size() - len + 1);
+                if (!fill())
+                    return std::string::npos;
+            }
+        }
+
+        size_t scanElement(Tag& tag)
+        {
+            size_t i = _pos + 1;
+            bool isEnd = false;
+            if (require(i + 1) && _buf[i] == '/')
+            {
+                isEnd = true;
+                ++i;
+            }
+
+            // element name
+            size_t nameStart = i;
+            for(;;)
+            {
+                if (i >= _buf.size() && !fill())
+                    return std::string::npos;
+                char c = _buf[i];
+                if (c == '>' || c == '/' || isspace((unsigned char)c))
+                    break;
+                ++i;
+            }
+            std::string qname = _buf.substr(nameStart, i - nameStart);
+            size_t colon = qname.find(':');
+            tag.name = toLower(colon != std::string::npos ? qname.substr(colon + 1) : qname);
+
+            // skip attributes up to the closing '>', honoring quotes
+            char quote = 0;
+            for(;;)
+            {
+                if (i >= _buf.size() && !fill())
+                    return std::string::npos;
+                char c = _buf[i];
+                if (quote)
+                {
+                    if (c == quote) quote = 0;
+                }
+                else if (c == '"' || c == '\'')
+                {
+                    quote = c;
+                }
+                else if (c == '>')
+                {
+                    break;
+                }
+                ++i;
+            }
+
+            tag.type =
+                isEnd ? END :
+                _buf[i-1] == '/' ? EMPTY :
+                START;
+
+            return i + 1;
+        }
+    };
+
+    // Elements that map to a group in the scene graph
+    bool isContainer(const std::string& name)
+    {
+        return name == "kml" || name == "document" || name == "folder";
+    }
+
+    // Elements that produce scene graph content
+    bool isFeature(const std::string& name)
+    {
+        return
+            name == "placemark" ||
+            name == "groundoverlay" ||
+            name == "screenoverlay" ||
+            name == "photooverlay" ||
+            name == "networklink";
+    }
+
+    // Depth-first search for the first <coordinates> element
+    xml_node<>* findCoordinates(xml_node<>* node)
+    {
+        for (xml_node<>* n = node->first_node(); n; n = n->next_sibling())
+        {
+            if (n->type() != node_element)
+                continue;
+            if (rapidxml::internal::compare(n->name(), n->name_size(), "coordinates", 11, false))
+                return n;
+            xml_node<>* c = findCoordinates(n);
+            if (c)
+                return c;
+        }
+        return 0L;
+    }
+
+    // Expands "bound" by the world position of every coordinate tuple
+    // under "node".
+    void expandByCoordinates(xml_node<>* node, const SpatialReference* srs, const SpatialReference* mapSRS, osg::BoundingSphere& bound)
+    {
+        for (xml_node<>* n = node->first_node(); n; n = n->next_sibling())
+        {
+            if (n->type() != node_element)
+                continue;
+
+            if (!rapidxml::internal::compare(n->name(), n->name_size(), "coordinates", 11, false))
+            {
+                expandByCoordinates(n, srs, mapSRS, bound);
+                continue;
+            }
+
+            const char* p = n->value();
+            double lon, lat;
+            int len = 0;
+            while (sscanf(p, " %lf , %lf%n", &lon, &lat, &len) == 2)
+            {
+                p += len;
+                double alt = 0.0;
+                if (sscanf(p, " , %lf%n", &alt, &len) == 1)
+                    p += len;
+
+                GeoPoint point;
+                osg::Vec3d world;
+                if (GeoPoint(srs, lon, lat, alt, ALTMODE_ABSOLUTE).transform(mapSRS, point) && point.toWorld(world))
+                    bound.expandBy(world);
+            }
+        }
+    }
+
+    // KMLOptions that redirect the icon/label group to a private scratch
+    // group, since the real one may already be live in the scene graph.
+    struct StreamOptions : public KMLOptions
+    {
+        StreamOptions(const KMLOptions& rhs, osg::Group* scratch) : KMLOptions(rhs)
+        {
+            _iconAndLabelGroup = scratch;
+        }
+    };
+
+    typedef std::pair<int, int> CellKey;
+
+    // A placemark whose nodes are built when its chunk pages in
+    struct PendingPlacemark
+    {
+        std::string source;                        // the <Placemark> element
+        Style activeStyle;                         // context style when it was read
+    };
+    typedef std::vector<PendingPlacemark> PlacemarkList;
+
+    /**
+     * The parts of a KMLContext that chunks need to build placemarks on
+     * the pager thread. The style sheet is a snapshot, since the reader
+     * keeps adding to its own; it is shared by chunks until that changes.
+     */
+    struct ChunkContext : public osg::Referenced
+    {
+        ChunkContext(const KMLContext& cx) :
+            _mapNode(cx._mapNode),
+            _options(*cx._options, 0L),
+            _srs(cx._srs),
+            _referrer(cx._referrer)
+        {
+            _sheet = new StyleSheet();
+            const StyleMap& styles = cx._sheet->getStyles();
+            for (StyleMap::const_iterator i = styles.begin(); i != styles.end(); ++i)
+                _sheet->addStyle(i->second);
+            _numStyles = styles.size();
+
+            // the reader's URI cache lives on its stack, so don't carry it over
+            osgDB::Options* dbOptions = Registry::instance()->cloneOrCreateOptions(cx._dbOptions.get());
+            dbOptions->removePluginData("osgEarth::URIResultCache");
+            _dbOptions = dbOptions;
+        }
+
+        osg::observer_ptr<MapNode>          _mapNode;
+        StreamOptions                       _options;
+        osg::ref_ptr<StyleSheet>            _sheet;
+        size_t                              _numStyles;
+        osg::ref_ptr<const SpatialReference> _srs;
+        osg::ref_ptr<const osgDB::Options>  _dbOptions;
+        std::string                         _referrer;
+    };
+
+    /**
+     * A chunk of the placemarks in one cell. The database pager loads it
+     * when the camera comes within range of the chunk's bound, and drops
+     * it again when it falls out of view. Only the placemarks' source is
+     * kept; their nodes are built on each load and released on expiry.
+     */
+    class CellChunk : public PagedNode
+    {
+    public:
+        CellChunk(PlacemarkList& placemarks, const osg::BoundingSphere& bound, ChunkContext* context) :
+            _bound(bound),
+            _context(context)
+        {
+            _placemarks.swap(placemarks);
+            setupPaging();
+        }
+
+    public: // PagedNode
+
+        osg::Node* loadChild()
+        {
+            osg::ref_ptr<MapNode> mapNode;
+            if (!_context->_mapNode.lock(mapNode))
+                return 0L;
+
+            KMLContext cx;
+            cx._mapNode   = mapNode.get();
+            cx._sheet     = _context->_sheet.get();
+            cx._options   = &_context->_options;
+            cx._srs       = _context->_srs.get();
+            cx._dbOptions = _context->_dbOptions.get();
+            cx._referrer  = _context->_referrer;
+
+            osg::Group* group = new osg::Group();
+            cx._groupStack.push(group);
+
+            for (PlacemarkList::const_iterator i = _placemarks.begin(); i != _placemarks.end(); ++i)
+            {
+                // rapidxml parses in place, so work on a copy
+                std::string source = i->source;
+                xml_document<> doc;
+                try
+                {
+                    doc.parse<0>(&source[0]);
+                }
+                catch (rapidxml::parse_error&)
+                {
+                    continue;
+                }
+
+                xml_node<>* node = doc.first_node();
+                if (node)
+                {
+                    // styles were already scanned into the sheet when the placemark was read
+                    cx._activeStyle = i->activeStyle;
+                    KML_Placemark placemark;
+                    placemark.build(node, cx);
+                }
+            }
+
+            cx._groupStack.pop();
+            return group;
+        }
+
+        osg::BoundingSphere getChildBound() const { return _bound; }
+
+    private:
+        PlacemarkList _placemarks;
+        osg::BoundingSphere _bound;
+        osg::ref_ptr<ChunkContext> _context;
+    };
+
+    struct Cell
+    {
+        osg::ref_ptr<osg::Group> group;            // holds the cell's chunks
+        PlacemarkList pending;                     // placemarks not yet in a chunk
+        osg::BoundingSphere bound;                 // bound of the pending placemarks
+    };
+
+    struct Container
+    {
+        std::string name;                          // element name (document, folder, kml)
+        std::string shell;                         // start tag + property elements
+        osg::ref_ptr<osg::Group> group;            // NULL for the kml root
+        bool emitted;                              // whether the group was sent out
+        std::map<CellKey, Cell> cells;
+    };
+
+    /**
+     * One streaming parse. Owns the KML context and collects the output
+     * batch, which is either applied directly to the root or sent to a sink.
+     */
+    class StreamParser
+    {
+    public:
+        StreamParser(KMLContext& cx, osg::Group* root, KMLStreamSink* sink,
+                     osg::Group* scratchIcons, osg::Group* iconAndLabelGroup,
+                     unsigned batchSize, double tileSize) :
+            _cx(cx),
+            _root(root),
+            _sink(sink),
+            _scratchIcons(scratchIcons),
+            _iconAndLabelGroup(iconAndLabelGroup),
+            _batchSize(std::max(batchSize, 1u)),
+            _tileSize(tileSize),
+            _featuresInBatch(0u),
+            _numFeatures(0u),
+            _numBatches(0u)
+        {
+            _scratch = new osg::Group();
+
+            // a chunk pages in at a multiple of its radius; keep a lone
+            // point from collapsing that to nothing. Roughly half a cell.
+            _minChunkRadius = 0.5 * _tileSize * 111000.0;
+        }
+
+        void run(std::istream& in)
+        {
+            TagScanner scanner(in);
+            TagScanner::Tag tag;
+
+            while (scanner.next(tag))
+            {
+                if (_sink && _sink->isCanceled())
+                    break;
+
+                if (tag.type == TagScanner::OTHER)
+                    continue;
+
+                if (tag.type == TagScanner::END)
+                {
+                    if (isContainer(tag.name) && !_containers.empty())
+                        closeContainer();
+                    continue;
+                }
+
+                if (isContainer(tag.name))
+                {
+                    if (tag.type == TagScanner::START)
+                        openContainer(tag.name, scanner.text(tag));
+                    continue;
+                }
+
+                // capture the complete element:
+                std::string fragment;
+                if (tag.type == TagScanner::EMPTY)
+                {
+                    fragment = scanner.text(tag);
+                }
+                else
+                {
+                    scanner.mark(tag.begin);
+                    TagScanner::Tag inner;
+                    int depth = 1;
+                    while (depth > 0 && scanner.next(inner))
+                    {
+                        if (inner.type == TagScanner::START) ++depth;
+                        else if (inner.type == TagScanner::END) --depth;
+                    }
+                    if (depth > 0)
+                    {
+                        OE_WARN << LC << "Unexpected end of stream inside <" << tag.name << ">" << std::endl;
+                        break;
+                    }
+                    fragment = scanner.take(inner.end);
+                }
+
+                handleElement(tag.name, fragment);
+            }
+
+            // close anything left open by a truncated file
+            while (!_containers.empty())
+                closeContainer();
+
+            flush();
+        }
+
+        unsigned numFeatures() const { return _numFeatures; }
+        unsigned numBatches() const { return _numBatches; }
+
+    private:
+        KMLContext&                 _cx;
+        osg::ref_ptr<osg::Group>    _root;
+        KMLStreamSink*              _sink;
+        osg::ref_ptr<osg::Group>    _scratch;
+        osg::ref_ptr<osg::Group>    _scratchIcons;
+        osg::ref_ptr<osg::Group>    _iconAndLabelGroup;
+        unsigned                    _batchSize;
+        double                      _tileSize;
+        double                      _minChunkRadius;
+        osg::ref_ptr<ChunkContext>  _chunkContext;
+        std::vector<Container>      _containers;
+        KMLStreamSink::Batch        _batch;
+        unsigned                    _featuresInBatch;
+        unsigned                    _numFeatures;
+        unsigned                    _numBatches;
+
+        void emit(osg::Group* parent, osg::Node* child)
+        {
+            _batch.push_back(std::make_pair(osg::ref_ptr<osg::Group>(parent), osg::ref_ptr<osg::Node>(child)));
+        }
+
+        void flush()
+        {
+            if (_batch.empty())
+                return;
+
+            if (_sink)
+            {
+                _sink->push(_batch);
+            }
+            else
+            {
+                for (KMLStreamSink::Batch::iterator i = _batch.begin(); i != _batch.end(); ++i)
+                {
+                    osg::Group* parent = i->first.valid() ? i->first.get() : _root.get();
+                    parent->addChild(i->second.get());
+                }
+            }
+
+            _batch.clear();
+            _featuresInBatch = 0u;
+            ++_numBatches;
+        }
+
+        void openContainer(const std::string& name, const std::string& startTag)
+        {
+            if (!_containers.empty())
+                emitContainer(_containers.back());
+
+            _containers.push_back(Container());
+            Container& c = _containers.back();
+            c.name = name;
+            c.emitted = (name == "kml");
+            if (!c.emitted)
+            {
+                c.group = new osg::Group();
+                c.shell = startTag;
+            }
+        }
+
+        void closeContainer()
+        {
+            Container& c = _containers.back();
+            emitContainer(c);
+            for (std::map<CellKey, Cell>::iterator i = c.cells.begin(); i != c.cells.end(); ++i)
+                emitChunk(i->second);
+            _containers.pop_back();
+        }
+
+        // Sends a cell's pending placemarks out as one paged chunk.
+        void emitChunk(Cell& cell)
+        {
+            if (cell.pending.empty())
+                return;
+
+            osg::BoundingSphere bound = cell.bound;
+            bound.radius() = osg::maximum(bound.radius(), (float)_minChunkRadius);
+
+            emit(cell.group.get(), new CellChunk(cell.pending, bound, chunkContext()));
+            cell.bound.init();
+        }
+
+        // Context for new chunks, refreshed when the style sheet has grown
+        ChunkContext* chunkContext()
+        {
+            if (!_chunkContext.valid() || _chunkContext->_numStyles != _cx._sheet->getStyles().size())
+                _chunkContext = new ChunkContext(_cx);
+            return _chunkContext.get();
+        }
+
+        // Sends a container's group out, first applying the properties
+        // (name, visibility, LookAt...) that preceded its first feature.
+        void emitContainer(Container& c)
+        {
+            if (c.emitted)
+                return;
+            c.emitted = true;
+
+            std::string shell = c.shell + "</" + c.name + ">";
+            try
+            {
+                xml_document<> doc;
+                doc.parse<0>(&shell[0]);
+                xml_node<>* node = doc.first_node();
+                if (node)
+                {
+                    KML_Container container;
+                    container.build(node, _cx, c.group.get());
+                }
+            }
+            catch (rapidxml::parse_error& e)
+            {
+                OE_WARN << LC << "Failed to parse <" << c.name << "> properties: " << e.what() << std::endl;
+            }
+            c.shell.clear();
+
+            emit(parentGroup(), c.group.get());
+        }
+
+        // Group of the innermost container below the current one, or NULL for the root
+        osg::Group* parentGroup() const
+        {
+            for (int i = (int)_containers.size() - 2; i >= 0; --i)
+                if (_containers[i].group.valid())
+                    return _containers[i].group.get();
+            return 0L;
+        }
+
+        osg::Group* currentGroup() const
+        {
+            for (int i = (int)_containers.size() - 1; i >= 0; --i)
+                if (_containers[i].group.valid())
+                    return _containers[i].group.get();
+            return 0L;
+        }
+
+        // Cell for a placemark in the current container, or NULL if it is not binned
+        Cell* findCell(xml_node<>* node)
+        {
+            if (_tileSize <= 0.0 || _containers.empty())
+                return 0L;
+
+            xml_node<>* coords = findCoordinates(node);
+            double lon, lat;
+            if (!coords || sscanf(coords->value(), " %lf , %lf", &lon, &lat) != 2)
+                return 0L;
+
+            CellKey key(
+                (int)floor((lon + 180.0) / _tileSize),
+                (int)floor((lat + 90.0) / _tileSize));
+
+            Cell& cell = _containers.back().cells[key];
+            if (!cell.group.valid())
+            {
+                cell.group = new osg::Group();
+                emit(currentGroup(), cell.group.get());
+            }
+            return &cell;
+        }
+
+        void handleElement(const std::string& name, std::string& fragment)
+        {
+            bool known =
+                isFeature(name) ||
+                name == "style" ||
+                name == "stylemap" ||
+                name == "schema" ||
+                name == "networklinkcontrol";
+
+            if (!known)
+            {
+                // a container property (name, visibility, LookAt...); apply it
+                // when the group goes out. Properties after the first feature
+                // are ignored.
+                if (!_containers.empty() && !_containers.back().emitted)
+                    _containers.back().shell += fragment;
+                return;
+            }
+
+            // rapidxml parses in place; a binned placemark needs its source later
+            std::string source;
+            if (name == "placemark")
+                source = fragment;
+
+            xml_document<> doc;
+            try
+            {
+                doc.parse<0>(&fragment[0]);
+            }
+            catch (rapidxml::parse_error& e)
+            {
+                OE_WARN << LC << "Skipping malformed <" << name << ">: " << e.what() << std::endl;
+                return;
+            }
+
+            xml_node<>* node = doc.first_node();
+            if (!node)
+                return;
+
+            if (name == "style")
+            {
+                KML_Style style;
+                style.scan(node, _cx);
+                style.scan2(node, _cx);
+            }
+            else if (name == "stylemap")
+            {
+                KML_StyleMap styleMap;
+                styleMap.scan(node, _cx);
+                styleMap.scan2(node, _cx);
+            }
+            else if (name == "schema")
+            {
+                KML_Schema schema;
+                schema.scan(node, _cx);
+                schema.scan2(node, _cx);
+            }
+            else if (name == "networklinkcontrol")
+            {
+                KML_NetworkLinkControl control;
+                control.scan(node, _cx);
+                control.scan2(node, _cx);
+            }
+            else
+            {
+                if (!_containers.empty())
+                    emitContainer(_containers.back());
+
+                if      (name == "placemark")     buildPlacemark(node, source);
+                else if (name == "groundoverlay") buildFeature<KML_GroundOverlay>(node);
+                else if (name == "screenoverlay") buildFeature<KML_ScreenOverlay>(node);
+                else if (name == "photooverlay")  buildFeature<KML_PhotoOverlay>(node);
+                else if (name == "networklink")   buildFeature<KML_NetworkLink>(node);
+            }
+        }
+
+        // Binned placemarks are not built here; their source goes into a
+        // chunk that builds them when it pages in.
+        void buildPlacemark(xml_node<>* node, std::string& source)
+        {
+            Cell* cell = findCell(node);
+            if (!cell)
+            {
+                buildFeature<KML_Placemark>(node);
+                return;
+            }
+
+            KML_Placemark placemark;
+            placemark.scan(node, _cx);
+            placemark.scan2(node, _cx);
+
+            expandByCoordinates(node, _cx._srs.get(), _cx._mapNode->getMapSRS(), cell->bound);
+
+            cell->pending.push_back(PendingPlacemark());
+            cell->pending.back().source.swap(source);
+            cell->pending.back().activeStyle = _cx._activeStyle;
+
+            if (cell->pending.size() >= _batchSize)
+                emitChunk(*cell);
+
+            ++_numFeatures;
+            if (++_featuresInBatch >= _batchSize)
+                flush();
+        }
+
+        template<typename T>
+        void buildFeature(xml_node<>* node)
+        {
+            T feature;
+            feature.scan(node, _cx);
+            feature.scan2(node, _cx);
+
+            _cx._groupStack.push(_scratch.get());
+            feature.build(node, _cx);
+            _cx._groupStack.pop();
+
+            for (unsigned i = 0; i < _scratch->getNumChildren(); ++i)
+                emit(currentGroup(), _scratch->getChild(i));
+            _scratch->removeChildren(0, _scratch->getNumChildren());
+
+            if (_scratchIcons.valid())
+            {
+                for (unsigned i = 0; i < _scratchIcons->getNumChildren(); ++i)
+                    emit(_iconAndLabelGroup.get(), _scratchIcons->getChild(i));
+                _scratchIcons->removeChildren(0, _scratchIcons->getNumChildren());
+            }
+
+            ++_numFeatures;
+            if (++_featuresInBatch >= _batchSize)
+                flush();
+        }
+    };
+}
+
+//........................................................................
+
+KMLStreamSink::KMLStreamSink() :
+_maxQueued(8u),
+_canceled(false),
+_done(false)
+{
+    //nop
+}
+
+void
+KMLStreamSink::push(Batch& batch)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    while (!_canceled && _queue.size() >= _maxQueued)
+    {
+        _notFull.wait(&_mutex);
+    }
+    _queue.push_back(Batch());
+    _queue.back().swap(batch);
+}
+
+bool
+KMLStreamSink::pop(Batch& batch)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    if (_queue.empty())
+        return false;
+    batch.swap(_queue.front());
+    _queue.pop_front();
+    _notFull.signal();
+    return true;
+}
+
+void
+KMLStreamSink::cancel()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _canceled = true;
+    _notFull.broadcast();
+}
+
+bool
+KMLStreamSink::isComplete() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _done && _queue.empty();
+}
+
+void
+KMLStreamSink::put(osgDB::Options* options)
+{
+    if (options)
+    {
+        options->setPluginData("osgEarth::KMLStreamSink", this);
+    }
+}
+
+KMLStreamSink*
+KMLStreamSink::get(const osgDB::Options* options)
+{
+    if (!options) return 0L;
+    return static_cast<KMLStreamSink*>(
+        const_cast<void*>(options->getPluginData("osgEarth::KMLStreamSink")));
+}
+
+//........................................................................
+
+namespace
+{
+    // Pool shared by every streaming load, unless the caller supplies
+    // one in its options.
+    Threading::Mutex s_streamPoolMutex;
+
+    osg::ref_ptr<Threading::ThreadPool> getStreamPool(const osgDB::Options* dbOptions)
+    {
+        osg::ref_ptr<Threading::ThreadPool> pool = Threading::ThreadPool::get(dbOptions);
+        if (pool.valid())
+            return pool;
+
+        static osg::ref_ptr<Threading::ThreadPool> s_pool;
+        Threading::ScopedMutexLock lock(s_streamPoolMutex);
+        if (!s_pool.valid())
+            s_pool = new Threading::ThreadPool(2u);
+        return s_pool;
+    }
+
+    // Runs a streaming read in the background, feeding a sink.
+    struct StreamOperation : public osg::Operation
+    {
+        StreamOperation(const std::string& url, const KMLOptions& kmlOptions, const osgDB::Options* dbOptions, KMLStreamSink* sink) :
+            osg::Operation("KML stream", false),
+            _url(url),
+            _kmlOptions(kmlOptions),
+            _sink(sink)
+        {
+            _dbOptions = Registry::instance()->cloneOrCreateOptions(dbOptions);
+        }
+
+        void operator()(osg::Object*)
+        {
+            if (!_sink->isCanceled())
+            {
+                // the KMLOptions passed in by the caller may not outlive us, so use our copy.
+                // The sink is only referenced by pointer; we hold it until we finish.
+                _dbOptions->setPluginData("osgEarth::KMLOptions", (void*)&_kmlOptions);
+                _sink->put(_dbOptions.get());
+
+                osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("kml");
+                if (rw)
+                {
+                    osgDB::ReaderWriter::ReadResult r = rw->readNode(_url, _dbOptions.get());
+                    if (!r.success() && !_sink->isCanceled())
+                    {
+                        OE_WARN << LC << "Failed to stream " << _url << ": " << r.message() << std::endl;
+                    }
+                }
+            }
+            _sink->setDone();
+        }
+
+        std::string _url;
+        KMLOptions _kmlOptions;
+        osg::ref_ptr<osgDB::Options> _dbOptions;
+        osg::ref_ptr<KMLStreamSink> _sink;
+    };
+}
+
+KMLStreamRoot::KMLStreamRoot(const std::string& url,
+                             const KMLOptions& kmlOptions,
+                             const osgDB::Options* dbOptions) :
+_merging(true)
+{
+    setName(url);
+
+    // Make sure the KML gets rendered after the terrain.
+    getOrCreateStateSet()->setRenderBinDetails(2, "RenderBin");
+
+    _sink = new KMLStreamSink();
+
+    getStreamPool(dbOptions)->getQueue()->add(new StreamOperation(url, kmlOptions, dbOptions, _sink.get()));
+
+    ADJUST_UPDATE_TRAV_COUNT(this, +1);
+}
+
+KMLStreamRoot::~KMLStreamRoot()
+{
+    // stop the reader; the operation holds the sink until it returns.
+    _sink->cancel();
+}
+
+void
+KMLStreamRoot::traverse(osg::NodeVisitor& nv)
+{
+    if (_merging && nv.getVisitorType() == nv.UPDATE_VISITOR)
+    {
+        KMLStreamSink::Batch batch;
+        if (_sink->pop(batch))
+        {
+            for (KMLStreamSink::Batch::iterator i = batch.begin(); i != batch.end(); ++i)
+            {
+                osg::Group* parent = i->first.valid() ? i->first.get() : this;
+                parent->addChild(i->second.get());
+            }
+        }
+        else if (_sink->isComplete())
+        {
+            _merging = false;
+            ADJUST_UPDATE_TRAV_COUNT(this, -1);
+            OE_INFO << LC << "Finished streaming " << getName() << std::endl;
+        }
+    }
+
+    osg::Group::traverse(nv);
+}
+
+//........................................................................
+
+KMLStreamReader::KMLStreamReader(MapNode* mapNode, const KMLOptions* options) :
+_mapNode(mapNode),
+_options(options)
+{
+    //nop
+}
+
+osg::Node*
+KMLStreamReader::read(std::istream& in, const osgDB::Options* dbOptions, KMLStreamSink* sink)
+{
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    URIContext context(dbOptions);
+
+    osg::ref_ptr<osg::Group> root = new osg::Group();
+    root->setName(context.referrer());
+
+    KMLOptions blankOptions;
+    const KMLOptions* options = _options ? _options : &blankOptions;
+
+    // redirect screen-space items to a scratch group; they are emitted
+    // along with the rest of the batch.
+    osg::ref_ptr<osg::Group> scratchIcons;
+    if (options->iconAndLabelGroup().valid())
+        scratchIcons = new osg::Group();
+    StreamOptions streamOptions(*options, scratchIcons.get());
+
+    KMLContext cx;
+    cx._mapNode  = _mapNode;
+    cx._sheet    = new StyleSheet();
+    cx._options  = &streamOptions;
+    cx._srs      = _mapNode->getMapSRS()->getGeographicSRS();
+    cx._referrer = context.referrer();
+
+    // install a resource cache if there isn't one already:
+    URIResultCache defaultUriCache;
+    if ( !URIResultCache::from(dbOptions) )
+    {
+        osgDB::Options* newOptions = Registry::instance()->cloneOrCreateOptions(dbOptions);
+        defaultUriCache.apply( newOptions );
+        cx._dbOptions = newOptions;
+    }
+    else
+    {
+        cx._dbOptions = dbOptions;
+    }
+
+    StreamParser parser(
+        cx, root.get(), sink,
+        scratchIcons.get(), options->iconAndLabelGroup().get(),
+        options->batchSize().get(),
+        options->tileSize().get());
+
+    parser.run(in);
+
+    OE_INFO << LC << "Streamed " << parser.numFeatures() << " features in "
+        << parser.numBatches() << " batches, "
+        << osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) << "s" << std::endl;
+
+    // Make sure the KML gets rendered after the terrain.
+    root->getOrCreateStateSet()->setRenderBinDetails(2, "RenderBin");
+
+    return root.release();
+}
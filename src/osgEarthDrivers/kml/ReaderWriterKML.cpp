@@ -28,6 +28,7 @@
 
 #include "KMLOptions"
 #include "KMLReader"
+#include "KMLStreamReader"
 #include "KMZArchive"
 
 #define LC "[ReaderWriterKML] "
@@ -65,6 +66,19 @@ struct ReaderWriterKML : public osgDB::ReaderWriter
         if ( !acceptsExtension(ext) )
             return ReadResult::FILE_NOT_HANDLED;
 
+        // progressive load: return an empty root right away and stream the
+        // features into it from a background thread.
+        if ( dbOptions && dbOptions->getPluginData("osgEarth::MapNode") && !KMLStreamSink::get(dbOptions) )
+        {
+            const KML::KMLOptions* kmlOptions =
+                static_cast<const KML::KMLOptions*>(dbOptions->getPluginData("osgEarth::KMLOptions"));
+
+            if ( kmlOptions && kmlOptions->progressive() == true )
+            {
+                return new KMLStreamRoot( url, *kmlOptions, dbOptions );
+            }
+        }
+
         if ( ext == "kmz" )
         {
             // redirect to the archive.
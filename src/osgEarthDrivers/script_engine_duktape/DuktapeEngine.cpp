@@ -18,6 +18,7 @@
  */
 #include "DuktapeEngine"
 #include "JSGeometry"
+#include "JSFeature"
 #include <osgEarth/JsonUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/GeometryUtils>
@@ -53,160 +54,91 @@ namespace
         return 0;
     }
 
-    static duk_ret_t oe_duk_save_feature(duk_context* ctx)
+    // feature.save() for the "geojson" profile: writes the decoded
+    // properties and geometry back to the feature.
+    static duk_ret_t saveGeoJSONFeature(duk_context* ctx)
     {
-        // stack: [ptr]
-
-        // pull the feature ptr from argument #0
-        Feature* feature = reinterpret_cast<Feature*>(duk_require_pointer(ctx, 0));
-
-        // Fetch the feature data:
-        duk_push_global_object(ctx);
-        // [ptr, global]
-
-        if ( !duk_get_prop_string(ctx, -1, "feature") || !duk_is_object(ctx, -1))
+        duk_push_this(ctx);                                      // [feature]
+        duk_get_prop_string(ctx, -1, "__ptr");                   // [feature, ptr]
+        Feature* feature = reinterpret_cast<Feature*>(duk_get_pointer(ctx, -1));
+        duk_pop(ctx);                                            // [feature]
+        if (!feature)
             return 0;
 
-         // [ptr, global, feature]
-
-        if ( duk_get_prop_string(ctx, -1, "properties") && duk_is_object(ctx, -1) )
+        if (duk_get_prop_string(ctx, -1, "properties") && duk_is_object(ctx, -1))
         {
-            // [ptr, global, feature, props]
-            duk_enum(ctx, -1, 0);
-
-            // [ptr, global, feature, props, enum]
-            while( duk_next(ctx, -1, 1/*get_value=true*/) )
+            // [feature, props]
+            duk_enum(ctx, -1, 0);                                // [feature, props, enum]
+            while (duk_next(ctx, -1, 1/*get_value=true*/))
             {
-                std::string key( duk_get_string(ctx, -2) );
+                std::string key(duk_get_string(ctx, -2));
                 if (duk_is_string(ctx, -1))
-                {
-                    feature->set( key, std::string(duk_get_string(ctx, -1)) );
-                }
+                    feature->set(key, std::string(duk_get_string(ctx, -1)));
                 else if (duk_is_number(ctx, -1))
-                {
-                    feature->set( key, (double)duk_get_number(ctx, -1) );
-                }
+                    feature->set(key, (double)duk_get_number(ctx, -1));
                 else if (duk_is_boolean(ctx, -1))
-                {
-                    feature->set( key, duk_get_boolean(ctx, -1) );
-                }
-                else if( duk_is_null_or_undefined( ctx, -1 ) )
-                {
-                    feature->setNull( key );
-                }
-                 duk_pop_2(ctx);
+                    feature->set(key, duk_get_boolean(ctx, -1) != 0);
+                else if (duk_is_null_or_undefined(ctx, -1))
+                    feature->setNull(key);
+                duk_pop_2(ctx);
             }
-
-            duk_pop_2(ctx);
-            // [ptr, global, feature]
-        }
-        else
-        {   // [ptr, global, feature, undefined]
-            duk_pop(ctx);
-            // [ptr, global, feature]
+            duk_pop(ctx);                                        // [feature, props]
         }
+        duk_pop(ctx);                                            // [feature]
 
-        // save the geometry, if set:
-        if ( duk_get_prop_string(ctx, -1, "geometry") )
+        if (duk_get_prop_string(ctx, -1, "geometry"))            // [feature, geometry]
         {
             if (duk_is_object(ctx, -1))
             {
-                // [ptr, global, feature, geometry]
-                std::string json( duk_json_encode(ctx, -1) ); // [ptr, global, feature, json]
+                std::string json(duk_json_encode(ctx, -1));
                 Geometry* newGeom = GeometryUtils::geometryFromGeoJSON(json);
-                if ( newGeom )
-                {
-                    feature->setGeometry( newGeom );
-                }
-                duk_pop(ctx); // [ptr, global, feature]
+                if (newGeom)
+                    feature->setGeometry(newGeom);
             }
             else
             {
                 feature->setGeometry(0L);
             }
         }
-        else
-        {
-            // [ptr, global, feature, undefined]
-        }
-
-        // [ptr, global, feature]
-        duk_pop_2(ctx);     // [ptr] (as we found it)
-        return 0;           // no return values.
+        duk_pop_2(ctx);                                          // []
+        return 0;
     }
-}
 
-//............................................................................
-
-namespace
-{
-    // Create a "feature" object in the global namespace.
-    void setFeature(duk_context* ctx, Feature const* feature, bool complete)
+    // Replaces the global "feature" object with a copy of the feature
+    // decoded from its GeoJSON. This is the binding the "geojson" profile
+    // uses, kept so scripts can be compared against the native one.
+    void setGeoJSONFeature(duk_context* ctx, Feature const* feature)
     {
         duk_push_global_object(ctx);                             // [global]
-
-        // Complete profile: properties, geometry, and API bindings.
-        if ( complete )
+        if (feature)
         {
-            std::string geojson = feature->getGeoJSON();
-            duk_push_string(ctx, geojson.c_str());               // [global, json]
+            duk_push_string(ctx, feature->getGeoJSON().c_str()); // [global, json]
             duk_json_decode(ctx, -1);                            // [global, feature]
-            duk_push_pointer(ctx, (void*)feature);               // [global, feature, ptr]
-            duk_put_prop_string(ctx, -2, "__ptr");               // [global, feature]
-            duk_put_prop_string(ctx, -2, "feature");             // [global]
-
-            // add the save() function and the "attributes" alias.
-            duk_eval_string_noresult(ctx,
-                "feature.save = function() {"
-                "    oe_duk_save_feature(this.__ptr);"
-                "} ");
-
-            duk_eval_string_noresult(ctx,
-                "Object.defineProperty(feature, 'attributes', {get:function() {return feature.properties;}});");
-
-            GeometryAPI::bindToFeature(ctx);
+            duk_idx_t feature_i = duk_get_top_index(ctx);
+
+            duk_push_pointer(ctx, (void*)feature);
+            duk_put_prop_string(ctx, feature_i, "__ptr");
+            duk_push_c_function(ctx, saveGeoJSONFeature, 0);
+            duk_put_prop_string(ctx, feature_i, "save");
+            duk_get_prop_string(ctx, feature_i, "properties");
+            duk_put_prop_string(ctx, feature_i, "attributes");
+
+            // attach the geometry API (buffer, getBounds, ...)
+            if (duk_get_global_string(ctx, "oe_duk_bind_geometry_api") &&
+                duk_get_prop_string(ctx, feature_i, "geometry") &&
+                duk_is_object(ctx, -1))
+            {
+                duk_pcall(ctx, 1);
+            }
+            duk_set_top(ctx, feature_i + 1);                     // [global, feature]
         }
-
-        // Minimal profile: ID and properties only. MUCH faster!
         else
         {
-            duk_idx_t feature_i = duk_push_object(ctx);     // [global] [feature]
-            {
-                duk_push_number(ctx, feature->getFID());       // [global] [feature] [id]
-                duk_put_prop_string(ctx, feature_i, "id");  // [global] [feature]
-
-                duk_idx_t props_i = duk_push_object(ctx);   // [global] [feature] [properties]
-                {
-                    const AttributeTable& attrs = feature->getAttrs();
-                    for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
-                    {
-                        AttributeType type = a->second.first;
-                        switch(type) {
-                        case ATTRTYPE_DOUBLE: duk_push_number (ctx, a->second.getDouble()); break;          // [global] [feature] [properties] [name]
-                        case ATTRTYPE_INT:    duk_push_number(ctx, (double)a->second.getInt()); break;             // [global] [feature] [properties] [name]
-                        case ATTRTYPE_BOOL:   duk_push_boolean(ctx, a->second.getBool()); break;            // [global] [feature] [properties] [name]
-                        case ATTRTYPE_DOUBLEARRAY: break;
-                        case ATTRTYPE_STRING:
-                        default:              duk_push_string (ctx, a->second.getString().c_str()); break;  // [global] [feature] [properties] [name]
-                        }
-                        duk_put_prop_string(ctx, props_i, a->first.c_str()); // [global] [feature] [properties]
-                    }
-                }
-                duk_put_prop_string(ctx, feature_i, "properties"); // [global] [feature]
-
-                duk_idx_t geometry_i = duk_push_object(ctx);  // [global] [feature] [geometry]
-                {
-                    duk_push_string(ctx, Geometry::toString(feature->getGeometry()->getType()).c_str()); // [global] [feature] [geometry] [type]
-                    duk_put_prop_string(ctx, geometry_i, "type"); // [global] [feature] [geometry]
-                }
-                duk_put_prop_string(ctx, feature_i, "geometry");
-            }
-            duk_put_prop_string(ctx, -2, "feature"); // [global] [feature]
+            duk_push_undefined(ctx);                             // [global, undefined]
         }
-
-        duk_pop(ctx);
+        duk_put_prop_string(ctx, -2, "feature");                 // [global]
+        duk_pop(ctx);                                            // []
     }
-
 }
 
 //............................................................................
@@ -214,10 +146,11 @@ namespace
 DuktapeEngine::Context::Context()
 {
     _ctx = 0L;
+    _numCompiled = 0u;
 }
 
 void
-DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool complete)
+DuktapeEngine::Context::initialize(const ScriptEngineOptions& options)
 {
     if ( _ctx == 0L )
     {
@@ -243,19 +176,50 @@ DuktapeEngine::Context::initialize(const ScriptEngineOptions& options, bool comp
         duk_push_c_function( _ctx, log, DUK_VARARGS ); // [global, function]
         duk_put_prop_string( _ctx, -2, "log" );        // [global]
 
-        if ( complete )
-        {
-            // feature.save() callback
-            duk_push_c_function(_ctx, oe_duk_save_feature, 1/*numargs*/); // [global, function]
-            duk_put_prop_string(_ctx, -2, "oe_duk_save_feature");         // [global]
-
-            GeometryAPI::install(_ctx);
-        }
+        GeometryAPI::install(_ctx);
 
         duk_pop(_ctx); // []
+
+        // the "feature" object, bound natively to each feature in turn.
+        FeatureAPI::install(_ctx);
     }
 }
 
+bool
+DuktapeEngine::Context::pushCompiled(const std::string& code)
+{
+    // compiled scripts live in the stash, keyed by their source.
+    duk_push_global_stash(_ctx);                                // [stash]
+    if (!duk_get_prop_string(_ctx, -1, "oe_scripts") || _numCompiled >= MAX_COMPILED_SCRIPTS)
+    {
+        // first use, or too many distinct scripts: start over.
+        duk_pop(_ctx);                                          // [stash]
+        duk_push_object(_ctx);                                  // [stash, scripts]
+        duk_dup_top(_ctx);
+        duk_put_prop_string(_ctx, -3, "oe_scripts");
+        _numCompiled = 0u;
+    }
+    duk_remove(_ctx, -2);                                       // [scripts]
+
+    if (!duk_get_prop_string(_ctx, -1, code.c_str()))           // [scripts, function]
+    {
+        duk_pop(_ctx);                                          // [scripts]
+        duk_push_string(_ctx, code.c_str());                    // [scripts, code]
+        duk_push_string(_ctx, "script");                        // [scripts, code, filename]
+        if (duk_pcompile(_ctx, 0) != 0)                         // [scripts, function|error]
+        {
+            duk_remove(_ctx, -2);                               // [error]
+            return false;
+        }
+        duk_dup_top(_ctx);                                      // [scripts, function, function]
+        duk_put_prop_string(_ctx, -3, code.c_str());            // [scripts, function]
+        ++_numCompiled;
+    }
+
+    duk_remove(_ctx, -2);                                       // [function]
+    return true;
+}
+
 DuktapeEngine::Context::~Context()
 {
     if ( _ctx )
@@ -287,38 +251,47 @@ DuktapeEngine::run(const std::string&   code,
     if (code.empty())
         return ScriptResult(EMPTY_STRING, false, "Script is empty.");
 
-    bool complete = false;
-
-    // gw: broken; disable until we can address (if necessary)
-    //bool complete = (getProfile() == "full");
-
 #ifdef MAXIMUM_ISOLATION
     // brand new context every time
     Context c;
-    c.initialize( _options, complete );
+    c.initialize( _options );
     duk_context* ctx = c._ctx;
 #else
     // cache the Context on a per-thread basis
     Context& c = _contexts.get();
-    c.initialize( _options, complete );
+    c.initialize( _options );
     duk_context* ctx = c._ctx;
 #endif
 
-	if ( feature && feature != c._feature.get() )
+    if ( !feature || feature != c._feature.get() )
     {
-		// encode the feature in the global object and push a native pointer:
-		setFeature(ctx, feature, complete);
-	}
+        if (getProfile() == "geojson")
+        {
+            // copy the feature into a plain JS object.
+            setGeoJSONFeature(ctx, feature);
+        }
+        else
+        {
+            // point the "feature" object at the new feature; nothing is copied.
+            // (Unbind when there is none, since the last one may be gone.)
+            FeatureAPI::bind(ctx, feature);
+        }
+    }
 
-    // remember the feature so we don't re-create it if not necessary
+    // remember the feature so we don't re-bind it if not necessary
     c._feature = feature;
 
     // run the script. On error, the top of stack will hold the error
     // message instead of the return value.
     std::string resultString;
 
-    duk_int_t r = (duk_peval_string(ctx, code.c_str()) == 0); // [ "result" ]
-    const char* resultVal = duk_to_string(ctx, -1);
+    duk_int_t r = -1;
+    if (c.pushCompiled(code))                                   // [function]
+    {
+        r = (duk_pcall(ctx, 0) == 0) ? 0 : -1;                  // [ "result" ]
+    }
+
+    const char* resultVal = duk_safe_to_string(ctx, -1);
     if ( resultVal )
         resultString = resultVal;
 
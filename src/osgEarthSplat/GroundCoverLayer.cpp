@@ -424,6 +424,14 @@ GroundCoverLayer::addedToMap(const Map* map)
     }
 }
 
+void
+GroundCoverLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    PatchLayer::getLayerReferences(names);
+    options().maskLayer().getLayerName(names);
+    options().colorLayer().getLayerName(names);
+}
+
 void
 GroundCoverLayer::removedFromMap(const Map* map)
 {
@@ -110,6 +110,14 @@ RoadSurfaceLayer::addedToMap(const Map* map)
     options().styleSheet().addedToMap(map);
 }
 
+void
+RoadSurfaceLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    ImageLayer::getLayerReferences(names);
+    options().featureSource().getLayerName(names);
+    options().styleSheet().getLayerName(names);
+}
+
 void
 RoadSurfaceLayer::removedFromMap(const Map* map)
 {
@@ -365,6 +365,13 @@ TritonLayer::addedToMap(const osgEarth::Map* map)
     options().maskLayer().addedToMap(map);
 }
 
+void
+TritonLayer::getLayerReferences(std::vector<std::string>& names) const
+{
+    VisibleLayer::getLayerReferences(names);
+    options().maskLayer().getLayerName(names);
+}
+
 void
 TritonLayer::removedFromMap(const osgEarth::Map* map)
 {
@@ -0,0 +1,166 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/AltitudeFilter>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/FilterContext>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/Map>
+#include <osgEarth/Session>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Elevation layer that reports 500m inside lon 10..20, lat 40..50 and
+    // has no data anywhere else.
+    class InsetElevationLayer : public ElevationLayer
+    {
+    public:
+        META_Layer(osgEarth, InsetElevationLayer, Options, ElevationLayer, inset_elevation);
+
+        virtual void init()
+        {
+            ElevationLayer::init();
+            layerHints().cachePolicy() = CachePolicy::NO_CACHE;
+        }
+
+        virtual Status openImplementation()
+        {
+            Status parent = ElevationLayer::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setProfile(Profile::create("global-geodetic"));
+            dataExtents().push_back(DataExtent(GeoExtent(getProfile()->getSRS(), 10, 40, 20, 50), 0, 8));
+            dirtyDataExtents();
+            return Status::NoError;
+        }
+
+        virtual GeoHeightField createHeightFieldImplementation(const TileKey& key, ProgressCallback*) const
+        {
+            osg::HeightField* hf = HeightFieldUtils::createReferenceHeightField(key.getExtent(), 17, 17, 0u, false);
+            hf->getFloatArray()->assign(hf->getFloatArray()->size(), 500.0f);
+            return GeoHeightField(hf, key.getExtent());
+        }
+
+    protected:
+        virtual ~InsetElevationLayer() { }
+    };
+
+    Feature* makeLine(const SpatialReference* srs, const osg::Vec3d& a, const osg::Vec3d& b)
+    {
+        LineString* line = new LineString();
+        line->push_back(a);
+        line->push_back(b);
+        return new Feature(line, srs);
+    }
+
+    void clamp(Map* map, FeatureList& features, AltitudeSymbol::Clamping clamping, AltitudeSymbol::Binding binding)
+    {
+        Style style;
+        style.getOrCreate<AltitudeSymbol>()->clamping() = clamping;
+        style.getOrCreate<AltitudeSymbol>()->binding() = binding;
+
+        osg::ref_ptr<Session> session = new Session(map);
+        osg::ref_ptr<FeatureProfile> profile = new FeatureProfile(map->getProfile()->getExtent());
+        FilterContext cx(session.get(), profile.get());
+
+        AltitudeFilter filter;
+        filter.setPropertiesFromStyle(style);
+        filter.push(features, cx);
+    }
+}
+
+TEST_CASE( "AltitudeFilter" ) {
+
+    osg::ref_ptr<Map> map = new Map();
+    map->setProfile(Profile::create("global-geodetic"));
+    map->addLayer(new InsetElevationLayer());
+
+    const SpatialReference* wgs84 = map->getSRS();
+
+    SECTION("Vertex binding clamps each point and puts points off the terrain at zero") {
+        FeatureList features;
+        features.push_back(makeLine(wgs84, osg::Vec3d(12, 42, 7), osg::Vec3d(18, 48, 7)));
+        features.push_back(makeLine(wgs84, osg::Vec3d(15, 45, 7), osg::Vec3d(-100, 30, 7)));
+
+        clamp(map.get(), features, AltitudeSymbol::CLAMP_TO_TERRAIN, AltitudeSymbol::BINDING_VERTEX);
+
+        Geometry* first = features.front()->getGeometry();
+        REQUIRE((*first)[0].z() == Approx(500.0));
+        REQUIRE((*first)[1].z() == Approx(500.0));
+
+        Geometry* second = features.back()->getGeometry();
+        REQUIRE((*second)[0].z() == Approx(500.0));
+        REQUIRE((*second)[1].z() == Approx(0.0));
+    }
+
+    SECTION("Vertex binding measures relative heights from zero off the terrain") {
+        FeatureList features;
+        features.push_back(makeLine(wgs84, osg::Vec3d(15, 45, 7), osg::Vec3d(-100, 30, 3)));
+
+        clamp(map.get(), features, AltitudeSymbol::CLAMP_RELATIVE_TO_TERRAIN, AltitudeSymbol::BINDING_VERTEX);
+
+        Geometry* line = features.front()->getGeometry();
+        REQUIRE((*line)[0].z() == Approx(507.0));
+        REQUIRE((*line)[1].z() == Approx(3.0));
+        REQUIRE(features.front()->getDouble("__min_terrain_z") == Approx(0.0));
+    }
+
+    SECTION("Centroid binding clamps each feature as a unit") {
+        FeatureList features;
+        features.push_back(makeLine(wgs84, osg::Vec3d(12, 42, 7), osg::Vec3d(18, 48, 3)));
+        features.push_back(makeLine(wgs84, osg::Vec3d(-110, 30, 7), osg::Vec3d(-90, 35, 3)));
+
+        clamp(map.get(), features, AltitudeSymbol::CLAMP_TO_TERRAIN, AltitudeSymbol::BINDING_CENTROID);
+
+        // both points take the terrain height at the centroid:
+        Geometry* first = features.front()->getGeometry();
+        REQUIRE((*first)[0].z() == Approx(500.0));
+        REQUIRE((*first)[1].z() == Approx(500.0));
+
+        // no terrain under the centroid clamps to zero:
+        Geometry* second = features.back()->getGeometry();
+        REQUIRE((*second)[0].z() == Approx(0.0));
+        REQUIRE((*second)[1].z() == Approx(0.0));
+    }
+
+    SECTION("Centroid binding keeps heights relative to the terrain") {
+        FeatureList features;
+        features.push_back(makeLine(wgs84, osg::Vec3d(12, 42, 7), osg::Vec3d(18, 48, 3)));
+        features.push_back(makeLine(wgs84, osg::Vec3d(-110, 30, 7), osg::Vec3d(-90, 35, 3)));
+
+        clamp(map.get(), features, AltitudeSymbol::CLAMP_RELATIVE_TO_TERRAIN, AltitudeSymbol::BINDING_CENTROID);
+
+        Geometry* first = features.front()->getGeometry();
+        REQUIRE((*first)[0].z() == Approx(507.0));
+        REQUIRE((*first)[1].z() == Approx(503.0));
+
+        Geometry* second = features.back()->getGeometry();
+        REQUIRE((*second)[0].z() == Approx(7.0));
+        REQUIRE((*second)[1].z() == Approx(3.0));
+    }
+}
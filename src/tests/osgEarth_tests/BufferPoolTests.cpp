@@ -0,0 +1,146 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/BufferPool>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+TEST_CASE( "BufferPool" ) {
+
+    SECTION("Size classes")
+    {
+        for (size_t bytes = BufferPoolBase::MIN_BYTES; bytes < 4u*1024u*1024u; bytes = bytes * 9 / 7 + 13)
+        {
+            size_t ceil = BufferPoolBase::classBytes(BufferPoolBase::ceilClass(bytes));
+            size_t floor = BufferPoolBase::classBytes(BufferPoolBase::floorClass(bytes));
+            REQUIRE(ceil >= bytes);
+            REQUIRE(floor <= bytes);
+            REQUIRE(ceil <= bytes + bytes / 4);
+        }
+        REQUIRE(BufferPoolBase::ceilClass(8192) == BufferPoolBase::floorClass(8192));
+    }
+
+    SECTION("Recycle")
+    {
+        VectorPool<float> pool;
+
+        std::vector<float> a;
+        pool.acquire(a, 257 * 257);
+        REQUIRE(a.empty());
+        REQUIRE(a.capacity() >= 257u * 257u);
+        a.resize(257 * 257);
+        const float* storage = &a[0];
+
+        pool.recycle(a);
+        REQUIRE(a.capacity() == 0u);
+        REQUIRE(pool.getStats()._pooledBuffers == 1u);
+
+        // a similar request reuses the same storage
+        std::vector<float> b;
+        pool.acquire(b, 257 * 257 - 10);
+        b.resize(257 * 257 - 10);
+        REQUIRE(&b[0] == storage);
+
+        BufferPoolBase::Stats stats = pool.getStats();
+        REQUIRE(stats._hits == 1u);
+        REQUIRE(stats._misses == 1u);
+        REQUIRE(stats._pooledBuffers == 0u);
+    }
+
+    SECTION("Limits")
+    {
+        VectorPool<unsigned char> pool;
+        pool.setMaxBytes(100000u);
+
+        std::vector<unsigned char> tiny(16);
+        pool.recycle(tiny);
+        REQUIRE(pool.getStats()._discarded == 1u);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            std::vector<unsigned char> v;
+            pool.acquire(v, 40000u);
+            pool.recycle(v);
+        }
+
+        std::vector<unsigned char> v1, v2, v3;
+        pool.acquire(v1, 40000u);
+        pool.acquire(v2, 40000u);
+        pool.acquire(v3, 40000u);
+        pool.recycle(v1);
+        pool.recycle(v2);
+        pool.recycle(v3); // would exceed the limit
+        REQUIRE(pool.getStats()._pooledBuffers == 2u);
+        REQUIRE(pool.getStats()._pooledBytes <= 100000u);
+
+        pool.trim(0u);
+        REQUIRE(pool.getStats()._pooledBuffers == 0u);
+        REQUIRE(pool.getStats()._pooledBytes == 0u);
+    }
+
+    SECTION("Pooled objects")
+    {
+        BufferPools::trim();
+
+        {
+            osg::ref_ptr<PooledImage> image = new PooledImage();
+            image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            REQUIRE(image->data() != 0L);
+            REQUIRE(image->getImageSizeInBytes() == 256u * 256u * 4u);
+            REQUIRE(image->data()[0] == 0);
+            REQUIRE(image->getInternalTextureFormat() == GL_RGBA);
+        }
+        REQUIRE(BufferPools::bytes().getStats()._pooledBuffers == 1u);
+
+        {
+            // a two-channel image must not end up with internal format 0
+            osg::ref_ptr<PooledImage> image = new PooledImage();
+            image->allocateImage(64, 64, 1, GL_RG, GL_UNSIGNED_BYTE);
+            REQUIRE(image->getInternalTextureFormat() == GL_RG);
+
+            // an internal format set beforehand is kept
+            osg::ref_ptr<PooledImage> image2 = new PooledImage();
+            image2->setInternalTextureFormat(GL_RGBA8);
+            image2->allocateImage(64, 64, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            REQUIRE(image2->getInternalTextureFormat() == GL_RGBA8);
+        }
+
+        {
+            osg::ref_ptr<PooledHeightField> hf = new PooledHeightField();
+            hf->allocate(257, 257);
+            REQUIRE(hf->getFloatArray()->size() == 257u * 257u);
+        }
+        REQUIRE(BufferPools::floats().getStats()._pooledBuffers == 1u);
+
+        {
+            osg::ref_ptr<osg::Vec3Array> verts = new PooledArray<osg::Vec3Array>(BufferPools::vec3fs(), 1000u);
+            REQUIRE(verts->empty());
+            verts->push_back(osg::Vec3f(1, 2, 3));
+        }
+        REQUIRE(BufferPools::vec3fs().getStats()._pooledBuffers == 1u);
+
+        BufferPools::trim();
+        REQUIRE(BufferPools::getStats()._pooledBytes == 0u);
+    }
+}
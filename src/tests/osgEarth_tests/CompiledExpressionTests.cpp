@@ -0,0 +1,210 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/CompiledExpression>
+#include <osgEarth/FilterContext>
+#include <osgEarth/StringUtils>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    FeatureList makeFeatures(unsigned count)
+    {
+        FeatureList features;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            Feature* feature = new Feature(new Geometry(), 0L, Style(), (FeatureID)i);
+            feature->set("height", 3.0 + (double)i);
+            feature->set("Width", (double)(i % 7));
+            feature->set("name", Stringify() << "b" << i);
+            if (i % 5 == 0)
+                feature->set("floors", std::string("12"));
+            features.push_back(feature);
+        }
+        return features;
+    }
+}
+
+TEST_CASE("CompiledNumericExpression matches Feature::eval") {
+    FeatureList features = makeFeatures(20);
+    FilterContext context;
+
+    const char* sources[] = {
+        "[height]*2",
+        "[height] + [width] * 3 - 1",
+        "max([height], 10) + min(2,3)",
+        "(1+2)*[height]",
+        "[height] % 4",
+        "height / (width + 1)",
+        "[floors]*3+[height]",
+        "[missing]+5",
+        "max(max([height],[width]),7)",
+        "1 + + 2"
+    };
+
+    for (unsigned s = 0; s < sizeof(sources) / sizeof(sources[0]); ++s)
+    {
+        osg::ref_ptr<CompiledNumericExpression> compiled = new CompiledNumericExpression(NumericExpression(sources[s]));
+
+        std::vector<double> batch;
+        compiled->eval(features, &context, batch);
+        REQUIRE(batch.size() == features.size());
+
+        unsigned k = 0;
+        for (FeatureList::iterator f = features.begin(); f != features.end(); ++f, ++k)
+        {
+            NumericExpression expr(sources[s]);
+            double expected = f->get()->eval(expr, (Session*)0L); // uncompiled
+            REQUIRE(compiled->eval(f->get(), &context) == expected);
+            REQUIRE(batch[k] == expected);
+        }
+    }
+}
+
+TEST_CASE("CompiledNumericExpression folds constants and shares slots") {
+    osg::ref_ptr<CompiledNumericExpression> folded = new CompiledNumericExpression(NumericExpression("(1+2)*[height]"));
+    REQUIRE(folded->getNumSlots() == 1u);
+    REQUIRE(folded->getNumInstructions() == 3u);
+
+    osg::ref_ptr<CompiledNumericExpression> shared = new CompiledNumericExpression(NumericExpression("[height]*[height]+[width]"));
+    REQUIRE(shared->getNumSlots() == 2u);
+
+    osg::ref_ptr<CompiledNumericExpression> constant = new CompiledNumericExpression(NumericExpression("2*3+4"));
+    REQUIRE(constant->isConstant());
+    REQUIRE(constant->eval(0L, 0L) == 10.0);
+
+    // literals keep their full precision:
+    osg::ref_ptr<CompiledNumericExpression> literal = new CompiledNumericExpression(NumericExpression(3.14159265));
+    REQUIRE(literal->eval(0L, 0L) == 3.14159265);
+}
+
+TEST_CASE("CompiledStringExpression matches Feature::eval") {
+    FeatureList features = makeFeatures(10);
+    FilterContext context;
+
+    const char* sources[] = {
+        "[name]",
+        "\"pre_\" + [name] + \"_\" + [height]",
+        "\"literal\"",
+        "[name] + [name]",
+        "[nope]"
+    };
+
+    for (unsigned s = 0; s < sizeof(sources) / sizeof(sources[0]); ++s)
+    {
+        osg::ref_ptr<CompiledStringExpression> compiled = new CompiledStringExpression(StringExpression(sources[s]));
+
+        std::vector<std::string> batch;
+        compiled->eval(features, &context, batch);
+
+        unsigned k = 0;
+        for (FeatureList::iterator f = features.begin(); f != features.end(); ++f, ++k)
+        {
+            StringExpression expr(sources[s]);
+            std::string expected = f->get()->eval(expr, (Session*)0L); // uncompiled
+            REQUIRE(compiled->eval(f->get(), &context) == expected);
+            REQUIRE(batch[k] == expected);
+        }
+    }
+}
+
+TEST_CASE("ExpressionCache compiles once per expression and schema") {
+    FeatureList features = makeFeatures(10);
+    FilterContext context;
+    ExpressionCache* cache = context.expressionCache();
+    REQUIRE(cache != 0L);
+
+    NumericExpression height("[height]*2");
+    Feature* first = features.front().get();
+
+    REQUIRE(cache->eval(height, first, &context) == 6.0);
+    REQUIRE(cache->getNumPrograms() == 1u);
+
+    SECTION("Results are cached per expression and feature") {
+        REQUIRE(cache->getNumResults() == 1u);
+        REQUIRE(cache->eval(height, first, &context) == 6.0);
+        REQUIRE(cache->getNumResults() == 1u);
+
+        cache->invalidate(first);
+        REQUIRE(cache->getNumResults() == 0u);
+    }
+
+    SECTION("Attribute changes are seen by the next evaluation") {
+        first->set("height", 10.0);
+        REQUIRE(cache->eval(height, first, &context) == 20.0);
+        REQUIRE(cache->getNumPrograms() == 1u);
+        REQUIRE(cache->getNumResults() == 1u);
+    }
+
+    SECTION("Feature::eval goes through the cache") {
+        NumericExpression width("[width]+1");
+        REQUIRE(first->eval(width, &context) == 1.0);
+        REQUIRE(cache->getNumPrograms() == 2u);
+
+        StringExpression name("[name]");
+        REQUIRE(first->eval(name, &context) == "b0");
+        REQUIRE(name.eval() == "b0");
+        REQUIRE(cache->getNumPrograms() == 3u);
+        REQUIRE(cache->getNumResults() == 3u);
+    }
+
+    SECTION("Schemas with the same content share a program") {
+        FeatureSchema* a = new FeatureSchema();
+        (*a)["height"] = ATTRTYPE_DOUBLE;
+        CompiledNumericExpression* program = cache->compile(height, *a);
+        delete a;
+
+        FeatureSchema b;
+        b["HEIGHT"] = ATTRTYPE_DOUBLE;
+        REQUIRE(cache->compile(height, b) == program);
+
+        // a schema that does not list the variable compiles differently:
+        FeatureSchema c;
+        c["name"] = ATTRTYPE_STRING;
+        REQUIRE(cache->compile(height, c) != program);
+        REQUIRE(cache->compile(height, c) == cache->compile(height, FeatureSchema()));
+    }
+
+    SECTION("Batch evaluation reuses the compiled expressions") {
+        std::vector<double> output;
+        cache->eval(height, features, &context, output);
+        REQUIRE(output.size() == 10u);
+        REQUIRE(output[4] == 14.0);
+        REQUIRE(cache->getNumPrograms() == 1u);
+
+        StringExpression name("[name] + \"!\"");
+        std::vector<std::string> names;
+        cache->eval(name, features, &context, names);
+        REQUIRE(names[3] == "b3!");
+        REQUIRE(cache->getNumPrograms() == 2u);
+        REQUIRE(cache->getNumResults() == 20u);
+    }
+
+    SECTION("Copies of a context share the cache") {
+        FilterContext copy(context);
+        REQUIRE(copy.expressionCache() == cache);
+    }
+}
@@ -0,0 +1,228 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+ * Copyright 2020 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/CoverageRasterizer>
+#include <cstdlib>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    const unsigned SIZE = 12u;
+    const unsigned char WHITE[4] = { 255, 255, 255, 255 };
+
+    // Blends opaque white over black and returns one channel, so each
+    // value is the pixel's coverage (253 = fully covered).
+    std::vector<unsigned char> resolve(CoverageRasterizer& ras)
+    {
+        std::vector<unsigned char> pixels(SIZE * SIZE * 4u, 0u);
+        ras.blend(&pixels[0], SIZE * 4u, WHITE);
+
+        std::vector<unsigned char> out(SIZE * SIZE);
+        for (unsigned i = 0; i < out.size(); ++i)
+            out[i] = pixels[i * 4u + 3u];
+        return out;
+    }
+
+    unsigned char at(const std::vector<unsigned char>& image, unsigned x, unsigned y)
+    {
+        return image[y * SIZE + x];
+    }
+
+    template<typename T>
+    T* make(double x0, double y0, double x1, double y1)
+    {
+        T* geom = new T();
+        geom->push_back(osg::Vec3d(x0, y0, 0));
+        geom->push_back(osg::Vec3d(x1, y0, 0));
+        geom->push_back(osg::Vec3d(x1, y1, 0));
+        geom->push_back(osg::Vec3d(x0, y1, 0));
+        return geom;
+    }
+
+    LineString* makeLine(double x0, double y0, double x1, double y1)
+    {
+        LineString* line = new LineString();
+        line->push_back(osg::Vec3d(x0, y0, 0));
+        line->push_back(osg::Vec3d(x1, y1, 0));
+        return line;
+    }
+}
+
+TEST_CASE( "CoverageRasterizer" ) {
+
+    SECTION("blendSpan matches the AGG span blender") {
+        ::srand(7);
+        for (unsigned trial = 0; trial < 100u; ++trial)
+        {
+            unsigned count = 1u + (unsigned)(::rand() % 37);
+            unsigned char color[4];
+            for (unsigned k = 0; k < 4u; ++k)
+                color[k] = (unsigned char)(::rand() & 0xFF);
+
+            std::vector<unsigned char> covers(count), pixels(count * 4u);
+            for (unsigned i = 0; i < count; ++i)
+                covers[i] = (::rand() % 3 == 0) ? 0u : (unsigned char)(::rand() & 0xFF);
+            for (unsigned i = 0; i < pixels.size(); ++i)
+                pixels[i] = (unsigned char)(::rand() & 0xFF);
+
+            // agg::span_abgr32
+            std::vector<unsigned char> expected(pixels);
+            for (unsigned i = 0; i < count; ++i)
+            {
+                int alpha = covers[i] * color[0];
+                for (unsigned k = 0; k < 4u; ++k)
+                {
+                    int p = expected[i * 4u + k];
+                    expected[i * 4u + k] = (unsigned char)((((color[k] - p) * alpha) + (p << 16)) >> 16);
+                }
+            }
+
+            CoverageRasterizer::blendSpan(&pixels[0], &covers[0], count, color);
+            REQUIRE(pixels == expected);
+        }
+    }
+
+    SECTION("Polygons cover their interior") {
+        CoverageRasterizer ras(SIZE, SIZE);
+        osg::ref_ptr<Polygon> square = make<Polygon>(2, 2, 6, 6);
+        ras.addPolygon(square.get());
+        REQUIRE(ras.empty() == false);
+
+        std::vector<unsigned char> image = resolve(ras);
+        REQUIRE(ras.empty() == true);
+        REQUIRE(at(image, 2, 2) == 253);
+        REQUIRE(at(image, 5, 5) == 253);
+        REQUIRE(at(image, 1, 3) == 0);
+        REQUIRE(at(image, 6, 3) == 0);
+    }
+
+    SECTION("Adjacent polygons leave no seam") {
+        CoverageRasterizer ras(SIZE, SIZE);
+        osg::ref_ptr<Polygon> left = make<Polygon>(1, 1, 4.5, 7);
+        osg::ref_ptr<Polygon> right = make<Polygon>(4.5, 1, 8, 7);
+        ras.setGamma(1.3);
+        ras.addPolygon(left.get());
+        ras.addPolygon(right.get());
+
+        std::vector<unsigned char> image = resolve(ras);
+        for (unsigned y = 1; y < 7; ++y)
+            REQUIRE(at(image, 4, y) == 253);
+    }
+
+    SECTION("Overlapping polygons blend once") {
+        const unsigned char translucent[4] = { 160, 10, 200, 30 };
+        osg::ref_ptr<Polygon> square = make<Polygon>(2, 2, 6, 6);
+
+        std::vector<unsigned char> once(SIZE * SIZE * 4u, 0u), twice(SIZE * SIZE * 4u, 0u);
+
+        CoverageRasterizer ras(SIZE, SIZE);
+        ras.addPolygon(square.get());
+        ras.blend(&once[0], SIZE * 4u, translucent);
+
+        ras.addPolygon(square.get());
+        ras.addPolygon(square.get());
+        ras.blend(&twice[0], SIZE * 4u, translucent);
+
+        REQUIRE(once == twice);
+    }
+
+    SECTION("Strokes have round joins") {
+        CoverageRasterizer ras(SIZE, SIZE);
+        osg::ref_ptr<LineString> line = new LineString();
+        line->push_back(osg::Vec3d(2, 8, 0));
+        line->push_back(osg::Vec3d(8, 8, 0));
+        line->push_back(osg::Vec3d(8, 2, 0));
+        ras.addLine(line.get(), 2.0, Stroke::LINECAP_FLAT);
+
+        std::vector<unsigned char> image = resolve(ras);
+        REQUIRE(at(image, 5, 7) == 253);
+        REQUIRE(at(image, 5, 8) == 253);
+        REQUIRE(at(image, 7, 5) == 253);
+        REQUIRE(at(image, 7, 7) == 253);
+
+        // outside corner: a quarter disc, not a square
+        REQUIRE(at(image, 8, 8) > 150);
+        REQUIRE(at(image, 8, 8) < 240);
+
+        // flat caps
+        REQUIRE(at(image, 1, 8) == 0);
+        REQUIRE(at(image, 8, 1) == 0);
+    }
+
+    SECTION("Square caps extend the line") {
+        osg::ref_ptr<LineString> line = makeLine(2, 5, 8, 5);
+
+        CoverageRasterizer flat(SIZE, SIZE);
+        flat.addLine(line.get(), 2.0, Stroke::LINECAP_FLAT);
+        std::vector<unsigned char> flatImage = resolve(flat);
+        REQUIRE(at(flatImage, 2, 4) == 253);
+        REQUIRE(at(flatImage, 1, 4) == 0);
+        REQUIRE(at(flatImage, 8, 4) == 0);
+
+        CoverageRasterizer square(SIZE, SIZE);
+        square.addLine(line.get(), 2.0, Stroke::LINECAP_SQUARE);
+        std::vector<unsigned char> squareImage = resolve(square);
+        REQUIRE(at(squareImage, 1, 4) == 253);
+        REQUIRE(at(squareImage, 8, 5) == 253);
+        REQUIRE(at(squareImage, 0, 4) == 0);
+    }
+
+    SECTION("Rings are stroked all the way around") {
+        CoverageRasterizer ras(SIZE, SIZE);
+        osg::ref_ptr<Ring> ring = make<Ring>(2, 2, 8, 8);
+        ras.addLine(ring.get(), 2.0, Stroke::LINECAP_FLAT);
+
+        std::vector<unsigned char> image = resolve(ras);
+        REQUIRE(at(image, 5, 1) == 253);
+        REQUIRE(at(image, 5, 8) == 253);
+        REQUIRE(at(image, 1, 5) == 253);
+        REQUIRE(at(image, 8, 5) == 253);
+        REQUIRE(at(image, 5, 5) == 0);
+    }
+
+    SECTION("fill writes values where coverage exceeds half") {
+        CoverageRasterizer ras(SIZE, SIZE);
+        osg::ref_ptr<Polygon> square = make<Polygon>(2, 2, 6.4, 6);
+        ras.addPolygon(square.get());
+
+        std::vector<float> values(SIZE * SIZE, -1.0f);
+        ras.fill(&values[0], SIZE, 42.0f);
+        REQUIRE(ras.empty() == true);
+        REQUIRE(values[3 * SIZE + 2] == 42.0f);
+        REQUIRE(values[3 * SIZE + 6] == -1.0f);
+        REQUIRE(values[3 * SIZE + 1] == -1.0f);
+    }
+
+    SECTION("setFrame maps geometry to pixels") {
+        CoverageRasterizer ras(SIZE, SIZE);
+        ras.setFrame(-10.0, 20.0, 0.5, 0.5);
+        osg::ref_ptr<Polygon> square = make<Polygon>(-6, 24, 2, 32);
+        ras.addPolygon(square.get());
+
+        std::vector<unsigned char> image = resolve(ras);
+        REQUIRE(at(image, 2, 2) == 253);
+        REQUIRE(at(image, 5, 5) == 253);
+        REQUIRE(at(image, 6, 6) == 0);
+        REQUIRE(at(image, 1, 1) == 0);
+    }
+}
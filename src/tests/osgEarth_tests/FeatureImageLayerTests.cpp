@@ -0,0 +1,166 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/BufferFilter>
+#include <osgEarth/FeatureImageLayer>
+#include <osgEarth/Map>
+#include <osgEarth/OGRFeatureSource>
+#include <osgEarth/StyleSheet>
+#include <cstring>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    const unsigned TILE_SIZE = 64u;
+
+    // Renders one tile of a layer whose only feature is the given geometry.
+    osg::ref_ptr<osg::Image> renderTile(Geometry* geometry, const Style& style, const TileKey& key, bool accumulate, unsigned threads)
+    {
+        osg::ref_ptr<OGRFeatureSource> features = new OGRFeatureSource();
+        features->setGeometry(geometry);
+
+        StyleSheet* sheet = new StyleSheet();
+        sheet->addStyle(style);
+
+        osg::ref_ptr<FeatureImageLayer> layer = new FeatureImageLayer();
+        layer->setFeatureSource(features.get());
+        layer->setStyleSheet(sheet);
+        layer->setTileSize(TILE_SIZE);
+        layer->setCachePolicy(CachePolicy::NO_CACHE);
+        layer->setAccumulateCoverage(accumulate);
+        layer->setRenderThreads(threads);
+
+        osg::ref_ptr<Map> map = new Map();
+        map->addLayer(layer.get());
+
+        GeoImage image = layer->createImage(key, 0L);
+
+        map->removeLayer(layer.get());
+        return image.valid() ? image.getImage() : 0L;
+    }
+
+    bool samePixel(const osg::Image* a, const osg::Image* b, int s, int t)
+    {
+        return ::memcmp(a->data(s, t), b->data(s, t), 4) == 0;
+    }
+
+    bool isEmpty(const osg::Image* image, int s, int t)
+    {
+        const unsigned char* p = image->data(s, t);
+        return p[0] == 0 && p[1] == 0 && p[2] == 0 && p[3] == 0;
+    }
+}
+
+TEST_CASE( "FeatureImageLayer" ) {
+
+    osg::ref_ptr<const Profile> profile = Profile::create("global-geodetic");
+    TileKey key = profile->createTileKey(10.1, 45.1, 10u);
+    const GeoExtent& extent = key.getExtent();
+    double w = extent.width(), h = extent.height();
+    double pixel = w / (double)TILE_SIZE;
+
+    // covers the west half of the tile and reaches well past its other edges:
+    osg::ref_ptr<Polygon> westHalf = new Polygon();
+    westHalf->push_back(osg::Vec3d(extent.xMin() - w, extent.yMin() - h, 0));
+    westHalf->push_back(osg::Vec3d(extent.xMin() + 0.5*w, extent.yMin() - h, 0));
+    westHalf->push_back(osg::Vec3d(extent.xMin() + 0.5*w, extent.yMax() + h, 0));
+    westHalf->push_back(osg::Vec3d(extent.xMin() - w, extent.yMax() + h, 0));
+
+    Style fill;
+    fill.getOrCreate<PolygonSymbol>()->fill()->color() = Color::Red;
+
+    SECTION("Fills the part of a polygon inside the tile") {
+        osg::ref_ptr<osg::Image> image = renderTile(westHalf.get(), fill, key, false, 1u);
+        REQUIRE(image.valid());
+        REQUIRE(image->s() == (int)TILE_SIZE);
+
+        const unsigned char* inside = image->data(8, 32);
+        REQUIRE(inside[0] > 200);
+        REQUIRE(inside[1] == 0);
+        REQUIRE(inside[2] == 0);
+        REQUIRE(inside[3] > 0);
+
+        REQUIRE(isEmpty(image.get(), 56, 32));
+    }
+
+    SECTION("Accumulating coverage matches the legacy renderer away from edges") {
+        osg::ref_ptr<osg::Image> legacy = renderTile(westHalf.get(), fill, key, false, 1u);
+        osg::ref_ptr<osg::Image> accumulated = renderTile(westHalf.get(), fill, key, true, 1u);
+        REQUIRE(legacy.valid());
+        REQUIRE(accumulated.valid());
+
+        REQUIRE(samePixel(legacy.get(), accumulated.get(), 8, 32));
+        REQUIRE(samePixel(legacy.get(), accumulated.get(), 56, 32));
+    }
+
+    SECTION("Strokes of lines just outside the tile still reach into it") {
+        // a 48-pixel stroke along a line 20 pixels past the east edge
+        // covers the last 4 columns of the tile:
+        osg::ref_ptr<LineString> line = new LineString();
+        line->push_back(osg::Vec3d(extent.xMax() + 20.0*pixel, extent.yMin() - h, 0));
+        line->push_back(osg::Vec3d(extent.xMax() + 20.0*pixel, extent.yMax() + h, 0));
+
+        Style stroke;
+        stroke.getOrCreate<LineSymbol>()->stroke()->color() = Color::White;
+        stroke.getOrCreate<LineSymbol>()->stroke()->width() = 48.0f;
+
+        // without GEOS, the legacy renderer cannot buffer lines:
+        for (int accumulate = BufferFilter::isSupported() ? 0 : 1; accumulate < 2; ++accumulate)
+        {
+            osg::ref_ptr<osg::Image> image = renderTile(line.get(), stroke, key, accumulate == 1, 1u);
+            REQUIRE(image.valid());
+            REQUIRE(image->data(62, 32)[3] > 0);
+            REQUIRE(isEmpty(image.get(), 50, 32));
+        }
+    }
+
+    SECTION("Renders the same image on one thread and on many") {
+        // many short lines, so buffering and clipping split into parts:
+        osg::ref_ptr<MultiGeometry> lines = new MultiGeometry();
+        for (unsigned i = 0; i < 128u; ++i)
+        {
+            double x = extent.xMin() - 0.25*w + 1.5*w*(double)(i % 16u) / 16.0;
+            double y = extent.yMin() - 0.25*h + 1.5*h*(double)(i / 16u) / 8.0;
+            LineString* part = new LineString();
+            part->push_back(osg::Vec3d(x, y, 0));
+            part->push_back(osg::Vec3d(x + 0.1*w, y + 0.05*h, 0));
+            lines->add(part);
+        }
+
+        Style stroke;
+        stroke.getOrCreate<LineSymbol>()->stroke()->color() = Color(Color::Yellow, 0.5f);
+        stroke.getOrCreate<LineSymbol>()->stroke()->width() = 3.0f;
+
+        for (int accumulate = 0; accumulate < 2; ++accumulate)
+        {
+            osg::ref_ptr<osg::Image> serial = renderTile(lines.get(), stroke, key, accumulate == 1, 1u);
+            osg::ref_ptr<osg::Image> parallel = renderTile(lines.get(), stroke, key, accumulate == 1, 8u);
+            REQUIRE(serial.valid());
+            REQUIRE(parallel.valid());
+            REQUIRE(::memcmp(serial->data(), parallel->data(), serial->getTotalSizeInBytes()) == 0);
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/GLObjectCompiler>
+#include <vector>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Compiler with a fake clock so budget accounting needs no GL context.
+    struct TestCompiler : public GLObjectCompiler
+    {
+        TestCompiler() : _clock(0.0) { }
+        double now_ms() const { return _clock; }
+        double _clock;
+    };
+
+    // Work item that just advances the fake clock and logs itself.
+    struct MockItem : public GLObjectCompiler::Item
+    {
+        MockItem(TestCompiler* compiler, double cost, int id, std::vector<int>& log) :
+            _compiler(compiler), _cost(cost), _id(id), _log(log) { }
+
+        void compile(osg::State* state)
+        {
+            _compiler->_clock += _cost;
+            _log.push_back(_id);
+        }
+
+        TestCompiler* _compiler;
+        double _cost;
+        int _id;
+        std::vector<int>& _log;
+    };
+}
+
+TEST_CASE( "GLObjectCompiler" ) {
+
+    osg::ref_ptr<TestCompiler> compiler = new TestCompiler();
+    std::vector<int> log;
+
+    SECTION("Priority")
+    {
+        osg::ref_ptr<GLObjectCompiler::Job> low = new GLObjectCompiler::Job(1.0f);
+        low->add(new MockItem(compiler.get(), 1.0, 1, log));
+
+        osg::ref_ptr<GLObjectCompiler::Job> high = new GLObjectCompiler::Job(2.0f);
+        high->add(new MockItem(compiler.get(), 1.0, 2, log));
+
+        compiler->submit(low.get());
+        compiler->submit(high.get());
+
+        REQUIRE(compiler->compile(0L, 0.0) == 2u);
+        REQUIRE(log.size() == 2u);
+        REQUIRE(log[0] == 2);
+        REQUIRE(log[1] == 1);
+        REQUIRE(low->isComplete());
+        REQUIRE(high->isComplete());
+        REQUIRE(compiler->getNumPendingJobs() == 0u);
+    }
+
+    SECTION("Budget")
+    {
+        osg::ref_ptr<GLObjectCompiler::Job> job = new GLObjectCompiler::Job();
+        for (int i = 0; i < 10; ++i)
+            job->add(new MockItem(compiler.get(), 1.0, i, log));
+        compiler->submit(job.get());
+
+        // stops once the budget is spent
+        REQUIRE(compiler->compile(0L, 3.5) == 4u);
+        REQUIRE(job->getNumPending() == 6u);
+        REQUIRE(job->isComplete() == false);
+
+        // always makes progress, even when one item blows the budget
+        osg::ref_ptr<GLObjectCompiler::Job> big = new GLObjectCompiler::Job(10.0f);
+        big->add(new MockItem(compiler.get(), 50.0, 100, log));
+        compiler->submit(big.get());
+        REQUIRE(compiler->compile(0L, 1.0) == 1u);
+        REQUIRE(big->isComplete());
+
+        REQUIRE(compiler->compile(0L, 100.0) == 6u);
+        REQUIRE(job->isComplete());
+    }
+
+    SECTION("Abandoned")
+    {
+        osg::ref_ptr<GLObjectCompiler::Job> job = new GLObjectCompiler::Job();
+        job->add(new MockItem(compiler.get(), 1.0, 1, log));
+        compiler->submit(job.get());
+        REQUIRE(compiler->getNumPendingJobs() == 1u);
+
+        // nobody is waiting on it any more, so it never compiles
+        job = 0L;
+        REQUIRE(compiler->compile(0L, 0.0) == 0u);
+        REQUIRE(compiler->getNumPendingJobs() == 0u);
+        REQUIRE(log.empty());
+    }
+
+    SECTION("Empty")
+    {
+        osg::ref_ptr<GLObjectCompiler::Job> job = new GLObjectCompiler::Job();
+        compiler->submit(job.get());
+        REQUIRE(job->isComplete());
+        REQUIRE(compiler->getNumPendingJobs() == 0u);
+    }
+}
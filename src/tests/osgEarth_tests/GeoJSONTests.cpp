@@ -0,0 +1,159 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/GeoJSON>
+#include <osgEarth/GeometryUtils>
+#include <sstream>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    const char* s_collection =
+        "{\"features\":["
+        "{\"properties\":{\"Name\":\"a\",\"height\":12,\"area\":1.5,\"tall\":true,\"note\":null,\"tags\":{\"x\":[1,2]}},"
+        " \"geometry\":{\"coordinates\":[[[0,0],[0,1],[1,1],[1,1],[1,0],[0,0]],[[0.2,0.2],[0.4,0.2],[0.4,0.4],[0.2,0.2]]],\"type\":\"Polygon\"},"
+        " \"type\":\"Feature\",\"id\":7},"
+        "{\"type\":\"Feature\",\"id\":\"abc\",\"properties\":{},"
+        " \"geometry\":{\"type\":\"MultiLineString\",\"coordinates\":[[[1,2,3],[4,5,6]],[[7,8],[9,10],[11,12]]]}},"
+        "{\"type\":\"Feature\",\"geometry\":null,\"properties\":null,\"bbox\":[0,0,1,1]}"
+        "],\"type\":\"FeatureCollection\"}";
+}
+
+TEST_CASE("GeoJSONReader reads a FeatureCollection") {
+    GeoJSONReader reader;
+    FeatureList features;
+    REQUIRE(reader.read(std::string(s_collection), features));
+    REQUIRE(features.size() == 3);
+
+    FeatureList::iterator i = features.begin();
+
+    SECTION("Attributes keep their types and get lower-case names") {
+        Feature* f = i->get();
+        REQUIRE(f->getFID() == 7);
+        REQUIRE(f->getString("name") == "a");
+        REQUIRE(f->getAttrs().find("height")->second.first == ATTRTYPE_INT);
+        REQUIRE(f->getInt("height") == 12);
+        REQUIRE(f->getDouble("area") == 1.5);
+        REQUIRE(f->getBool("tall") == true);
+        REQUIRE(f->hasAttr("note"));
+        REQUIRE(f->isSet("note") == false);
+        REQUIRE(f->getString("tags") == "{\"x\":[1,2]}");
+    }
+
+    SECTION("Polygons are opened, deduplicated and rewound") {
+        Polygon* poly = dynamic_cast<Polygon*>(i->get()->getGeometry());
+        REQUIRE(poly != 0L);
+        REQUIRE(poly->size() == 4);
+        REQUIRE(poly->getSignedArea2D() > 0.0);
+        REQUIRE(poly->getHoles().size() == 1);
+        REQUIRE(poly->getHoles().front()->size() == 3);
+        REQUIRE(poly->getHoles().front()->getSignedArea2D() < 0.0);
+    }
+
+    SECTION("A string id is an attribute and the FID is the feature index") {
+        Feature* f = (++i)->get();
+        REQUIRE(f->getFID() == 1);
+        REQUIRE(f->getString("id") == "abc");
+
+        MultiGeometry* multi = dynamic_cast<MultiGeometry*>(f->getGeometry());
+        REQUIRE(multi != 0L);
+        REQUIRE(multi->getComponents().size() == 2);
+        REQUIRE(multi->getComponents()[0]->getType() == Geometry::TYPE_LINESTRING);
+        REQUIRE((*multi->getComponents()[0])[1] == osg::Vec3d(4, 5, 6));
+        REQUIRE(multi->getComponents()[1]->size() == 3);
+    }
+
+    SECTION("A null geometry makes an empty feature") {
+        ++i; ++i;
+        REQUIRE(i->get()->getGeometry() == 0L);
+        REQUIRE(i->get()->getFID() == 2);
+    }
+}
+
+TEST_CASE("GeoJSONReader rejects malformed input") {
+    GeoJSONReader reader;
+    FeatureList features;
+    REQUIRE_FALSE(reader.read(std::string("{\"type\":\"FeatureCollection\",\"features\":[{"), features));
+    REQUIRE(features.empty());
+    REQUIRE_FALSE(reader.getError().empty());
+    REQUIRE(GeometryUtils::geometryFromGeoJSON("{\"type\":") == 0L);
+}
+
+TEST_CASE("GeoJSONWriter output reads back the same") {
+    GeoJSONReader reader;
+    FeatureList features;
+    REQUIRE(reader.read(std::string(s_collection), features));
+
+    std::string json = GeoJSONWriter::toGeoJSON(features);
+
+    FeatureList copies;
+    std::istringstream in(json);
+    REQUIRE(reader.read(in, copies));
+    REQUIRE(copies.size() == features.size());
+    REQUIRE(GeoJSONWriter::toGeoJSON(copies) == json);
+
+    SECTION("The streaming writer matches the string writer") {
+        std::ostringstream out;
+        {
+            GeoJSONWriter writer(out);
+            writer.beginFeatureCollection();
+            for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f)
+                writer.write(f->get());
+            writer.endFeatureCollection();
+        }
+        REQUIRE(out.str() == json);
+    }
+
+    SECTION("Geometry round trips through GeometryUtils") {
+        Geometry* source = features.front()->getGeometry();
+        osg::ref_ptr<Geometry> copy = GeometryUtils::geometryFromGeoJSON(GeometryUtils::geometryToGeoJSON(source));
+        REQUIRE(copy.valid());
+        REQUIRE(copy->getType() == Geometry::TYPE_POLYGON);
+        REQUIRE(copy->size() == source->size());
+        for (unsigned v = 0; v < source->size(); ++v)
+            REQUIRE((*copy)[v] == (*source)[v]);
+    }
+}
+
+TEST_CASE("GeoJSONWriter writes every point of a MultiPoint") {
+    osg::ref_ptr<MultiGeometry> multi = new MultiGeometry();
+    PointSet* a = new PointSet();
+    a->push_back(osg::Vec3d(0, 0, 0));
+    a->push_back(osg::Vec3d(1, 1, 0));
+    PointSet* b = new PointSet();
+    b->push_back(osg::Vec3d(2, 2, 0));
+    multi->add(a);
+    multi->add(b);
+
+    std::string json = GeoJSONWriter::toGeoJSON(multi.get());
+    REQUIRE(json.find("\"MultiPoint\"") != std::string::npos);
+
+    osg::ref_ptr<Geometry> copy = GeoJSONReader().readGeometry(json);
+    REQUIRE(copy.valid());
+    REQUIRE(copy->getTotalPointCount() == 3);
+    REQUIRE((*copy)[2] == osg::Vec3d(2, 2, 0));
+}
@@ -0,0 +1,154 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/GeometryClamper>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/Map>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    // Elevation layer that reports the same height everywhere.
+    class ConstantElevationLayer : public ElevationLayer
+    {
+    public:
+        META_Layer(osgEarth, ConstantElevationLayer, Options, ElevationLayer, constant_elevation);
+
+        virtual void init()
+        {
+            ElevationLayer::init();
+            layerHints().cachePolicy() = CachePolicy::NO_CACHE;
+        }
+
+        virtual Status openImplementation()
+        {
+            Status parent = ElevationLayer::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setProfile(Profile::create("global-geodetic"));
+            return Status::NoError;
+        }
+
+        virtual GeoHeightField createHeightFieldImplementation(const TileKey& key, ProgressCallback*) const
+        {
+            osg::HeightField* hf = HeightFieldUtils::createReferenceHeightField(key.getExtent(), 17, 17, 0u, false);
+            hf->getFloatArray()->assign(hf->getFloatArray()->size(), 500.0f);
+            return GeoHeightField(hf, key.getExtent());
+        }
+
+    protected:
+        virtual ~ConstantElevationLayer() { }
+    };
+
+    // Geocentric line crossing a few degrees of longitude at sea level.
+    osg::Geode* makeLine(const SpatialReference* wgs84)
+    {
+        const osg::EllipsoidModel* em = wgs84->getEllipsoid();
+        osg::Vec3Array* verts = new osg::Vec3Array();
+        for (int i = 0; i < 8; ++i)
+        {
+            double x, y, z;
+            em->convertLatLongHeightToXYZ(osg::DegreesToRadians(45.0), osg::DegreesToRadians(10.0 + 0.5*(double)i), 0.0, x, y, z);
+            verts->push_back(osg::Vec3(x, y, z));
+        }
+
+        osg::Geometry* geom = new osg::Geometry();
+        geom->setUseVertexBufferObjects(true);
+        geom->setVertexArray(verts);
+        geom->addPrimitiveSet(new osg::DrawArrays(GL_LINE_STRIP, 0, verts->size()));
+
+        osg::Geode* geode = new osg::Geode();
+        geode->addDrawable(geom);
+        return geode;
+    }
+
+    // Largest distance of any vertex from the given height above the ellipsoid.
+    double maxHeightError(osg::Geode* geode, const SpatialReference* wgs84, double height)
+    {
+        const osg::Vec3Array* verts = static_cast<const osg::Vec3Array*>(geode->getDrawable(0)->asGeometry()->getVertexArray());
+        double maxError = 0.0;
+        for (unsigned i = 0; i < verts->size(); ++i)
+        {
+            double lat, lon, h;
+            wgs84->getEllipsoid()->convertXYZToLatLongHeight((*verts)[i].x(), (*verts)[i].y(), (*verts)[i].z(), lat, lon, h);
+            maxError = osg::maximum(maxError, fabs(h - height));
+        }
+        return maxError;
+    }
+}
+
+TEST_CASE( "GeometryClamper" ) {
+
+    const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+
+    SECTION("Geometry is clamped to the map's elevation") {
+        osg::ref_ptr<Map> map = new Map();
+        map->setProfile(Profile::create("global-geodetic"));
+        map->addLayer(new ConstantElevationLayer());
+
+        osg::ref_ptr<osg::Geode> line = makeLine(wgs84);
+
+        GeometryClamper::LocalData data;
+        ElevationPool::WorkingSet workingSet;
+        GeometryClamper clamper(data);
+        clamper.setTerrainSRS(wgs84);
+        clamper.setUseVertexZ(false);
+        clamper.setMap(map.get());
+        clamper.setWorkingSet(&workingSet);
+        line->accept(clamper);
+
+        REQUIRE(maxHeightError(line.get(), wgs84, 500.0) < 1.0);
+
+        // re-clamping everything consumes all the marked vertices
+        REQUIRE(clamper.dirty(TileKey::INVALID) == 8u);
+        REQUIRE(clamper.hasPendingWork());
+        REQUIRE(clamper.update(1u));
+        REQUIRE(!clamper.hasPendingWork());
+        REQUIRE(maxHeightError(line.get(), wgs84, 500.0) < 1.0);
+    }
+
+    SECTION("Geometry is clamped through a projected map profile") {
+        osg::ref_ptr<Map> map = new Map();
+        map->setProfile(Profile::create("spherical-mercator"));
+        map->addLayer(new ConstantElevationLayer());
+
+        osg::ref_ptr<osg::Geode> line = makeLine(wgs84);
+
+        GeometryClamper::LocalData data;
+        GeometryClamper clamper(data);
+        clamper.setTerrainSRS(wgs84);
+        clamper.setUseVertexZ(false);
+        clamper.setMap(map.get());
+        line->accept(clamper);
+
+        REQUIRE(maxHeightError(line.get(), wgs84, 500.0) < 1.0);
+    }
+}
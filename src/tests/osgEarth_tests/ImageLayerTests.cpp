@@ -70,4 +70,82 @@ TEST_CASE("Attribution works")
 
     REQUIRE(status.isOK());
     REQUIRE(layer->getAttribution() == attribution);
-}
\ No newline at end of file
+}
+namespace
+{
+    // Reports a 20x20 grid of one-degree data extents (LODs 0-12)
+    // plus a global extent (LODs 0-5).
+    class DataExtentsImageLayer : public ImageLayer
+    {
+    public:
+        META_Layer(osgEarth, DataExtentsImageLayer, Options, ImageLayer, data_extents_image);
+
+        virtual void init()
+        {
+            ImageLayer::init();
+            layerHints().cachePolicy() = CachePolicy::NO_CACHE;
+        }
+
+        virtual Status openImplementation()
+        {
+            Status parent = ImageLayer::openImplementation();
+            if (parent.isError())
+                return parent;
+
+            setProfile(Profile::create("global-geodetic"));
+            const SpatialReference* srs = getProfile()->getSRS();
+
+            for (int x = 0; x < 20; ++x)
+                for (int y = 40; y < 60; ++y)
+                    dataExtents().push_back(DataExtent(GeoExtent(srs, x, y, x + 1, y + 1), 0, 12));
+
+            dataExtents().push_back(DataExtent(getProfile()->getExtent(), 0, 5));
+            dirtyDataExtents();
+
+            return Status::NoError;
+        }
+
+    protected:
+        virtual ~DataExtentsImageLayer() { }
+    };
+}
+
+TEST_CASE("Data extents limit the available tile keys")
+{
+    osg::ref_ptr<DataExtentsImageLayer> layer = new DataExtentsImageLayer();
+    REQUIRE(layer->open().isOK());
+
+    const Profile* profile = layer->getProfile();
+    REQUIRE(profile != NULL);
+    REQUIRE(layer->getDataExtents().size() == 401u);
+
+    SECTION("Keys inside the detailed extents have data")
+    {
+        TileKey key = profile->createTileKey(10.5, 50.5, 10);
+        REQUIRE(layer->mayHaveData(key));
+        REQUIRE(layer->getBestAvailableTileKey(key) == key);
+    }
+
+    SECTION("Keys past the detailed max level fall back to it")
+    {
+        TileKey key = profile->createTileKey(10.5, 50.5, 14);
+        REQUIRE(!layer->mayHaveData(key));
+        REQUIRE(layer->getBestAvailableTileKey(key) == key.createAncestorKey(12));
+    }
+
+    SECTION("Keys outside the detailed extents fall back to the global extent")
+    {
+        TileKey key = profile->createTileKey(-150.5, 0.5, 10);
+        REQUIRE(!layer->mayHaveData(key));
+        REQUIRE(layer->getBestAvailableTileKey(key) == key.createAncestorKey(5));
+    }
+
+    SECTION("Keys in another profile are supported")
+    {
+        osg::ref_ptr<const Profile> mercator = Profile::create("spherical-mercator");
+        GeoPoint point(profile->getSRS(), 10.5, 50.5);
+        GeoPoint pointMerc = point.transform(mercator->getSRS());
+        TileKey key = mercator->createTileKey(pointMerc.x(), pointMerc.y(), 10);
+        REQUIRE(layer->mayHaveData(key));
+    }
+}
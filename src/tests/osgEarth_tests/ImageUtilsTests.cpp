@@ -0,0 +1,240 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Random>
+#include <string.h>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    osg::Image* makeImage(int s, int t, GLenum pixelFormat, GLenum dataType, unsigned seed)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(s, t, 1, pixelFormat, dataType);
+        Random prng(seed);
+        unsigned char* data = image->data();
+        if (dataType == GL_FLOAT)
+        {
+            for (unsigned i = 0; i < image->getTotalSizeInBytes() / sizeof(float); ++i)
+                ((float*)data)[i] = (float)(prng.next() * 8000.0 - 500.0);
+        }
+        else
+        {
+            for (unsigned i = 0; i < image->getTotalSizeInBytes(); ++i)
+                data[i] = (unsigned char)prng.next(256);
+        }
+        return image;
+    }
+
+    bool sameData(const osg::Image* a, const osg::Image* b)
+    {
+        return
+            a && b &&
+            a->getTotalSizeInBytes() == b->getTotalSizeInBytes() &&
+            ::memcmp(a->data(), b->data(), a->getTotalSizeInBytes()) == 0;
+    }
+
+    // Restores the kernel setting when a section exits.
+    struct KernelToggle
+    {
+        bool _old;
+        KernelToggle(bool value) : _old(ImageUtils::setPixelKernelsEnabled(value)) { }
+        ~KernelToggle() { ImageUtils::setPixelKernelsEnabled(_old); }
+    };
+
+    struct Format { GLenum pixelFormat, dataType; };
+}
+
+TEST_CASE( "ImageUtils pixel kernels match the generic path" )
+{
+    const Format formats[] = {
+        { GL_RGBA, GL_UNSIGNED_BYTE },
+        { GL_RGB, GL_UNSIGNED_BYTE },
+        { GL_RED, GL_FLOAT },
+        { GL_RG, GL_UNSIGNED_SHORT }
+    };
+    const unsigned numFormats = sizeof(formats)/sizeof(formats[0]);
+
+    osg::ref_ptr<osg::Image> inputs[numFormats];
+    for (unsigned f = 0; f < numFormats; ++f)
+        inputs[f] = makeImage(67, 45, formats[f].pixelFormat, formats[f].dataType, 17u + f);
+
+    SECTION("resizeImage")
+    {
+        for (unsigned f = 0; f < numFormats; ++f)
+        {
+            for (int bilinear = 0; bilinear < 2; ++bilinear)
+            {
+                osg::ref_ptr<osg::Image> fast, slow;
+                {
+                    KernelToggle toggle(true);
+                    REQUIRE(ImageUtils::resizeImage(inputs[f].get(), 128, 31, fast, 0, bilinear != 0));
+                }
+                {
+                    KernelToggle toggle(false);
+                    REQUIRE(ImageUtils::resizeImage(inputs[f].get(), 128, 31, slow, 0, bilinear != 0));
+                }
+                REQUIRE(sameData(fast.get(), slow.get()));
+            }
+        }
+    }
+
+    SECTION("mix")
+    {
+        for (unsigned f = 0; f < numFormats; ++f)
+        {
+            osg::ref_ptr<osg::Image> fast = ImageUtils::cloneImage(inputs[f].get());
+            osg::ref_ptr<osg::Image> slow = ImageUtils::cloneImage(inputs[f].get());
+            {
+                KernelToggle toggle(true);
+                REQUIRE(ImageUtils::mix(fast.get(), inputs[0].get(), 0.6f));
+            }
+            {
+                KernelToggle toggle(false);
+                REQUIRE(ImageUtils::mix(slow.get(), inputs[0].get(), 0.6f));
+            }
+            REQUIRE(sameData(fast.get(), slow.get()));
+        }
+    }
+
+    SECTION("convert")
+    {
+        for (unsigned f = 0; f < numFormats; ++f)
+        {
+            for (unsigned g = 0; g < numFormats; ++g)
+            {
+                osg::ref_ptr<osg::Image> fast, slow;
+                {
+                    KernelToggle toggle(true);
+                    fast = ImageUtils::convert(inputs[f].get(), formats[g].pixelFormat, formats[g].dataType);
+                }
+                {
+                    KernelToggle toggle(false);
+                    slow = ImageUtils::convert(inputs[f].get(), formats[g].pixelFormat, formats[g].dataType);
+                }
+                REQUIRE(sameData(fast.get(), slow.get()));
+            }
+        }
+    }
+
+    SECTION("featherAlphaRegions")
+    {
+        osg::ref_ptr<osg::Image> fast = ImageUtils::cloneImage(inputs[0].get());
+        osg::ref_ptr<osg::Image> slow = ImageUtils::cloneImage(inputs[0].get());
+        {
+            KernelToggle toggle(true);
+            REQUIRE(ImageUtils::featherAlphaRegions(fast.get(), 0.5f));
+        }
+        {
+            KernelToggle toggle(false);
+            REQUIRE(ImageUtils::featherAlphaRegions(slow.get(), 0.5f));
+        }
+        REQUIRE(sameData(fast.get(), slow.get()));
+    }
+
+    SECTION("bicubicUpsample")
+    {
+        for (unsigned f = 0; f < numFormats; ++f)
+        {
+            osg::ref_ptr<osg::Image> source = makeImage(19, 19, formats[f].pixelFormat, formats[f].dataType, 5u);
+            for (unsigned quadrant = 0; quadrant < 4; ++quadrant)
+            {
+                osg::ref_ptr<osg::Image> fast = makeImage(19, 19, formats[f].pixelFormat, formats[f].dataType, 0u);
+                osg::ref_ptr<osg::Image> slow = ImageUtils::cloneImage(fast.get());
+                {
+                    KernelToggle toggle(true);
+                    REQUIRE(ImageUtils::bicubicUpsample(source.get(), fast.get(), quadrant, 4u));
+                }
+                {
+                    KernelToggle toggle(false);
+                    REQUIRE(ImageUtils::bicubicUpsample(source.get(), slow.get(), quadrant, 4u));
+                }
+                REQUIRE(sameData(fast.get(), slow.get()));
+            }
+        }
+    }
+}
+
+TEST_CASE( "ImageUtils empty and single-color tests use the pixel kernels" )
+{
+    osg::ref_ptr<osg::Image> image = ImageUtils::createEmptyImage(64, 64);
+    REQUIRE(ImageUtils::isEmptyImage(image.get()));
+    REQUIRE(ImageUtils::isSingleColorImage(image.get()));
+
+    // one faint pixel at the very end of the image:
+    ImageUtils::PixelWriter write(image.get());
+    write(osg::Vec4(0.0f, 0.0f, 0.0f, 0.02f), 63, 63);
+
+    REQUIRE(ImageUtils::isEmptyImage(image.get(), 0.05f));
+    REQUIRE_FALSE(ImageUtils::isEmptyImage(image.get(), 0.01f));
+    REQUIRE(ImageUtils::isSingleColorImage(image.get(), 0.05f));
+    REQUIRE_FALSE(ImageUtils::isSingleColorImage(image.get(), 0.01f));
+
+    KernelToggle toggle(false);
+    REQUIRE(ImageUtils::isEmptyImage(image.get(), 0.05f));
+    REQUIRE_FALSE(ImageUtils::isEmptyImage(image.get(), 0.01f));
+    REQUIRE(ImageUtils::isSingleColorImage(image.get(), 0.05f));
+    REQUIRE_FALSE(ImageUtils::isSingleColorImage(image.get(), 0.01f));
+}
+
+TEST_CASE( "ImageUtils cropAndResizeImage upsamples a window in one pass" )
+{
+    osg::ref_ptr<osg::Image> source = makeImage(4, 4, GL_RGBA, GL_UNSIGNED_BYTE, 7u);
+
+    SECTION("Nearest neighbor replicates the window's pixels")
+    {
+        // upper-right quadrant, doubled in size:
+        osg::ref_ptr<osg::Image> result = ImageUtils::cropAndResizeImage(
+            source.get(), 0.5, 0.5, 1.0, 1.0, 8, 8, false);
+
+        REQUIRE(result.valid());
+        REQUIRE(result->s() == 8);
+        REQUIRE(result->t() == 8);
+        REQUIRE(result->getPixelFormat() == source->getPixelFormat());
+
+        ImageUtils::PixelReader readSource(source.get());
+        ImageUtils::PixelReader readResult(result.get());
+        for (int t = 0; t < 8; ++t)
+            for (int s = 0; s < 8; ++s)
+                REQUIRE(readResult(s, t) == readSource(2 + s/4, 2 + t/4));
+    }
+
+    SECTION("Bilinear keeps a solid color solid")
+    {
+        osg::ref_ptr<osg::Image> solid = ImageUtils::createOnePixelImage(osg::Vec4(0.25f, 0.5f, 0.75f, 1.0f));
+        osg::ref_ptr<osg::Image> result = ImageUtils::cropAndResizeImage(
+            solid.get(), 0.25, 0.25, 0.5, 0.5, 16, 16, true);
+
+        REQUIRE(result.valid());
+        REQUIRE(ImageUtils::isSingleColorImage(result.get()));
+    }
+
+    SECTION("An empty window fails")
+    {
+        REQUIRE(ImageUtils::cropAndResizeImage(source.get(), 0.5, 0.5, 0.5, 1.0, 8, 8) == 0L);
+    }
+}
@@ -0,0 +1,96 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/ImageWarp>
+#include <osgEarth/SpatialReference>
+#include <cmath>
+#include <limits>
+
+using namespace osgEarth;
+
+namespace
+{
+    osg::Image* makeFloatImage(int s, int t)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(s, t, 1, GL_LUMINANCE, GL_FLOAT);
+        for (int y = 0; y < t; ++y)
+            for (int x = 0; x < s; ++x)
+                *(float*)image->data(x, y) = (float)(x + 10 * y);
+        return image;
+    }
+
+    float at(const osg::Image* image, int x, int y)
+    {
+        return *(const float*)image->data(x, y);
+    }
+}
+
+TEST_CASE( "ImageWarp" ) {
+
+    const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+    GeoExtent extent(wgs84, 0.0, 0.0, 8.0, 8.0);
+
+    SECTION("Bilinear sampling skips NaN and no-data neighbours") {
+        osg::ref_ptr<osg::Image> source = makeFloatImage(8, 8);
+        *(float*)source->data(3, 3) = std::numeric_limits<float>::quiet_NaN();
+        *(float*)source->data(5, 2) = NO_DATA_VALUE;
+
+        osg::ref_ptr<osg::Image> result = ImageWarp::warp(
+            source.get(), extent, extent, 8, 8, true, ImageWarp::PIXEL_IS_AREA);
+        REQUIRE(result.valid());
+
+        for (int y = 0; y < 8; ++y)
+        {
+            for (int x = 0; x < 8; ++x)
+            {
+                float value = at(result.get(), x, y);
+                if (x == 3 && y == 3)
+                {
+                    REQUIRE(value != value);
+                }
+                else if (x == 5 && y == 2)
+                {
+                    REQUIRE(value == NO_DATA_VALUE);
+                }
+                else
+                {
+                    REQUIRE(fabs(value - (float)(x + 10 * y)) < 1e-3f);
+                }
+            }
+        }
+    }
+
+    SECTION("Single-column images are sampled per pixel") {
+        osg::ref_ptr<osg::Image> source = makeFloatImage(1, 8);
+        GeoExtent column(wgs84, 0.0, 0.0, 1.0, 8.0);
+
+        osg::ref_ptr<osg::Image> result = ImageWarp::warp(
+            source.get(), column, column, 1, 8, false, ImageWarp::PIXEL_IS_AREA);
+        REQUIRE(result.valid());
+
+        for (int y = 0; y < 8; ++y)
+            REQUIRE(at(result.get(), 0, y) == (float)(10 * y));
+    }
+}
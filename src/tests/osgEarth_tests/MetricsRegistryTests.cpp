@@ -0,0 +1,86 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/MetricsRegistry>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+TEST_CASE( "MetricsRegistry" ) {
+
+    MetricsRegistry registry;
+
+    SECTION("Counter")
+    {
+        MetricsRegistry::Counter* c = registry.counter("test_total", "test counter");
+        REQUIRE(c != NULL);
+        c->add();
+        c->add(4);
+        REQUIRE(c->value() == 5u);
+
+        // same name and labels yields the same counter
+        REQUIRE(registry.counter("test_total", "test counter") == c);
+
+        // different labels yield a different one
+        MetricsRegistry::Labels labels;
+        labels.push_back(std::make_pair("layer", "a"));
+        REQUIRE(registry.counter("test_total", "test counter", labels) != c);
+
+        // a name can only hold one kind of metric
+        REQUIRE(registry.gauge("test_total", "test gauge") == NULL);
+    }
+
+    SECTION("Histogram")
+    {
+        MetricsRegistry::Histogram* h = registry.histogram("test_seconds", "test histogram");
+        REQUIRE(h != NULL);
+        for (int i = 1; i <= 1000; ++i)
+            h->record(0.001 * (double)i);
+
+        REQUIRE(h->count() == 1000u);
+        REQUIRE(h->min() == Approx(0.001).epsilon(0.05));
+        REQUIRE(h->max() == Approx(1.0).epsilon(0.05));
+        REQUIRE(h->quantile(0.5) == Approx(0.5).epsilon(0.05));
+        REQUIRE(h->quantile(0.99) == Approx(0.99).epsilon(0.05));
+    }
+
+    SECTION("Export")
+    {
+        registry.counter("test_total", "test counter")->add(3);
+        registry.gauge("test_depth", "test gauge")->set(7.0);
+        registry.histogram("test_seconds", "test histogram")->record(0.25);
+
+        std::string prom = registry.toPrometheus();
+        REQUIRE(prom.find("# TYPE test_total counter") != std::string::npos);
+        REQUIRE(prom.find("test_total 3") != std::string::npos);
+        REQUIRE(prom.find("test_depth 7") != std::string::npos);
+        REQUIRE(prom.find("test_seconds_count 1") != std::string::npos);
+
+        std::string json = registry.toJSON();
+        REQUIRE(json.find("\"test_total\"") != std::string::npos);
+        REQUIRE(json.find("\"histograms\"") != std::string::npos);
+
+        registry.reset();
+        REQUIRE(registry.counter("test_total", "test counter")->value() == 0u);
+    }
+}
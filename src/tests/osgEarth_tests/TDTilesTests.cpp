@@ -0,0 +1,174 @@
+/* -*-c++-*- */
+/* osgEarth - Geospatial SDK for OpenSceneGraph
+* Copyright 2020 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+#include <osgEarth/TDTiles>
+#include <osgUtil/UpdateVisitor>
+
+using namespace osgEarth;
+using namespace osgEarth::Contrib::ThreeDTiles;
+
+namespace
+{
+    const char* s_tileset =
+        "{"
+        "  \"asset\": { \"version\": \"1.0\" },"
+        "  \"geometricError\": 500,"
+        "  \"extras\": { \"children\": [ { \"geometricError\": 1 } ] },"
+        "  \"root\": {"
+        "    \"boundingVolume\": { \"region\": [ -1.2, 0.6, -1.1, 0.7, 0, 100 ] },"
+        "    \"geometricError\": 100,"
+        "    \"refine\": \"ADD\","
+        "    \"transform\": [ 1,0,0,0, 0,1,0,0, 0,0,1,0, 10,20,30,1 ],"
+        "    \"children\": ["
+        "      {"
+        "        \"boundingVolume\": { \"box\": [ 0,0,0, 10,0,0, 0,20,0, 0,0,30 ] },"
+        "        \"geometricError\": 50,"
+        "        \"refine\": \"REPLACE\","
+        "        \"children\": ["
+        "          { \"boundingVolume\": { \"sphere\": [ 1,2,3,4 ] }, \"geometricError\": 0, \"content\": { \"uri\": \"a.b3dm\" } },"
+        "          { \"boundingVolume\": { \"sphere\": [ 5,6,7,8 ] }, \"geometricError\": 0, \"content\": { \"url\": \"b.b3dm\", \"extras\": [ {}, [] ] } }"
+        "        ]"
+        "      },"
+        "      { \"boundingVolume\": { \"sphere\": [ 0,0,0,9 ] }, \"geometricError\": 25, \"content\": { \"uri\": \"c.b3dm\" } }"
+        "    ]"
+        "  }"
+        "}";
+}
+
+TEST_CASE( "3D Tiles tileset parsing" ) {
+
+    SECTION("Matches the DOM parser")
+    {
+        Json::Reader reader;
+        Json::Value value;
+        REQUIRE(reader.parse(s_tileset, value, false));
+        LoadContext lc;
+        osg::ref_ptr<Tileset> dom = new Tileset(value, lc);
+
+        osg::ref_ptr<Tileset> sax = Tileset::create(s_tileset, URIContext(), 8u);
+        REQUIRE(sax.valid());
+
+        Json::FastWriter writer;
+        REQUIRE(writer.write(sax->getJSON()) == writer.write(dom->getJSON()));
+    }
+
+    SECTION("Defers tiles below the preload depth")
+    {
+        osg::ref_ptr<Tileset> tileset = Tileset::create(s_tileset, URIContext(), 1u);
+        REQUIRE(tileset.valid());
+        REQUIRE(tileset->asset()->version().get() == "1.0");
+        REQUIRE(tileset->geometricError().get() == 500.0);
+
+        Tile* root = tileset->root().get();
+        REQUIRE(root != NULL);
+        REQUIRE(root->getChildrenLoaded() == true);
+        REQUIRE(root->children().size() == 2u);
+        REQUIRE(root->transform()->getTrans() == osg::Vec3d(10, 20, 30));
+
+        Tile* child = root->children()[0].get();
+        REQUIRE(child->refine().get() == REFINE_REPLACE);
+        REQUIRE(child->boundingVolume()->box()->xMax() == 10.0);
+        REQUIRE(child->getChildrenLoaded() == false);
+        REQUIRE(child->children().empty());
+        REQUIRE(child->getNumChildren() == 2u);
+
+        // the deferred tiles still appear in the JSON:
+        REQUIRE(child->getJSON()["children"].size() == 2u);
+
+        REQUIRE(child->loadChildren() == true);
+        REQUIRE(child->getChildrenLoaded() == true);
+        REQUIRE(child->children().size() == 2u);
+        REQUIRE(child->children()[0]->content()->uri()->base() == "a.b3dm");
+        REQUIRE(child->children()[1]->content()->uri()->base() == "b.b3dm");
+        REQUIRE(child->children()[1]->boundingVolume()->sphere()->radius() == 8.0);
+    }
+
+    SECTION("Unloads and reloads children")
+    {
+        osg::ref_ptr<Tileset> tileset = Tileset::create(s_tileset, URIContext(), 0u);
+        REQUIRE(tileset.valid());
+
+        Tile* root = tileset->root().get();
+        REQUIRE(root->getNumChildren() == 2u);
+        REQUIRE(root->children().empty());
+
+        REQUIRE(root->loadChildren() == true);
+        REQUIRE(root->children()[1]->geometricError().get() == 25.0);
+
+        REQUIRE(root->unloadChildren() == true);
+        REQUIRE(root->children().empty());
+        REQUIRE(root->getNumChildren() == 2u);
+
+        REQUIRE(root->loadChildren() == true);
+        REQUIRE(root->children()[0]->getNumChildren() == 2u);
+        REQUIRE(root->children()[0]->geometricError().get() == 50.0);
+    }
+
+    SECTION("Rejects invalid JSON")
+    {
+        REQUIRE(Tileset::create("{ \"root\": { \"children\": [", URIContext()) == NULL);
+        REQUIRE(Tileset::create("[ 1, 2 ]", URIContext()) == NULL);
+    }
+}
+
+TEST_CASE( "3D Tiles content scheduler" ) {
+
+    SECTION("Releases the request when the content fails to load")
+    {
+        osg::ref_ptr<Tileset> tileset = Tileset::create(s_tileset, URIContext(), 8u);
+        REQUIRE(tileset.valid());
+
+        osg::ref_ptr<ThreeDTilesetNode> tilesetNode = new ThreeDTilesetNode(tileset.get(), "", 0L, 0L);
+        tilesetNode->setMaxConcurrentRequests(1u);
+
+        // "c.b3dm" does not exist
+        Tile* tile = tileset->root()->children()[1].get();
+        osg::ref_ptr<ThreeDTileNode> node = new ThreeDTileNode(tilesetNode.get(), tile, false, 0L);
+        node->requestContent(0L, 1.0, 1.0);
+
+        osg::ref_ptr<osg::FrameStamp> frame = new osg::FrameStamp();
+        osgUtil::UpdateVisitor update;
+        update.setFrameStamp(frame.get());
+
+        // Starts the request. There is no thread pool, so the read runs
+        // (and fails) right away.
+        frame->setFrameNumber(1);
+        tilesetNode->accept(update);
+        REQUIRE(tilesetNode->getNumActiveRequests() == 1u);
+
+        // Resolving records the failure and ends the request.
+        REQUIRE(node->isContentReady());
+        REQUIRE(node->isContentFailed());
+        REQUIRE(!node->isContentRequested());
+        REQUIRE(node->getContent() == 0L);
+
+        // The slot is released, and the tile is not requested again.
+        node->requestContent(0L, 1.0, 1.0);
+        frame->setFrameNumber(2);
+        tilesetNode->accept(update);
+        REQUIRE(tilesetNode->getNumActiveRequests() == 0u);
+
+        node->startRequest(0L);
+        REQUIRE(!node->isContentRequested());
+    }
+}
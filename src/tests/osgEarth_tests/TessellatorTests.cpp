@@ -0,0 +1,196 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2018 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Tessellator>
+#include <osg/Geometry>
+#include <osgUtil/Tessellator>
+#include <algorithm>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Util;
+
+namespace
+{
+    typedef std::vector<osg::Vec3> Ring;
+
+    // A geometry with one LINE_LOOP per ring, outer ring first.
+    osg::Geometry* makePolygon(const std::vector<Ring>& rings)
+    {
+        osg::Geometry* geom = new osg::Geometry();
+        osg::Vec3Array* verts = new osg::Vec3Array();
+        geom->setVertexArray(verts);
+        for (unsigned r = 0; r < rings.size(); ++r)
+        {
+            geom->addPrimitiveSet(new osg::DrawArrays(GL_LINE_LOOP, verts->size(), rings[r].size()));
+            verts->insert(verts->end(), rings[r].begin(), rings[r].end());
+        }
+        return geom;
+    }
+
+    Ring makeCircle(const osg::Vec3& center, float radius, unsigned numVerts, bool ccw)
+    {
+        Ring ring;
+        for (unsigned i = 0; i < numVerts; ++i)
+        {
+            double a = (ccw ? 2.0 : -2.0) * osg::PI * (double)i / (double)numVerts;
+            ring.push_back(center + osg::Vec3(radius * cos(a), radius * sin(a), 0.0f));
+        }
+        return ring;
+    }
+
+    // Sum of the triangle normals (each twice its triangle's area).
+    osg::Vec3d sumNormals(osg::Geometry* geom)
+    {
+        osg::Vec3d sum;
+        const osg::Vec3Array& verts = *static_cast<osg::Vec3Array*>(geom->getVertexArray());
+        for (unsigned p = 0; p < geom->getNumPrimitiveSets(); ++p)
+        {
+            osg::PrimitiveSet* pset = geom->getPrimitiveSet(p);
+            for (unsigned i = 0; i + 2 < pset->getNumIndices(); i += 3)
+            {
+                osg::Vec3d a = verts[pset->index(i)], b = verts[pset->index(i+1)], c = verts[pset->index(i+2)];
+                sum += (b - a) ^ (c - a);
+            }
+        }
+        return sum;
+    }
+
+    double area(osg::Geometry* geom)
+    {
+        double total = 0.0;
+        const osg::Vec3Array& verts = *static_cast<osg::Vec3Array*>(geom->getVertexArray());
+        for (unsigned p = 0; p < geom->getNumPrimitiveSets(); ++p)
+        {
+            osg::PrimitiveSet* pset = geom->getPrimitiveSet(p);
+            REQUIRE(pset->getMode() == GL_TRIANGLES);
+            for (unsigned i = 0; i + 2 < pset->getNumIndices(); i += 3)
+            {
+                osg::Vec3d a = verts[pset->index(i)], b = verts[pset->index(i+1)], c = verts[pset->index(i+2)];
+                total += 0.5 * ((b - a) ^ (c - a)).length();
+            }
+        }
+        return total;
+    }
+}
+
+TEST_CASE("Tessellator::tessellateGeometry") {
+    Tessellator tess;
+
+    SECTION("Square with a hole") {
+        std::vector<Ring> rings(2);
+        rings[0].push_back(osg::Vec3(0, 0, 5));
+        rings[0].push_back(osg::Vec3(10, 0, 5));
+        rings[0].push_back(osg::Vec3(10, 10, 5));
+        rings[0].push_back(osg::Vec3(0, 10, 5));
+        rings[1].push_back(osg::Vec3(2, 2, 5));
+        rings[1].push_back(osg::Vec3(2, 4, 5));
+        rings[1].push_back(osg::Vec3(4, 4, 5));
+        rings[1].push_back(osg::Vec3(4, 2, 5));
+
+        osg::ref_ptr<osg::Geometry> geom = makePolygon(rings);
+        REQUIRE(tess.tessellateGeometry(*geom.get()));
+        REQUIRE(geom->getNumPrimitiveSets() == 1);
+        REQUIRE(geom->getPrimitiveSet(0)->getNumIndices() == 24);
+        REQUIRE(area(geom.get()) == Approx(96.0));
+
+        // faces up, like the CCW outer ring:
+        REQUIRE(sumNormals(geom.get()).z() == Approx(192.0));
+    }
+
+    SECTION("Large ring with many holes") {
+        std::vector<Ring> rings;
+        rings.push_back(makeCircle(osg::Vec3(0, 0, 0), 1000.0f, 4000, true));
+        double expected = 0.5 * 4000.0 * 1000.0 * 1000.0 * sin(2.0 * osg::PI / 4000.0);
+        for (int i = 0; i < 20; ++i)
+        {
+            rings.push_back(makeCircle(osg::Vec3(-500.0f + 50.0f * i, (i % 2) ? 100.0f : -100.0f, 0.0f), 10.0f, 24, false));
+            expected -= 0.5 * 24.0 * 10.0 * 10.0 * sin(2.0 * osg::PI / 24.0);
+        }
+
+        osg::ref_ptr<osg::Geometry> geom = makePolygon(rings);
+        REQUIRE(tess.tessellateGeometry(*geom.get()));
+        REQUIRE(area(geom.get()) == Approx(expected).epsilon(1e-4));
+    }
+
+    SECTION("Vertical polygon faces the same way as its ring") {
+        std::vector<Ring> rings(1);
+        rings[0].push_back(osg::Vec3(0, 3, 0));
+        rings[0].push_back(osg::Vec3(10, 3, 0));
+        rings[0].push_back(osg::Vec3(10, 3, 5));
+        rings[0].push_back(osg::Vec3(0, 3, 5));
+
+        osg::ref_ptr<osg::Geometry> geom = makePolygon(rings);
+        REQUIRE(tess.tessellateGeometry(*geom.get()));
+        REQUIRE(area(geom.get()) == Approx(50.0));
+        REQUIRE(sumNormals(geom.get()).y() == Approx(-100.0));
+    }
+
+    SECTION("Matches the OSG tessellator on a concave polygon") {
+        // a comb with 50 teeth
+        std::vector<Ring> rings(1);
+        for (int i = 0; i < 50; ++i)
+        {
+            rings[0].push_back(osg::Vec3(2.0f * i, 0, 0));
+            rings[0].push_back(osg::Vec3(2.0f * i + 1.0f, 0, 0));
+            rings[0].push_back(osg::Vec3(2.0f * i + 1.0f, 10, 0));
+            rings[0].push_back(osg::Vec3(2.0f * i + 2.0f, 10, 0));
+        }
+        rings[0].push_back(osg::Vec3(100, -5, 0));
+        rings[0].push_back(osg::Vec3(0, -5, 0));
+        std::reverse(rings[0].begin(), rings[0].end());
+
+        osg::ref_ptr<osg::Geometry> geom = makePolygon(rings);
+        REQUIRE(tess.tessellateGeometry(*geom.get()));
+
+        osg::ref_ptr<osg::Geometry> reference = makePolygon(rings);
+        osgUtil::Tessellator glu;
+        glu.setTessellationType(osgUtil::Tessellator::TESS_TYPE_GEOMETRY);
+        glu.setWindingType(osgUtil::Tessellator::TESS_WINDING_ODD);
+        glu.retessellatePolygons(*reference.get());
+
+        REQUIRE(area(geom.get()) == Approx(area(reference.get())));
+    }
+
+    SECTION("Self-intersecting ring is left alone") {
+        std::vector<Ring> rings(1);
+        rings[0].push_back(osg::Vec3(0, 0, 0));
+        rings[0].push_back(osg::Vec3(10, 10, 0));
+        rings[0].push_back(osg::Vec3(10, 0, 0));
+        rings[0].push_back(osg::Vec3(0, 10, 0));
+
+        osg::ref_ptr<osg::Geometry> geom = makePolygon(rings);
+        REQUIRE_FALSE(tess.tessellateGeometry(*geom.get()));
+        REQUIRE(geom->getNumPrimitiveSets() == 1);
+        REQUIRE(geom->getPrimitiveSet(0)->getMode() == GL_LINE_LOOP);
+    }
+
+    SECTION("Geometry that is not a polygon is rejected") {
+        osg::ref_ptr<osg::Geometry> geom = new osg::Geometry();
+        geom->setVertexArray(new osg::Vec3Array(3));
+        geom->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, 3));
+        REQUIRE_FALSE(tess.tessellateGeometry(*geom.get()));
+    }
+}